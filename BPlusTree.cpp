@@ -0,0 +1,553 @@
+/**
+ * @file BPlusTree.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the BPlusTree class.
+ * @see BPlusTree.h for declaration.
+ */
+
+#include "BPlusTree.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ZIPCODES_HAVE_PREAD 1
+#endif
+
+constexpr char BPlusTree::MAGIC[8];
+
+namespace {
+
+/**
+ * @brief Orders two zero-padded keys.
+ */
+int compareKeys(const char* a, const char* b) {
+    return std::memcmp(a, b, KeyIndexEntry::KEY_WIDTH);
+}
+
+/**
+ * @brief Orders entries by their zero-padded keys.
+ */
+bool keyLess(const KeyIndexEntry& a, const KeyIndexEntry& b) {
+    return compareKeys(a.key, b.key) < 0;
+}
+
+} // namespace
+
+/**
+ * @brief Default constructor. No tree is open.
+ */
+BPlusTree::BPlusTree() : fd(-1), poolFile(BufferPool::NO_FILE), writable(false), header(), root(), reads(0) {
+}
+
+BPlusTree::~BPlusTree() {
+    close();
+}
+
+/**
+ * @brief Sorts 'entries' by key and writes them as a new tree.
+ * @param fileName Name of the tree file to create.
+ * @param entries The index entries, in any order. Keys must be unique.
+ * @param keyField Field of the records the keys were taken from.
+ * @return true if the file was written, false otherwise.
+ */
+bool BPlusTree::Build(const std::string& fileName, std::vector<KeyIndexEntry> entries, std::uint32_t keyField) {
+    std::sort(entries.begin(), entries.end(), keyLess);
+    std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error: Failed to open the index file for writing." << std::endl;
+        return false;
+    }
+
+    FileHeader fileHeader{};
+    std::memcpy(fileHeader.magic, MAGIC, sizeof(fileHeader.magic));
+    fileHeader.version = VERSION;
+    fileHeader.pageSize = PAGE_SIZE;
+    fileHeader.keyWidth = KeyIndexEntry::KEY_WIDTH;
+    fileHeader.byteOrder = BYTE_ORDER_MARK;
+    fileHeader.keyCount = entries.size();
+    fileHeader.keyField = keyField;
+    fileHeader.firstLeaf = 1;
+
+    // Page 0 is written last, once the root is known.
+    Page page{};
+    out.write(page.bytes, PAGE_SIZE);
+    std::uint32_t nextPage = 1;
+
+    // Leaves, full and linked in key order. An empty tree is one empty leaf.
+    std::vector<std::pair<KeyIndexEntry, std::uint32_t>> level;
+    std::size_t done = 0;
+    do {
+        page = Page{};
+        NodeHeader& node = nodeOf(page);
+        node.kind = LEAF;
+        node.count = static_cast<std::uint32_t>(std::min(LEAF_CAPACITY, entries.size() - done));
+        node.next = done + node.count < entries.size() ? nextPage + 1 : 0;
+        std::copy_n(entries.begin() + static_cast<std::ptrdiff_t>(done), node.count, leafEntries(page));
+        level.emplace_back(node.count > 0 ? entries[done] : KeyIndexEntry{}, nextPage++);
+        done += node.count;
+        out.write(page.bytes, PAGE_SIZE);
+    } while (done < entries.size());
+
+    // Internal levels, each holding the first key of every child but the first as its separators.
+    std::uint32_t height = 1;
+    while (level.size() > 1) {
+        std::vector<std::pair<KeyIndexEntry, std::uint32_t>> parents;
+        for (std::size_t first = 0; first < level.size(); first += INTERNAL_CAPACITY + 1) {
+            const std::size_t last = std::min(level.size(), first + INTERNAL_CAPACITY + 1);
+            page = Page{};
+            NodeHeader& node = nodeOf(page);
+            node.kind = INTERNAL;
+            node.count = static_cast<std::uint32_t>(last - first - 1);
+            node.firstChild = level[first].second;
+            InternalSlot* slots = internalSlots(page);
+            for (std::size_t child = first + 1; child < last; child++) {
+                std::memcpy(slots->key, level[child].first.key, KeyIndexEntry::KEY_WIDTH);
+                slots->child = level[child].second;
+                slots++;
+            }
+            parents.emplace_back(level[first].first, nextPage++);
+            out.write(page.bytes, PAGE_SIZE);
+        }
+        level = std::move(parents);
+        height++;
+    }
+
+    fileHeader.rootPage = level.front().second;
+    fileHeader.height = height;
+    fileHeader.pageCount = nextPage;
+    page = Page{};
+    std::memcpy(page.bytes, &fileHeader, sizeof(fileHeader));
+    out.seekp(0);
+    out.write(page.bytes, PAGE_SIZE);
+    return static_cast<bool>(out.flush());
+}
+
+/**
+ * @brief Opens a tree file and caches its root page.
+ * @param fileName Name of the tree file.
+ * @param writable When true, Insert() and Erase() may change the file.
+ * @return true if the file is a valid tree for this host, false otherwise.
+ */
+bool BPlusTree::Open(const std::string& fileName, bool writable) {
+    close();
+#ifdef ZIPCODES_HAVE_PREAD
+    fd = ::open(fileName.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat status;
+    const std::uint64_t fileSize = ::fstat(fd, &status) == 0 ? static_cast<std::uint64_t>(status.st_size) : 0;
+#else
+    stream.open(fileName, std::ios::binary | std::ios::in | (writable ? std::ios::out : std::ios::openmode())
+                          | std::ios::ate);
+    if (!stream.is_open()) {
+        return false;
+    }
+    const std::uint64_t fileSize = static_cast<std::uint64_t>(stream.tellg());
+#endif
+    poolFile = BufferPool::Shared().OpenFile(fileName);
+    this->writable = writable;
+    Page page;
+    bool valid = poolFile != BufferPool::NO_FILE && fileSize >= PAGE_SIZE && readAt(0, page);
+    if (valid) {
+        std::memcpy(&header, page.bytes, sizeof(header));
+        valid = std::memcmp(header.magic, MAGIC, sizeof(header.magic)) == 0
+                && header.version == VERSION
+                && header.pageSize == PAGE_SIZE
+                && header.keyWidth == KeyIndexEntry::KEY_WIDTH
+                && header.byteOrder == BYTE_ORDER_MARK
+                && header.height >= 1
+                && header.rootPage > 0 && header.rootPage < header.pageCount
+                && fileSize >= std::uint64_t(header.pageCount) * PAGE_SIZE
+                && readAt(header.rootPage, root)
+                && nodeOf(root).kind == (header.height == 1 ? LEAF : INTERNAL);
+    }
+    if (!valid) {
+        std::cerr << "Error: " << fileName << " is not a version " << VERSION << " B+ tree index." << std::endl;
+        close();
+        return false;
+    }
+    reads = 0;
+    return true;
+}
+
+bool BPlusTree::isOpen() const {
+#ifdef ZIPCODES_HAVE_PREAD
+    return fd >= 0;
+#else
+    return stream.is_open();
+#endif
+}
+
+/**
+ * @brief Looks a key up.
+ * @param key The key.
+ * @param entry Receives the entry of the key.
+ * @return true if the key is in the tree, false otherwise.
+ */
+bool BPlusTree::Find(std::string_view key, KeyIndexEntry& entry) const {
+    KeyIndexEntry probe;
+    Page leaf;
+    if (!isOpen() || !probe.SetKey(key) || findLeaf(probe, leaf, nullptr) == 0) {
+        return false;
+    }
+    const KeyIndexEntry* first = leafEntries(leaf);
+    const KeyIndexEntry* last = first + nodeOf(leaf).count;
+    const KeyIndexEntry* found = std::lower_bound(first, last, probe, keyLess);
+    if (found == last || compareKeys(found->key, probe.key) != 0) {
+        return false;
+    }
+    entry = *found;
+    return true;
+}
+
+/**
+ * @brief Visits the entries in key order, starting at the first key not below 'fromKey'.
+ * @param fromKey Where to start; empty for the first key.
+ * @param visit Called with each entry; returning false stops the scan.
+ * @return false if a page could not be read.
+ */
+bool BPlusTree::Scan(std::string_view fromKey, const std::function<bool(const KeyIndexEntry&)>& visit) const {
+    KeyIndexEntry probe;
+    if (!isOpen() || !probe.SetKey(fromKey)) {
+        return false;
+    }
+    Page leaf;
+    if (findLeaf(probe, leaf, nullptr) == 0) {
+        return false;
+    }
+    const KeyIndexEntry* first = leafEntries(leaf);
+    const KeyIndexEntry* entry = std::lower_bound(first, first + nodeOf(leaf).count, probe, keyLess);
+    while (true) {
+        for (const KeyIndexEntry* last = leafEntries(leaf) + nodeOf(leaf).count; entry != last; ++entry) {
+            if (!visit(*entry)) {
+                return true;
+            }
+        }
+        const std::uint32_t next = nodeOf(leaf).next;
+        if (next == 0) {
+            return true;
+        }
+        if (!readPage(next, leaf)) {
+            return false;
+        }
+        entry = leafEntries(leaf);
+    }
+}
+
+/**
+ * @brief Adds a key, or points an existing key at a new record.
+ * @param entry The key with the offset and length of its record.
+ * @return true if the change was written, false otherwise.
+ */
+bool BPlusTree::Insert(const KeyIndexEntry& entry) {
+    if (!isOpen() || !writable) {
+        return false;
+    }
+    std::vector<std::uint32_t> path;
+    Page leaf;
+    const std::uint32_t leafNumber = findLeaf(entry, leaf, &path);
+    if (leafNumber == 0) {
+        return false;
+    }
+    NodeHeader& node = nodeOf(leaf);
+    KeyIndexEntry* first = leafEntries(leaf);
+    KeyIndexEntry* position = std::lower_bound(first, first + node.count, entry, keyLess);
+    if (position != first + node.count && compareKeys(position->key, entry.key) == 0) {
+        *position = entry;
+        return writePage(leafNumber, leaf);
+    }
+
+    header.keyCount++;
+    if (node.count < LEAF_CAPACITY) {
+        std::copy_backward(position, first + node.count, first + node.count + 1);
+        *position = entry;
+        node.count++;
+        return writePage(leafNumber, leaf) && writeHeader();
+    }
+
+    // Split the full leaf: the lower half stays, the upper half moves to a new page linked after it.
+    std::vector<KeyIndexEntry> merged(first, first + node.count);
+    merged.insert(merged.begin() + (position - first), entry);
+    const std::size_t keep = merged.size() / 2;
+    Page right{};
+    NodeHeader& rightNode = nodeOf(right);
+    rightNode.kind = LEAF;
+    rightNode.count = static_cast<std::uint32_t>(merged.size() - keep);
+    rightNode.next = node.next;
+    std::copy(merged.begin() + static_cast<std::ptrdiff_t>(keep), merged.end(), leafEntries(right));
+    const std::uint32_t rightNumber = header.pageCount++;
+
+    std::memset(first, 0, PAGE_SIZE - sizeof(NodeHeader));
+    std::copy_n(merged.begin(), keep, first);
+    node.count = static_cast<std::uint32_t>(keep);
+    node.next = rightNumber;
+
+    // The new page is written before the old one links to it.
+    return writePage(rightNumber, right) && writePage(leafNumber, leaf)
+           && insertSeparator(path, leafEntries(right)->key, rightNumber) && writeHeader();
+}
+
+/**
+ * @brief Removes a key.
+ * @param key The key.
+ * @return true if the key was in the tree and was removed, false otherwise.
+ */
+bool BPlusTree::Erase(std::string_view key) {
+    KeyIndexEntry probe;
+    if (!isOpen() || !writable || !probe.SetKey(key)) {
+        return false;
+    }
+    Page leaf;
+    const std::uint32_t leafNumber = findLeaf(probe, leaf, nullptr);
+    if (leafNumber == 0) {
+        return false;
+    }
+    NodeHeader& node = nodeOf(leaf);
+    KeyIndexEntry* first = leafEntries(leaf);
+    KeyIndexEntry* last = first + node.count;
+    KeyIndexEntry* found = std::lower_bound(first, last, probe, keyLess);
+    if (found == last || compareKeys(found->key, probe.key) != 0) {
+        return false;
+    }
+    // The page is not merged with its neighbours; the separators above it stay valid bounds.
+    std::copy(found + 1, last, found);
+    std::memset(last - 1, 0, sizeof(KeyIndexEntry));
+    node.count--;
+    header.keyCount--;
+    return writePage(leafNumber, leaf) && writeHeader();
+}
+
+/**
+ * @brief Number of keys in the tree.
+ */
+std::uint64_t BPlusTree::size() const {
+    return isOpen() ? header.keyCount : 0;
+}
+
+/**
+ * @brief Number of levels; 1 when the root is a leaf.
+ */
+std::uint32_t BPlusTree::height() const {
+    return isOpen() ? header.height : 0;
+}
+
+std::uint32_t BPlusTree::pageCount() const {
+    return isOpen() ? header.pageCount : 0;
+}
+
+std::uint32_t BPlusTree::keyField() const {
+    return header.keyField;
+}
+
+/**
+ * @brief Pages read from the file since Open(); the cached root is not counted.
+ */
+std::uint64_t BPlusTree::pageReads() const {
+    return reads;
+}
+
+/**
+ * @brief Closes the tree file.
+ */
+void BPlusTree::close() {
+#ifdef ZIPCODES_HAVE_PREAD
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+#else
+    stream.close();
+#endif
+    if (poolFile != BufferPool::NO_FILE) {
+        BufferPool::Shared().CloseFile(poolFile);
+        poolFile = BufferPool::NO_FILE;
+    }
+    writable = false;
+    header = FileHeader{};
+}
+
+BPlusTree::NodeHeader& BPlusTree::nodeOf(Page& page) {
+    return *reinterpret_cast<NodeHeader*>(page.bytes);
+}
+
+const BPlusTree::NodeHeader& BPlusTree::nodeOf(const Page& page) {
+    return *reinterpret_cast<const NodeHeader*>(page.bytes);
+}
+
+KeyIndexEntry* BPlusTree::leafEntries(Page& page) {
+    return reinterpret_cast<KeyIndexEntry*>(page.bytes + sizeof(NodeHeader));
+}
+
+const KeyIndexEntry* BPlusTree::leafEntries(const Page& page) {
+    return reinterpret_cast<const KeyIndexEntry*>(page.bytes + sizeof(NodeHeader));
+}
+
+BPlusTree::InternalSlot* BPlusTree::internalSlots(Page& page) {
+    return reinterpret_cast<InternalSlot*>(page.bytes + sizeof(NodeHeader));
+}
+
+const BPlusTree::InternalSlot* BPlusTree::internalSlots(const Page& page) {
+    return reinterpret_cast<const InternalSlot*>(page.bytes + sizeof(NodeHeader));
+}
+
+/**
+ * @brief Descends from the root to the leaf that holds, or would hold, 'probe'.
+ * @param path When set, receives the internal pages passed, root first.
+ * @return The leaf's page number, or 0 if a page could not be read.
+ */
+std::uint32_t BPlusTree::findLeaf(const KeyIndexEntry& probe, Page& leaf, std::vector<std::uint32_t>* path) const {
+    std::uint32_t pageNumber = header.rootPage;
+    leaf = root;
+    for (std::uint32_t level = 1; level < header.height; level++) {
+        if (path != nullptr) {
+            path->push_back(pageNumber);
+        }
+        // The child is the one left of the first separator above the probe.
+        const InternalSlot* first = internalSlots(leaf);
+        const InternalSlot* above = std::upper_bound(first, first + nodeOf(leaf).count, probe,
+                                                     [](const KeyIndexEntry& key, const InternalSlot& slot) {
+                                                         return compareKeys(key.key, slot.key) < 0;
+                                                     });
+        pageNumber = above == first ? nodeOf(leaf).firstChild : (above - 1)->child;
+        if (pageNumber == 0 || pageNumber >= header.pageCount || !readPage(pageNumber, leaf)) {
+            return 0;
+        }
+    }
+    return nodeOf(leaf).kind == LEAF ? pageNumber : 0;
+}
+
+/**
+ * @brief Adds a separator and its right child to the parents in 'path', splitting them as needed.
+ * @return false if a write failed.
+ */
+bool BPlusTree::insertSeparator(std::vector<std::uint32_t>& path, const char* key, std::uint32_t child) {
+    InternalSlot carried;
+    std::memcpy(carried.key, key, KeyIndexEntry::KEY_WIDTH);
+    carried.child = child;
+    auto slotLess = [](const InternalSlot& a, const InternalSlot& b) {
+        return compareKeys(a.key, b.key) < 0;
+    };
+    while (!path.empty()) {
+        const std::uint32_t pageNumber = path.back();
+        path.pop_back();
+        Page page;
+        if (!readPage(pageNumber, page)) {
+            return false;
+        }
+        NodeHeader& node = nodeOf(page);
+        InternalSlot* first = internalSlots(page);
+        InternalSlot* position = std::upper_bound(first, first + node.count, carried, slotLess);
+        if (node.count < INTERNAL_CAPACITY) {
+            std::copy_backward(position, first + node.count, first + node.count + 1);
+            *position = carried;
+            node.count++;
+            return writePage(pageNumber, page);
+        }
+
+        // Split the full page: the middle separator moves up and its child becomes the new page's first.
+        std::vector<InternalSlot> merged(first, first + node.count);
+        merged.insert(merged.begin() + (position - first), carried);
+        const std::size_t middle = merged.size() / 2;
+        Page right{};
+        NodeHeader& rightNode = nodeOf(right);
+        rightNode.kind = INTERNAL;
+        rightNode.count = static_cast<std::uint32_t>(merged.size() - middle - 1);
+        rightNode.firstChild = merged[middle].child;
+        std::copy(merged.begin() + static_cast<std::ptrdiff_t>(middle) + 1, merged.end(), internalSlots(right));
+        const std::uint32_t rightNumber = header.pageCount++;
+
+        std::memset(first, 0, PAGE_SIZE - sizeof(NodeHeader));
+        std::copy_n(merged.begin(), middle, first);
+        node.count = static_cast<std::uint32_t>(middle);
+        if (!writePage(rightNumber, right) || !writePage(pageNumber, page)) {
+            return false;
+        }
+        carried = merged[middle];
+        carried.child = rightNumber;
+    }
+
+    // The root split: a new root holds the old one and the carried separator.
+    Page newRoot{};
+    NodeHeader& node = nodeOf(newRoot);
+    node.kind = INTERNAL;
+    node.count = 1;
+    node.firstChild = header.rootPage;
+    *internalSlots(newRoot) = carried;
+    const std::uint32_t rootNumber = header.pageCount++;
+    if (!writePage(rootNumber, newRoot)) {
+        return false;
+    }
+    header.rootPage = rootNumber;
+    header.height++;
+    root = newRoot;
+    return true;
+}
+
+/**
+ * @brief Reads one page; the root is served from its cached copy.
+ * @return false if the read failed.
+ */
+bool BPlusTree::readPage(std::uint32_t pageNumber, Page& page) const {
+    if (pageNumber == header.rootPage) {
+        page = root;
+        return true;
+    }
+    reads++;
+    return readAt(pageNumber, page);
+}
+
+/**
+ * @brief Reads one page through the shared buffer pool.
+ * @return false if the read failed.
+ */
+bool BPlusTree::readAt(std::uint32_t pageNumber, Page& page) const {
+    return BufferPool::Shared().Read(poolFile, std::uint64_t(pageNumber) * PAGE_SIZE, page.bytes, PAGE_SIZE);
+}
+
+/**
+ * @brief Writes one page, keeping the cached root and the buffer pool current.
+ * @return false if the write failed.
+ */
+bool BPlusTree::writePage(std::uint32_t pageNumber, const Page& page) {
+    if (pageNumber == header.rootPage) {
+        root = page;
+    }
+    const std::uint64_t offset = std::uint64_t(pageNumber) * PAGE_SIZE;
+#ifdef ZIPCODES_HAVE_PREAD
+    std::size_t done = 0;
+    while (done < PAGE_SIZE) {
+        ssize_t put = ::pwrite(fd, page.bytes + done, PAGE_SIZE - done, static_cast<off_t>(offset + done));
+        if (put <= 0) {
+            break;
+        }
+        done += static_cast<std::size_t>(put);
+    }
+    const bool written = done == PAGE_SIZE;
+#else
+    stream.clear();
+    stream.seekp(static_cast<std::streamoff>(offset));
+    const bool written = stream.write(page.bytes, PAGE_SIZE) && stream.flush();
+#endif
+    // Dropped even after a failed write, which may have changed part of the page.
+    BufferPool::Shared().Invalidate(poolFile, offset, PAGE_SIZE);
+    if (!written) {
+        std::cerr << "Error: Unable to write the B+ tree index." << std::endl;
+    }
+    return written;
+}
+
+/**
+ * @brief Writes the in-memory header to page 0.
+ * @return false if the write failed.
+ */
+bool BPlusTree::writeHeader() {
+    Page page{};
+    std::memcpy(page.bytes, &header, sizeof(header));
+    return writePage(0, page);
+}
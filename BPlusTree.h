@@ -0,0 +1,240 @@
+/**
+ * @file BPlusTree.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class BPlusTree
+ * @see BPlusTree.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class BPlusTree, a disk-resident primary key index made of fixed-size pages. Only
+ * the root page is kept by the tree; every other page is read through the shared BufferPool when a lookup
+ * passes through it, so the memory used for the index is bounded by the pool's budget, not by the number of
+ * keys. Internal pages hold 203 separator keys, so a tree of a few million keys is three levels deep and a
+ * lookup costs two page requests below the cached root, most of them pool hits once the upper level is warm.
+ *
+ * File layout (version 1, host byte order, checked through 'byteOrder'), PAGE_SIZE bytes per page:
+ * - page 0: the file header (magic "ZIPBTRE\0", version, page size, key width, byte order, root page,
+ *   height, page count, key count, first leaf, key field)
+ * - leaf page: a 32-byte node header, then up to 127 KeyIndexEntry records sorted by key. Leaves are linked
+ *   through 'next' in key order, so ordered iteration reads each leaf once.
+ * - internal page: a 32-byte node header whose 'firstChild' covers the keys below the first separator,
+ *   then up to 203 (key, child) slots; a slot's child covers the keys from its key up to the next one.
+ *
+ * Build() bulk-loads sorted entries bottom-up with full leaves. Insert() splits full pages on the way back
+ * up and grows a new root when the old one splits. Erase() removes the entry from its leaf without merging
+ * underfull pages; Build() rewrites a tree whose leaves have become sparse.
+ *
+ * Assumptions:
+ * - Keys are at most KeyIndexEntry::KEY_WIDTH bytes and unique within the tree.
+ * - 'keyField' records which field of a record the keys come from, as given by
+ *   HeaderRecord::getPrimaryKeyOrdinality(); the tree itself never reads records.
+ * - Lookups may run on several threads at once; Insert() and Erase() need exclusive access.
+ */
+
+#ifndef ZIPCODES_BPLUSTREE_H
+#define ZIPCODES_BPLUSTREE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "BufferPool.h"
+#include "KeyIndexFile.h"
+
+class BPlusTree {
+public:
+    static constexpr std::size_t PAGE_SIZE = 4096;  /**< Bytes per page. */
+    static constexpr std::uint32_t VERSION = 1;     /**< Format version written by Build(). */
+
+    /**
+     * @brief Default constructor. No tree is open.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    BPlusTree();
+
+    ~BPlusTree();
+
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+
+    /**
+     * @brief Sorts 'entries' by key and writes them as a new tree.
+     * @param fileName Name of the tree file to create.
+     * @param entries The index entries, in any order. Keys must be unique.
+     * @param keyField Field of the records the keys were taken from.
+     * @return true if the file was written, false otherwise.
+     * @pre None.
+     * @post 'fileName' holds a version 1 tree that Open() accepts.
+     */
+    static bool Build(const std::string& fileName, std::vector<KeyIndexEntry> entries, std::uint32_t keyField = 0);
+
+    /**
+     * @brief Opens a tree file and caches its root page.
+     * @param fileName Name of the tree file.
+     * @param writable When true, Insert() and Erase() may change the file.
+     * @return true if the file is a valid tree for this host, false otherwise.
+     * @pre None.
+     * @post On success Find() and Scan() read pages on demand.
+     */
+    bool Open(const std::string& fileName, bool writable = false);
+
+    bool isOpen() const;
+
+    /**
+     * @brief Looks a key up.
+     * @param key The key.
+     * @param entry Receives the entry of the key.
+     * @return true if the key is in the tree, false otherwise.
+     * @pre The tree is open.
+     * @post 'entry' is updated only when true is returned. One page is read per level below the root.
+     */
+    bool Find(std::string_view key, KeyIndexEntry& entry) const;
+
+    /**
+     * @brief Visits the entries in key order, starting at the first key not below 'fromKey'.
+     * @param fromKey Where to start; empty for the first key.
+     * @param visit Called with each entry; returning false stops the scan.
+     * @return false if a page could not be read.
+     * @pre The tree is open.
+     * @post None.
+     */
+    bool Scan(std::string_view fromKey, const std::function<bool(const KeyIndexEntry&)>& visit) const;
+
+    /**
+     * @brief Adds a key, or points an existing key at a new record.
+     * @param entry The key with the offset and length of its record.
+     * @return true if the change was written, false otherwise.
+     * @pre The tree was opened writable.
+     * @post Find() returns 'entry'.
+     */
+    bool Insert(const KeyIndexEntry& entry);
+
+    /**
+     * @brief Removes a key.
+     * @param key The key.
+     * @return true if the key was in the tree and was removed, false otherwise.
+     * @pre The tree was opened writable.
+     * @post Find() no longer finds 'key'.
+     */
+    bool Erase(std::string_view key);
+
+    /**
+     * @brief Number of keys in the tree.
+     */
+    std::uint64_t size() const;
+
+    /**
+     * @brief Number of levels; 1 when the root is a leaf.
+     */
+    std::uint32_t height() const;
+
+    std::uint32_t pageCount() const;
+    std::uint32_t keyField() const;
+
+    /**
+     * @brief Pages requested from the buffer pool since Open(); the cached root is not counted.
+     */
+    std::uint64_t pageReads() const;
+
+    /**
+     * @brief Closes the tree file.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    void close();
+
+private:
+    /**
+     * @brief Contents of page 0.
+     */
+    struct FileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t pageSize;
+        std::uint32_t keyWidth;
+        std::uint32_t byteOrder;
+        std::uint32_t rootPage;
+        std::uint32_t height;
+        std::uint32_t pageCount;
+        std::uint32_t firstLeaf;
+        std::uint64_t keyCount;
+        std::uint32_t keyField;
+        std::uint32_t reserved;
+    };
+
+    /**
+     * @brief First 32 bytes of every leaf and internal page.
+     */
+    struct NodeHeader {
+        std::uint32_t kind;        /**< LEAF or INTERNAL. */
+        std::uint32_t count;       /**< Entries or slots in the page. */
+        std::uint32_t next;        /**< Next leaf in key order, 0 for none. */
+        std::uint32_t firstChild;  /**< Internal pages: child for the keys below the first slot. */
+        std::uint32_t reserved[4];
+    };
+
+    /**
+     * @brief One separator of an internal page.
+     */
+    struct InternalSlot {
+        char key[KeyIndexEntry::KEY_WIDTH];
+        std::uint32_t child;
+    };
+
+    /**
+     * @brief One page, aligned for the structures laid over it.
+     */
+    struct Page {
+        alignas(8) char bytes[PAGE_SIZE];
+    };
+
+    enum NodeKind : std::uint32_t {
+        LEAF = 1,
+        INTERNAL = 2
+    };
+
+    static constexpr char MAGIC[8] = {'Z', 'I', 'P', 'B', 'T', 'R', 'E', '\0'};
+    static constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static constexpr std::size_t LEAF_CAPACITY = (PAGE_SIZE - sizeof(NodeHeader)) / sizeof(KeyIndexEntry);
+    static constexpr std::size_t INTERNAL_CAPACITY = (PAGE_SIZE - sizeof(NodeHeader)) / sizeof(InternalSlot);
+
+    int fd;                         /**< Descriptor of the tree file, or -1; used for writes. */
+    mutable std::fstream stream;    /**< The tree file on hosts without positioned I/O. */
+    BufferPool::FileId poolFile;    /**< The tree file's registration with the shared pool; pages are read there. */
+    bool writable;                  /**< Opened for Insert() and Erase(). */
+    FileHeader header;              /**< Copy of page 0. */
+    Page root;                      /**< Cached root page. */
+    mutable std::atomic<std::uint64_t> reads; /**< Pages requested from the pool. */
+
+    static NodeHeader& nodeOf(Page& page);
+    static const NodeHeader& nodeOf(const Page& page);
+    static KeyIndexEntry* leafEntries(Page& page);
+    static const KeyIndexEntry* leafEntries(const Page& page);
+    static InternalSlot* internalSlots(Page& page);
+    static const InternalSlot* internalSlots(const Page& page);
+
+    /**
+     * @brief Descends from the root to the leaf that holds, or would hold, 'probe'.
+     * @param path When set, receives the internal pages passed, root first.
+     * @return The leaf's page number, or 0 if a page could not be read.
+     */
+    std::uint32_t findLeaf(const KeyIndexEntry& probe, Page& leaf, std::vector<std::uint32_t>* path) const;
+
+    /**
+     * @brief Adds a separator and its right child to the parents in 'path', splitting them as needed.
+     * @return false if a write failed.
+     */
+    bool insertSeparator(std::vector<std::uint32_t>& path, const char* key, std::uint32_t child);
+
+    bool readPage(std::uint32_t pageNumber, Page& page) const;
+    bool readAt(std::uint32_t pageNumber, Page& page) const;
+    bool writePage(std::uint32_t pageNumber, const Page& page);
+    bool writeHeader();
+};
+
+#endif //ZIPCODES_BPLUSTREE_H
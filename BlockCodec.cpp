@@ -0,0 +1,290 @@
+/**
+ * @file BlockCodec.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the BlockCodec class.
+ * @see BlockCodec.h for declaration.
+ */
+
+#include "BlockCodec.h"
+#include <cstring>
+#include <vector>
+
+#ifdef ZIPCODES_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+constexpr unsigned HASH_BITS = 14;          /**< log2 of the number of hash chains. */
+constexpr std::size_t MAX_DISTANCE = 65535; /**< Farthest match the 16-bit distance reaches. */
+constexpr int MAX_CHAIN = 32;               /**< Candidates tried per position. */
+
+/**
+ * @brief Hash of the four bytes at 'p'.
+ */
+inline std::uint32_t hash4(const char* p) {
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/**
+ * @brief Appends a length that did not fit in its nibble: bytes of 255, then the remainder.
+ */
+void appendLength(std::size_t length, std::string& output) {
+    while (length >= 255) {
+        output.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    output.push_back(static_cast<char>(length));
+}
+
+/**
+ * @brief Appends one sequence: literals, then a match unless 'matchLength' is zero.
+ */
+void appendSequence(const char* literals, std::size_t literalLength, std::size_t matchLength, std::size_t distance,
+                    std::string& output) {
+    const std::size_t matchCode = matchLength == 0 ? 0 : matchLength - BlockCodec::MIN_MATCH;
+    const unsigned char token = static_cast<unsigned char>((literalLength < 15 ? literalLength : 15) << 4
+                                                           | (matchCode < 15 ? matchCode : 15));
+    output.push_back(static_cast<char>(token));
+    if (literalLength >= 15) {
+        appendLength(literalLength - 15, output);
+    }
+    output.append(literals, literalLength);
+    if (matchLength == 0) {
+        return;
+    }
+    output.push_back(static_cast<char>(distance & 0xFF));
+    output.push_back(static_cast<char>(distance >> 8));
+    if (matchCode >= 15) {
+        appendLength(matchCode - 15, output);
+    }
+}
+
+/**
+ * @brief Reads a length continued past its nibble.
+ * @return false if the input ended first.
+ */
+bool readLength(const unsigned char*& in, const unsigned char* end, std::size_t& length) {
+    unsigned char byte;
+    do {
+        if (in == end) {
+            return false;
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+} // namespace
+
+/**
+ * @brief Compresses a block.
+ * @param type The codec.
+ * @param input The block.
+ * @param size Bytes in the block.
+ * @param output Receives the compressed block; its previous contents are discarded.
+ * @return false if the codec is not available in this build.
+ */
+bool BlockCodec::Compress(Type type, const char* input, std::size_t size, std::string& output) {
+    output.clear();
+    switch (type) {
+    case NONE:
+        output.assign(input, size);
+        return true;
+    case LZ:
+        compressLz(input, size, output);
+        return true;
+    case ZLIB: {
+#ifdef ZIPCODES_HAVE_ZLIB
+        uLongf length = compressBound(static_cast<uLong>(size));
+        output.resize(length);
+        if (compress2(reinterpret_cast<Bytef*>(&output[0]), &length, reinterpret_cast<const Bytef*>(input),
+                      static_cast<uLong>(size), Z_BEST_COMPRESSION) != Z_OK) {
+            return false;
+        }
+        output.resize(length);
+        return true;
+#else
+        return false;
+#endif
+    }
+    }
+    return false;
+}
+
+/**
+ * @brief Decompresses a block.
+ * @param type The codec it was compressed with.
+ * @param input The compressed block.
+ * @param size Bytes of compressed data.
+ * @param output Receives the block; must hold 'outputSize' bytes.
+ * @param outputSize Size of the block before compression.
+ * @return true if the data decoded to exactly 'outputSize' bytes.
+ */
+bool BlockCodec::Decompress(Type type, const char* input, std::size_t size, char* output, std::size_t outputSize) {
+    switch (type) {
+    case NONE:
+        if (size != outputSize) {
+            return false;
+        }
+        std::memcpy(output, input, size);
+        return true;
+    case LZ:
+        return decompressLz(input, size, output, outputSize);
+    case ZLIB: {
+#ifdef ZIPCODES_HAVE_ZLIB
+        uLongf length = static_cast<uLongf>(outputSize);
+        return uncompress(reinterpret_cast<Bytef*>(output), &length, reinterpret_cast<const Bytef*>(input),
+                          static_cast<uLong>(size)) == Z_OK
+               && length == outputSize;
+#else
+        return false;
+#endif
+    }
+    }
+    return false;
+}
+
+/**
+ * @brief Checks if a codec can be used in this build.
+ */
+bool BlockCodec::Available(Type type) {
+#ifdef ZIPCODES_HAVE_ZLIB
+    return type == NONE || type == LZ || type == ZLIB;
+#else
+    return type == NONE || type == LZ;
+#endif
+}
+
+const char* BlockCodec::Name(Type type) {
+    switch (type) {
+    case NONE:
+        return "none";
+    case LZ:
+        return "lz";
+    case ZLIB:
+        return "zlib";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Looks up a codec by name.
+ * @param name "none", "lz" or "zlib".
+ * @param type Receives the codec.
+ * @return false if the name is unknown.
+ */
+bool BlockCodec::FromName(const std::string& name, Type& type) {
+    for (Type candidate : {NONE, LZ, ZLIB}) {
+        if (name == Name(candidate)) {
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Compresses with the built-in LZ77 codec.
+ * @details Every position is linked into the hash chain of its first four bytes. At each position up to
+ * MAX_CHAIN earlier positions with the same hash are compared and the longest match within the window
+ * is taken; positions inside a match are linked too, so later matches can start anywhere.
+ */
+void BlockCodec::compressLz(const char* input, std::size_t size, std::string& output) {
+    output.reserve(size / 2 + 16);
+    std::vector<std::int32_t> head(std::size_t(1) << HASH_BITS, -1);
+    std::vector<std::int32_t> previous(size, -1);
+    auto link = [&](std::size_t pos) {
+        const std::uint32_t h = hash4(input + pos);
+        previous[pos] = head[h];
+        head[h] = static_cast<std::int32_t>(pos);
+    };
+
+    std::size_t anchor = 0;
+    std::size_t pos = 0;
+    while (pos + MIN_MATCH <= size) {
+        std::size_t bestLength = 0;
+        std::size_t bestDistance = 0;
+        std::int32_t candidate = head[hash4(input + pos)];
+        for (int tries = 0; candidate >= 0 && pos - candidate <= MAX_DISTANCE && tries < MAX_CHAIN; tries++) {
+            const char* a = input + candidate;
+            const char* b = input + pos;
+            std::size_t length = 0;
+            const std::size_t limit = size - pos;
+            while (length < limit && a[length] == b[length]) {
+                length++;
+            }
+            if (length > bestLength) {
+                bestLength = length;
+                bestDistance = pos - candidate;
+                if (length == limit) {
+                    break;
+                }
+            }
+            candidate = previous[candidate];
+        }
+        link(pos);
+        if (bestLength < MIN_MATCH) {
+            pos++;
+            continue;
+        }
+        appendSequence(input + anchor, pos - anchor, bestLength, bestDistance, output);
+        const std::size_t end = pos + bestLength;
+        for (pos++; pos < end; pos++) {
+            if (pos + MIN_MATCH <= size) {
+                link(pos);
+            }
+        }
+        anchor = pos;
+    }
+    appendSequence(input + anchor, size - anchor, 0, 0, output);
+}
+
+/**
+ * @brief Decompresses a block written by compressLz().
+ * @return false if the stream is damaged or does not decode to exactly 'outputSize' bytes.
+ */
+bool BlockCodec::decompressLz(const char* input, std::size_t size, char* output, std::size_t outputSize) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(input);
+    const unsigned char* end = in + size;
+    std::size_t out = 0;
+    while (in < end) {
+        const unsigned char token = *in++;
+        std::size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(in, end, literalLength)) {
+            return false;
+        }
+        if (literalLength > static_cast<std::size_t>(end - in) || literalLength > outputSize - out) {
+            return false;
+        }
+        std::memcpy(output + out, in, literalLength);
+        in += literalLength;
+        out += literalLength;
+        if (in == end) {
+            break; // The last sequence has no match.
+        }
+        if (end - in < 2) {
+            return false;
+        }
+        const std::size_t distance = in[0] | (std::size_t(in[1]) << 8);
+        in += 2;
+        std::size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !readLength(in, end, matchLength)) {
+            return false;
+        }
+        matchLength += MIN_MATCH;
+        if (distance == 0 || distance > out || matchLength > outputSize - out) {
+            return false;
+        }
+        // Byte by byte: a match may overlap the bytes it produces.
+        const char* from = output + out - distance;
+        for (std::size_t i = 0; i < matchLength; i++) {
+            output[out + i] = from[i];
+        }
+        out += matchLength;
+    }
+    return out == outputSize;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file BlockCodec.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class BlockCodec
+ * @see BlockCodec.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class BlockCodec, which compresses and decompresses one block of the data file.
+ * Two codecs are available:
+ * - "lz": a self-contained LZ77 codec. The stream is a sequence of (literal run, match) pairs, each
+ *   introduced by a token byte whose high nibble is the literal length and low nibble the match length
+ *   minus MIN_MATCH; a nibble of 15 is continued by bytes of 255 and a final byte below 255. A match is
+ *   a 16-bit little-endian distance back into the output, so the window is 64 KiB. The stream ends
+ *   with a literal run that has no match. The compressor follows a hash chain of earlier positions,
+ *   which finds longer matches than a single hash slot at the cost of compression speed only.
+ * - "zlib": DEFLATE through zlib, when the program is built with ZIPCODES_HAVE_ZLIB and linked against it.
+ *
+ * Assumptions:
+ * - A block is small enough to be held in memory twice, compressed and decompressed.
+ * - The decompressed size of a block is stored next to it by the caller.
+ */
+
+#ifndef ZIPCODES_BLOCKCODEC_H
+#define ZIPCODES_BLOCKCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class BlockCodec {
+public:
+    /**
+     * @brief Codec identifiers, as stored in data file headers.
+     */
+    enum Type : std::uint32_t {
+        NONE = 0, /**< Blocks are stored as they are. */
+        LZ = 1,   /**< The built-in LZ77 codec. */
+        ZLIB = 2  /**< DEFLATE through zlib. */
+    };
+
+    static constexpr std::size_t MIN_MATCH = 4; /**< Shortest match the LZ codec encodes. */
+
+    /**
+     * @brief Compresses a block.
+     * @param type The codec.
+     * @param input The block.
+     * @param size Bytes in the block.
+     * @param output Receives the compressed block; its previous contents are discarded.
+     * @return false if the codec is not available in this build.
+     */
+    static bool Compress(Type type, const char* input, std::size_t size, std::string& output);
+
+    /**
+     * @brief Decompresses a block.
+     * @param type The codec it was compressed with.
+     * @param input The compressed block.
+     * @param size Bytes of compressed data.
+     * @param output Receives the block; must hold 'outputSize' bytes.
+     * @param outputSize Size of the block before compression.
+     * @return true if the data decoded to exactly 'outputSize' bytes.
+     */
+    static bool Decompress(Type type, const char* input, std::size_t size, char* output, std::size_t outputSize);
+
+    /**
+     * @brief Checks if a codec can be used in this build.
+     */
+    static bool Available(Type type);
+
+    /**
+     * @brief Name of a codec: "none", "lz" or "zlib".
+     */
+    static const char* Name(Type type);
+
+    /**
+     * @brief Looks up a codec by name.
+     * @param name "none", "lz" or "zlib".
+     * @param type Receives the codec.
+     * @return false if the name is unknown.
+     */
+    static bool FromName(const std::string& name, Type& type);
+
+private:
+    static void compressLz(const char* input, std::size_t size, std::string& output);
+    static bool decompressLz(const char* input, std::size_t size, char* output, std::size_t outputSize);
+};
+
+#endif //ZIPCODES_BLOCKCODEC_H
@@ -0,0 +1,662 @@
+/**
+ * @file BlockedDataFile.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the BlockedDataFileBuilder and BlockedDataFile classes.
+ * @see BlockedDataFile.h for declaration.
+ */
+
+#include "BlockedDataFile.h"
+#include "CSVReader.h"
+#include "FieldTokenizer.h"
+#include "MappedDataFile.h"
+#include "ZipKeyIndex.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ZIPCODES_HAVE_PREAD 1
+#endif
+
+constexpr char BlockedDataFile::MAGIC[8];
+
+namespace {
+
+/**
+ * @brief Appends an unsigned LEB128 varint.
+ */
+void appendVarint(std::uint64_t value, std::vector<char>& out) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+/**
+ * @brief Reads an unsigned LEB128 varint.
+ * @return false if the input ended first.
+ */
+bool readVarint(const char*& in, const char* end, std::uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; in < end && shift < 64; shift += 7) {
+        const unsigned char byte = static_cast<unsigned char>(*in++);
+        value |= std::uint64_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Writes a zip in canonical form, as ZipKeyIndex::ZIP_DIGITS zero-padded digits.
+ */
+void paddedZip(std::uint32_t zip, char* digits) {
+    for (std::size_t i = ZipKeyIndex::ZIP_DIGITS; i-- > 0; zip /= 10) {
+        digits[i] = static_cast<char>('0' + zip % 10);
+    }
+}
+
+/**
+ * @brief Length of the canonical zip at the start of 'record', or 0 if it is written otherwise.
+ */
+std::size_t canonicalZipLength(std::string_view record, std::uint32_t zip) {
+    char digits[ZipKeyIndex::ZIP_DIGITS];
+    paddedZip(zip, digits);
+    const std::size_t length = ZipKeyIndex::ZIP_DIGITS;
+    const bool canonical = record.size() >= length && record.compare(0, length, digits, length) == 0
+                           && (record.size() == length || record[length] == ',');
+    return canonical ? length : 0;
+}
+
+/**
+ * @brief Restores a packed record: the canonical zip if it was stripped, then the stored payload.
+ */
+void restoreRecord(std::uint32_t zip, std::string_view rest, bool stripped, std::string& record) {
+    char digits[ZipKeyIndex::ZIP_DIGITS];
+    record.clear();
+    if (stripped) {
+        paddedZip(zip, digits);
+        record.assign(digits, ZipKeyIndex::ZIP_DIGITS);
+    }
+    record.append(rest.data(), rest.size());
+}
+
+} // namespace
+
+/**
+ * @brief Constructor.
+ * @param blockSize Bytes per block, a power of two from 512 to 65536.
+ * @param codec Codec that compresses every block, or BlockCodec::NONE.
+ */
+BlockedDataFileBuilder::BlockedDataFileBuilder(std::uint32_t blockSize, BlockCodec::Type codec)
+        : blockSize(blockSize), codec(codec) {
+    starts.push_back(0);
+}
+
+/**
+ * @brief Adds one record.
+ * @param record The record payload.
+ * @return true if the record had a numeric zip and fits in a block, false if it was skipped.
+ */
+bool BlockedDataFileBuilder::AddRecord(std::string_view record) {
+    std::uint32_t zip;
+    if (!ZipKeyIndex::ParseZip(FieldTokenizer::ExtractField(record, 0), zip)) {
+        return false;
+    }
+    const std::size_t largest = blockSize - sizeof(BlockedDataFile::BlockHeader) - sizeof(BlockedDataFile::Slot);
+    if (record.size() > largest) {
+        std::cerr << "Record for zip " << zip << " does not fit in a " << blockSize << "-byte block." << std::endl;
+        return false;
+    }
+    keys.push_back(zip);
+    payloads.append(record.data(), record.size());
+    starts.push_back(payloads.size());
+    return true;
+}
+
+/**
+ * @brief Adds every record of a length-indicated data file.
+ * @param fileName Name of the data file.
+ * @param dataOffset Offset of the first record, used to skip a header block.
+ * @param format Format of the length indicators of the data file.
+ * @param dataSize Bytes of records after 'dataOffset', or MappedDataFile::TO_END_OF_FILE.
+ * @return true if the file could be read, false otherwise.
+ */
+bool BlockedDataFileBuilder::AddDataFile(const std::string& fileName, std::uint64_t dataOffset,
+                                         LengthIndicator::Format format, std::uint64_t dataSize) {
+    MappedDataFile dataFile;
+    if (dataFile.Open(fileName, dataOffset, format, dataSize)) {
+        dataFile.mapping().AdviseSequential();
+        for (const RecordView& record : dataFile) {
+            AddRecord(record.data);
+        }
+        return true;
+    }
+    std::ifstream inputFile(fileName, std::ios::binary);
+    if (!inputFile) {
+        std::cerr << "Failed to open input file." << std::endl;
+        return false;
+    }
+    const std::uint64_t dataEnd = dataSize == MappedDataFile::TO_END_OF_FILE ? dataSize : dataOffset + dataSize;
+    inputFile.seekg(static_cast<std::streamoff>(dataOffset));
+    while (inputFile && static_cast<std::uint64_t>(inputFile.tellg()) < dataEnd) {
+        std::pair<std::size_t, std::string> record = CSVReader::ReadFromFile(inputFile, format);
+        if (record.first == 0) {
+            break; // End of file reached
+        }
+        if (MappedDataFile::IsTombstone(record.second)) {
+            continue;
+        }
+        AddRecord(record.second);
+    }
+    return true;
+}
+
+/**
+ * @brief Sorts the records by key and writes them as a blocked data file.
+ * @param fileName Name of the file to create.
+ * @return true if the file was written, false otherwise.
+ * @details Blocks are filled greedily in key order: a record goes into the current block if its slot
+ * and payload still fit, otherwise the block is written and a new one started.
+ */
+bool BlockedDataFileBuilder::Write(const std::string& fileName) const {
+    using Header = BlockedDataFile::FileHeader;
+    if (!BlockCodec::Available(codec)) {
+        std::cerr << "Error: The " << BlockCodec::Name(codec) << " codec is not available in this build." << std::endl;
+        return false;
+    }
+    if (blockSize < BlockedDataFile::MIN_BLOCK_SIZE || blockSize > BlockedDataFile::MAX_BLOCK_SIZE
+        || (blockSize & (blockSize - 1)) != 0) {
+        std::cerr << "Error: Block size " << blockSize << " is not a power of two from "
+                  << BlockedDataFile::MIN_BLOCK_SIZE << " to " << BlockedDataFile::MAX_BLOCK_SIZE << "." << std::endl;
+        return false;
+    }
+    std::ofstream blockedFile(fileName, std::ios::binary | std::ios::trunc);
+    if (!blockedFile) {
+        std::cerr << "Error: Unable to create the blocked data file " << fileName << "." << std::endl;
+        return false;
+    }
+
+    // Stable, so records with the same zip keep their input order.
+    std::vector<std::uint32_t> order(keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](std::uint32_t a, std::uint32_t b) {
+        return keys[a] < keys[b];
+    });
+
+    // Block 0 is reserved for the header, which is only complete once the blocks are counted.
+    blockedFile.write(std::vector<char>(blockSize, '\0').data(), blockSize);
+    std::vector<BlockBounds> bounds;
+    std::vector<BlockedDataFile::BlockExtent> extents;
+    const bool written = codec == BlockCodec::NONE ? writePlainBlocks(blockedFile, order, bounds)
+                                                   : writeCompressedBlocks(blockedFile, order, bounds, extents);
+    if (!written) {
+        return false;
+    }
+    const std::uint64_t indexOffset = static_cast<std::uint64_t>(blockedFile.tellp());
+    blockedFile.write(reinterpret_cast<const char*>(bounds.data()),
+                      static_cast<std::streamsize>(bounds.size() * sizeof(BlockBounds)));
+    blockedFile.write(reinterpret_cast<const char*>(extents.data()),
+                      static_cast<std::streamsize>(extents.size() * sizeof(BlockedDataFile::BlockExtent)));
+
+    Header header = {};
+    std::memcpy(header.magic, BlockedDataFile::MAGIC, sizeof(header.magic));
+    header.version = BlockedDataFile::VERSION;
+    header.byteOrder = BlockedDataFile::BYTE_ORDER_MARK;
+    header.blockSize = blockSize;
+    header.codec = codec;
+    header.blockCount = bounds.size();
+    header.recordCount = keys.size();
+    header.indexOffset = indexOffset;
+    blockedFile.seekp(0);
+    blockedFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!blockedFile) {
+        std::cerr << "Error: Unable to write the blocked data file " << fileName << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::size_t BlockedDataFileBuilder::size() const {
+    return keys.size();
+}
+
+/**
+ * @brief Writes the records as fixed-size blocks with a slot directory.
+ * @details Blocks are filled greedily in key order: a record goes into the current block if its slot
+ * and payload still fit, otherwise the block is written and a new one started.
+ */
+bool BlockedDataFileBuilder::writePlainBlocks(std::ofstream& out, const std::vector<std::uint32_t>& order,
+                                              std::vector<BlockBounds>& bounds) const {
+    using BlockHeader = BlockedDataFile::BlockHeader;
+    using Slot = BlockedDataFile::Slot;
+    std::vector<char> block(blockSize, '\0');
+    std::vector<std::uint32_t> blockRows;
+    std::size_t used = sizeof(BlockHeader);
+    auto flushBlock = [&]() {
+        std::fill(block.begin(), block.end(), '\0');
+        const BlockHeader blockHeader = {keys[blockRows.front()], keys[blockRows.back()],
+                                         static_cast<std::uint32_t>(blockRows.size()), static_cast<std::uint32_t>(used)};
+        std::memcpy(block.data(), &blockHeader, sizeof(blockHeader));
+        std::size_t offset = sizeof(BlockHeader) + blockRows.size() * sizeof(Slot);
+        for (std::size_t i = 0; i < blockRows.size(); i++) {
+            const std::uint32_t row = blockRows[i];
+            const std::size_t length = starts[row + 1] - starts[row];
+            const Slot slot = {keys[row], static_cast<std::uint16_t>(offset), static_cast<std::uint16_t>(length)};
+            std::memcpy(block.data() + sizeof(BlockHeader) + i * sizeof(Slot), &slot, sizeof(slot));
+            std::memcpy(block.data() + offset, payloads.data() + starts[row], length);
+            offset += length;
+        }
+        out.write(block.data(), blockSize);
+        bounds.push_back(BlockBounds{blockHeader.firstKey, blockHeader.lastKey});
+        blockRows.clear();
+        used = sizeof(BlockHeader);
+    };
+    for (std::uint32_t row : order) {
+        const std::size_t need = sizeof(Slot) + (starts[row + 1] - starts[row]);
+        if (used + need > blockSize) {
+            flushBlock();
+        }
+        blockRows.push_back(row);
+        used += need;
+    }
+    if (!blockRows.empty()) {
+        flushBlock();
+    }
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief Writes the records as compressed blocks of at most 'blockSize' packed bytes each.
+ * @details A record is packed as the varint difference between its zip and the previous zip of the
+ * block, the varint (length << 1 | stripped) and the payload. When the payload starts with the zip in
+ * canonical form, five zero-padded digits, those digits are left out ('stripped'), since the zip is
+ * already known.
+ */
+bool BlockedDataFileBuilder::writeCompressedBlocks(std::ofstream& out, const std::vector<std::uint32_t>& order,
+                                                   std::vector<BlockBounds>& bounds,
+                                                   std::vector<BlockedDataFile::BlockExtent>& extents) const {
+    std::vector<char> packed;
+    packed.reserve(blockSize);
+    std::string compressed;
+    std::uint64_t offset = blockSize;
+    std::uint32_t firstKey = 0;
+    std::uint32_t previousKey = 0;
+    auto flushBlock = [&]() {
+        if (!BlockCodec::Compress(codec, packed.data(), packed.size(), compressed)) {
+            return false;
+        }
+        out.write(compressed.data(), static_cast<std::streamsize>(compressed.size()));
+        bounds.push_back(BlockBounds{firstKey, previousKey});
+        extents.push_back(BlockedDataFile::BlockExtent{offset, static_cast<std::uint32_t>(compressed.size()),
+                                                       static_cast<std::uint32_t>(packed.size())});
+        offset += compressed.size();
+        packed.clear();
+        return true;
+    };
+    std::vector<char> entry;
+    for (std::uint32_t row : order) {
+        const std::string_view record(payloads.data() + starts[row], starts[row + 1] - starts[row]);
+        const std::size_t zipLength = canonicalZipLength(record, keys[row]);
+        const std::string_view rest = record.substr(zipLength);
+        if (!packed.empty() && packed.size() + rest.size() + 2 * 5 > blockSize) {
+            if (!flushBlock()) {
+                return false;
+            }
+        }
+        if (packed.empty()) {
+            firstKey = keys[row];
+            previousKey = firstKey;
+        }
+        entry.clear();
+        appendVarint(keys[row] - previousKey, entry);
+        appendVarint((std::uint64_t(rest.size()) << 1) | (zipLength != 0 ? 1 : 0), entry);
+        packed.insert(packed.end(), entry.begin(), entry.end());
+        packed.insert(packed.end(), rest.begin(), rest.end());
+        previousKey = keys[row];
+    }
+    if (!packed.empty() && !flushBlock()) {
+        return false;
+    }
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief Default constructor. No file is open.
+ */
+BlockedDataFile::BlockedDataFile() : dataFd(-1), blockBytes(0), codecType(BlockCodec::NONE), recordCount(0) {
+}
+
+/**
+ * @brief Closes the file.
+ */
+BlockedDataFile::~BlockedDataFile() {
+    close();
+}
+
+/**
+ * @brief Opens a blocked data file and loads its sparse index.
+ * @param fileName Name of the file.
+ * @return true if the file is a valid blocked data file for this host, false otherwise.
+ */
+bool BlockedDataFile::Open(const std::string& fileName) {
+    close();
+#ifdef ZIPCODES_HAVE_PREAD
+    dataFd = ::open(fileName.c_str(), O_RDONLY);
+    if (dataFd < 0) {
+        return false;
+    }
+    struct stat status;
+    const std::uint64_t fileSize = ::fstat(dataFd, &status) == 0 ? static_cast<std::uint64_t>(status.st_size) : 0;
+#else
+    dataStream.open(fileName, std::ios::binary | std::ios::ate);
+    if (!dataStream.is_open()) {
+        return false;
+    }
+    const std::uint64_t fileSize = static_cast<std::uint64_t>(dataStream.tellg());
+#endif
+    FileHeader header;
+    bool valid = fileSize >= sizeof(header) && readAt(0, reinterpret_cast<char*>(&header), sizeof(header))
+                 && std::memcmp(header.magic, MAGIC, sizeof(header.magic)) == 0
+                 && header.version == VERSION && header.byteOrder == BYTE_ORDER_MARK
+                 && header.blockSize >= MIN_BLOCK_SIZE && header.blockSize <= MAX_BLOCK_SIZE
+                 && BlockCodec::Available(static_cast<BlockCodec::Type>(header.codec));
+    if (valid && header.codec == BlockCodec::NONE) {
+        valid = header.indexOffset == (header.blockCount + 1) * header.blockSize
+                && fileSize == header.indexOffset + header.blockCount * sizeof(BlockBounds);
+    } else if (valid) {
+        valid = header.indexOffset >= header.blockSize
+                && fileSize == header.indexOffset + header.blockCount * (sizeof(BlockBounds) + sizeof(BlockExtent));
+    }
+    if (!valid) {
+        std::cerr << "Error: " << fileName << " is not a blocked data file for this build." << std::endl;
+        close();
+        return false;
+    }
+    bounds.resize(header.blockCount);
+    if (header.codec != BlockCodec::NONE) {
+        extents.resize(header.blockCount);
+    }
+    if (!readAt(header.indexOffset, reinterpret_cast<char*>(bounds.data()), bounds.size() * sizeof(BlockBounds))
+        || !readAt(header.indexOffset + bounds.size() * sizeof(BlockBounds), reinterpret_cast<char*>(extents.data()),
+                   extents.size() * sizeof(BlockExtent))) {
+        close();
+        return false;
+    }
+    blockBytes = header.blockSize;
+    codecType = static_cast<BlockCodec::Type>(header.codec);
+    recordCount = header.recordCount;
+    return true;
+}
+
+bool BlockedDataFile::isOpen() const {
+#ifdef ZIPCODES_HAVE_PREAD
+    return dataFd >= 0;
+#else
+    return dataStream.is_open();
+#endif
+}
+
+/**
+ * @brief Looks up the first record with a zip code.
+ * @param zip The zip code.
+ * @param record Receives the record payload.
+ * @return true if the zip is in the file.
+ */
+bool BlockedDataFile::Find(std::uint32_t zip, std::string& record) const {
+    const std::size_t blockIndex = firstBlockFor(zip);
+    if (blockIndex == bounds.size() || bounds[blockIndex].firstKey > zip) {
+        return false;
+    }
+    if (codecType != BlockCodec::NONE) {
+        const BlockExtent& extent = extents[blockIndex];
+        std::vector<char> stored(extent.storedBytes);
+        std::vector<char> packed;
+        if (!readAt(extent.offset, stored.data(), stored.size()) || !unpackBlock(blockIndex, stored.data(), packed)) {
+            return false;
+        }
+        bool found = false;
+        forEachPacked(packed, bounds[blockIndex].firstKey, [&](std::uint32_t key, std::string_view rest, bool stripped) {
+            if (key < zip) {
+                return true;
+            }
+            if (key == zip) {
+                restoreRecord(key, rest, stripped, record);
+                found = true;
+            }
+            return false;
+        });
+        return found;
+    }
+    std::vector<char> block(blockBytes);
+    if (!readAt((blockIndex + 1) * static_cast<std::uint64_t>(blockBytes), block.data(), blockBytes)) {
+        return false;
+    }
+    BlockHeader blockHeader;
+    std::memcpy(&blockHeader, block.data(), sizeof(blockHeader));
+    const Slot* slots = reinterpret_cast<const Slot*>(block.data() + sizeof(BlockHeader));
+    const Slot* found = std::lower_bound(slots, slots + blockHeader.recordCount, zip, [](const Slot& slot, std::uint32_t value) {
+        return slot.key < value;
+    });
+    if (found == slots + blockHeader.recordCount || found->key != zip) {
+        return false;
+    }
+    record.assign(block.data() + found->offset, found->length);
+    return true;
+}
+
+/**
+ * @brief Looks up the first record with a zip code given as text.
+ * @param key The zip code, as in the record.
+ * @param record Receives the record payload.
+ * @return true if the zip is in the file.
+ */
+bool BlockedDataFile::Find(std::string_view key, std::string& record) const {
+    std::uint32_t zip;
+    return ZipKeyIndex::ParseZip(key, zip) && Find(zip, record);
+}
+
+/**
+ * @brief Visits every record whose zip lies in [firstZip, lastZip], in key order.
+ * @param firstZip Smallest zip of the range.
+ * @param lastZip Largest zip of the range.
+ * @param visit Called with the zip and payload of every record in the range.
+ * @return Number of records visited.
+ * @details The blocks of the range are contiguous in the file, so they are read in runs of up to
+ * SCAN_READ_BYTES with one positioned read per run. Compressed blocks are decompressed one at a time
+ * from the run.
+ */
+std::size_t BlockedDataFile::Scan(std::uint32_t firstZip, std::uint32_t lastZip,
+                                  const std::function<void(std::uint32_t, std::string_view)>& visit) const {
+    std::size_t blockIndex = firstBlockFor(firstZip);
+    std::size_t endBlock = blockIndex;
+    while (endBlock < bounds.size() && bounds[endBlock].firstKey <= lastZip) {
+        endBlock++;
+    }
+    std::size_t visited = 0;
+    if (codecType != BlockCodec::NONE) {
+        std::vector<char> run;
+        std::vector<char> packed;
+        std::string record;
+        while (blockIndex < endBlock) {
+            // Take blocks into the run until it would exceed SCAN_READ_BYTES, but always at least one.
+            std::size_t count = 1;
+            std::uint64_t runBytes = extents[blockIndex].storedBytes;
+            while (blockIndex + count < endBlock && runBytes + extents[blockIndex + count].storedBytes <= SCAN_READ_BYTES) {
+                runBytes += extents[blockIndex + count].storedBytes;
+                count++;
+            }
+            run.resize(runBytes);
+            if (!readAt(extents[blockIndex].offset, run.data(), run.size())) {
+                break;
+            }
+            for (std::size_t b = 0; b < count; b++) {
+                const std::size_t index = blockIndex + b;
+                if (!unpackBlock(index, run.data() + (extents[index].offset - extents[blockIndex].offset), packed)) {
+                    return visited;
+                }
+                forEachPacked(packed, bounds[index].firstKey, [&](std::uint32_t key, std::string_view rest, bool stripped) {
+                    if (key > lastZip) {
+                        return false;
+                    }
+                    if (key >= firstZip) {
+                        restoreRecord(key, rest, stripped, record);
+                        visit(key, record);
+                        visited++;
+                    }
+                    return true;
+                });
+            }
+            blockIndex += count;
+        }
+        return visited;
+    }
+    const std::size_t runBlocks = std::max<std::size_t>(1, SCAN_READ_BYTES / blockBytes);
+    std::vector<char> run(std::min(runBlocks, endBlock - blockIndex) * blockBytes);
+    while (blockIndex < endBlock) {
+        const std::size_t count = std::min(runBlocks, endBlock - blockIndex);
+        if (!readAt((blockIndex + 1) * static_cast<std::uint64_t>(blockBytes), run.data(), count * blockBytes)) {
+            break;
+        }
+        for (std::size_t b = 0; b < count; b++) {
+            const char* block = run.data() + b * blockBytes;
+            BlockHeader blockHeader;
+            std::memcpy(&blockHeader, block, sizeof(blockHeader));
+            const Slot* slots = reinterpret_cast<const Slot*>(block + sizeof(BlockHeader));
+            for (std::uint32_t i = 0; i < blockHeader.recordCount; i++) {
+                if (slots[i].key >= firstZip && slots[i].key <= lastZip) {
+                    visit(slots[i].key, std::string_view(block + slots[i].offset, slots[i].length));
+                    visited++;
+                }
+            }
+        }
+        blockIndex += count;
+    }
+    return visited;
+}
+
+std::uint32_t BlockedDataFile::blockSize() const {
+    return blockBytes;
+}
+
+BlockCodec::Type BlockedDataFile::codec() const {
+    return codecType;
+}
+
+std::size_t BlockedDataFile::blockCount() const {
+    return bounds.size();
+}
+
+std::size_t BlockedDataFile::size() const {
+    return static_cast<std::size_t>(recordCount);
+}
+
+/**
+ * @brief Bytes of the resident sparse index, block extents included.
+ */
+std::size_t BlockedDataFile::IndexBytes() const {
+    return bounds.size() * sizeof(BlockBounds) + extents.size() * sizeof(BlockExtent);
+}
+
+void BlockedDataFile::close() {
+#ifdef ZIPCODES_HAVE_PREAD
+    if (dataFd >= 0) {
+        ::close(dataFd);
+        dataFd = -1;
+    }
+#else
+    dataStream.close();
+#endif
+    bounds.clear();
+    extents.clear();
+    blockBytes = 0;
+    codecType = BlockCodec::NONE;
+    recordCount = 0;
+}
+
+/**
+ * @brief Index of the first block whose last key is not below 'zip', or blockCount().
+ * @details Keys only grow from block to block, so this is the only block that can hold the first record
+ * with 'zip'. Equal keys may continue into the following blocks.
+ */
+std::size_t BlockedDataFile::firstBlockFor(std::uint32_t zip) const {
+    auto found = std::lower_bound(bounds.begin(), bounds.end(), zip, [](const BlockBounds& block, std::uint32_t value) {
+        return block.lastKey < value;
+    });
+    return static_cast<std::size_t>(found - bounds.begin());
+}
+
+/**
+ * @brief Decompresses one block of a compressed file.
+ * @param blockIndex Index of the block.
+ * @param stored The compressed block, extents[blockIndex].storedBytes bytes.
+ * @param packed Receives the packed records.
+ * @return false if the block is damaged.
+ */
+bool BlockedDataFile::unpackBlock(std::size_t blockIndex, const char* stored, std::vector<char>& packed) const {
+    const BlockExtent& extent = extents[blockIndex];
+    packed.resize(extent.rawBytes);
+    if (!BlockCodec::Decompress(codecType, stored, extent.storedBytes, packed.data(), packed.size())) {
+        std::cerr << "Error: Block " << blockIndex << " of the blocked data file is damaged." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Walks the records of a packed block in key order.
+ * @param packed The packed block.
+ * @param firstKey First key of the block, the base of the first zip delta.
+ * @param visit Called with the zip, the stored payload and whether the zip was stripped from it;
+ * returns false to stop.
+ * @return false if the block ended inside a record.
+ */
+bool BlockedDataFile::forEachPacked(const std::vector<char>& packed, std::uint32_t firstKey,
+                                    const std::function<bool(std::uint32_t, std::string_view, bool)>& visit) {
+    const char* in = packed.data();
+    const char* end = in + packed.size();
+    std::uint64_t key = firstKey;
+    while (in < end) {
+        std::uint64_t delta;
+        std::uint64_t lengthCode;
+        if (!readVarint(in, end, delta) || !readVarint(in, end, lengthCode)
+            || (lengthCode >> 1) > static_cast<std::uint64_t>(end - in)) {
+            return false;
+        }
+        key += delta;
+        const std::size_t length = static_cast<std::size_t>(lengthCode >> 1);
+        if (!visit(static_cast<std::uint32_t>(key), std::string_view(in, length), (lengthCode & 1) != 0)) {
+            return true;
+        }
+        in += length;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads 'length' bytes at 'offset' with one positioned read.
+ * @return true if all bytes were read.
+ */
+bool BlockedDataFile::readAt(std::uint64_t offset, char* buffer, std::size_t length) const {
+#ifdef ZIPCODES_HAVE_PREAD
+    std::size_t done = 0;
+    while (done < length) {
+        ssize_t got = ::pread(dataFd, buffer + done, length - done, static_cast<off_t>(offset + done));
+        if (got <= 0) {
+            return false;
+        }
+        done += static_cast<std::size_t>(got);
+    }
+    return true;
+#else
+    dataStream.clear();
+    dataStream.seekg(static_cast<std::streamoff>(offset));
+    return static_cast<bool>(dataStream.read(buffer, static_cast<std::streamsize>(length)));
+#endif
+}
@@ -0,0 +1,265 @@
+/**
+ * @file BlockedDataFile.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for classes BlockedDataFileBuilder and BlockedDataFile
+ * @see BlockedDataFile.cpp for the implementation of these functions.
+ * @details
+ * This file declares a blocked sequence-set layout of the data file. Records are sorted by zip code and
+ * packed into fixed-size blocks; no record crosses a block boundary. Every block starts with its first
+ * and last key and a slot directory, so a block can be binary-searched once it is in memory.
+ *
+ * The only resident structure is the sparse block index: the first and last key of every block, eight
+ * bytes per block instead of one index entry per record. A point lookup binary-searches the sparse
+ * index, reads one block with one positioned read and searches the slots. A range scan reads the
+ * blocks of the range in order, several at a time.
+ *
+ * A file may instead be compressed block by block with a BlockCodec. A compressed block holds the same
+ * key range as before, but the records are packed as a delta-encoded zip, a length and the rest of the
+ * payload, and the packed block is compressed and stored at its natural size. The sparse index then also
+ * records the offset and sizes of every block. Readers decompress transparently: Find() and Scan()
+ * behave the same for every codec, and the codec is only visible through codec().
+ *
+ * The layout is a library for programs that want a sorted, compact copy of a data file: no build or query
+ * path of this program writes or reads one. BlockedDataFileBuilder::AddDataFile() makes the copy from a
+ * data file, and it is kept beside that file rather than replacing it.
+ *
+ * File layout (version 1, host byte order, checked through 'byteOrder'):
+ * - block 0:             FileHeader, padded with zero bytes to blockSize
+ * - uncompressed:        blocks 1..blockCount, each BlockHeader, Slot[recordCount], then the payloads,
+ *                        padded to blockSize
+ * - compressed:          the compressed blocks back to back from offset blockSize; a packed block is a
+ *                        sequence of varint zip delta, varint (length << 1 | zip stripped), payload bytes
+ * - at indexOffset:      BlockBounds[blockCount], the sparse index, then for compressed files
+ *                        BlockExtent[blockCount]
+ *
+ * Assumptions:
+ * - The key of a record is its zip code, a number of at most five digits; other records are not stored.
+ * - A record fits in one block: its payload is at most blockSize - 24 bytes.
+ * - The zip of a compressed record is only stripped from its payload when it is written in canonical
+ *   form, as five zero-padded digits, so every payload is restored byte for byte.
+ * - Records with the same zip keep their input order, and a lookup returns the first of them.
+ */
+
+#ifndef ZIPCODES_BLOCKEDDATAFILE_H
+#define ZIPCODES_BLOCKEDDATAFILE_H
+
+#include "BlockCodec.h"
+#include "LengthIndicator.h"
+#include "MappedDataFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief First and last key of one block; the sparse index is an array of these.
+ */
+struct BlockBounds {
+    std::uint32_t firstKey; /**< Smallest key in the block. */
+    std::uint32_t lastKey;  /**< Largest key in the block. */
+};
+
+class BlockedDataFile {
+public:
+    static constexpr std::uint32_t VERSION = 1;               /**< Format version written by the builder. */
+    static constexpr std::uint32_t DEFAULT_BLOCK_SIZE = 4096; /**< Block size used unless one is given. */
+    static constexpr std::uint32_t MIN_BLOCK_SIZE = 512;      /**< Smallest accepted block size. */
+    static constexpr std::uint32_t MAX_BLOCK_SIZE = 65536;    /**< Largest block size the 16-bit slots address. */
+
+    /**
+     * @brief Default constructor. No file is open.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    BlockedDataFile();
+
+    /**
+     * @brief Closes the file.
+     */
+    ~BlockedDataFile();
+
+    BlockedDataFile(const BlockedDataFile&) = delete;
+    BlockedDataFile& operator=(const BlockedDataFile&) = delete;
+
+    /**
+     * @brief Opens a blocked data file and loads its sparse index.
+     * @param fileName Name of the file.
+     * @return true if the file is a valid blocked data file for this host, false otherwise.
+     * @pre None.
+     * @post On success Find() and Scan() read from the file.
+     */
+    bool Open(const std::string& fileName);
+
+    bool isOpen() const;
+
+    /**
+     * @brief Looks up the first record with a zip code.
+     * @param zip The zip code.
+     * @param record Receives the record payload.
+     * @return true if the zip is in the file.
+     * @pre The file is open.
+     * @post At most one block was read.
+     */
+    bool Find(std::uint32_t zip, std::string& record) const;
+
+    /**
+     * @brief Looks up the first record with a zip code given as text.
+     * @param key The zip code, as in the record.
+     * @param record Receives the record payload.
+     * @return true if the zip is in the file.
+     */
+    bool Find(std::string_view key, std::string& record) const;
+
+    /**
+     * @brief Visits every record whose zip lies in [firstZip, lastZip], in key order.
+     * @param firstZip Smallest zip of the range.
+     * @param lastZip Largest zip of the range.
+     * @param visit Called with the zip and payload of every record in the range.
+     * @return Number of records visited.
+     * @pre The file is open.
+     * @post Only the blocks that overlap the range were read, in file order.
+     */
+    std::size_t Scan(std::uint32_t firstZip, std::uint32_t lastZip,
+                     const std::function<void(std::uint32_t, std::string_view)>& visit) const;
+
+    std::uint32_t blockSize() const;
+    BlockCodec::Type codec() const;
+    std::size_t blockCount() const;
+    std::size_t size() const;
+
+    /**
+     * @brief Bytes of the resident sparse index, block extents included.
+     */
+    std::size_t IndexBytes() const;
+
+    void close();
+
+private:
+    friend class BlockedDataFileBuilder;
+
+    /**
+     * @brief On-disk header of a blocked data file, stored at the start of block 0.
+     */
+    struct FileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byteOrder;
+        std::uint32_t blockSize;
+        std::uint32_t codec;     /**< BlockCodec::Type of every block. */
+        std::uint64_t blockCount;
+        std::uint64_t recordCount;
+        std::uint64_t indexOffset;
+    };
+
+    /**
+     * @brief Start of every data block.
+     */
+    struct BlockHeader {
+        std::uint32_t firstKey;
+        std::uint32_t lastKey;
+        std::uint32_t recordCount;
+        std::uint32_t usedBytes; /**< Bytes of the block in use, header included. */
+    };
+
+    /**
+     * @brief Directory entry of one record inside a block, sorted by key.
+     */
+    struct Slot {
+        std::uint32_t key;
+        std::uint16_t offset; /**< Offset of the payload from the start of the block. */
+        std::uint16_t length; /**< Payload length in bytes. */
+    };
+
+    /**
+     * @brief Where a compressed block is stored.
+     */
+    struct BlockExtent {
+        std::uint64_t offset;      /**< File offset of the compressed block. */
+        std::uint32_t storedBytes; /**< Bytes of the compressed block. */
+        std::uint32_t rawBytes;    /**< Bytes of the packed block before compression. */
+    };
+
+    static constexpr char MAGIC[8] = {'Z', 'I', 'P', 'B', 'L', 'K', 'D', '\0'};
+    static constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static constexpr std::size_t SCAN_READ_BYTES = 256 * 1024; /**< Bytes read at once by Scan(). */
+
+    std::size_t firstBlockFor(std::uint32_t zip) const;
+    bool unpackBlock(std::size_t blockIndex, const char* stored, std::vector<char>& packed) const;
+    static bool forEachPacked(const std::vector<char>& packed, std::uint32_t firstKey,
+                              const std::function<bool(std::uint32_t, std::string_view, bool)>& visit);
+    bool readAt(std::uint64_t offset, char* buffer, std::size_t length) const;
+
+    int dataFd;                         /**< Descriptor of the open file, or -1. */
+    mutable std::ifstream dataStream;   /**< The open file on hosts without positioned reads. */
+    std::uint32_t blockBytes;           /**< Bytes per block. */
+    BlockCodec::Type codecType;         /**< Codec of every block. */
+    std::uint64_t recordCount;          /**< Records in the file. */
+    std::vector<BlockBounds> bounds;    /**< Sparse index: key range of every block. */
+    std::vector<BlockExtent> extents;   /**< Location of every block of a compressed file. */
+};
+
+class BlockedDataFileBuilder {
+public:
+    /**
+     * @brief Constructor.
+     * @param blockSize Bytes per block, a power of two from 512 to 65536. For a compressed file this
+     * is the size of a block before compression.
+     * @param codec Codec that compresses every block, or BlockCodec::NONE.
+     * @pre None.
+     * @post No records have been added.
+     */
+    explicit BlockedDataFileBuilder(std::uint32_t blockSize = BlockedDataFile::DEFAULT_BLOCK_SIZE,
+                                    BlockCodec::Type codec = BlockCodec::NONE);
+
+    /**
+     * @brief Adds one record.
+     * @param record The record payload.
+     * @return true if the record had a numeric zip and fits in a block, false if it was skipped.
+     * @pre None.
+     * @post The record is part of the next Write().
+     */
+    bool AddRecord(std::string_view record);
+
+    /**
+     * @brief Adds every record of a length-indicated data file.
+     * @param fileName Name of the data file.
+     * @param dataOffset Offset of the first record, used to skip a header block.
+     * @param format Format of the length indicators of the data file.
+     * @param dataSize Bytes of records after 'dataOffset', HeaderRecord::getDataSize() of the file.
+     * @return true if the file could be read, false otherwise.
+     */
+    bool AddDataFile(const std::string& fileName, std::uint64_t dataOffset = 0,
+                     LengthIndicator::Format format = LengthIndicator::DEFAULT,
+                     std::uint64_t dataSize = MappedDataFile::TO_END_OF_FILE);
+
+    /**
+     * @brief Sorts the records by key and writes them as a blocked data file.
+     * @param fileName Name of the file to create.
+     * @return true if the file was written, false otherwise.
+     * @pre None.
+     * @post 'fileName' holds a file that BlockedDataFile::Open() accepts.
+     */
+    bool Write(const std::string& fileName) const;
+
+    std::size_t size() const;
+
+private:
+    bool writePlainBlocks(std::ofstream& out, const std::vector<std::uint32_t>& order,
+                          std::vector<BlockBounds>& bounds) const;
+    bool writeCompressedBlocks(std::ofstream& out, const std::vector<std::uint32_t>& order,
+                               std::vector<BlockBounds>& bounds,
+                               std::vector<BlockedDataFile::BlockExtent>& extents) const;
+
+    std::uint32_t blockSize;             /**< Bytes per block. */
+    BlockCodec::Type codec;              /**< Codec of every block. */
+    std::vector<std::uint32_t> keys;     /**< Key of every record. */
+    std::vector<std::uint64_t> starts;   /**< Start of every payload in 'payloads', plus the end of the last. */
+    std::string payloads;                /**< Payloads, back to back, in input order. */
+};
+
+#endif //ZIPCODES_BLOCKEDDATAFILE_H
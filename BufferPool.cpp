@@ -0,0 +1,471 @@
+/**
+ * @file BufferPool.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the BufferPool class.
+ * @see BufferPool.h for declaration.
+ */
+
+#include "BufferPool.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ZIPCODES_HAVE_PREAD 1
+#endif
+
+namespace {
+
+std::mutex sharedLock;                                  /**< Guards the two values below. */
+std::size_t sharedBudget = BufferPool::DEFAULT_BUDGET;  /**< Budget of the shared pool. */
+bool sharedCreated = false;                             /**< Shared() has created the pool. */
+
+} // namespace
+
+BufferPool::PageRef::PageRef() : pool(nullptr), frame(0), bytes(nullptr), valid(0) {
+}
+
+BufferPool::PageRef::PageRef(BufferPool* pool, std::size_t frame, const char* data, std::size_t size)
+        : pool(pool), frame(frame), bytes(data), valid(size) {
+}
+
+BufferPool::PageRef::PageRef(PageRef&& other) noexcept
+        : pool(other.pool), frame(other.frame), bytes(other.bytes), valid(other.valid) {
+    other.pool = nullptr;
+}
+
+BufferPool::PageRef& BufferPool::PageRef::operator=(PageRef&& other) noexcept {
+    if (this != &other) {
+        if (pool != nullptr) {
+            pool->unpin(frame);
+        }
+        pool = other.pool;
+        frame = other.frame;
+        bytes = other.bytes;
+        valid = other.valid;
+        other.pool = nullptr;
+    }
+    return *this;
+}
+
+/**
+ * @brief Unpins the page.
+ */
+BufferPool::PageRef::~PageRef() {
+    if (pool != nullptr) {
+        pool->unpin(frame);
+    }
+}
+
+/**
+ * @brief First byte of the page.
+ */
+const char* BufferPool::PageRef::data() const {
+    return bytes;
+}
+
+/**
+ * @brief Bytes of the page that lie inside the file.
+ */
+std::size_t BufferPool::PageRef::size() const {
+    return valid;
+}
+
+BufferPool::PageRef::operator bool() const {
+    return pool != nullptr;
+}
+
+/**
+ * @brief Constructor. Allocates all frames at once.
+ * @param budgetBytes Most bytes of pages held at once; rounded down to whole pages.
+ * @param pageSize Bytes per page.
+ */
+BufferPool::BufferPool(std::size_t budgetBytes, std::size_t pageSize)
+        : bytesPerPage(std::max<std::size_t>(pageSize, 1)), nextFile(NO_FILE + 1), hand(0),
+          hitCount(0), missCount(0), evictionCount(0) {
+    const std::size_t frameCount = budgetBytes / bytesPerPage;
+    memory.resize(frameCount * bytesPerPage);
+    frames.resize(frameCount, Frame{NO_FILE, 0, 0, false, false, false, 0});
+    table.reserve(frameCount);
+}
+
+/**
+ * @brief Closes every file still registered.
+ */
+BufferPool::~BufferPool() {
+#ifdef ZIPCODES_HAVE_PREAD
+    for (auto& file : files) {
+        if (file.second->fd >= 0) {
+            ::close(file.second->fd);
+        }
+    }
+#endif
+}
+
+/**
+ * @brief The pool shared by the whole process, created on first use.
+ */
+BufferPool& BufferPool::Shared() {
+    // Never destroyed, so objects that outlive static destruction can still close their files.
+    static BufferPool* pool = new BufferPool([] {
+        std::lock_guard<std::mutex> guard(sharedLock);
+        sharedCreated = true;
+        return sharedBudget;
+    }());
+    return *pool;
+}
+
+/**
+ * @brief Sets the budget of the shared pool.
+ * @param budgetBytes Most bytes of pages the shared pool holds.
+ * @return false if the shared pool was already created.
+ */
+bool BufferPool::ConfigureShared(std::size_t budgetBytes) {
+    std::lock_guard<std::mutex> guard(sharedLock);
+    if (sharedCreated) {
+        return false;
+    }
+    sharedBudget = budgetBytes;
+    return true;
+}
+
+/**
+ * @brief Registers a file for reading through the pool.
+ * @param fileName Name of the file.
+ * @return The file's id, shared with every other registration of the same file; NO_FILE on failure.
+ */
+BufferPool::FileId BufferPool::OpenFile(const std::string& fileName) {
+    std::unique_ptr<File> opened(new File());
+    opened->users = 1;
+#ifdef ZIPCODES_HAVE_PREAD
+    opened->fd = ::open(fileName.c_str(), O_RDONLY);
+    struct stat status;
+    if (opened->fd < 0 || ::fstat(opened->fd, &status) != 0) {
+        if (opened->fd >= 0) {
+            ::close(opened->fd);
+        }
+        return NO_FILE;
+    }
+    // Two names of one file share its pages; a file renamed over another is a new file.
+    opened->identity = std::to_string(status.st_dev) + ":" + std::to_string(status.st_ino);
+#else
+    opened->fd = -1;
+    opened->stream.open(fileName, std::ios::binary);
+    if (!opened->stream.is_open()) {
+        return NO_FILE;
+    }
+    opened->identity = fileName;
+#endif
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto& file : files) {
+        if (file.second->identity == opened->identity) {
+#ifdef ZIPCODES_HAVE_PREAD
+            ::close(opened->fd);
+#endif
+            file.second->users++;
+            return file.first;
+        }
+    }
+    const FileId id = nextFile++;
+    files.emplace(id, std::move(opened));
+    return id;
+}
+
+/**
+ * @brief Drops one registration of a file; the last one evicts its pages and closes it.
+ * @param file The file's id.
+ */
+void BufferPool::CloseFile(FileId file) {
+    std::lock_guard<std::mutex> guard(lock);
+    const auto found = files.find(file);
+    if (found == files.end() || --found->second->users > 0) {
+        return;
+    }
+    for (std::size_t i = 0; i < frames.size(); i++) {
+        if (frames[i].file == file) {
+            releaseFrame(i);
+        }
+    }
+#ifdef ZIPCODES_HAVE_PREAD
+    ::close(found->second->fd);
+#endif
+    files.erase(found);
+}
+
+/**
+ * @brief Pins one page, reading it on a miss.
+ * @param file The file's id.
+ * @param pageNumber Page of the file, counted from 0.
+ * @return The pinned page; empty if the read failed or every frame is pinned.
+ */
+BufferPool::PageRef BufferPool::Pin(FileId file, std::uint64_t pageNumber) {
+    std::unique_lock<std::mutex> guard(lock);
+    const auto source = files.find(file);
+    if (source == files.end()) {
+        return PageRef();
+    }
+    const std::uint64_t key = tableKey(file, pageNumber);
+    const auto cached = table.find(key);
+    if (cached != table.end()) {
+        const std::size_t i = cached->second;
+        Frame& frame = frames[i];
+        frame.pins++;
+        frame.referenced = true;
+        loaded.wait(guard, [&frame]() { return !frame.loading; });
+        if (frame.failed) {
+            dropPin(i);
+            return PageRef();
+        }
+        hitCount++;
+        return PageRef(this, i, memory.data() + i * bytesPerPage, frame.valid);
+    }
+
+    const std::size_t i = findVictim();
+    if (i == frames.size()) {
+        return PageRef();
+    }
+    Frame& frame = frames[i];
+    frame = Frame{file, pageNumber, 1, true, true, false, 0};
+    table[key] = i;
+    missCount++;
+    File& input = *source->second;
+
+    // Other threads may use the pool while the page is read; those wanting this page wait for it.
+    guard.unlock();
+    const long long got = readFile(input, pageNumber * bytesPerPage, memory.data() + i * bytesPerPage,
+                                   bytesPerPage);
+    guard.lock();
+    frame.loading = false;
+    if (got < 0) {
+        frame.failed = true;
+        const auto entry = table.find(key);
+        if (entry != table.end() && entry->second == i) {
+            table.erase(entry);
+        }
+    } else {
+        frame.valid = static_cast<std::size_t>(got);
+    }
+    loaded.notify_all();
+    if (frame.failed) {
+        dropPin(i);
+        return PageRef();
+    }
+    return PageRef(this, i, memory.data() + i * bytesPerPage, frame.valid);
+}
+
+/**
+ * @brief Copies bytes of a file through the pool.
+ * @param file The file's id.
+ * @param offset File offset of the first byte.
+ * @param buffer Receives the bytes.
+ * @param length Number of bytes.
+ * @return true if all bytes were read.
+ */
+bool BufferPool::Read(FileId file, std::uint64_t offset, char* buffer, std::size_t length) {
+    while (length > 0) {
+        const std::uint64_t pageNumber = offset / bytesPerPage;
+        const std::size_t inPage = static_cast<std::size_t>(offset % bytesPerPage);
+        const std::size_t chunk = std::min(length, bytesPerPage - inPage);
+        PageRef page = Pin(file, pageNumber);
+        if (page) {
+            if (page.size() < inPage + chunk) {
+                return false;
+            }
+            std::memcpy(buffer, page.data() + inPage, chunk);
+        } else {
+            // Every frame is pinned: the budget is a hard limit, so the bytes are read around the pool.
+            File* input;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                const auto found = files.find(file);
+                if (found == files.end()) {
+                    return false;
+                }
+                input = found->second.get();
+            }
+            if (readFile(*input, offset, buffer, chunk) != static_cast<long long>(chunk)) {
+                return false;
+            }
+        }
+        offset += chunk;
+        buffer += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+/**
+ * @brief Drops the cached pages that overlap bytes a writer changed.
+ * @param file The file's id.
+ * @param offset File offset of the first changed byte.
+ * @param length Number of changed bytes.
+ */
+void BufferPool::Invalidate(FileId file, std::uint64_t offset, std::size_t length) {
+    if (length == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    const std::uint64_t last = (offset + length - 1) / bytesPerPage;
+    for (std::uint64_t pageNumber = offset / bytesPerPage; pageNumber <= last; pageNumber++) {
+        const auto cached = table.find(tableKey(file, pageNumber));
+        if (cached != table.end()) {
+            releaseFrame(cached->second);
+        }
+    }
+}
+
+/**
+ * @brief Page requests served from the pool.
+ */
+std::uint64_t BufferPool::hits() const {
+    return hitCount;
+}
+
+/**
+ * @brief Page requests that read the file.
+ */
+std::uint64_t BufferPool::misses() const {
+    return missCount;
+}
+
+/**
+ * @brief Pages evicted to make room for others.
+ */
+std::uint64_t BufferPool::evictions() const {
+    return evictionCount;
+}
+
+/**
+ * @brief Sets the hit, miss and eviction counters to 0.
+ */
+void BufferPool::ResetCounters() {
+    hitCount = 0;
+    missCount = 0;
+    evictionCount = 0;
+}
+
+std::size_t BufferPool::pageSize() const {
+    return bytesPerPage;
+}
+
+/**
+ * @brief Number of frames, the most pages the pool holds.
+ */
+std::size_t BufferPool::capacity() const {
+    return frames.size();
+}
+
+/**
+ * @brief Bytes the pool may hold, whole pages only.
+ */
+std::size_t BufferPool::budget() const {
+    return memory.size();
+}
+
+/**
+ * @brief Number of pages currently cached.
+ */
+std::size_t BufferPool::residentPages() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return table.size();
+}
+
+std::uint64_t BufferPool::tableKey(FileId file, std::uint64_t pageNumber) {
+    // 40 bits of page number cover files of 4 PiB at the default page size.
+    return (std::uint64_t(file) << 40) ^ pageNumber;
+}
+
+/**
+ * @brief Picks a free or unpinned, unreferenced frame and removes its page from the table.
+ * @return The frame, or frames.size() if every frame is pinned.
+ */
+std::size_t BufferPool::findVictim() {
+    // Two sweeps: the first may only clear reference bits, the second then finds one unless all are pinned.
+    for (std::size_t step = 0; step < 2 * frames.size(); step++) {
+        const std::size_t i = hand;
+        hand = (hand + 1) % frames.size();
+        Frame& frame = frames[i];
+        if (frame.pins > 0) {
+            continue;
+        }
+        if (frame.file == NO_FILE) {
+            return i;
+        }
+        if (frame.referenced) {
+            frame.referenced = false;
+            continue;
+        }
+        evictionCount++;
+        releaseFrame(i);
+        return i;
+    }
+    return frames.size();
+}
+
+/**
+ * @brief Marks a frame free and drops its page from the table if the table still points at it.
+ */
+void BufferPool::releaseFrame(std::size_t frame) {
+    Frame& released = frames[frame];
+    if (released.file != NO_FILE) {
+        const auto entry = table.find(tableKey(released.file, released.page));
+        if (entry != table.end() && entry->second == frame) {
+            table.erase(entry);
+        }
+    }
+    // A pinned frame keeps its bytes for its holders; findVictim() skips it until the last unpin.
+    released.file = NO_FILE;
+    released.referenced = false;
+}
+
+/**
+ * @brief Drops one pin of a frame.
+ */
+void BufferPool::unpin(std::size_t frame) {
+    std::lock_guard<std::mutex> guard(lock);
+    dropPin(frame);
+}
+
+/**
+ * @brief Drops one pin of a frame; the caller holds the lock.
+ */
+void BufferPool::dropPin(std::size_t frame) {
+    Frame& unpinned = frames[frame];
+    if (unpinned.pins > 0 && --unpinned.pins == 0 && unpinned.failed) {
+        releaseFrame(frame);
+        unpinned.failed = false;
+    }
+}
+
+/**
+ * @brief Reads up to 'length' bytes of a file at 'offset'.
+ * @return Bytes read, which is less than 'length' at the end of the file; -1 on error.
+ */
+long long BufferPool::readFile(File& file, std::uint64_t offset, char* buffer, std::size_t length) {
+#ifdef ZIPCODES_HAVE_PREAD
+    std::size_t done = 0;
+    while (done < length) {
+        ssize_t got = ::pread(file.fd, buffer + done, length - done, static_cast<off_t>(offset + done));
+        if (got < 0) {
+            return -1;
+        }
+        if (got == 0) {
+            break;
+        }
+        done += static_cast<std::size_t>(got);
+    }
+    return static_cast<long long>(done);
+#else
+    std::lock_guard<std::mutex> guard(file.streamLock);
+    file.stream.clear();
+    file.stream.seekg(static_cast<std::streamoff>(offset));
+    file.stream.read(buffer, static_cast<std::streamsize>(length));
+    if (file.stream.bad()) {
+        return -1;
+    }
+    return static_cast<long long>(file.stream.gcount());
+#endif
+}
@@ -0,0 +1,275 @@
+/**
+ * @file BufferPool.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class BufferPool
+ * @see BufferPool.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class BufferPool, a process-wide cache of fixed-size file pages. A page is
+ * identified by the file it belongs to and its page number; a file is registered once with OpenFile() and
+ * every reader of the same file shares its cached pages. PrimaryKeyIndex reads records and BPlusTree reads
+ * index pages through the shared pool, so a zip that is looked up often is served from the pool without a
+ * system call.
+ *
+ * The pool holds at most 'budgetBytes' of pages, allocated once when it is created. When every frame is in
+ * use the CLOCK hand picks the victim: a frame read since the hand last passed it gets a second chance, so
+ * pages in steady use stay resident while pages read once are evicted first. A pinned page is never evicted;
+ * Pin() returns a PageRef that unpins the page when it is destroyed.
+ *
+ * Assumptions:
+ * - The budget of the shared pool is set with ConfigureShared() before the first call to Shared().
+ * - A file registered with the pool is changed only by a writer that calls Invalidate() for the bytes it
+ *   wrote. Files replaced by a rename are new files and are registered anew.
+ * - The pool is thread-safe. A miss is read outside the pool's lock; other threads wanting the same page
+ *   wait for that read instead of issuing their own.
+ */
+
+#ifndef ZIPCODES_BUFFERPOOL_H
+#define ZIPCODES_BUFFERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class BufferPool {
+public:
+    using FileId = std::uint32_t;
+
+    static constexpr FileId NO_FILE = 0;                                    /**< Id that names no file. */
+    static constexpr std::size_t PAGE_SIZE = 4096;                           /**< Default bytes per page. */
+    static constexpr std::size_t DEFAULT_BUDGET = std::size_t(64) << 20;     /**< Default bytes of the shared pool. */
+
+    /**
+     * @brief A pinned page. The page stays resident until the PageRef is destroyed.
+     */
+    class PageRef {
+    public:
+        PageRef();
+        PageRef(PageRef&& other) noexcept;
+        PageRef& operator=(PageRef&& other) noexcept;
+        PageRef(const PageRef&) = delete;
+        PageRef& operator=(const PageRef&) = delete;
+
+        /**
+         * @brief Unpins the page.
+         */
+        ~PageRef();
+
+        /**
+         * @brief First byte of the page.
+         */
+        const char* data() const;
+
+        /**
+         * @brief Bytes of the page that lie inside the file; less than the page size for the last page.
+         */
+        std::size_t size() const;
+
+        explicit operator bool() const;
+
+    private:
+        friend class BufferPool;
+        PageRef(BufferPool* pool, std::size_t frame, const char* data, std::size_t size);
+
+        BufferPool* pool;  /**< Pool that holds the page, or nullptr. */
+        std::size_t frame; /**< Frame of the page inside the pool. */
+        const char* bytes; /**< The page. */
+        std::size_t valid; /**< Bytes of the page inside the file. */
+    };
+
+    /**
+     * @brief Constructor. Allocates all frames at once.
+     * @param budgetBytes Most bytes of pages held at once; rounded down to whole pages.
+     * @param pageSize Bytes per page.
+     * @pre pageSize is not 0.
+     * @post The pool is empty.
+     */
+    explicit BufferPool(std::size_t budgetBytes = DEFAULT_BUDGET, std::size_t pageSize = PAGE_SIZE);
+
+    /**
+     * @brief Closes every file still registered.
+     * @pre No page is pinned.
+     */
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /**
+     * @brief The pool shared by the whole process, created on first use.
+     */
+    static BufferPool& Shared();
+
+    /**
+     * @brief Sets the budget of the shared pool.
+     * @param budgetBytes Most bytes of pages the shared pool holds.
+     * @return false if the shared pool was already created, so the budget can no longer change.
+     * @pre None.
+     * @post Shared() creates its pool with 'budgetBytes'.
+     */
+    static bool ConfigureShared(std::size_t budgetBytes);
+
+    /**
+     * @brief Registers a file for reading through the pool.
+     * @param fileName Name of the file.
+     * @return The file's id, shared with every other registration of the same file; NO_FILE on failure.
+     * @pre None.
+     * @post Every OpenFile() that succeeded must be matched by one CloseFile().
+     */
+    FileId OpenFile(const std::string& fileName);
+
+    /**
+     * @brief Drops one registration of a file; the last one evicts its pages and closes it.
+     * @param file The file's id.
+     * @pre No page of the file is pinned through this registration.
+     * @post None.
+     */
+    void CloseFile(FileId file);
+
+    /**
+     * @brief Pins one page, reading it on a miss.
+     * @param file The file's id.
+     * @param pageNumber Page of the file, counted from 0.
+     * @return The pinned page; empty if the read failed or every frame is pinned.
+     * @pre 'file' is registered.
+     * @post The page stays resident while the returned PageRef lives.
+     */
+    PageRef Pin(FileId file, std::uint64_t pageNumber);
+
+    /**
+     * @brief Copies bytes of a file through the pool.
+     * @param file The file's id.
+     * @param offset File offset of the first byte.
+     * @param buffer Receives the bytes.
+     * @param length Number of bytes.
+     * @return true if all bytes were read.
+     * @pre 'file' is registered.
+     * @post A page that cannot be cached because every frame is pinned is read directly.
+     */
+    bool Read(FileId file, std::uint64_t offset, char* buffer, std::size_t length);
+
+    /**
+     * @brief Drops the cached pages that overlap bytes a writer changed.
+     * @param file The file's id.
+     * @param offset File offset of the first changed byte.
+     * @param length Number of changed bytes.
+     * @pre None.
+     * @post The next read of those bytes goes to the file.
+     */
+    void Invalidate(FileId file, std::uint64_t offset, std::size_t length);
+
+    /**
+     * @brief Page requests served from the pool.
+     */
+    std::uint64_t hits() const;
+
+    /**
+     * @brief Page requests that read the file.
+     */
+    std::uint64_t misses() const;
+
+    /**
+     * @brief Pages evicted to make room for others.
+     */
+    std::uint64_t evictions() const;
+
+    /**
+     * @brief Sets the hit, miss and eviction counters to 0.
+     */
+    void ResetCounters();
+
+    std::size_t pageSize() const;
+
+    /**
+     * @brief Number of frames, the most pages the pool holds.
+     */
+    std::size_t capacity() const;
+
+    /**
+     * @brief Bytes the pool may hold, whole pages only.
+     */
+    std::size_t budget() const;
+
+    /**
+     * @brief Number of pages currently cached.
+     */
+    std::size_t residentPages() const;
+
+private:
+    /**
+     * @brief One registered file.
+     */
+    struct File {
+        int fd;                 /**< Descriptor of the file, or -1. */
+        std::ifstream stream;   /**< The file on hosts without positioned reads. */
+        std::mutex streamLock;  /**< Serializes reads of 'stream'. */
+        std::string identity;   /**< Device and inode, or the file name on other hosts. */
+        std::size_t users;      /**< Registrations not yet closed. */
+    };
+
+    /**
+     * @brief One page-sized slot of the pool.
+     */
+    struct Frame {
+        FileId file;            /**< File of the cached page, NO_FILE when the frame is free. */
+        std::uint64_t page;     /**< Page number of the cached page. */
+        std::uint32_t pins;     /**< PageRefs holding the frame. */
+        bool referenced;        /**< Read since the CLOCK hand last passed. */
+        bool loading;           /**< The page is being read. */
+        bool failed;            /**< The read of the page failed. */
+        std::size_t valid;      /**< Bytes of the page inside the file. */
+    };
+
+    std::size_t bytesPerPage;                          /**< Bytes per page. */
+    std::vector<char> memory;                          /**< The pages of all frames. */
+    std::vector<Frame> frames;                         /**< The frames. */
+    std::unordered_map<std::uint64_t, std::size_t> table; /**< Frame of every cached (file, page). */
+    std::map<FileId, std::unique_ptr<File>> files;     /**< Registered files. */
+    FileId nextFile;                                   /**< Id of the next new file. */
+    std::size_t hand;                                  /**< CLOCK hand. */
+    mutable std::mutex lock;                           /**< Guards everything above. */
+    std::condition_variable loaded;                    /**< Signalled when a page read ends. */
+    std::atomic<std::uint64_t> hitCount;               /**< Requests served from the pool. */
+    std::atomic<std::uint64_t> missCount;              /**< Requests that read the file. */
+    std::atomic<std::uint64_t> evictionCount;          /**< Pages evicted. */
+
+    static std::uint64_t tableKey(FileId file, std::uint64_t pageNumber);
+
+    /**
+     * @brief Picks a free or unpinned, unreferenced frame and removes its page from the table.
+     * @return The frame, or frames.size() if every frame is pinned.
+     */
+    std::size_t findVictim();
+
+    /**
+     * @brief Marks a frame free and drops its page from the table if the table still points at it.
+     */
+    void releaseFrame(std::size_t frame);
+
+    /**
+     * @brief Drops one pin of a frame.
+     */
+    void unpin(std::size_t frame);
+
+    /**
+     * @brief Drops one pin of a frame; the caller holds the lock.
+     */
+    void dropPin(std::size_t frame);
+
+    /**
+     * @brief Reads up to 'length' bytes of a file at 'offset'.
+     * @return Bytes read, which is less than 'length' at the end of the file; -1 on error.
+     */
+    static long long readFile(File& file, std::uint64_t offset, char* buffer, std::size_t length);
+};
+
+#endif //ZIPCODES_BUFFERPOOL_H
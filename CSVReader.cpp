@@ -10,11 +10,8 @@
  * - Constructor: Opens a specified CSV file for reading.
  * - isOpen(): Checks if the CSV file is currently open.
  * - GetHeaders(): Parses and stores the header row of the CSV file, populating the Headers vector with column headers.
- * - ReadFile(): Reads and processes the entire CSV file, including parsing data rows and calculating state statistics.
- * - ParseLine(): Parses a single data row of the CSV file into a Row object, updating it with data from the input line.
- * - CheckMaxima(): Checks and updates a map (StateMaximums) with maximum and minimum values for latitude and longitude based on the input Row.
- * - CompareExtremes(): Compares and updates the maximum and minimum values for latitude and longitude in a state.
- * - GetStateMaximums(): Retrieves a copy of the StateMaximums map, which contains state statistics.
+ * - ReadFile(): Reads the entire CSV file and feeds every data row to a StateExtremes analyzer.
+ * - ParseLine(): Parses a single data row of the CSV file into its fields.
  * - close(): Closes the CSV file if it's currently open.
  *
  * Assumptions:
@@ -32,10 +29,18 @@
  *
  */
 #include "CSVReader.h"
+#include "DataFileBuilder.h"
+#include "FieldTokenizer.h"
+#include "HeaderRecordBuffer.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <bitset>
+#include <cstring>
+#include <thread>
 
 /**
  * @brief Constructor that opens the CSV file specified by the 'filename' parameter.
@@ -43,7 +48,7 @@
  * @pre None.
  * @post The CSVReader object is constructed, and the CSV file is opened for reading.
  */
-CSVReader::CSVReader(const std::string filename) {
+CSVReader::CSVReader(const std::string filename) : FileName(filename) {
     ZipCSV.open(filename, std::ios::in);
 }
 
@@ -64,56 +69,462 @@ bool CSVReader::isOpen() const {
  * @post The 'Headers' vector is populated with column headers from the CSV file.
  */
 void CSVReader::GetHeaders(std::string &line) {
-    std::stringstream stream(line);
-    std::string header;
-    // Parses the first of the csv by comma to get headers
-    while (std::getline(stream, header, ',')) {
+    // Splits the first row of the csv on the unquoted commas found by the scanner
+    std::vector<std::string_view> fields;
+    scanner.SplitFields(line, fields);
+    for (std::string_view header : fields) {
         // Adds headers to the vector
-        Headers.push_back(header);
+        Headers.emplace_back(header);
     }
 }
 
+/**
+ * @brief Calls 'visit' with every non-empty row of the CSV file, header included, in file order.
+ * @return false if 'visit' returned false, which stops the scan at that row.
+ * @details The file is read in INGEST_BLOCK_SIZE blocks. Row boundaries come from the newline bitmap
+ * built by the DelimiterScanner, which ignores newlines inside quoted fields. A row that is cut by the
+ * end of a block is carried to the front of the buffer and completed by the next block.
+ * A trailing '\r' is removed from every row and empty rows are skipped.
+ */
+template <typename Visitor>
+bool CSVReader::forEachRow(Visitor&& visit) {
+    std::vector<char> buffer(INGEST_BLOCK_SIZE);
+    std::vector<std::uint64_t> commaBits;
+    std::vector<std::uint64_t> newlineBits;
+    std::size_t carry = 0;
+    bool stopped = false;
+
+    auto processRow = [&](std::string_view row) {
+        row = TrimRow(row);
+        if (!stopped && !row.empty() && !visit(row)) {
+            stopped = true;
+        }
+    };
+
+    scanner.Reset();
+    while (!stopped) {
+        if (buffer.size() < carry + INGEST_BLOCK_SIZE) {
+            buffer.resize(carry + INGEST_BLOCK_SIZE);
+        }
+        ZipCSV.read(buffer.data() + carry, INGEST_BLOCK_SIZE);
+        const std::size_t got = static_cast<std::size_t>(ZipCSV.gcount());
+        if (got == 0) {
+            break;
+        }
+        // Only the new bytes are scanned; the carried bytes were scanned with the previous block.
+        scanner.Scan(buffer.data() + carry, got, commaBits, newlineBits);
+        std::size_t rowStart = 0;
+        DelimiterScanner::ForEachBit(newlineBits, [&](std::size_t pos) {
+            const std::size_t newline = carry + pos;
+            processRow(std::string_view(buffer.data() + rowStart, newline - rowStart));
+            rowStart = newline + 1;
+        });
+        carry = carry + got - rowStart;
+        std::memmove(buffer.data(), buffer.data() + rowStart, carry);
+    }
+    // Last row of a file that does not end with a newline.
+    processRow(std::string_view(buffer.data(), carry));
+    return !stopped;
+}
+
 /**
  * @brief Reads and processes the entire CSV file.
+ * @return false if a record could not be written.
  * @pre The CSV file is open for reading.
  * @post The CSV file is read, and data is parsed and stored in memory.
+ * @details The records go through a RecordWriter attached to 'file', so they reach the stream a buffer
+ * at a time.
  */
-void CSVReader::buildFileStructure(std::ofstream& file,HeaderRecord& headerRecord) {
-    std::string line;
+bool CSVReader::buildFileStructure(std::ofstream& file,HeaderRecord& headerRecord) {
+    RecordWriter writer(RecordWriter::DEFAULT_BUFFER_SIZE, headerRecord.getLengthFormat());
+    writer.Attach(file);
+    const bool written = buildFileStructure(writer, headerRecord);
+    if (!writer.Close() || !written) {
+        std::cerr << "Error: The data file is incomplete." << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    // Read and store the header row of the CSV file.
-    std::getline(ZipCSV, line, '\n');
-    GetHeaders(line);
-    headerRecord.setFieldsPerRecord(Headers.size());
+/**
+ * @brief Reads the CSV file and writes every data row through a buffered RecordWriter.
+ * @param writer Open writer that receives one length-indicated record per CSV row.
+ * @param headerRecord Receives the field names, the counts, the dictionaries and the length indicator format.
+ * @param visit When set, called with every record as written and the offset of its length indicator.
+ * @return false if a record could not be written; the rest of the CSV file is not read.
+ * @details The first row from forEachRow() is the header; every other row becomes one record.
+ */
+bool CSVReader::buildFileStructure(RecordWriter& writer, HeaderRecord& headerRecord,
+                                   const std::function<void(std::string_view, std::uint64_t)>& visit) {
+    bool haveHeaders = false;
     int recordCount = 0;
-    // Read and process each data row of the CSV file.
-    while (std::getline(ZipCSV, line, '\n')) {
+    RecordDictionary* dictionary = headerRecord.isDictionaryEncoded() ? &headerRecord.getDictionary() : nullptr;
+    headerRecord.setLengthIndicatorFormat(LengthIndicator::Name(writer.lengthFormat()));
+    std::string encoded;
 
-        // line needs to be converted to length indicated
-        // after converting read to file.
-       //  ParseLine(line, NewRow);
-        WriteToFile(line, file);
+    const bool written = forEachRow([&](std::string_view row) {
+        if (!haveHeaders) {
+            // Read and store the header row of the CSV file.
+            std::string line(row);
+            GetHeaders(line);
+            headerRecord.fieldNames = Headers;
+            headerRecord.setFieldsPerRecord(Headers.size());
+            haveHeaders = true;
+            return true;
+        }
+        if (dictionary != nullptr) {
+            // State and County are written as codes; the dictionaries go into the header record.
+            dictionary->Add(row);
+            encoded.clear();
+            dictionary->Encode(row, encoded);
+            row = encoded;
+        }
+        std::uint64_t offset;
+        if (!writer.Write(row, offset)) {
+            // Every later record would fail the same way; the file is incomplete either way.
+            return false;
+        }
+        if (visit) {
+            visit(row, offset);
+        }
         recordCount = recordCount + 1;
+        return true;
+    });
+
+    if (Headers.empty()) {
+        headerRecord.setFieldsPerRecord(0);
     }
     headerRecord.setRecordCount(recordCount);
+    return written;
+}
+
+/**
+ * @brief Reads the entire CSV file and computes the extreme places of every state.
+ * @param extremes Receives every data row.
+ * @pre The CSV file is open for reading.
+ * @post 'extremes' is flushed and holds the extremes of every state in the file.
+ */
+void CSVReader::ReadFile(StateExtremes& extremes) {
+    bool haveHeaders = false;
+    forEachRow([&](std::string_view row) {
+        if (!haveHeaders) {
+            std::string line(row);
+            GetHeaders(line);
+            haveHeaders = true;
+            return true;
+        }
+        extremes.AddRow(row);
+        return true;
+    });
+    extremes.Flush();
+}
+
+/**
+ * @brief Converts the CSV file to length-indicated records on several threads.
+ * @param file The data file that receives one length-indicated record per CSV row.
+ * @param headerRecord Receives the field and record counts.
+ * @param threadCount Number of worker threads, 0 for one per hardware thread.
+ * @return false if a record could not be written.
+ * @pre The CSV file is open for reading.
+ * @post 'file' holds exactly the bytes buildFileStructure() would have written.
+ */
+bool CSVReader::buildFileStructureParallel(std::ofstream& file, HeaderRecord& headerRecord, unsigned threadCount) {
+    RecordWriter writer(RecordWriter::DEFAULT_BUFFER_SIZE, headerRecord.getLengthFormat());
+    writer.Attach(file);
+    const bool written = buildFileStructureParallel(writer, headerRecord, nullptr, threadCount);
+    if (!writer.Close() || !written) {
+        std::cerr << "Error: The data file is incomplete." << std::endl;
+        return false;
+    }
+    return true;
 }
 
 /**
- * @brief
- * @param
- * @param
- * @pre
- * @post
+ * @brief Converts the CSV file on several threads and writes the records through a buffered RecordWriter.
+ * @param writer Open writer that receives one length-indicated record per CSV row.
+ * @param headerRecord Receives the field names, the counts, the dictionaries and the length indicator format.
+ * @param visit When set, called with every record as written and the offset of its length indicator.
+ * @param threadCount Number of worker threads, 0 for one per hardware thread.
+ * @return false if 'writer' failed; no further chunk is written after the first failure.
+ * @details The CSV file is mapped and the rows after the header are cut into chunks of at most
+ * PARALLEL_CHUNK_SIZE bytes. Each chunk boundary is moved forward to the start of the next row:
+ * the quote state at the nominal boundary is the parity of the quotes before it, which the workers
+ * count in parallel first, so a newline inside a quoted field is never taken as a row end.
+ * Workers then encode a wave of 'threadCount' chunks into private buffers while a writer thread hands
+ * the previous wave to 'writer' in input order, so parsing and I/O overlap. The writer thread also
+ * calls 'visit', one record at a time in file order. If the file cannot be mapped the serial path is used.
+ */
+bool CSVReader::buildFileStructureParallel(RecordWriter& writer, HeaderRecord& headerRecord,
+                                           const std::function<void(std::string_view, std::uint64_t)>& visit,
+                                           unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    MappedFile csv;
+    if (threadCount == 1 || !csv.Open(FileName)) {
+        return buildFileStructure(writer, headerRecord, visit);
+    }
+    csv.AdviseSequential();
+    const char* text = csv.data();
+    const std::size_t size = csv.size();
+
+    // The header is the first non-empty row; it is short, so it is located serially.
+    std::vector<std::uint64_t> commaBits;
+    std::vector<std::uint64_t> newlineBits;
+    std::size_t bodyStart = size;
+    std::size_t rowStart = 0;
+    bool haveHeaders = false;
+    scanner.Reset();
+    for (std::size_t block = 0; block < size && !haveHeaders; block += INGEST_BLOCK_SIZE) {
+        const std::size_t length = std::min(INGEST_BLOCK_SIZE, size - block);
+        scanner.Scan(text + block, length, commaBits, newlineBits);
+        DelimiterScanner::ForEachBit(newlineBits, [&](std::size_t pos) {
+            if (haveHeaders) {
+                return;
+            }
+            std::string_view row = TrimRow(std::string_view(text + rowStart, block + pos - rowStart));
+            rowStart = block + pos + 1;
+            if (!row.empty()) {
+                std::string line(row);
+                GetHeaders(line);
+                haveHeaders = true;
+                bodyStart = rowStart;
+            }
+        });
+    }
+    if (!haveHeaders) {
+        std::string_view row = TrimRow(std::string_view(text + rowStart, size - rowStart));
+        if (!row.empty()) {
+            std::string line(row);
+            GetHeaders(line);
+        }
+    }
+    headerRecord.fieldNames = Headers;
+    headerRecord.setFieldsPerRecord(Headers.size());
+    headerRecord.setLengthIndicatorFormat(LengthIndicator::Name(writer.lengthFormat()));
+
+    // Nominal chunks: enough to keep every thread busy, none larger than PARALLEL_CHUNK_SIZE.
+    const std::size_t bodySize = size - bodyStart;
+    std::size_t chunkCount = std::max<std::size_t>(threadCount, (bodySize + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE);
+    chunkCount = std::max<std::size_t>(1, std::min(chunkCount, bodySize / DelimiterScanner::BITS_PER_WORD));
+    std::vector<std::size_t> bounds(chunkCount + 1);
+    for (std::size_t i = 0; i <= chunkCount; i++) {
+        bounds[i] = bodyStart + bodySize / chunkCount * i;
+    }
+    bounds[chunkCount] = size;
+
+    // Pass 1: quote parity of every nominal chunk, in parallel.
+    std::vector<unsigned char> quoteParity(chunkCount);
+    runWorkers(threadCount, chunkCount, [&](std::size_t i) {
+        std::size_t quotes = std::count(text + bounds[i], text + bounds[i + 1], '"');
+        quoteParity[i] = static_cast<unsigned char>(quotes & 1);
+    });
+
+    // Move every inner boundary to the first byte after an unquoted newline.
+    bool insideQuotes = false;
+    std::vector<std::size_t> rowBounds(chunkCount + 1);
+    rowBounds[0] = bodyStart;
+    for (std::size_t i = 1; i < chunkCount; i++) {
+        insideQuotes = insideQuotes != (quoteParity[i - 1] != 0);
+        bool inside = insideQuotes;
+        std::size_t pos = std::max(bounds[i], rowBounds[i - 1]);
+        // Re-derive the quote state if an earlier boundary was pushed past this chunk's start.
+        for (std::size_t p = bounds[i]; p < pos; p++) {
+            inside = text[p] == '"' ? !inside : inside;
+        }
+        while (pos < size && (inside || text[pos] != '\n')) {
+            inside = text[pos] == '"' ? !inside : inside;
+            pos++;
+        }
+        rowBounds[i] = std::min(size, pos + 1);
+    }
+    rowBounds[chunkCount] = size;
+
+    // Dictionary encoding: every chunk collects its values in parallel, and merging them in chunk order
+    // assigns the codes in order of first appearance in the file, as the serial path does.
+    RecordDictionary* dictionary = headerRecord.isDictionaryEncoded() ? &headerRecord.getDictionary() : nullptr;
+    if (dictionary != nullptr) {
+        std::vector<RecordDictionary> chunkDictionaries(chunkCount);
+        runWorkers(threadCount, chunkCount, [&](std::size_t chunk) {
+            forEachChunkRow(std::string_view(text + rowBounds[chunk], rowBounds[chunk + 1] - rowBounds[chunk]),
+                            [&](std::string_view row) { chunkDictionaries[chunk].Add(row); });
+        });
+        for (const RecordDictionary& chunkDictionary : chunkDictionaries) {
+            dictionary->Merge(chunkDictionary);
+        }
+    }
+
+    // Pass 2: the workers encode a wave into one set of buffers while the writer thread writes the
+    // previous wave from the other set. A set is only reused once the thread writing it was joined.
+    const LengthIndicator::Format lengthFormat = writer.lengthFormat();
+    std::vector<std::string> buffers[2] = {std::vector<std::string>(threadCount), std::vector<std::string>(threadCount)};
+    std::vector<int> counts[2] = {std::vector<int>(threadCount), std::vector<int>(threadCount)};
+    int recordCount = 0;
+    bool written = true;
+    auto writeWave = [&](std::size_t set, std::size_t waveSize) {
+        for (std::size_t slot = 0; slot < waveSize; slot++) {
+            const std::string& buffer = buffers[set][slot];
+            const std::uint64_t start = writer.offset();
+            if (!writer.WriteEncoded(buffer.data(), buffer.size(), static_cast<std::size_t>(counts[set][slot]))) {
+                written = false;
+                return;
+            }
+            std::size_t length;
+            std::size_t indicatorBytes;
+            for (std::size_t at = 0; visit && at < buffer.size(); at += indicatorBytes + length) {
+                LengthIndicator::Decode(buffer.data() + at, buffer.size() - at, lengthFormat, length, indicatorBytes);
+                visit(std::string_view(buffer.data() + at + indicatorBytes, length), start + at);
+            }
+            recordCount = recordCount + counts[set][slot];
+        }
+    };
+    std::thread writing;
+    for (std::size_t wave = 0, set = 0; wave < chunkCount; wave += threadCount, set ^= 1) {
+        const std::size_t waveSize = std::min<std::size_t>(threadCount, chunkCount - wave);
+        runWorkers(threadCount, waveSize, [&](std::size_t slot) {
+            const std::size_t chunk = wave + slot;
+            counts[set][slot] = encodeChunk(std::string_view(text + rowBounds[chunk], rowBounds[chunk + 1] - rowBounds[chunk]),
+                                            buffers[set][slot], dictionary, lengthFormat);
+        });
+        if (writing.joinable()) {
+            writing.join();
+        }
+        if (!written) {
+            break;
+        }
+        writing = std::thread(writeWave, set, waveSize);
+    }
+    if (writing.joinable()) {
+        writing.join();
+    }
+    headerRecord.setRecordCount(recordCount);
+    return written;
+}
+
+/**
+ * @brief Removes a trailing carriage return from a row.
+ * @param row A CSV row without its newline.
+ * @return The row without a trailing '\r'.
+ */
+std::string_view CSVReader::TrimRow(std::string_view row) {
+    if (!row.empty() && row.back() == '\r') {
+        row.remove_suffix(1);
+    }
+    return row;
+}
+
+/**
+ * @brief Appends one length-indicated record to a buffer, in the layout WriteToFile() uses.
+ * @param str The record payload.
+ * @param buffer The buffer to append to.
+ * @param format Format of the length indicator.
+ */
+void CSVReader::EncodeRecord(std::string_view str, std::string& buffer, LengthIndicator::Format format) {
+    LengthIndicator::Append(str.size(), format, buffer);
+    buffer.append(str.data(), str.size());
+}
+
+/**
+ * @brief Calls 'visit' with every non-empty row of a chunk that starts and ends on row boundaries.
+ * @param chunk The CSV text of the chunk.
+ * @param visit Callable taking the std::string_view of a row, without its line ending.
+ */
+template <typename Visitor>
+void CSVReader::forEachChunkRow(std::string_view chunk, Visitor&& visit) {
+    DelimiterScanner chunkScanner;
+    std::vector<std::uint64_t> commaBits;
+    std::vector<std::uint64_t> newlineBits;
+    auto processRow = [&](std::string_view row) {
+        row = TrimRow(row);
+        if (!row.empty()) {
+            visit(row);
+        }
+    };
+    std::size_t rowStart = 0;
+    for (std::size_t block = 0; block < chunk.size(); block += INGEST_BLOCK_SIZE) {
+        const std::size_t length = std::min(INGEST_BLOCK_SIZE, chunk.size() - block);
+        chunkScanner.Scan(chunk.data() + block, length, commaBits, newlineBits);
+        DelimiterScanner::ForEachBit(newlineBits, [&](std::size_t pos) {
+            processRow(chunk.substr(rowStart, block + pos - rowStart));
+            rowStart = block + pos + 1;
+        });
+    }
+    if (rowStart < chunk.size()) {
+        processRow(chunk.substr(rowStart));
+    }
+}
+
+/**
+ * @brief Encodes every row of a chunk that starts and ends on row boundaries.
+ * @param chunk The CSV text of the chunk.
+ * @param buffer Receives the length-indicated records; its previous contents are discarded.
+ * @param dictionary Codes for the State and County fields, or nullptr to write plain records.
+ * @param format Format of the length indicators.
+ * @return The number of records encoded.
+ */
+int CSVReader::encodeChunk(std::string_view chunk, std::string& buffer, const RecordDictionary* dictionary,
+                           LengthIndicator::Format format) {
+    buffer.clear();
+    buffer.reserve(chunk.size() + chunk.size() / 4);
+    std::string encoded;
+    int count = 0;
+    forEachChunkRow(chunk, [&](std::string_view row) {
+        if (dictionary != nullptr) {
+            encoded.clear();
+            dictionary->Encode(row, encoded);
+            row = encoded;
+        }
+        EncodeRecord(row, buffer, format);
+        count++;
+    });
+    return count;
+}
+
+/**
+ * @brief Runs 'task' for every index in [0, taskCount) on up to 'threadCount' threads.
+ * @param threadCount Maximum number of threads.
+ * @param taskCount Number of tasks.
+ * @param task Callable taking the std::size_t index of a task.
+ */
+template <typename Task>
+void CSVReader::runWorkers(unsigned threadCount, std::size_t taskCount, Task&& task) {
+    std::atomic<std::size_t> next(0);
+    auto worker = [&]() {
+        for (std::size_t i = next++; i < taskCount; i = next++) {
+            task(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    const std::size_t extra = std::min<std::size_t>(threadCount, taskCount);
+    for (std::size_t t = 1; t < extra; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+/**
+ * @brief Splits a length-indicated record into its fields.
+ * @param Record The record payload, comma separated.
+ * @return The fields of the record, in order, or no fields if it has more than FieldViews::CAPACITY.
+ * @pre None.
+ * @post None.
+ * @details Kept for callers that need owned strings. Scans should use FieldTokenizer directly,
+ * which returns views into the record and does not allocate.
  */
 std::vector<std::string> CSVReader::ParseLine(const std::string& Record) {
-    // for parsing a length indicated record after being read from data file, not csv
-    // consider switching to the c++ >> operator
-    // parse by comma based on fields read from header
-    std::stringstream stream(Record);
-    std::string field;
+    FieldViews fields;
     std::vector<std::string> parsedRecord;
-    while (std::getline(stream, field, ',')) {
-        parsedRecord.push_back(field);
+    if (!FieldTokenizer::Tokenize(Record, fields)) {
+        // Cut to CAPACITY fields the row would lose its last fields without notice.
+        std::cerr << "Error: The record has more than " << FieldViews::CAPACITY << " fields: " << Record << std::endl;
+        return parsedRecord;
+    }
+    parsedRecord.reserve(fields.size());
+    for (std::size_t i = 0; i < fields.size(); i++) {
+        parsedRecord.emplace_back(fields[i]);
     }
     return parsedRecord;
 }
@@ -125,19 +536,22 @@ void CSVReader::ConvertToLength(const std::string& inputRecord, Record& outputRe
     // store row in records struct made up of a char vector and an integer size.
 }
 
-void CSVReader::WriteToFile(const std::string& str, std::ofstream& file) {
+void CSVReader::WriteToFile(std::string_view str, std::ofstream& file, LengthIndicator::Format format) {
     // should write a record with its length concatenated to the beginning.
-    std::size_t size = str.size();
-    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
-    file.write(str.c_str(), size);
+    std::string indicator;
+    LengthIndicator::Append(str.size(), format, indicator);
+    file.write(indicator.data(), indicator.size());
+    file.write(str.data(), str.size());
 }
 
-std::pair<std::size_t, std::string> CSVReader::ReadFromFile(std::ifstream& file) {
+std::pair<std::size_t, std::string> CSVReader::ReadFromFile(std::ifstream& file, LengthIndicator::Format format) {
     // reads the record length to determine offset.
     // watch out fo errors caused by over, or under reading
         // ie. make sure the length of the "length indicator" itself is accounted for
-    std::size_t size;
-    file.read(reinterpret_cast<char*>(&size), sizeof(size));
+    std::size_t size = 0;
+    if (!LengthIndicator::Read(file, format, size)) {
+        return std::make_pair(std::size_t(0), std::string());
+    }
     std::string str;
     str.resize(size);
     file.read(&str[0], size);
@@ -152,25 +566,27 @@ std::pair<std::size_t, std::string> CSVReader::ReadFromFile(std::ifstream& file)
 //    return header;
 //
 
-bool CSVReader::BuildDataFile(const std::string& sourceFile1, const std::string& sourceFile2, const std::string& destinationFile) {
-    // Implementation for BuildDataFile
-    // after header record is built use data to define and create file.
-    std::ifstream file1("header.txt",std::ios::binary);
-    std::ifstream file2("output.txt",std::ios::binary);
-    std::ofstream destFile("combined_file.txt",std::ios::binary);
-
-    if (!file1.is_open() || !file2.is_open() || !destFile.is_open()) {
-        std::cerr << "Failed to open one or more files." << std::endl;
-        return false;
+/**
+ * @brief Builds one data file holding the header block, the records and the primary key index.
+ * @param csvFile Name of the CSV file to convert.
+ * @param headerFile Name of a header record file whose settings the new file takes, or empty for the defaults.
+ * @param destinationFile Name of the data file to publish.
+ * @return true if the file was built, false otherwise.
+ * @details The conversion is a single streaming pass; see DataFileBuilder.
+ */
+bool CSVReader::BuildDataFile(const std::string& csvFile, const std::string& headerFile, const std::string& destinationFile) {
+    HeaderRecord header;
+    if (!headerFile.empty()) {
+        HeaderRecordBuffer settings;
+        if (!settings.ReadHeaderRecord(headerFile)) {
+            std::cerr << "Failed to open one or more files." << std::endl;
+            return false;
+        }
+        header = settings.GetHeaderRecord();
     }
-
-    destFile << file1.rdbuf() << file2.rdbuf();
-
-    file1.close();
-    file2.close();
-    destFile.close();
-
-    return true;
+    CSVReader source(csvFile);
+    DataFileBuilder builder;
+    return builder.Build(source, header, destinationFile);
 }
 
 /**
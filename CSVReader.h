@@ -27,11 +27,17 @@
 
 #include <iostream>
 #include <fstream>
+#include <functional>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <map>
+#include "DelimiterScanner.h"
 #include "HeaderRecord.h"
+#include "LengthIndicator.h"
+#include "RecordWriter.h"
+#include "StateExtremes.h"
 
 /**
  * @brief Represents a row of data in the CSV file.
@@ -82,17 +88,71 @@ public:
 
     /**
      * @brief Reads and processes the entire CSV file.
+     * @param file The data file that receives one length-indicated record per CSV row.
+     * @param headerRecord Receives the field and record counts, and the State and County dictionaries
+     * when it asks for dictionary encoding. Its length indicator format selects the record prefixes.
+     * @return false if a record could not be written.
      * @pre The CSV file is open for reading.
-     * @post The CSV file is read, and data is parsed and stored in memory.
+     * @post The CSV file is read, and every data row is written to 'file'.
      */
-    void buildFileStructure(std::ofstream& file,HeaderRecord& headerRecord);
+    bool buildFileStructure(std::ofstream& file,HeaderRecord& headerRecord);
 
     /**
-     * @brief Parses a single data row of the CSV file into a Row object.
-     * @param Line The data row to parse.
-     * @param r Reference to the Row object to store the parsed data.
+     * @brief Reads the CSV file and writes every data row through a buffered RecordWriter.
+     * @param writer Open writer that receives one length-indicated record per CSV row.
+     * @param headerRecord Receives the field names, the field and record counts, the dictionaries when it
+     * asks for dictionary encoding, and the length indicator format of 'writer'.
+     * @param visit When set, called with every record as written and the offset of its length indicator,
+     * so indexes can be built in the same pass.
+     * @return false if 'writer' failed; the scan stops at the first record it could not take.
+     * @pre The CSV file is open for reading and 'writer' is open.
+     * @post Every data row was handed to 'writer'; the caller closes it.
+     */
+    bool buildFileStructure(RecordWriter& writer, HeaderRecord& headerRecord,
+                            const std::function<void(std::string_view, std::uint64_t)>& visit = nullptr);
+
+    /**
+     * @brief Reads the entire CSV file and computes the extreme places of every state.
+     * @param extremes Receives every data row.
+     * @pre The CSV file is open for reading.
+     * @post 'extremes' is flushed and holds the extremes of every state in the file.
+     */
+    void ReadFile(StateExtremes& extremes);
+
+    /**
+     * @brief Converts the CSV file to length-indicated records on several threads.
+     * @param file The data file that receives one length-indicated record per CSV row.
+     * @param headerRecord Receives the field and record counts.
+     * @param threadCount Number of worker threads, 0 for one per hardware thread.
+     * @return false if a record could not be written.
      * @pre The CSV file is open for reading.
-     * @post The 'r' object is updated with data from the input 'Line'.
+     * @post 'file' holds exactly the bytes buildFileStructure() would have written.
+     */
+    bool buildFileStructureParallel(std::ofstream& file, HeaderRecord& headerRecord, unsigned threadCount = 0);
+
+    /**
+     * @brief Converts the CSV file on several threads and writes the records through a buffered RecordWriter.
+     * @param writer Open writer that receives one length-indicated record per CSV row.
+     * @param headerRecord As for the serial buildFileStructure().
+     * @param visit When set, called with every record as written and the offset of its length indicator,
+     * in file order and from one thread at a time.
+     * @param threadCount Number of worker threads, 0 for one per hardware thread.
+     * @return false if 'writer' failed.
+     * @pre The CSV file is open for reading and 'writer' is open.
+     * @post 'writer' received exactly the records the serial buildFileStructure() would have written.
+     */
+    bool buildFileStructureParallel(RecordWriter& writer, HeaderRecord& headerRecord,
+                                    const std::function<void(std::string_view, std::uint64_t)>& visit = nullptr,
+                                    unsigned threadCount = 0);
+
+    /**
+     * @brief Splits a length-indicated record into its fields.
+     * @param line The record payload, comma separated.
+     * @return The fields of the record, in order. A record with more than FieldViews::CAPACITY fields is
+     * reported on std::cerr and yields no fields.
+     * @pre None.
+     * @post None.
+     * @see FieldTokenizer for the allocation-free equivalent used by scans.
      */
     static std::vector<std::string> ParseLine(const std::string &line);
 
@@ -107,14 +167,46 @@ public:
 
     //---------------- New methods for handling length-indicated records ------------------------------------//
     void ConvertToLength(const std::string& inputRecord, Record& outputRecord);
-    void WriteToFile(const std::string& str, std::ofstream& file);
-    static std::pair<std::size_t, std::string> ReadFromFile(std::ifstream& file);
+    void WriteToFile(std::string_view str, std::ofstream& file,
+                     LengthIndicator::Format format = LengthIndicator::DEFAULT);
+    static void EncodeRecord(std::string_view str, std::string& buffer,
+                             LengthIndicator::Format format = LengthIndicator::DEFAULT);
+    static std::pair<std::size_t, std::string> ReadFromFile(std::ifstream& file,
+                                                            LengthIndicator::Format format = LengthIndicator::DEFAULT);
     HeaderRecord GenerateHeaderRecord();
-    bool BuildDataFile(const std::string& sourceFile1, const std::string& sourceFile2, const std::string& destinationFile);
+
+    /**
+     * @brief Builds one data file holding the header block, the records and the primary key index.
+     * @param csvFile Name of the CSV file to convert.
+     * @param headerFile Name of a header record file whose settings (length indicator format, record
+     * encoding, key ordinality, version) the new file takes, or empty for the defaults.
+     * @param destinationFile Name of the data file to publish.
+     * @return true if the file was built, false otherwise.
+     * @pre None.
+     * @post On success 'destinationFile' was replaced atomically; on failure it is unchanged.
+     * @see DataFileBuilder
+     */
+    static bool BuildDataFile(const std::string& csvFile, const std::string& headerFile,
+                              const std::string& destinationFile);
 
 private:
+    std::string FileName; /**< Name of the CSV file, used to map it for parallel conversion. */
     std::ifstream ZipCSV; /**< Represents the input CSV file stream used to open and read the CSV file. */
     std::vector<std::string> Headers; /**< Stores the column headers from the CSV file. */
+    DelimiterScanner scanner; /**< Locates unquoted commas and newlines in the CSV text. */
+
+    static constexpr std::size_t INGEST_BLOCK_SIZE = 1 << 20; /**< Bytes read from the CSV file per block. */
+    static constexpr std::size_t PARALLEL_CHUNK_SIZE = std::size_t(32) << 20; /**< Largest chunk given to one worker. */
+
+    static std::string_view TrimRow(std::string_view row);
+    static int encodeChunk(std::string_view chunk, std::string& buffer, const RecordDictionary* dictionary,
+                           LengthIndicator::Format format);
+    template <typename Visitor>
+    bool forEachRow(Visitor&& visit);
+    template <typename Visitor>
+    static void forEachChunkRow(std::string_view chunk, Visitor&& visit);
+    template <typename Task>
+    static void runWorkers(unsigned threadCount, std::size_t taskCount, Task&& task);
 };
 
 #endif //ZIPCODES_CSVREADER_H
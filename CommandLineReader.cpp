@@ -11,26 +11,87 @@
  * - Accept commands from the user.
  * - Search for a given ZIP code in a database.
  * - Find the ZIP code of a place based on its name and latitude.
+ * - Answer a stream of queries in batch mode, optionally on several threads.
  * - Exit the application.
  * 
  * Assumptions:
- * - The database file 'us_postal_codes.txt' is properly formatted and available.
+ * - The length-indicated data file and its primary key index are available for zip lookups.
+ * - The place name index is built from the same data file as the primary key index.
  * - The user provides valid input.
  */
 
 #include "CommandLineReader.h"
+#include "Compactor.h"
+#include "HeaderRecordBuffer.h"
 #include <string>
 #include <iostream>
-#include <fstream>  
-#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 /**
- * @brief Default constructor that initializes the application state.
+ * @brief Constructor that initializes the application state and loads the primary key index.
+ * @param dataFileName Name of the length-indicated data file.
+ * @param indexFileName Name of the binary primary key index.
+ * @param nameIndexFileName Name of the place name index.
+ * @param spatialIndexFileName Name of the spatial index.
+ * @param headerFileName Header record of a data file without a header block of its own.
+ * @param indexTreeFileName Name of the B+ tree written in place of the binary index for a large key set.
  * @pre None.
  * @post The CommandLineReader object is constructed and the application is ready to run.
  */
-CommandLineReader::CommandLineReader() {
+CommandLineReader::CommandLineReader(const std::string& dataFileName, const std::string& indexFileName,
+                                     const std::string& nameIndexFileName,
+                                     const std::string& spatialIndexFileName, const std::string& headerFileName,
+                                     const std::string& indexTreeFileName) {
     running = true;
+    // A compaction interrupted by a crash leaves its swap to be finished before the files are opened.
+    Compactor::Recover(dataFileName, indexFileName, indexTreeFileName);
+    // Every reader of the data file needs the length indicator format its header record names.
+    HeaderRecordBuffer header;
+    header.ReadDataFileHeader(dataFileName, headerFileName);
+    const HeaderRecord record = header.GetHeaderRecord();
+    {
+        // The indexes only have to be built the first time the data file is used, all in one pass. A data
+        // file built by DataFileBuilder carries its primary key index; only the other two are separate.
+        PrimaryKeyIndex keys;
+        NameIndex placeNames;
+        SpatialIndex places;
+        if (!keys.OpenIndexFor(dataFileName, record, indexFileName, indexTreeFileName)
+            || !placeNames.Open(nameIndexFileName) || !places.Open(spatialIndexFileName)) {
+            const std::size_t keyField = PrimaryKeyIndex::KeyFieldOf(record);
+            NameIndexBuilder names(keyField);
+            SpatialIndexBuilder points(keyField);
+            std::vector<KeyIndexEntry> entries = keys.BuildIndexEntries(
+                    dataFileName, &names, &points, record.getLengthFormat(), keyField,
+                    record.getDataSection().offset, record.getDataSize());
+            if (!entries.empty()) {
+                if (record.getIndexSection().size == 0) {
+                    keys.WriteIndexFor(entries, indexFileName, indexTreeFileName, keyField);
+                }
+                names.Write(nameIndexFileName);
+                points.Write(spatialIndexFileName);
+            }
+        }
+    }
+    QueryEngine::Files files;
+    files.data = dataFileName;
+    files.index = indexFileName;
+    files.indexTree = indexTreeFileName;
+    files.nameIndex = nameIndexFileName;
+    files.spatialIndex = spatialIndexFileName;
+    files.header = headerFileName;
+    if (!engine.Load(files)) {
+        std::cerr << "Lookups are unavailable: " << dataFileName << " could not be opened." << std::endl;
+    }
 }
 
 /**
@@ -43,6 +104,7 @@ void CommandLineReader::Main() {
     while (running) {
         std::cout << "press E to enter zip code and see if it's in database\n";
         std::cout << "press F to find and print zipcode\n";
+        std::cout << "press N to find the zip codes nearest to a point\n";
         std::cout << "press T to close program\n";
         
         std::string input;
@@ -59,28 +121,20 @@ void CommandLineReader::Main() {
  * @post The user's command is executed.
  */
 void CommandLineReader::ParseCommandLine(const std::string& input) {
-    std::string line, fileZip, fileCity, state, county, latitude, longitude;
     bool found = false;
 
     if (input == "E" || input == "e") {
         std::cout << "Enter the zip code: ";
         std::string enteredZip;  // Use a different variable to capture user input
         std::cin >> enteredZip;
-        std::ifstream file("us_postal_codes.txt"); // reead file
-        while (getline(file, line)) { // goes through all the lines in us_postal_codes.csv
-            std::istringstream iss(line); //reading across the line using ',' as breakpoint
-            getline(iss, fileZip, ','); 
-            if (fileZip == enteredZip) {
-                std::cout << "Zip code " << enteredZip << " is in the database." << std::endl;
-                found = true;
-                break; //break the reading loop
-            }
-        }
-        if (!found) { // if loop is done but still no zip file then come here and print
+        std::string record;
+        // One index probe and one positioned read, independent of the size of the data file.
+        found = engine.FindZip(enteredZip, record);
+        if (found) {
+            std::cout << "Zip code " << enteredZip << " is in the database." << std::endl;
+        } else {
             std::cout << "Zip code " << enteredZip << " is not in the database." << std::endl;
         }
-        //close file 
-        file.close();
 
     }
     else if (input == "F" || input == "f") {
@@ -92,26 +146,55 @@ void CommandLineReader::ParseCommandLine(const std::string& input) {
         std::string enteredLat;  // read user entered latitude
         std::cin >> enteredLat;
         
-        std::ifstream file("us_postal_codes.txt"); //read from database
-        while (getline(file, line)) {
-            std::istringstream iss(line); // go through each line
-            // go across the line with breakpoints ',' and input each data into string format and their relevant variables
-            getline(iss, fileZip, ',');
-            getline(iss, fileCity, ',');  // save cityname in strings with break point ',' 
-            getline(iss, state, ',');
-            getline(iss, county, ',');
-            getline(iss, latitude, ','); // save latitude 
-            getline(iss, longitude, ',');
-            if (fileCity == enteredCity && latitude == enteredLat ) { // if for accuracy both cityname and latitude point match then 
-                std::cout << "Zip code for " << enteredCity << " @Latitude: " << enteredLat << " is: " << fileZip << std::endl;
-                found = true;
-                break;
-            }
+        // One hash probe on the normalised name; the latitude picks between places of the same name.
+        NamePosting posting;
+        char* end = nullptr;
+        const float latitude = std::strtof(enteredLat.c_str(), &end);
+        found = end != enteredLat.c_str() && engine.FindPlace(enteredCity, latitude, posting);
+        if (found) {
+            std::cout << "Zip code for " << enteredCity << " @Latitude: " << enteredLat << " is: " << posting.Key() << std::endl;
         }
         if (!found) {
             std::cout << "City of " << enteredCity << " or its latitude @: " << enteredLat <<" not found in the database." << std::endl;
         }
-        file.close(); //close file read buffer
+
+    } else if (input == "N" || input == "n") {
+        std::cout << "Enter the latitude and longitude of the point: e.g '42.3671 -72.6378' ";
+        std::string enteredLat;
+        std::string enteredLon;
+        std::cin >> enteredLat >> enteredLon;
+        std::cout << "Enter the search radius in km, or 0 for the nearest zip code only: ";
+        std::string enteredRadius;
+        std::cin >> enteredRadius;
+
+        // Only the grid cells around the point are read, never the whole data file.
+        char* latEnd = nullptr;
+        char* lonEnd = nullptr;
+        char* radiusEnd = nullptr;
+        const double latitude = std::strtod(enteredLat.c_str(), &latEnd);
+        const double longitude = std::strtod(enteredLon.c_str(), &lonEnd);
+        const double radius = std::strtod(enteredRadius.c_str(), &radiusEnd);
+        if (latEnd == enteredLat.c_str() || lonEnd == enteredLon.c_str() || radiusEnd == enteredRadius.c_str()) {
+            std::cout << "Invalid coordinates. Please try again.\n";
+        } else if (radius <= 0.0) {
+            SpatialPoint nearest;
+            double distance = 0.0;
+            found = engine.Nearest(latitude, longitude, nearest, distance);
+            if (found) {
+                std::cout << "Nearest zip code is " << nearest.Key() << " at " << distance << " km." << std::endl;
+            } else {
+                std::cout << "No zip codes in the database." << std::endl;
+            }
+        } else {
+            std::vector<SpatialPoint> places;
+            engine.WithinRadius(latitude, longitude, radius, places);
+            std::cout << places.size() << " zip codes within " << radius << " km:" << std::endl;
+            for (const SpatialPoint& place : places) {
+                std::cout << "  " << place.Key() << " at "
+                          << SpatialIndex::DistanceKm(latitude, longitude, place.latitude, place.longitude)
+                          << " km" << std::endl;
+            }
+        }
 
     } else if (input == "T" || input == "t") {
         running = false;  // Exit the loop
@@ -120,6 +203,193 @@ void CommandLineReader::ParseCommandLine(const std::string& input) {
     }
 }
 
+/**
+ * @brief Answers a stream of queries without the menu, one query per line.
+ * @param in The queries.
+ * @param out Receives one answer line per query, in the order of the queries.
+ * @param threads Threads answering the queries.
+ * @return The number of queries answered.
+ */
+std::size_t CommandLineReader::RunBatch(std::istream& in, std::ostream& out, unsigned threads) {
+    threads = std::min(std::max(threads, 1u), MAX_BATCH_THREADS);
+    std::vector<std::string> queries;
+    std::vector<std::string> answers;
+    std::string buffer;
+    buffer.reserve(BATCH_OUTPUT_BYTES);
+    std::size_t answered = 0;
+    std::string line;
+
+    // Each thread answers a contiguous slice of a chunk; the answers keep the positions of their queries.
+    // The whole chunk is answered from one snapshot, even if the engine publishes another meanwhile.
+    std::shared_ptr<const QueryEngine::Snapshot> snapshot;
+    std::size_t slice = 0;
+    auto answerSlice = [&snapshot, &queries, &answers](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; i++) {
+            answerQuery(snapshot.get(), queries[i], answers[i]);
+        }
+    };
+    // The workers are started once and wait for each chunk; the reading thread answers the first slice.
+    // 'queries', 'answers', 'snapshot' and 'slice' only change while no worker has a slice pending.
+    std::mutex lock;
+    std::condition_variable chunkReady;
+    std::condition_variable slicesDone;
+    std::uint64_t chunk = 0;   // Number of the chunk being answered, counted from 1.
+    std::size_t pending = 0;   // Worker slices of the chunk not answered yet.
+    bool finished = false;
+    std::vector<std::thread> workers;
+    for (std::size_t worker = 1; worker < threads; worker++) {
+        workers.emplace_back([&, worker]() {
+            std::uint64_t answeredChunk = 0;
+            while (true) {
+                std::size_t first;
+                std::size_t last;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    chunkReady.wait(guard, [&]() { return finished || chunk != answeredChunk; });
+                    if (finished) {
+                        return;
+                    }
+                    answeredChunk = chunk;
+                    first = std::min(queries.size(), worker * slice);
+                    last = std::min(queries.size(), first + slice);
+                }
+                answerSlice(first, last);
+                std::lock_guard<std::mutex> guard(lock);
+                if (--pending == 0) {
+                    slicesDone.notify_one();
+                }
+            }
+        });
+    }
+
+    bool more = true;
+    while (more) {
+        queries.clear();
+        while (queries.size() < BATCH_CHUNK && (more = static_cast<bool>(std::getline(in, line)))) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            const std::size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line[start] != '#') {
+                queries.push_back(line);
+            }
+        }
+
+        answers.resize(queries.size());
+        snapshot = engine.Acquire();
+        slice = (queries.size() + threads - 1) / threads;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            chunk++;
+            pending = workers.size();
+        }
+        chunkReady.notify_all();
+        answerSlice(0, std::min(queries.size(), slice));
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            slicesDone.wait(guard, [&pending]() { return pending == 0; });
+        }
 
+        for (std::size_t i = 0; i < queries.size(); i++) {
+            buffer += answers[i];
+            buffer += '\n';
+            if (buffer.size() >= BATCH_OUTPUT_BYTES) {
+                out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                buffer.clear();
+            }
+        }
+        answered += queries.size();
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        finished = true;
+    }
+    chunkReady.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.flush();
+    return answered;
+}
 
+/**
+ * @brief Answers one batch query.
+ * @param snapshot The snapshot to look the query up in; nullptr if the engine has none.
+ * @param query The query line.
+ * @param answer Receives the answer line, without its line break.
+ */
+void CommandLineReader::answerQuery(const QueryEngine::Snapshot* snapshot, const std::string& query,
+                                    std::string& answer) {
+    std::vector<std::string_view> fields;
+    const std::string_view text(query);
+    for (std::size_t at = text.find_first_not_of(" \t"); at != std::string_view::npos;) {
+        const std::size_t end = std::min(text.find_first_of(" \t", at), text.size());
+        fields.push_back(text.substr(at, end - at));
+        at = text.find_first_not_of(" \t", end);
+    }
+    auto number = [](std::string_view field, double& value) {
+        const std::string digits(field);
+        char* end = nullptr;
+        value = std::strtod(digits.c_str(), &end);
+        return end != digits.c_str() && *end == '\0';
+    };
+    auto appendKm = [&answer](double km) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.3f", km);
+        answer += text;
+    };
 
+    answer = query;
+    answer += '\t';
+    const char command = !fields.empty() && fields[0].size() == 1
+                         ? static_cast<char>(std::toupper(static_cast<unsigned char>(fields[0][0]))) : '\0';
+    double latitude = 0.0;
+    double longitude = 0.0;
+    double radius = 0.0;
+    if (command == 'E' && fields.size() == 2) {
+        std::string record;
+        if (snapshot != nullptr && snapshot->FindZip(fields[1], record)) {
+            answer += record;
+        } else {
+            answer += "NOT FOUND";
+        }
+    } else if (command == 'F' && fields.size() >= 3 && number(fields.back(), latitude)) {
+        // The name is everything between the command and the latitude, inner blanks included.
+        const std::size_t nameStart = static_cast<std::size_t>(fields[1].data() - text.data());
+        const std::size_t nameEnd = static_cast<std::size_t>(fields[fields.size() - 2].data() - text.data())
+                                    + fields[fields.size() - 2].size();
+        const std::string_view name = text.substr(nameStart, nameEnd - nameStart);
+        NamePosting posting;
+        if (snapshot != nullptr && snapshot->FindPlace(name, static_cast<float>(latitude), posting)) {
+            answer += posting.Key();
+        } else {
+            answer += "NOT FOUND";
+        }
+    } else if (command == 'N' && fields.size() == 3 && number(fields[1], latitude) && number(fields[2], longitude)) {
+        SpatialPoint nearest;
+        double distance = 0.0;
+        if (snapshot != nullptr && snapshot->Nearest(latitude, longitude, nearest, distance)) {
+            answer += nearest.Key();
+            answer += '\t';
+            appendKm(distance);
+        } else {
+            answer += "NOT FOUND";
+        }
+    } else if (command == 'R' && fields.size() == 4 && number(fields[1], latitude) && number(fields[2], longitude)
+               && number(fields[3], radius)) {
+        std::vector<SpatialPoint> places;
+        if (snapshot != nullptr) {
+            snapshot->WithinRadius(latitude, longitude, radius, places);
+        }
+        answer += std::to_string(places.size());
+        for (const SpatialPoint& place : places) {
+            answer += &place == &places.front() ? '\t' : ' ';
+            answer += place.Key();
+            answer += ':';
+            appendKm(SpatialIndex::DistanceKm(latitude, longitude, place.latitude, place.longitude));
+        }
+    } else {
+        answer += "INVALID";
+    }
+}
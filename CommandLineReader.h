@@ -13,21 +13,43 @@
  * - Input from the command line is provided in a valid format.
  * - Parsing functions are capable of handling various types of command input.
  * - The loop continues until a termination condition is met.
+ * - Zip and place lookups go through a QueryEngine loaded at construction, never a scan of the data file.
+ * - The length indicator format of the data file is taken from its header record.
+ * - In batch mode the queries are read from a stream and answered without the menu. The queries of a chunk
+ *   are answered against one QueryEngine snapshot, so several threads can answer them at once.
  */
 
 #ifndef COMMANDLINEREADER_H
 #define COMMANDLINEREADER_H
 
+#include <cstddef>
+#include <istream>
+#include <ostream>
 #include <string>
+#include "QueryEngine.h"
 
 class CommandLineReader {
 public:
+    static constexpr unsigned MAX_BATCH_THREADS = 256; /**< Most threads RunBatch() answers queries on. */
+
     /**
-     * @brief Default constructor for CommandLineReader.
+     * @brief Constructor that opens the data file and its indexes in a QueryEngine, building missing indexes.
+     * @param dataFileName Name of the length-indicated data file.
+     * @param indexFileName Name of the binary primary key index. It is built from the data file if it is missing.
+     * @param nameIndexFileName Name of the place name index. It is built together with the primary key index.
+     * @param spatialIndexFileName Name of the spatial index. It is built together with the primary key index.
+     * @param headerFileName Header record of a data file without a header block of its own. Without either,
+     * the data file is read with the size_t length indicators of legacy files.
+     * @param indexTreeFileName Name of the B+ tree written in place of 'indexFileName' for a large key set.
      * @pre None.
-     * @post A CommandLineReader object is constructed with default settings.
+     * @post A CommandLineReader object is constructed and lookups go through the engine's snapshot.
      */
-    CommandLineReader();
+    CommandLineReader(const std::string& dataFileName = "output.txt",
+                      const std::string& indexFileName = "KeyIndex.idx",
+                      const std::string& nameIndexFileName = "NameIndex.idx",
+                      const std::string& spatialIndexFileName = "SpatialIndex.idx",
+                      const std::string& headerFileName = "header.txt",
+                      const std::string& indexTreeFileName = "KeyIndex.bpt");
 
     /**
      * @brief Starts the command line reader loop, processing inputs.
@@ -44,8 +66,41 @@ public:
      */
     void ParseCommandLine(const std::string& input);
 
+    /**
+     * @brief Answers a stream of queries without the menu, one query per line.
+     * @param in The queries, such as std::cin or an opened query file.
+     * @param out Receives one answer line per query, in the order of the queries.
+     * @param threads Threads answering the queries, at most MAX_BATCH_THREADS; 1 answers them on the calling
+     * thread. The other threads are started once and answer a slice of every chunk.
+     * @return The number of queries answered.
+     * @pre None.
+     * @post Every query of 'in' was answered and 'out' was flushed.
+     * @details A query is a command letter, in either case, and its blank-separated arguments:
+     * - E zip: the record of the zip
+     * - F name latitude: the zip of the place; the name may contain blanks
+     * - N latitude longitude: the nearest zip and its distance in km
+     * - R latitude longitude radiusKm: the number of zips within the radius, then zip:km pairs, nearest first
+     *
+     * An answer is the query, a tab and the result, or NOT FOUND or INVALID. Blank lines and lines starting
+     * with '#' are skipped. Queries are read and answered BATCH_CHUNK at a time and the answers are written
+     * in blocks of about BATCH_OUTPUT_BYTES.
+     */
+    std::size_t RunBatch(std::istream& in, std::ostream& out, unsigned threads = 1);
+
 private:
+    static constexpr std::size_t BATCH_CHUNK = 8192;                /**< Queries read and answered together. */
+    static constexpr std::size_t BATCH_OUTPUT_BYTES = 1024 * 1024;  /**< Answer bytes buffered before a write. */
+
     bool running;  /**< Flag to check if the program is still running. */
+    QueryEngine engine; /**< The data file and its three indexes, published as snapshots. */
+
+    /**
+     * @brief Answers one batch query.
+     * @param snapshot The snapshot to look the query up in; nullptr if the engine has none.
+     * @param query The query line.
+     * @param answer Receives the answer line, without its line break.
+     */
+    static void answerQuery(const QueryEngine::Snapshot* snapshot, const std::string& query, std::string& answer);
 };
 
 #endif //COMMANDLINEREADER_H
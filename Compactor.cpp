@@ -0,0 +1,348 @@
+/**
+ * @file Compactor.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the Compactor class.
+ * @see Compactor.h for declaration.
+ */
+
+#include "Compactor.h"
+#include "DataFileBuilder.h"
+#include "FileLock.h"
+#include "KeyIndexFile.h"
+#include "MappedDataFile.h"
+#include "PrimaryKeyIndex.h"
+#include "RecordWriter.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Directory that holds a file, for syncing a rename in it.
+ */
+std::string directoryOf(const std::string& fileName) {
+    const std::string::size_type slash = fileName.find_last_of('/');
+    return slash == std::string::npos ? std::string(".") : fileName.substr(0, slash + 1);
+}
+
+bool exists(const std::string& fileName) {
+    return std::ifstream(fileName).is_open();
+}
+
+const std::string TREE_FORM = "tree"; /**< Swap marker contents when the new index is a B+ tree. */
+const std::string FLAT_FORM = "flat"; /**< Swap marker contents when the new index is a binary index. */
+
+} // namespace
+
+/**
+ * @brief Constructor.
+ * @param bytesPerSecond Sustained rate of the copy, in bytes read from the old file; 0 for no limit.
+ * @param burstBytes Bytes that may be copied at once before the rate applies.
+ */
+Compactor::Compactor(std::uint64_t bytesPerSecond, std::uint64_t burstBytes)
+        : rate(bytesPerSecond), burst(std::max<std::uint64_t>(burstBytes, 1)), tokens(0), refilled(Clock::now()),
+          busy(false), cancelled(false), succeeded(false), copied(0), reclaimed(0), records(0) {
+}
+
+/**
+ * @brief Cancels a running compaction and waits for its thread.
+ */
+Compactor::~Compactor() {
+    Cancel();
+    Wait();
+}
+
+/**
+ * @brief Checks if a file has enough dead space to be worth compacting.
+ * @param deadBytes Bytes held by deleted records.
+ * @param fileBytes Bytes of records, live and dead.
+ * @param maxDeadFraction Dead share of the file above which it should be compacted.
+ * @return true if the file should be compacted.
+ */
+bool Compactor::NeedsCompaction(std::uint64_t deadBytes, std::uint64_t fileBytes, double maxDeadFraction) {
+    return fileBytes > 0 && static_cast<double>(deadBytes) > maxDeadFraction * static_cast<double>(fileBytes);
+}
+
+/**
+ * @brief Completes or undoes a swap that a crash interrupted.
+ * @param dataFileName Name of the data file.
+ * @param indexFileName Name of its binary primary key index.
+ * @param indexTreeFileName Name of the B+ tree written in place of 'indexFileName' for a large key set.
+ * @return true if the files are a consistent pair, false if a writer holds them or a rename failed.
+ */
+bool Compactor::Recover(const std::string& dataFileName, const std::string& indexFileName,
+                        const std::string& indexTreeFileName) {
+    FileLock lock;
+    if (!lock.Acquire(dataFileName)) {
+        return false;
+    }
+    return finishSwap(dataFileName, indexFileName, indexTreeFileName);
+}
+
+/**
+ * @brief Starts compacting a data file and its index on a background thread.
+ * @param dataFileName Name of the length-indicated data file.
+ * @param indexFileName Name of its binary primary key index.
+ * @param indexTreeFileName Name of the B+ tree written in place of 'indexFileName' for a large key set.
+ * @param format Format of the length indicators.
+ * @param dataOffset Offset of the first record; the bytes before it are copied unchanged.
+ * @param keyField Field of a record that holds its key.
+ * @param done When set, called on the background thread with the result.
+ * @return false if a compaction is already running.
+ */
+bool Compactor::Start(const std::string& dataFileName, const std::string& indexFileName,
+                      const std::string& indexTreeFileName, LengthIndicator::Format format, std::uint64_t dataOffset,
+                      std::size_t keyField, std::function<void(bool)> done) {
+    if (busy.exchange(true)) {
+        return false;
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+    cancelled = false;
+    worker = std::thread([this, dataFileName, indexFileName, indexTreeFileName, format, dataOffset, keyField,
+                          done = std::move(done)]() {
+        const bool ok = Compact(dataFileName, indexFileName, indexTreeFileName, format, dataOffset, keyField);
+        busy = false;
+        if (done) {
+            done(ok);
+        }
+    });
+    return true;
+}
+
+/**
+ * @brief Compacts a data file and its index on the calling thread.
+ * @return true if the compacted files replaced the old ones, false otherwise.
+ */
+bool Compactor::Compact(const std::string& dataFileName, const std::string& indexFileName,
+                        const std::string& indexTreeFileName, LengthIndicator::Format format, std::uint64_t dataOffset,
+                        std::size_t keyField) {
+    succeeded = false;
+    copied = 0;
+    reclaimed = 0;
+    records = 0;
+    FileLock lock;
+    if (!lock.Acquire(dataFileName)) {
+        std::cerr << "Error: " << dataFileName << " is open for changes or already being compacted." << std::endl;
+        return false;
+    }
+    // A swap interrupted by a crash is finished first, so the copy below starts from a consistent pair.
+    if (!finishSwap(dataFileName, indexFileName, indexTreeFileName)) {
+        return false;
+    }
+    {
+        // The new index is built from the live records, so a log of changes to the old one must not survive it.
+        // Only the binary index has a log; a tree was changed in place.
+        PrimaryKeyIndex index;
+        if (index.OpenIndex(indexFileName, false) && !index.Checkpoint()) {
+            return false;
+        }
+    }
+    MappedDataFile source;
+    if (!source.Open(dataFileName, dataOffset, format)) {
+        std::cerr << "Failed to open input file." << std::endl;
+        return false;
+    }
+    source.mapping().AdviseSequential();
+
+    const std::string tempData = dataFileName + TEMP_SUFFIX;
+    const std::string tempIndex = indexFileName + TEMP_SUFFIX;
+    const std::string tempTree = indexTreeFileName + TEMP_SUFFIX;
+    RecordWriter writer(RecordWriter::DEFAULT_BUFFER_SIZE, format);
+    if (!writer.Open(tempData)) {
+        return false;
+    }
+    // A header block in front of the records is carried over as it is.
+    bool ok = writer.WriteEncoded(source.mapping().data(), static_cast<std::size_t>(dataOffset), 0);
+
+    std::vector<KeyIndexEntry> entries;
+    tokens = static_cast<double>(burst);
+    refilled = Clock::now();
+    std::uint64_t readEnd = dataOffset;
+    std::uint64_t unthrottled = 0;
+    for (const RecordView& record : source) {
+        if (!ok || cancelled) {
+            ok = false;
+            break;
+        }
+        std::uint64_t offset;
+        ok = writer.Write(record.data, offset);
+        KeyIndexEntry entry;
+        if (PrimaryKeyIndex::MakeEntry(record.data, offset, entry, keyField)) {
+            entries.push_back(entry);
+        }
+        copied += record.length;
+        records++;
+        // The bucket is charged for what was read, tombstones included, not only for what was kept.
+        const std::uint64_t recordEnd = static_cast<std::uint64_t>(record.data.data() - source.mapping().data())
+                                        + record.length;
+        unthrottled += recordEnd - readEnd;
+        readEnd = recordEnd;
+        if (unthrottled >= THROTTLE_STEP) {
+            throttle(unthrottled);
+            unthrottled = 0;
+        }
+    }
+    ok = writer.Close() && ok;
+    bool tree = false;
+    if (ok) {
+        // The live keys decide the form, as they do when the index is first built.
+        PrimaryKeyIndex::KeepLastOfEachKey(entries);
+        tree = entries.size() >= PrimaryKeyIndex::TREE_MIN_KEYS;
+        PrimaryKeyIndex index;
+        ok = index.WriteIndexFor(entries, tempIndex, tempTree, keyField)
+             && DataFileBuilder::SyncPath(tempData) && DataFileBuilder::SyncPath(tree ? tempTree : tempIndex);
+    }
+    const std::uint64_t oldSize = source.size();
+    source.close();
+    if (!ok) {
+        if (!cancelled) {
+            std::cerr << "Error: Unable to compact the data file " << dataFileName << "." << std::endl;
+        }
+        std::remove(tempData.c_str());
+        std::remove(tempIndex.c_str());
+        std::remove(tempTree.c_str());
+        return false;
+    }
+
+    // The marker on disk commits the swap: from here on the new pair replaces the old one, even after a crash.
+    // It names the form of the new index, so the swap knows which index file to replace and which to remove.
+    const std::string marker = dataFileName + SWAP_SUFFIX;
+    bool committed = false;
+    {
+        std::ofstream markerFile(marker, std::ios::binary | std::ios::trunc);
+        markerFile << (tree ? TREE_FORM : FLAT_FORM);
+        markerFile.close();
+        committed = markerFile && DataFileBuilder::SyncPath(marker) && DataFileBuilder::SyncPath(directoryOf(marker));
+    }
+    if (!committed) {
+        std::cerr << "Error: Unable to commit the compacted copy of " << dataFileName << "." << std::endl;
+        std::remove(marker.c_str());
+        std::remove(tempData.c_str());
+        std::remove(tempIndex.c_str());
+        std::remove(tempTree.c_str());
+        return false;
+    }
+    if (!finishSwap(dataFileName, indexFileName, indexTreeFileName)) {
+        std::cerr << "Error: Unable to replace " << dataFileName << " with its compacted copy; Recover() completes "
+                  << "the swap." << std::endl;
+        return false;
+    }
+    reclaimed = oldSize > writer.offset() ? oldSize - writer.offset() : 0;
+    succeeded = true;
+    return true;
+}
+
+/**
+ * @brief Waits for the background compaction to end.
+ * @return The result of the last compaction.
+ */
+bool Compactor::Wait() {
+    if (worker.joinable()) {
+        worker.join();
+    }
+    return succeeded;
+}
+
+/**
+ * @brief Asks the background compaction to stop; the old files are kept.
+ */
+void Compactor::Cancel() {
+    cancelled = true;
+}
+
+bool Compactor::running() const {
+    return busy;
+}
+
+/**
+ * @brief Bytes of live records copied by the last compaction.
+ */
+std::uint64_t Compactor::bytesCopied() const {
+    return copied;
+}
+
+/**
+ * @brief Bytes the last compaction removed from the data file.
+ */
+std::uint64_t Compactor::bytesReclaimed() const {
+    return reclaimed;
+}
+
+/**
+ * @brief Live records copied by the last compaction.
+ */
+std::size_t Compactor::recordsCopied() const {
+    return records;
+}
+
+/**
+ * @brief Renames the copies of a committed swap over the old files, or removes the copies of one that was
+ * never committed.
+ * @return false if a rename or a directory sync failed; the marker is then kept.
+ */
+bool Compactor::finishSwap(const std::string& dataFileName, const std::string& indexFileName,
+                           const std::string& indexTreeFileName) {
+    const std::string marker = dataFileName + SWAP_SUFFIX;
+    const std::string tempData = dataFileName + TEMP_SUFFIX;
+    const std::string tempIndex = indexFileName + TEMP_SUFFIX;
+    const std::string tempTree = indexTreeFileName + TEMP_SUFFIX;
+    std::ifstream markerFile(marker, std::ios::binary);
+    if (!markerFile.is_open()) {
+        // Copies without a marker were never committed; the old files are current.
+        std::remove(tempData.c_str());
+        std::remove(tempIndex.c_str());
+        std::remove(tempTree.c_str());
+        return true;
+    }
+    std::string form;
+    markerFile >> form;
+    markerFile.close();
+    const bool tree = form == TREE_FORM;
+    const std::string& newIndex = tree ? indexTreeFileName : indexFileName;
+    const std::string& tempNewIndex = tree ? tempTree : tempIndex;
+    // A copy that is gone was renamed before the swap was interrupted. The data file goes first: until the
+    // index follows, stale entries fail SearchIndex()'s key check.
+    if ((exists(tempData) && std::rename(tempData.c_str(), dataFileName.c_str()) != 0)
+        || (exists(tempNewIndex) && std::rename(tempNewIndex.c_str(), newIndex.c_str()) != 0)
+        || !DataFileBuilder::SyncPath(directoryOf(dataFileName))
+        || !DataFileBuilder::SyncPath(directoryOf(newIndex))) {
+        return false;
+    }
+    // The index of the other form describes the old offsets; OpenIndexFor() would open a stale tree first.
+    if (tree) {
+        std::remove(indexFileName.c_str());
+        std::remove((indexFileName + PrimaryKeyIndex::LOG_SUFFIX).c_str());
+    } else {
+        std::remove(indexTreeFileName.c_str());
+    }
+    if (!DataFileBuilder::SyncPath(directoryOf(tree ? indexFileName : indexTreeFileName))) {
+        return false;
+    }
+    std::remove(marker.c_str());
+    DataFileBuilder::SyncPath(directoryOf(marker));
+    return true;
+}
+
+/**
+ * @brief Takes 'bytes' tokens from the bucket, sleeping until they are available.
+ */
+void Compactor::throttle(std::uint64_t bytes) {
+    if (rate == 0) {
+        return;
+    }
+    const Clock::time_point now = Clock::now();
+    const double earned = std::chrono::duration<double>(now - refilled).count() * static_cast<double>(rate);
+    tokens = std::min(static_cast<double>(burst), tokens + earned);
+    refilled = now;
+    tokens -= static_cast<double>(bytes);
+    if (tokens < 0) {
+        // The deficit is at most one step, so the sleep is short and Cancel() is noticed promptly.
+        std::this_thread::sleep_for(std::chrono::duration<double>(-tokens / static_cast<double>(rate)));
+    }
+}
@@ -0,0 +1,192 @@
+/**
+ * @file Compactor.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class Compactor
+ * @see Compactor.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class Compactor, which reclaims the space that MutableDataFile leaves behind.
+ * Deleted and relocated records stay in the data file as tombstones until the file is compacted: the
+ * compactor copies only the live records, in file order, into a new data file, builds a new primary key
+ * index from the offsets the RecordWriter reports, and renames both over the old files. The new index is
+ * written by PrimaryKeyIndex::WriteIndexFor(), as a binary index or, for PrimaryKeyIndex::TREE_MIN_KEYS live
+ * keys or more, as a B+ tree, whatever the form of the old index; the file of the other form is removed.
+ *
+ * The two renames are made atomic by a swap marker, the data file name with SWAP_SUFFIX appended, which names
+ * the form of the new index. Both copies are synced before the marker is created and synced; from then on the
+ * swap is committed. The copies are renamed over the old files, the index of the other form is removed, the
+ * directory is synced and the marker is removed. After a crash, Recover()
+ * (or the next Compact()) completes a committed swap by renaming the copies that are still there, and
+ * removes the copies of a swap that was never committed, so the files are always the old pair or the new one.
+ *
+ * Compaction runs on a background thread started by Start(). Its reads and writes are throttled by a token
+ * bucket, 'bytesPerSecond' with bursts of up to 'burstBytes', so foreground lookups keep most of the disk.
+ * Readers that opened the old files keep reading the old version through their descriptors and mappings
+ * until they reopen; the completion callback tells the application when the new version is in place, and is
+ * where a QueryEngine serving the files calls QueryEngine::Reload().
+ *
+ * NeedsCompaction() is the trigger: compacting whenever the dead bytes pass a fixed fraction of the file
+ * keeps space amplification, and with it scan time, bounded under a sustained update load.
+ *
+ * Assumptions:
+ * - No MutableDataFile changes the files while they are compacted. This is enforced: both hold the FileLock
+ *   of the data file, and Compact() fails when a MutableDataFile has the file open. Readers may use them.
+ * - The index's delta log is merged into the index file before the records are copied, so the swap never
+ *   leaves a log that describes the old offsets. A tree is changed in place and has no log.
+ * - A reader that opens the files between the two renames may pair the new data file with the old index;
+ *   SearchIndex() then reports the mismatched keys as missing until the reader reopens the files.
+ * - Recover() runs before the files are opened after a crash, as CommandLineReader does at startup.
+ */
+
+#ifndef ZIPCODES_COMPACTOR_H
+#define ZIPCODES_COMPACTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include "LengthIndicator.h"
+
+class Compactor {
+public:
+    static constexpr std::uint64_t DEFAULT_RATE = std::uint64_t(32) << 20;  /**< Bytes per second; 0 is unthrottled. */
+    static constexpr std::uint64_t DEFAULT_BURST = std::uint64_t(1) << 20; /**< Bytes that may pass without waiting. */
+    static constexpr double DEFAULT_MAX_DEAD_FRACTION = 0.25;             /**< Dead share of the file that triggers compaction. */
+    static constexpr const char* TEMP_SUFFIX = ".compact";               /**< Appended to the files being written. */
+    static constexpr const char* SWAP_SUFFIX = ".swap";                  /**< Appended to the data file to name the swap marker. */
+
+    /**
+     * @brief Constructor.
+     * @param bytesPerSecond Sustained rate of the copy, in bytes read from the old file; 0 for no limit.
+     * @param burstBytes Bytes that may be copied at once before the rate applies.
+     * @pre None.
+     * @post No compaction is running.
+     */
+    explicit Compactor(std::uint64_t bytesPerSecond = DEFAULT_RATE, std::uint64_t burstBytes = DEFAULT_BURST);
+
+    /**
+     * @brief Cancels a running compaction and waits for its thread.
+     */
+    ~Compactor();
+
+    Compactor(const Compactor&) = delete;
+    Compactor& operator=(const Compactor&) = delete;
+
+    /**
+     * @brief Checks if a file has enough dead space to be worth compacting.
+     * @param deadBytes Bytes held by deleted records, such as MutableDataFile::freeBytes().
+     * @param fileBytes Bytes of records, live and dead, such as MutableDataFile::endOffset().
+     * @param maxDeadFraction Dead share of the file above which it should be compacted.
+     * @return true if the file should be compacted.
+     */
+    static bool NeedsCompaction(std::uint64_t deadBytes, std::uint64_t fileBytes,
+                                double maxDeadFraction = DEFAULT_MAX_DEAD_FRACTION);
+
+    /**
+     * @brief Completes or undoes a swap that a crash interrupted.
+     * @param dataFileName Name of the data file.
+     * @param indexFileName Name of its binary primary key index.
+     * @param indexTreeFileName Name of the B+ tree written in place of 'indexFileName' for a large key set.
+     * @return true if the files are a consistent pair, false if a writer holds them or a rename failed.
+     * @pre None.
+     * @post With a swap marker, the compacted copies have replaced the old files; without one, leftover
+     * copies are removed.
+     */
+    static bool Recover(const std::string& dataFileName, const std::string& indexFileName,
+                        const std::string& indexTreeFileName);
+
+    /**
+     * @brief Starts compacting a data file and its index on a background thread.
+     * @param dataFileName Name of the length-indicated data file.
+     * @param indexFileName Name of its binary primary key index.
+     * @param indexTreeFileName Name of the B+ tree written in place of 'indexFileName' for a large key set.
+     * @param format Format of the length indicators.
+     * @param dataOffset Offset of the first record; the bytes before it are copied unchanged.
+     * @param keyField Field of a record that holds its key, HeaderRecord::getPrimaryKeyOrdinality() of the file.
+     * @param done When set, called on the background thread with the result once the files were swapped
+     * or the compaction failed.
+     * @return false if a compaction is already running.
+     * @pre None.
+     * @post running() returns true until the compaction ends.
+     */
+    bool Start(const std::string& dataFileName, const std::string& indexFileName,
+               const std::string& indexTreeFileName, LengthIndicator::Format format = LengthIndicator::DEFAULT,
+               std::uint64_t dataOffset = 0, std::size_t keyField = 0, std::function<void(bool)> done = nullptr);
+
+    /**
+     * @brief Compacts a data file and its index on the calling thread.
+     * @see Start() for the parameters.
+     * @return true if the compacted files replaced the old ones, false otherwise.
+     * @pre No MutableDataFile is open on the files; Compact() fails if one is.
+     * @post On failure before the swap was committed the old files are unchanged and the temporary files are
+     * removed. A committed swap that failed is completed by Recover().
+     */
+    bool Compact(const std::string& dataFileName, const std::string& indexFileName,
+                 const std::string& indexTreeFileName, LengthIndicator::Format format = LengthIndicator::DEFAULT,
+                 std::uint64_t dataOffset = 0, std::size_t keyField = 0);
+
+    /**
+     * @brief Waits for the background compaction to end.
+     * @return The result of the last compaction.
+     */
+    bool Wait();
+
+    /**
+     * @brief Asks the background compaction to stop; the old files are kept.
+     */
+    void Cancel();
+
+    bool running() const;
+
+    /**
+     * @brief Bytes of live records copied by the last compaction.
+     */
+    std::uint64_t bytesCopied() const;
+
+    /**
+     * @brief Bytes the last compaction removed from the data file.
+     */
+    std::uint64_t bytesReclaimed() const;
+
+    /**
+     * @brief Live records copied by the last compaction.
+     */
+    std::size_t recordsCopied() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::uint64_t THROTTLE_STEP = 64 * 1024; /**< Bytes copied between throttle checks. */
+
+    std::uint64_t rate;                  /**< Token refill rate in bytes per second, 0 for no limit. */
+    std::uint64_t burst;                 /**< Token bucket capacity. */
+    double tokens;                       /**< Bytes that may be copied before waiting. */
+    Clock::time_point refilled;          /**< When 'tokens' was last refilled. */
+    std::thread worker;                  /**< Background compaction, if one was started. */
+    std::atomic<bool> busy;              /**< True while a compaction runs. */
+    std::atomic<bool> cancelled;         /**< Set by Cancel(). */
+    std::atomic<bool> succeeded;         /**< Result of the last compaction. */
+    std::atomic<std::uint64_t> copied;   /**< Live bytes copied. */
+    std::atomic<std::uint64_t> reclaimed; /**< Bytes removed. */
+    std::atomic<std::size_t> records;    /**< Live records copied. */
+
+    /**
+     * @brief Takes 'bytes' tokens from the bucket, sleeping until they are available.
+     */
+    void throttle(std::uint64_t bytes);
+
+    /**
+     * @brief Renames the copies of a committed swap over the old files, or removes the copies of one that was
+     * never committed.
+     * @return false if a rename or a directory sync failed; the marker is then kept.
+     * @pre The caller holds the FileLock of the data file.
+     */
+    static bool finishSwap(const std::string& dataFileName, const std::string& indexFileName,
+                           const std::string& indexTreeFileName);
+};
+
+#endif //ZIPCODES_COMPACTOR_H
@@ -0,0 +1,176 @@
+/**
+ * @file DataFileBuilder.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the DataFileBuilder class.
+ * @see DataFileBuilder.h for declaration.
+ */
+
+#include "DataFileBuilder.h"
+#include "FieldTokenizer.h"
+#include "HeaderRecordBuffer.h"
+#include "PrimaryKeyIndex.h"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define ZIPCODES_HAVE_POSIX_IO 1
+#endif
+
+/**
+ * @brief Constructor.
+ * @param directIO When true, the records are written around the page cache where the host allows it.
+ * @param bufferSize Bytes the RecordWriter buffers between writes.
+ * @param threadCount Threads converting the CSV rows, 0 for one per hardware thread.
+ */
+DataFileBuilder::DataFileBuilder(bool directIO, std::size_t bufferSize, unsigned threadCount)
+        : direct(directIO), bufferSize(bufferSize), threads(threadCount), keys(0), unindexed(0) {
+}
+
+/**
+ * @brief Converts a CSV file into a data file with an embedded primary key index.
+ * @param csv Reader of the CSV file, positioned at its header row.
+ * @param header Settings of the new file; receives its counts, dictionaries and section offsets.
+ * @param fileName Name of the data file to publish.
+ * @return true if the file was built and renamed into place, false otherwise.
+ */
+bool DataFileBuilder::Build(CSVReader& csv, HeaderRecord& header, const std::string& fileName) {
+    keys = 0;
+    unindexed = 0;
+    if (!csv.isOpen()) {
+        std::cerr << "Failed to open input file." << std::endl;
+        return false;
+    }
+    // The rename is only atomic within one directory, so the temporary file sits next to the destination.
+    const std::string tempName = fileName + TEMP_SUFFIX;
+    header.setFileName(fileName);
+    header.getDictionary().clear();
+    header.setDataSection(FileSection());
+    header.setIndexSection(FileSection());
+    header.setFooterSection(FileSection());
+
+    RecordWriter writer(bufferSize, header.getLengthFormat());
+    if (!writer.Open(tempName, direct)) {
+        return false;
+    }
+    // Reserve the header block; it is patched once the counts and offsets are known.
+    const std::string zeros(HeaderRecordBuffer::HEADER_BLOCK_SIZE, '\0');
+    writer.WriteEncoded(zeros.data(), zeros.size(), 0);
+
+    // The rows are converted on 'threads' workers; the entries are collected as the records are written.
+    std::vector<KeyIndexEntry> entries;
+    const std::size_t keyField = PrimaryKeyIndex::KeyFieldOf(header);
+    std::string tooLong; // First key that does not fit an index entry.
+    auto addEntry = [&](std::string_view record, std::uint64_t offset) {
+        KeyIndexEntry entry;
+        if (PrimaryKeyIndex::MakeEntry(record, offset, entry, keyField)) {
+            entries.push_back(entry);
+            return;
+        }
+        const std::string_view key = FieldTokenizer::ExtractField(record, keyField);
+        if (key.empty()) {
+            unindexed++;
+        } else if (tooLong.empty()) {
+            tooLong.assign(key.data(), key.size());
+        }
+    };
+    const bool converted = csv.buildFileStructureParallel(writer, header, addEntry, threads);
+    if (!tooLong.empty()) {
+        std::cerr << "Error: The key \"" << tooLong << "\" is longer than " << KeyIndexEntry::KEY_WIDTH
+                  << " bytes and cannot be indexed." << std::endl;
+    }
+
+    FileSection data;
+    data.offset = HeaderRecordBuffer::HEADER_BLOCK_SIZE;
+    data.size = writer.offset() - data.offset;
+    header.setDataSection(data);
+    // Pad so the index entries, read in place through a mapping, are aligned.
+    writer.WriteEncoded(zeros.data(), (SECTION_ALIGNMENT - writer.offset() % SECTION_ALIGNMENT) % SECTION_ALIGNMENT, 0);
+    if (!writer.Close() || !converted || !tooLong.empty() || !finish(tempName, header, entries)) {
+        std::cerr << "Error: Unable to build the data file " << fileName << "." << std::endl;
+        std::remove(tempName.c_str());
+        return false;
+    }
+    if (std::rename(tempName.c_str(), fileName.c_str()) != 0) {
+        std::cerr << "Error: Unable to replace the data file " << fileName << "." << std::endl;
+        std::remove(tempName.c_str());
+        return false;
+    }
+    // Make the rename itself durable; the file is complete either way, so a failure here is only reported.
+    const std::string::size_type slash = fileName.find_last_of('/');
+    if (!SyncPath(slash == std::string::npos ? std::string(".") : fileName.substr(0, slash + 1))) {
+        std::cerr << "Warning: The directory of " << fileName << " was not synced." << std::endl;
+    }
+    if (unindexed > 0) {
+        std::cerr << unindexed << " records with an empty key were not indexed." << std::endl;
+    }
+    return true;
+}
+
+std::size_t DataFileBuilder::keyCount() const {
+    return keys;
+}
+
+std::size_t DataFileBuilder::unindexedCount() const {
+    return unindexed;
+}
+
+/**
+ * @brief Appends the index and the footer to the records and patches the header block.
+ * @return false if any write failed.
+ */
+bool DataFileBuilder::finish(const std::string& tempName, HeaderRecord& header, std::vector<KeyIndexEntry>& entries) {
+    PrimaryKeyIndex::KeepLastOfEachKey(entries);
+    keys = entries.size();
+
+    std::fstream file(tempName, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.seekp(0, std::ios::end);
+    FileSection index;
+    index.offset = static_cast<std::uint64_t>(file.tellp());
+    if (!KeyIndexFile::Write(file, std::move(entries))) {
+        return false;
+    }
+    index.size = static_cast<std::uint64_t>(file.tellp()) - index.offset;
+    header.setIndexSection(index);
+
+    HeaderRecordBuffer buffer;
+    if (!buffer.WriteFooter(header, file)) {
+        return false;
+    }
+    header.setSizeFormatType("binary");
+    header.setPrimaryKeyIndexFileName(header.getFileName());
+    file.seekp(0);
+    if (!buffer.WriteBinaryHeader(header, file) || !file.flush()) {
+        return false;
+    }
+    file.close();
+    // The contents must reach the disk before the rename can publish them.
+    return SyncPath(tempName);
+}
+
+/**
+ * @brief Forces a file, or the directory entry of a rename, to stable storage.
+ * @param path Name of the file or directory.
+ * @return false if the host reported an error.
+ */
+bool DataFileBuilder::SyncPath(const std::string& path) {
+#ifdef ZIPCODES_HAVE_POSIX_IO
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    const bool synced = ::fsync(fd) == 0;
+    return ::close(fd) == 0 && synced;
+#else
+    (void)path;
+    return true;
+#endif
+}
@@ -0,0 +1,107 @@
+/**
+ * @file DataFileBuilder.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class DataFileBuilder
+ * @see DataFileBuilder.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class DataFileBuilder, which converts a CSV file into one self-describing data file
+ * in a single pass. The file holds, in order:
+ * - the binary header block, HeaderRecordBuffer::HEADER_BLOCK_SIZE bytes
+ * - the data section, one length-indicated record per CSV row
+ * - zero padding up to a multiple of SECTION_ALIGNMENT
+ * - the index section, a KeyIndexFile keyed on the first field
+ * - the footer section, the State and County dictionaries of a dictionary-encoded file
+ *
+ * The header block is reserved with zero bytes, the records are converted on several threads by
+ * CSVReader::buildFileStructureParallel() and streamed through a RecordWriter while their index entries are
+ * collected, and the index and footer are appended once the last record is written. Only
+ * then are the record count and the section offsets known, so the header block is patched last.
+ *
+ * Everything is written to a temporary file next to the destination, flushed to disk and renamed over the
+ * destination. Readers therefore see either the previous file or the complete new one, never a partial build.
+ *
+ * CommandLineReader and QueryEngine open the result directly: HeaderRecordBuffer::ReadDataFileHeader() reads
+ * the header block, the records are read within the data section and the index section is opened in place by
+ * PrimaryKeyIndex::OpenIndex(). ZipTable::Load() takes the data section and the dictionaries.
+ *
+ * Assumptions:
+ * - The destination directory is writable and on one file system, so the rename is atomic.
+ * - The primary key is the field named by the key ordinality of the header record. A key longer than
+ *   KeyIndexEntry::KEY_WIDTH bytes fails the build; records with an empty key are written but not indexed.
+ *   When a key repeats, the last record wins.
+ */
+
+#ifndef ZIPCODES_DATAFILEBUILDER_H
+#define ZIPCODES_DATAFILEBUILDER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "CSVReader.h"
+#include "HeaderRecord.h"
+#include "KeyIndexFile.h"
+#include "RecordWriter.h"
+
+class DataFileBuilder {
+public:
+    static constexpr std::size_t SECTION_ALIGNMENT = 8; /**< Alignment of the index section, for in-place use. */
+    static constexpr const char* TEMP_SUFFIX = ".tmp";  /**< Appended to the destination while it is built. */
+
+    /**
+     * @brief Constructor.
+     * @param directIO When true, the records are written around the page cache where the host allows it.
+     * @param bufferSize Bytes the RecordWriter buffers between writes.
+     * @param threadCount Threads converting the CSV rows, 0 for one per hardware thread; 1 converts serially.
+     * @pre None.
+     * @post No file has been built.
+     */
+    explicit DataFileBuilder(bool directIO = false, std::size_t bufferSize = RecordWriter::DEFAULT_BUFFER_SIZE,
+                             unsigned threadCount = 0);
+
+    /**
+     * @brief Converts a CSV file into a data file with an embedded primary key index.
+     * @param csv Reader of the CSV file, positioned at its header row.
+     * @param header Settings of the new file: length indicator format, record encoding, key ordinality and
+     * version. Receives the field names, the record count, the dictionaries and the section offsets.
+     * @param fileName Name of the data file to publish.
+     * @return true if the file was built and renamed into place, false otherwise, also when a key is longer
+     * than KeyIndexEntry::KEY_WIDTH bytes.
+     * @pre 'csv' is open.
+     * @post On success 'fileName' is complete; on failure it is unchanged and the temporary file is removed.
+     */
+    bool Build(CSVReader& csv, HeaderRecord& header, const std::string& fileName);
+
+    /**
+     * @brief Forces a file, or the directory entry of a rename, to stable storage.
+     * @param path Name of the file or directory.
+     * @return false if the host reported an error.
+     */
+    static bool SyncPath(const std::string& path);
+
+    /**
+     * @brief Number of keys in the index section of the last file built.
+     */
+    std::size_t keyCount() const;
+
+    /**
+     * @brief Number of records of the last file built that have an empty key.
+     */
+    std::size_t unindexedCount() const;
+
+private:
+    bool direct;            /**< Write the records with O_DIRECT where possible. */
+    std::size_t bufferSize; /**< RecordWriter buffer size. */
+    unsigned threads;       /**< Threads given to CSVReader::buildFileStructureParallel(). */
+    std::size_t keys;       /**< Keys indexed by the last Build(). */
+    std::size_t unindexed;  /**< Records with an empty key, skipped by the index in the last Build(). */
+
+    /**
+     * @brief Appends the index and the footer to the records and patches the header block.
+     * @return false if any write failed.
+     */
+    bool finish(const std::string& tempName, HeaderRecord& header, std::vector<KeyIndexEntry>& entries);
+};
+
+#endif //ZIPCODES_DATAFILEBUILDER_H
@@ -0,0 +1,214 @@
+/**
+ * @file DelimiterScanner.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the DelimiterScanner class.
+ * @see DelimiterScanner.h for declaration.
+ */
+
+#include "DelimiterScanner.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ZIPCODES_HAVE_X86 1
+#endif
+
+namespace {
+
+/**
+ * @brief Portable kernel, one byte at a time.
+ */
+void scanScalar(const char* data, std::size_t words,
+                std::uint64_t* comma, std::uint64_t* newline, std::uint64_t* quote) {
+    for (std::size_t w = 0; w < words; w++) {
+        std::uint64_t c = 0, n = 0, q = 0;
+        const char* block = data + w * DelimiterScanner::BITS_PER_WORD;
+        for (std::size_t i = 0; i < DelimiterScanner::BITS_PER_WORD; i++) {
+            const std::uint64_t bit = std::uint64_t(1) << i;
+            c |= block[i] == ',' ? bit : 0;
+            n |= block[i] == '\n' ? bit : 0;
+            q |= block[i] == '"' ? bit : 0;
+        }
+        comma[w] = c;
+        newline[w] = n;
+        quote[w] = q;
+    }
+}
+
+#ifdef ZIPCODES_HAVE_X86
+
+/**
+ * @brief SSE2 kernel, four 16-byte compares per 64-byte word.
+ */
+__attribute__((target("sse2")))
+void scanSse2(const char* data, std::size_t words,
+              std::uint64_t* comma, std::uint64_t* newline, std::uint64_t* quote) {
+    const __m128i commaVec = _mm_set1_epi8(',');
+    const __m128i newlineVec = _mm_set1_epi8('\n');
+    const __m128i quoteVec = _mm_set1_epi8('"');
+    for (std::size_t w = 0; w < words; w++) {
+        std::uint64_t c = 0, n = 0, q = 0;
+        const char* block = data + w * DelimiterScanner::BITS_PER_WORD;
+        for (int lane = 0; lane < 4; lane++) {
+            const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * lane));
+            const int shift = 16 * lane;
+            c |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, commaVec)))) << shift;
+            n |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newlineVec)))) << shift;
+            q |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quoteVec)))) << shift;
+        }
+        comma[w] = c;
+        newline[w] = n;
+        quote[w] = q;
+    }
+}
+
+/**
+ * @brief 64-bit match mask of 'needle' over two 32-byte halves.
+ */
+__attribute__((target("avx2")))
+inline std::uint64_t matchMaskAvx2(__m256i lo, __m256i hi, __m256i needle) {
+    const std::uint32_t l = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)));
+    const std::uint32_t h = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)));
+    return (std::uint64_t(h) << 32) | l;
+}
+
+/**
+ * @brief AVX2 kernel, two 32-byte compares per 64-byte word.
+ */
+__attribute__((target("avx2")))
+void scanAvx2(const char* data, std::size_t words,
+              std::uint64_t* comma, std::uint64_t* newline, std::uint64_t* quote) {
+    const __m256i commaVec = _mm256_set1_epi8(',');
+    const __m256i newlineVec = _mm256_set1_epi8('\n');
+    const __m256i quoteVec = _mm256_set1_epi8('"');
+    for (std::size_t w = 0; w < words; w++) {
+        const char* block = data + w * DelimiterScanner::BITS_PER_WORD;
+        const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+        const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+        comma[w] = matchMaskAvx2(lo, hi, commaVec);
+        newline[w] = matchMaskAvx2(lo, hi, newlineVec);
+        quote[w] = matchMaskAvx2(lo, hi, quoteVec);
+    }
+}
+
+#endif
+
+/**
+ * @brief Inclusive prefix XOR: bit i of the result is the parity of bits 0..i of 'x'.
+ * @details Applied to the quote mask this sets every bit from an opening quote up to, but not
+ * including, its closing quote, which is exactly the set of bytes inside the quoted field.
+ */
+inline std::uint64_t prefixXor(std::uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+} // namespace
+
+/**
+ * @brief Constructor that selects the fastest kernel supported by the processor.
+ */
+DelimiterScanner::DelimiterScanner() : kernel(scanScalar), kernelName("scalar"), quoteCarry(0) {
+#ifdef ZIPCODES_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernel = scanAvx2;
+        kernelName = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        kernel = scanSse2;
+        kernelName = "sse2";
+    }
+#endif
+}
+
+/**
+ * @brief Builds the comma and newline bitmaps of a block.
+ * @param data Start of the block.
+ * @param length Number of bytes in the block.
+ * @param commaBits Receives one bit per byte, set for unquoted commas.
+ * @param newlineBits Receives one bit per byte, set for unquoted newlines.
+ */
+void DelimiterScanner::Scan(const char* data, std::size_t length,
+                            std::vector<std::uint64_t>& commaBits, std::vector<std::uint64_t>& newlineBits) {
+    const std::size_t fullWords = length / BITS_PER_WORD;
+    const std::size_t tail = length % BITS_PER_WORD;
+    const std::size_t words = fullWords + (tail != 0 ? 1 : 0);
+    commaBits.resize(words);
+    newlineBits.resize(words);
+    quoteBits.resize(words);
+
+    kernel(data, fullWords, commaBits.data(), newlineBits.data(), quoteBits.data());
+    if (tail != 0) {
+        // The kernels read whole words, so the last partial word is scanned from a zero-padded copy.
+        char padded[BITS_PER_WORD] = {};
+        std::memcpy(padded, data + fullWords * BITS_PER_WORD, tail);
+        kernel(padded, 1, &commaBits[fullWords], &newlineBits[fullWords], &quoteBits[fullWords]);
+    }
+
+    for (std::size_t w = 0; w < words; w++) {
+        const std::uint64_t inside = prefixXor(quoteBits[w]) ^ quoteCarry;
+        commaBits[w] &= ~inside;
+        newlineBits[w] &= ~inside;
+        // Arithmetic spread of the top bit: all ones if the word ends inside quotes.
+        quoteCarry = std::uint64_t(0) - (inside >> 63);
+    }
+}
+
+/**
+ * @brief Forgets the quote state, so the next block is treated as the start of a file.
+ */
+void DelimiterScanner::Reset() {
+    quoteCarry = 0;
+}
+
+/**
+ * @brief Checks whether the last scanned block ended inside a quoted field.
+ * @return true if a quoted field is still open.
+ */
+bool DelimiterScanner::InsideQuotes() const {
+    return quoteCarry != 0;
+}
+
+/**
+ * @brief Name of the kernel in use, "avx2", "sse2" or "scalar".
+ */
+const char* DelimiterScanner::KernelName() const {
+    return kernelName;
+}
+
+/**
+ * @brief Splits one CSV row into its fields using the comma bitmap.
+ * @param line The row, without its newline.
+ * @param fields Receives views into 'line'. Surrounding quotes are removed from quoted fields.
+ */
+void DelimiterScanner::SplitFields(std::string_view line, std::vector<std::string_view>& fields) {
+    fields.clear();
+    if (line.empty()) {
+        return;
+    }
+    const std::uint64_t savedCarry = quoteCarry;
+    quoteCarry = 0;
+    std::vector<std::uint64_t> commas;
+    std::vector<std::uint64_t> newlines;
+    Scan(line.data(), line.size(), commas, newlines);
+    quoteCarry = savedCarry;
+
+    auto addField = [&](std::size_t begin, std::size_t end) {
+        std::string_view field = line.substr(begin, end - begin);
+        if (field.size() >= 2 && field.front() == '"' && field.back() == '"') {
+            field = field.substr(1, field.size() - 2);
+        }
+        fields.push_back(field);
+    };
+    std::size_t start = 0;
+    ForEachBit(commas, [&](std::size_t pos) {
+        addField(start, pos);
+        start = pos + 1;
+    });
+    addField(start, line.size());
+}
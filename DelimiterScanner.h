@@ -0,0 +1,110 @@
+/**
+ * @file DelimiterScanner.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class DelimiterScanner
+ * @see DelimiterScanner.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class DelimiterScanner, which locates commas and newlines in large blocks of
+ * CSV text with SIMD instructions. Each call produces two bitmaps with one bit per input byte: bit i of
+ * word w is set when byte 64 * w + i is a comma (or a newline). Delimiters that sit inside a quoted
+ * field are cleared from both bitmaps, and the quote state is carried from one call to the next so a
+ * file can be scanned block by block.
+ *
+ * The kernel is chosen once at construction: AVX2 when the processor reports it at runtime, SSE2 as
+ * the x86-64 baseline, and a portable scalar loop everywhere else.
+ *
+ * Assumptions:
+ * - Quoting follows RFC 4180: a field is quoted with '"' and a literal quote is written as "".
+ * - Blocks passed to consecutive Scan() calls are consecutive pieces of the same input.
+ */
+
+#ifndef ZIPCODES_DELIMITERSCANNER_H
+#define ZIPCODES_DELIMITERSCANNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+class DelimiterScanner {
+public:
+    static constexpr std::size_t BITS_PER_WORD = 64; /**< Input bytes described by one bitmap word. */
+
+    /**
+     * @brief Constructor that selects the fastest kernel supported by the processor.
+     * @pre None.
+     * @post The scanner starts outside of any quoted field.
+     */
+    DelimiterScanner();
+
+    /**
+     * @brief Builds the comma and newline bitmaps of a block.
+     * @param data Start of the block.
+     * @param length Number of bytes in the block.
+     * @param commaBits Receives one bit per byte, set for unquoted commas.
+     * @param newlineBits Receives one bit per byte, set for unquoted newlines.
+     * @pre The block follows the block given to the previous call, or Reset() was called.
+     * @post Both vectors hold (length + 63) / 64 words. The quote state at the end of the block is kept.
+     */
+    void Scan(const char* data, std::size_t length,
+              std::vector<std::uint64_t>& commaBits, std::vector<std::uint64_t>& newlineBits);
+
+    /**
+     * @brief Forgets the quote state, so the next block is treated as the start of a file.
+     * @pre None.
+     * @post InsideQuotes() returns false.
+     */
+    void Reset();
+
+    /**
+     * @brief Checks whether the last scanned block ended inside a quoted field.
+     * @return true if a quoted field is still open.
+     */
+    bool InsideQuotes() const;
+
+    /**
+     * @brief Name of the kernel in use, "avx2", "sse2" or "scalar".
+     */
+    const char* KernelName() const;
+
+    /**
+     * @brief Splits one CSV row into its fields using the comma bitmap.
+     * @param line The row, without its newline.
+     * @param fields Receives views into 'line'. Surrounding quotes are removed from quoted fields.
+     * @pre None.
+     * @post 'fields' holds one entry per field; an empty row yields no fields.
+     */
+    void SplitFields(std::string_view line, std::vector<std::string_view>& fields);
+
+    /**
+     * @brief Calls 'visit' with the position of every set bit, in increasing order.
+     * @param bits The bitmap to walk.
+     * @param visit Callable taking the std::size_t position of a set bit.
+     */
+    template <typename Visitor>
+    static void ForEachBit(const std::vector<std::uint64_t>& bits, Visitor&& visit) {
+        for (std::size_t word = 0; word < bits.size(); word++) {
+            std::uint64_t w = bits[word];
+            while (w != 0) {
+                visit(word * BITS_PER_WORD + static_cast<std::size_t>(__builtin_ctzll(w)));
+                w &= w - 1;
+            }
+        }
+    }
+
+    /**
+     * @brief Signature shared by the kernels: raw comma, newline and quote masks for 'words' * 64 bytes.
+     */
+    using Kernel = void (*)(const char* data, std::size_t words,
+                            std::uint64_t* comma, std::uint64_t* newline, std::uint64_t* quote);
+
+private:
+    Kernel kernel;              /**< Selected mask kernel. */
+    const char* kernelName;     /**< Name of the selected kernel. */
+    std::uint64_t quoteCarry;   /**< All ones when the previous block ended inside quotes, else zero. */
+    std::vector<std::uint64_t> quoteBits; /**< Scratch space for the raw quote mask. */
+};
+
+#endif //ZIPCODES_DELIMITERSCANNER_H
@@ -0,0 +1,64 @@
+/**
+ * @file FieldDictionary.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the FieldDictionary class.
+ * @see FieldDictionary.h for declaration.
+ */
+
+#include "FieldDictionary.h"
+
+/**
+ * @brief Returns the code of a value, adding it on first sight.
+ * @param value The field value.
+ * @return Its code.
+ */
+std::uint32_t FieldDictionary::Encode(std::string_view value) {
+    // Consecutive rows usually share their state and county.
+    if (lastCode < entries.size() && entries[lastCode] == value) {
+        return lastCode;
+    }
+    auto found = codes.find(std::string(value));
+    if (found == codes.end()) {
+        found = codes.emplace(std::string(value), static_cast<std::uint32_t>(entries.size())).first;
+        entries.emplace_back(value);
+    }
+    lastCode = found->second;
+    return lastCode;
+}
+
+/**
+ * @brief Looks up the code of a value without adding it.
+ * @param value The field value.
+ * @param code Receives its code.
+ * @return true if the value is in the dictionary.
+ */
+bool FieldDictionary::Find(std::string_view value, std::uint32_t& code) const {
+    auto found = codes.find(std::string(value));
+    if (found == codes.end()) {
+        return false;
+    }
+    code = found->second;
+    return true;
+}
+
+std::string_view FieldDictionary::Decode(std::uint32_t code) const {
+    return entries[code];
+}
+
+const std::vector<std::string>& FieldDictionary::values() const {
+    return entries;
+}
+
+std::size_t FieldDictionary::size() const {
+    return entries.size();
+}
+
+bool FieldDictionary::empty() const {
+    return entries.empty();
+}
+
+void FieldDictionary::clear() {
+    entries.clear();
+    codes.clear();
+    lastCode = 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file FieldDictionary.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class FieldDictionary
+ * @see FieldDictionary.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class FieldDictionary, which maps the distinct values of one field to small
+ * integer codes. The code of a value is its position in order of first appearance, so two dictionaries
+ * fed the same values in the same order assign the same codes.
+ *
+ * Assumptions:
+ * - A field has far fewer distinct values than rows, so every value is stored once in memory.
+ * - Consecutive rows often repeat a value; the last code is checked before the hash table.
+ */
+
+#ifndef ZIPCODES_FIELDDICTIONARY_H
+#define ZIPCODES_FIELDDICTIONARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class FieldDictionary {
+public:
+    /**
+     * @brief Returns the code of a value, adding it on first sight.
+     * @param value The field value.
+     * @return Its code.
+     * @pre None.
+     * @post 'value' is in the dictionary.
+     */
+    std::uint32_t Encode(std::string_view value);
+
+    /**
+     * @brief Looks up the code of a value without adding it.
+     * @param value The field value.
+     * @param code Receives its code.
+     * @return true if the value is in the dictionary.
+     */
+    bool Find(std::string_view value, std::uint32_t& code) const;
+
+    /**
+     * @brief Returns the value of a code.
+     * @param code A code below size().
+     * @return The value.
+     */
+    std::string_view Decode(std::uint32_t code) const;
+
+    /**
+     * @brief Every value, in code order.
+     */
+    const std::vector<std::string>& values() const;
+
+    std::size_t size() const;
+    bool empty() const;
+    void clear();
+
+private:
+    std::vector<std::string> entries;                     /**< Value of every code. */
+    std::unordered_map<std::string, std::uint32_t> codes; /**< Code of every value. */
+    std::uint32_t lastCode = 0;                           /**< Code returned by the previous Encode(). */
+};
+
+#endif //ZIPCODES_FIELDDICTIONARY_H
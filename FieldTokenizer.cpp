@@ -0,0 +1,92 @@
+/**
+ * @file FieldTokenizer.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the FieldTokenizer class.
+ * @see FieldTokenizer.h for declaration.
+ */
+
+#include "FieldTokenizer.h"
+#include <cstring>
+
+/**
+ * @brief Splits a record into its fields.
+ * @param line The record to split.
+ * @param out Receives the field views; its previous contents are discarded.
+ * @return true if every field fit in 'out', false if the record has more than FieldViews::CAPACITY fields.
+ */
+bool FieldTokenizer::Tokenize(std::string_view line, FieldViews& out) {
+    out.count = 0;
+    if (line.empty()) {
+        return true;
+    }
+    std::size_t pos = 0;
+    while (true) {
+        if (out.count == FieldViews::CAPACITY) {
+            return false;
+        }
+        std::size_t comma = scanField(line, pos, out.fields[out.count]);
+        out.count++;
+        if (comma >= line.size()) {
+            return true;
+        }
+        pos = comma + 1;
+    }
+}
+
+/**
+ * @brief Returns a single field of a record, scanning no further than that field.
+ * @param line The record to read from.
+ * @param ordinal Zero-based position of the field.
+ * @return A view of the field, or an empty view if the record has fewer fields.
+ */
+std::string_view FieldTokenizer::ExtractField(std::string_view line, std::size_t ordinal) {
+    std::size_t pos = 0;
+    std::string_view field;
+    for (std::size_t i = 0; i <= ordinal; i++) {
+        if (pos > line.size()) {
+            return std::string_view();
+        }
+        pos = scanField(line, pos, field) + 1;
+    }
+    return field;
+}
+
+/**
+ * @brief Finds the end of the field starting at 'pos'.
+ * @param line The record being scanned.
+ * @param pos Offset of the first character of the field.
+ * @param field Receives the field contents, without surrounding quotes.
+ * @return Offset of the ',' that ends the field, or line.size() for the last field.
+ */
+std::size_t FieldTokenizer::scanField(std::string_view line, std::size_t pos, std::string_view& field) {
+    const char* base = line.data();
+    const std::size_t size = line.size();
+
+    if (pos < size && base[pos] == '"') {
+        // Quoted field: find the closing quote, stepping over "" escapes, then the next comma.
+        std::size_t close = pos + 1;
+        while (close < size) {
+            const void* hit = std::memchr(base + close, '"', size - close);
+            if (hit == nullptr) {
+                close = size;
+                break;
+            }
+            close = static_cast<const char*>(hit) - base;
+            if (close + 1 < size && base[close + 1] == '"') {
+                close += 2;
+                continue;
+            }
+            break;
+        }
+        field = line.substr(pos + 1, close - pos - 1);
+        pos = close < size ? close + 1 : size;
+        const void* comma = std::memchr(base + pos, ',', size - pos);
+        return comma == nullptr ? size : static_cast<std::size_t>(static_cast<const char*>(comma) - base);
+    }
+
+    // Unquoted field: memchr is vectorised by the C library and is the whole cost of the scan.
+    const void* comma = pos < size ? std::memchr(base + pos, ',', size - pos) : nullptr;
+    std::size_t end = comma == nullptr ? size : static_cast<std::size_t>(static_cast<const char*>(comma) - base);
+    field = line.substr(pos, end - pos);
+    return end;
+}
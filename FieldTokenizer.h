@@ -0,0 +1,76 @@
+/**
+ * @file FieldTokenizer.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class FieldTokenizer
+ * @see FieldTokenizer.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class FieldTokenizer, which splits a comma separated record into fields
+ * without allocating. Fields are returned as std::string_view spans into the caller's buffer and are
+ * collected in a fixed-capacity FieldViews object, so a scan performs no heap allocation per record.
+ * ExtractField() is the fast path for key extraction: it stops at the requested field.
+ *
+ * Assumptions:
+ * - Fields are separated by ',' and a record holds at most FieldViews::CAPACITY fields.
+ * - A field that starts with '"' is quoted; commas inside the quotes do not split it and the
+ *   surrounding quotes are not part of the returned view. Doubled quotes ("") inside a quoted
+ *   field are left as they are, because unescaping them would require a copy.
+ * - The views are only valid while the caller's buffer is alive and unchanged.
+ */
+
+#ifndef ZIPCODES_FIELDTOKENIZER_H
+#define ZIPCODES_FIELDTOKENIZER_H
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+/**
+ * @brief Fixed-capacity list of field views produced by FieldTokenizer::Tokenize.
+ */
+struct FieldViews {
+    static constexpr std::size_t CAPACITY = 16; /**< Maximum number of fields kept per record. */
+
+    std::array<std::string_view, CAPACITY> fields; /**< The fields, in record order. */
+    std::size_t count = 0;                         /**< Number of valid entries in 'fields'. */
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    std::string_view operator[](std::size_t i) const { return fields[i]; }
+};
+
+class FieldTokenizer {
+public:
+    /**
+     * @brief Splits a record into its fields.
+     * @param line The record to split.
+     * @param out Receives the field views; its previous contents are discarded.
+     * @return true if every field fit in 'out', false if the record has more than FieldViews::CAPACITY fields.
+     * @pre None.
+     * @post 'out' holds up to FieldViews::CAPACITY views into 'line'. An empty record has no fields.
+     */
+    static bool Tokenize(std::string_view line, FieldViews& out);
+
+    /**
+     * @brief Returns a single field of a record, scanning no further than that field.
+     * @param line The record to read from.
+     * @param ordinal Zero-based position of the field.
+     * @return A view of the field, or an empty view if the record has fewer fields.
+     * @pre None.
+     * @post None.
+     */
+    static std::string_view ExtractField(std::string_view line, std::size_t ordinal);
+
+private:
+    /**
+     * @brief Finds the end of the field starting at 'pos'.
+     * @param line The record being scanned.
+     * @param pos Offset of the first character of the field.
+     * @param field Receives the field contents, without surrounding quotes.
+     * @return Offset of the ',' that ends the field, or line.size() for the last field.
+     */
+    static std::size_t scanField(std::string_view line, std::size_t pos, std::string_view& field);
+};
+
+#endif //ZIPCODES_FIELDTOKENIZER_H
@@ -0,0 +1,71 @@
+/**
+ * @file FileLock.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the FileLock class.
+ * @see FileLock.h for declaration.
+ */
+
+#include "FileLock.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#define ZIPCODES_HAVE_POSIX_IO 1
+#endif
+
+/**
+ * @brief Default constructor. No lock is held.
+ */
+FileLock::FileLock() : descriptor(-1), held(false) {
+}
+
+/**
+ * @brief Releases the lock if it is held.
+ */
+FileLock::~FileLock() {
+    Release();
+}
+
+/**
+ * @brief Takes the writer lock of a data file without waiting.
+ * @param dataFileName Name of the data file.
+ * @return true if the lock is now held, false if another writer holds it or the lock file cannot be opened.
+ */
+bool FileLock::Acquire(const std::string& dataFileName) {
+    Release();
+#ifdef ZIPCODES_HAVE_POSIX_IO
+    const std::string lockName = dataFileName + LOCK_SUFFIX;
+    descriptor = ::open(lockName.c_str(), O_RDWR | O_CREAT, 0644);
+    if (descriptor < 0) {
+        return false;
+    }
+    if (::flock(descriptor, LOCK_EX | LOCK_NB) != 0) {
+        ::close(descriptor);
+        descriptor = -1;
+        return false;
+    }
+#else
+    (void)dataFileName;
+#endif
+    held = true;
+    return true;
+}
+
+/**
+ * @brief Releases the lock.
+ */
+void FileLock::Release() {
+#ifdef ZIPCODES_HAVE_POSIX_IO
+    if (descriptor >= 0) {
+        // Closing the descriptor drops the flock.
+        ::close(descriptor);
+        descriptor = -1;
+    }
+#endif
+    held = false;
+}
+
+bool FileLock::isHeld() const {
+    return held;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file FileLock.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class FileLock
+ * @see FileLock.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class FileLock, the writer lock of a data file. A MutableDataFile holds it while
+ * the file is open for changes and a Compactor holds it while it copies and swaps the file, so the two never
+ * change the same file at once. Readers do not take it.
+ *
+ * The lock is an exclusive advisory lock (flock) on a lock file beside the data file, its name with LOCK_SUFFIX
+ * appended. The lock file is never renamed, so the lock outlives the renames of a compaction, and it is
+ * released by the operating system when the process ends, so a crash never leaves a file locked.
+ *
+ * Assumptions:
+ * - Every writer of a data file takes its lock; the lock is advisory and does not stop other programs.
+ * - Two FileLock objects exclude each other even within one process.
+ * - On hosts without flock the lock is always granted.
+ */
+
+#ifndef ZIPCODES_FILELOCK_H
+#define ZIPCODES_FILELOCK_H
+
+#include <string>
+
+class FileLock {
+public:
+    static constexpr const char* LOCK_SUFFIX = ".lock"; /**< Appended to the data file name to name its lock file. */
+
+    /**
+     * @brief Default constructor. No lock is held.
+     * @pre None.
+     * @post isHeld() returns false.
+     */
+    FileLock();
+
+    /**
+     * @brief Releases the lock if it is held.
+     */
+    ~FileLock();
+
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+    /**
+     * @brief Takes the writer lock of a data file without waiting.
+     * @param dataFileName Name of the data file.
+     * @return true if the lock is now held, false if another writer holds it or the lock file cannot be opened.
+     * @pre None.
+     * @post A lock held before is released first.
+     */
+    bool Acquire(const std::string& dataFileName);
+
+    /**
+     * @brief Releases the lock.
+     * @pre None.
+     * @post isHeld() returns false.
+     */
+    void Release();
+
+    bool isHeld() const;
+
+private:
+    int descriptor; /**< Open lock file while the lock is held, otherwise -1. */
+    bool held;      /**< True while the lock is held. */
+};
+
+#endif //ZIPCODES_FILELOCK_H
@@ -1,4 +1,7 @@
 #include "HeaderRecord.h"
+#include <limits>
+
+HeaderRecord::HeaderRecord() = default;
 
 HeaderRecord::HeaderRecord(
         const std::string& fileName,
@@ -51,6 +54,48 @@ int HeaderRecord::getPrimaryKeyOrdinality() const {
     return primaryKeyOrdinality;
 }
 
+const std::string& HeaderRecord::getRecordEncoding() const {
+    return recordEncoding;
+}
+
+bool HeaderRecord::isDictionaryEncoded() const {
+    return recordEncoding == "dictionary";
+}
+
+const std::string& HeaderRecord::getLengthIndicatorFormat() const {
+    return lengthIndicatorFormat;
+}
+
+LengthIndicator::Format HeaderRecord::getLengthFormat() const {
+    LengthIndicator::Format format = LengthIndicator::DEFAULT;
+    LengthIndicator::FromName(lengthIndicatorFormat, format);
+    return format;
+}
+
+const FileSection& HeaderRecord::getDataSection() const {
+    return dataSection;
+}
+
+const FileSection& HeaderRecord::getIndexSection() const {
+    return indexSection;
+}
+
+const FileSection& HeaderRecord::getFooterSection() const {
+    return footerSection;
+}
+
+std::uint64_t HeaderRecord::getDataSize() const {
+    return indexSection.size > 0 ? dataSection.size : std::numeric_limits<std::uint64_t>::max();
+}
+
+const RecordDictionary& HeaderRecord::getDictionary() const {
+    return dictionary;
+}
+
+RecordDictionary& HeaderRecord::getDictionary() {
+    return dictionary;
+}
+
 // Implement setter methods
 void HeaderRecord::setFileName(const std::string& newFileName) {
     fileName = newFileName;
@@ -87,3 +132,23 @@ void HeaderRecord::setFieldsPerRecord(int newFieldsPerRecord) {
 void HeaderRecord::setPrimaryKeyOrdinality(int newPrimaryKeyOrdinality) {
     primaryKeyOrdinality = newPrimaryKeyOrdinality;
 }
+
+void HeaderRecord::setRecordEncoding(const std::string& newRecordEncoding) {
+    recordEncoding = newRecordEncoding;
+}
+
+void HeaderRecord::setLengthIndicatorFormat(const std::string& newLengthIndicatorFormat) {
+    lengthIndicatorFormat = newLengthIndicatorFormat;
+}
+
+void HeaderRecord::setDataSection(const FileSection& newDataSection) {
+    dataSection = newDataSection;
+}
+
+void HeaderRecord::setIndexSection(const FileSection& newIndexSection) {
+    indexSection = newIndexSection;
+}
+
+void HeaderRecord::setFooterSection(const FileSection& newFooterSection) {
+    footerSection = newFooterSection;
+}
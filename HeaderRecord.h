@@ -1,12 +1,24 @@
 #ifndef ZIPCODES_HEADERRECORD_H
 #define ZIPCODES_HEADERRECORD_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
+#include "LengthIndicator.h"
+#include "RecordDictionary.h"
+
+// A byte range of a data file: the records, the primary key index or the footer.
+struct FileSection {
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+};
 
 class HeaderRecord {
+    friend class HeaderRecordBuffer;
+
 public:
     std::vector<std::string> fieldNames;
+    HeaderRecord();
     HeaderRecord(
             const std::string& fileName,
             int version,
@@ -25,6 +37,18 @@ public:
     int getRecordCount() const;
     int getFieldsPerRecord() const;
     int getPrimaryKeyOrdinality() const;
+    const std::string& getRecordEncoding() const;
+    bool isDictionaryEncoded() const;
+    const std::string& getLengthIndicatorFormat() const;
+    LengthIndicator::Format getLengthFormat() const;
+    const FileSection& getDataSection() const;
+    const FileSection& getIndexSection() const;
+    const FileSection& getFooterSection() const;
+    // Bytes of records in the data section. Only a file with an index section records it; the records of
+    // any other file run to its end, and UINT64_MAX is returned.
+    std::uint64_t getDataSize() const;
+    const RecordDictionary& getDictionary() const;
+    RecordDictionary& getDictionary();
 
     // Setter methods
     void setFileName(const std::string& newFileName);
@@ -36,18 +60,32 @@ public:
     void setRecordCount(int newRecordCount);
     void setFieldsPerRecord(int newFieldsPerRecord);
     void setPrimaryKeyOrdinality(int newPrimaryKeyOrdinality);
+    // "plain" or "dictionary": State and County stored as codes into the header's dictionaries.
+    void setRecordEncoding(const std::string& newRecordEncoding);
+    // LengthIndicator name of the record length prefixes: "varint", or "size_t" for legacy data files.
+    void setLengthIndicatorFormat(const std::string& newLengthIndicatorFormat);
+    // Where the records, the primary key index and the footer (the dictionaries) lie in the file.
+    void setDataSection(const FileSection& newDataSection);
+    void setIndexSection(const FileSection& newIndexSection);
+    void setFooterSection(const FileSection& newFooterSection);
 
 
 private:
     std::string fileName;
-    int version;
-    int headerSize;
+    int version = 1;
+    int headerSize = 0;
     std::string recordSizeBytes = "variable";
-    std::string sizeFormatType;
+    std::string sizeFormatType = "ASCII";
     std::string primaryKeyIndexFileName;
-    int recordCount;
-    int fieldsPerRecord;
-    int primaryKeyOrdinality;
+    int recordCount = 0;
+    int fieldsPerRecord = 0;
+    int primaryKeyOrdinality = 0;
+    std::string recordEncoding = "plain";
+    std::string lengthIndicatorFormat = LengthIndicator::Name(LengthIndicator::DEFAULT);
+    FileSection dataSection;
+    FileSection indexSection;
+    FileSection footerSection;
+    RecordDictionary dictionary;
 
 };
 
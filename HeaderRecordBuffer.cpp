@@ -18,8 +18,68 @@
 #include "HeaderRecordBuffer.h"
 #include <fstream>
 #include <iostream>
-#include <bitset>
+#include <cstring>
 #include <exception>
+#include <sstream>
+
+constexpr char HeaderRecordBuffer::MAGIC[8];
+
+namespace {
+
+// Offsets of the fields of the binary header block. Every number is stored little-endian.
+constexpr std::size_t MAGIC_AT = 0;
+constexpr std::size_t FORMAT_VERSION_AT = 8;
+constexpr std::size_t HEADER_SIZE_AT = 12;
+constexpr std::size_t LENGTH_FORMAT_AT = 16;
+constexpr std::size_t RECORD_ENCODING_AT = 20;
+constexpr std::size_t RESERVED_AT = 24; // Written as 0 and ignored on reading.
+constexpr std::size_t FIELD_COUNT_AT = 28;
+constexpr std::size_t KEY_ORDINALITY_AT = 32;
+constexpr std::size_t VERSION_AT = 36;
+constexpr std::size_t RECORD_COUNT_AT = 40;
+constexpr std::size_t DATA_SECTION_AT = 48;
+constexpr std::size_t INDEX_SECTION_AT = 64;
+constexpr std::size_t FOOTER_SECTION_AT = 80;
+
+/**
+ * @brief Stores the low 'bytes' bytes of 'value' little-endian.
+ */
+void putLittle(char* out, std::uint64_t value, std::size_t bytes)
+{
+    for (std::size_t i = 0; i < bytes; i++)
+    {
+        out[i] = static_cast<char>(value >> (8 * i));
+    }
+}
+
+/**
+ * @brief Loads a little-endian number of 'bytes' bytes.
+ */
+std::uint64_t getLittle(const char* in, std::size_t bytes)
+{
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < bytes; i++)
+    {
+        value |= std::uint64_t(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+void putSection(char* out, const FileSection& section)
+{
+    putLittle(out, section.offset, 8);
+    putLittle(out + 8, section.size, 8);
+}
+
+FileSection getSection(const char* in)
+{
+    FileSection section;
+    section.offset = getLittle(in, 8);
+    section.size = getLittle(in + 8, 8);
+    return section;
+}
+
+} // namespace
 
 /**
  * @brief Constructor definition
@@ -47,7 +107,11 @@ bool HeaderRecordBuffer::ReadHeaderRecord(const std::string& filename) {
     // 1. The file being read must be length indicated
 
         headerRecord.fileName = filename;
-        std::ifstream file(filename);
+        headerRecord.recordEncoding = "plain";
+        // Header records written before the format was recorded describe data files with size_t prefixes.
+        headerRecord.lengthIndicatorFormat = LengthIndicator::Name(LengthIndicator::FIXED);
+        headerRecord.dictionary.clear();
+        std::ifstream file(filename, std::ios::binary);
         std::string header;
         std::string word = "";
         int count = 0;
@@ -58,18 +122,65 @@ bool HeaderRecordBuffer::ReadHeaderRecord(const std::string& filename) {
             std::cout << "No such file";
             return false;
         }
-        while(file >> word)
+        // A binary header is read in constant time; only legacy text headers are scanned line by line.
+        char magic[sizeof(MAGIC)] = {};
+        if (file.read(magic, sizeof(magic)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0)
         {
-            count++;
-            if (count == 2)
+            return ReadBinaryHeader(file);
+        }
+        file.clear();
+        file.seekg(0);
+        std::string line;
+        std::streampos lineStart = file.tellg();
+        while(std::getline(file, line))
+        {
+            // Older headers named the codec of a blocked copy here; the header no longer records it.
+            if (line.compare(0, 12, "#compression") == 0)
             {
-                vec = parser(word);
+                lineStart = file.tellg();
+                continue;
             }
-            
-            if (count == 5)
+            if (line.compare(0, 8, "#lengths") == 0)
             {
-                header = word;
+                std::istringstream words(line.substr(8));
+                LengthIndicator::Format format;
+                if (!(words >> headerRecord.lengthIndicatorFormat)
+                    || !LengthIndicator::FromName(headerRecord.lengthIndicatorFormat, format))
+                {
+                    std::cerr << "Unknown length indicator format in header record." << std::endl;
+                    return false;
+                }
+                lineStart = file.tellg();
+                continue;
             }
+            // A dictionary-encoded data file has its State and County dictionaries after the field names.
+            if (line.compare(0, 11, "#dictionary") == 0)
+            {
+                file.clear();
+                file.seekg(lineStart);
+                if (!headerRecord.dictionary.Read(file))
+                {
+                    std::cerr << "Incomplete dictionary in header record." << std::endl;
+                    return false;
+                }
+                headerRecord.recordEncoding = "dictionary";
+                break;
+            }
+            std::istringstream words(line);
+            while(words >> word)
+            {
+                count++;
+                if (count == 2)
+                {
+                    vec = parser(word);
+                }
+
+                if (count == 5)
+                {
+                    header = word;
+                }
+            }
+            lineStart = file.tellg();
         }
         headerRecord.version = std::stoi(vec[1]);
         headerRecord.sizeFormatType = vec[3];
@@ -94,6 +205,48 @@ bool HeaderRecordBuffer::ReadHeaderRecord(const std::string& filename) {
     return true;
 }
 
+/**
+ * @brief Method to read the header record that describes a data file
+ * @param dataFileName The data file; one built by DataFileBuilder starts with its binary header block
+ * @param headerFileName Separate header file of a data file without a header block, or empty
+ * @pre None.
+ * @post On success the header record describes the data file
+ */
+bool HeaderRecordBuffer::ReadDataFileHeader(const std::string& dataFileName, const std::string& headerFileName)
+{
+    headerRecord = HeaderRecord();
+    std::ifstream data(dataFileName, std::ios::binary);
+    if (!data.is_open())
+    {
+        std::cerr << "Data file " << dataFileName << " could not be opened." << std::endl;
+        return false;
+    }
+    char magic[sizeof(MAGIC)] = {};
+    if (data.read(magic, sizeof(magic)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0)
+    {
+        headerRecord.fileName = dataFileName;
+        return ReadBinaryHeader(data);
+    }
+    // A headerless data file: its records start at offset 0, whatever sections the header file names.
+    if (!headerFileName.empty() && std::ifstream(headerFileName).is_open())
+    {
+        if (!ReadHeaderRecord(headerFileName))
+        {
+            return false;
+        }
+        headerRecord.dataSection = FileSection();
+        headerRecord.indexSection = FileSection();
+        headerRecord.footerSection = FileSection();
+    }
+    else
+    {
+        // Without a header file the data file predates the header records and has size_t length indicators.
+        headerRecord.setLengthIndicatorFormat(LengthIndicator::Name(LengthIndicator::FIXED));
+    }
+    headerRecord.fileName = dataFileName;
+    return true;
+}
+
 /**
  * @brief Method to write file
  * @param header HeaderRecord object with desired data
@@ -105,17 +258,13 @@ bool HeaderRecordBuffer::WriteHeaderRecord( HeaderRecord& header, std::string& f
     // Write the fields of the header struct to the file
     // Return true if successful, false if there was an error
 
-    // Method only outputs:
-    // 1. headerSize
-    // 2. sizeFormatType
-    // 3. fieldsPerRecord
-    // 4. fieldNames
+    // Method outputs the binary header block (see HeaderRecordBuffer.h),
+    // followed by the footer with the dictionaries of a dictionary-encoded file.
 
     // Method only requires
     // the following to write:
     // 1. HeaderRecord object
     //    - filename
-    //    - sizeFormatType {ASCII or binary}
     // 2. field names with comma separation (string)
     //    - ex: "Zip,Place,State...etc"
 
@@ -123,6 +272,8 @@ bool HeaderRecordBuffer::WriteHeaderRecord( HeaderRecord& header, std::string& f
     {
         if (header.headerSize == 0)
         {
+            // 'fields' is authoritative; names left by CSVReader::buildFileStructure() are replaced.
+            header.fieldNames.clear();
             char c;
             std::string temp = "";
             int holder = 0;
@@ -144,50 +295,25 @@ bool HeaderRecordBuffer::WriteHeaderRecord( HeaderRecord& header, std::string& f
             header.headerSize = holder;
             header.fieldsPerRecord = header.fieldNames.size();
         }
-        std::ofstream file(header.fileName);
-        
-        if (header.sizeFormatType == "ASCII")
+        // A fixed-size binary block, then the footer. A data file appended to this header starts after the footer.
+        std::ofstream file(header.fileName, std::ios::binary | std::ios::trunc);
+        header.headerSize = HEADER_BLOCK_SIZE;
+        header.sizeFormatType = "binary";
+        file.write(std::string(HEADER_BLOCK_SIZE, '\0').data(), HEADER_BLOCK_SIZE);
+        if (!WriteFooter(header, file))
         {
-            file << "39filename,version,headersize,sizeFormatType" << std::endl;
-            file << header.fileName.size() + sizeof(header.version) + sizeof(header.headerSize) + header.sizeFormatType.size()
-            << header.fileName << "," << header.version << "," << header.headerSize <<"," << header.sizeFormatType << std::endl;
-            file << 26 << "recordCount,fieldsPerRecord" << std::endl;
-            file << sizeof(int) + sizeof(int)<<header.recordCount << ","<<header.fieldsPerRecord << std::endl;
-            file << header.headerSize;
+            return false;
         }
-        if (header.sizeFormatType == "binary")
+        header.dataSection.offset = header.footerSection.offset + header.footerSection.size;
+        file.seekp(0);
+        if (!WriteBinaryHeader(header, file))
         {
-            file << std::bitset<8>(39).to_string() << "filename,version,headersize,sizeFormatType" << std::endl;
-            file << std::bitset<8>(header.fileName.size() + sizeof(header.version) + sizeof(header.headerSize) + header.sizeFormatType.size())
-            << header.fileName << "," << header.version << "," << header.headerSize <<"," << header.sizeFormatType << std::endl;
-            file << std::bitset<8>(26) << "recordCount,fieldsPerRecord" << std::endl;
-            file << std::bitset<8>(sizeof(int) + sizeof(int))<<header.recordCount<< "," << header.fieldsPerRecord << std::endl;
-            std::string byte = std::bitset<32>(header.headerSize).to_string();
-            std::string temp = "";
-            int coolInteger = 0;
-            for (int i =0; i < byte.size(); i++)
-            {
-                temp = temp + byte[i];
-                if (i == 7 || i == 15 || i == 23)
-                {
-                    temp = "";
-                }
-            }
-            byte = temp;
-            file << byte;
+            return false;
         }
-        for (int i = 0; i < header.fieldNames.size();i++)
+        if (!file)
         {
-            if (i == header.fieldNames.size() - 1)
-            {
-                file << header.fieldNames[i] << '\n';
-            }
-            else
-            {
-                file << header.fieldNames[i] << ",";
-            }
+            return false;
         }
-        throw std::runtime_error("");
     }
     catch(...)
     {
@@ -196,6 +322,139 @@ bool HeaderRecordBuffer::WriteHeaderRecord( HeaderRecord& header, std::string& f
     return true;
 }
 
+/**
+ * @brief Method to write the fixed-size binary header block
+ * @param header HeaderRecord object with the counts, formats and section offsets to store
+ * @param out Stream positioned where the block goes, normally offset 0 of the data file
+ * @pre header.fieldNames holds at most MAX_FIELDS names of at most FIELD_NAME_WIDTH - 1 bytes
+ * @post Exactly HEADER_BLOCK_SIZE bytes were written
+ */
+bool HeaderRecordBuffer::WriteBinaryHeader(const HeaderRecord& header, std::ostream& out)
+{
+    if (header.fieldNames.size() > MAX_FIELDS)
+    {
+        std::cerr << "Header record does not fit the binary header block." << std::endl;
+        return false;
+    }
+    std::string block(HEADER_BLOCK_SIZE, '\0');
+    std::memcpy(&block[MAGIC_AT], MAGIC, sizeof(MAGIC));
+    putLittle(&block[FORMAT_VERSION_AT], BINARY_VERSION, 4);
+    putLittle(&block[HEADER_SIZE_AT], HEADER_BLOCK_SIZE, 4);
+    putLittle(&block[LENGTH_FORMAT_AT], header.getLengthFormat(), 4);
+    putLittle(&block[RECORD_ENCODING_AT], header.isDictionaryEncoded() ? 1 : 0, 4);
+    putLittle(&block[RESERVED_AT], 0, 4);
+    putLittle(&block[FIELD_COUNT_AT], header.fieldNames.size(), 4);
+    putLittle(&block[KEY_ORDINALITY_AT], static_cast<std::uint32_t>(header.primaryKeyOrdinality), 4);
+    putLittle(&block[VERSION_AT], static_cast<std::uint32_t>(header.version), 4);
+    putLittle(&block[RECORD_COUNT_AT], static_cast<std::uint64_t>(header.recordCount), 8);
+    putSection(&block[DATA_SECTION_AT], header.dataSection);
+    putSection(&block[INDEX_SECTION_AT], header.indexSection);
+    putSection(&block[FOOTER_SECTION_AT], header.footerSection);
+    // Field schema: one slot per field, a length byte followed by the name.
+    for (std::size_t i = 0; i < header.fieldNames.size(); i++)
+    {
+        const std::string& name = header.fieldNames[i];
+        if (name.size() >= FIELD_NAME_WIDTH)
+        {
+            std::cerr << "Field name " << name << " is too long for the binary header block." << std::endl;
+            return false;
+        }
+        char* slot = &block[SCHEMA_OFFSET + i * FIELD_NAME_WIDTH];
+        slot[0] = static_cast<char>(name.size());
+        std::memcpy(slot + 1, name.data(), name.size());
+    }
+    out.write(block.data(), block.size());
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief Method to read the fixed-size binary header block and the footer
+ * @param in Stream of a file that starts with a binary header block
+ * @pre None.
+ * @post On success the header record holds the block's values and, for dictionary-encoded files,
+ * the dictionaries from the footer
+ */
+bool HeaderRecordBuffer::ReadBinaryHeader(std::istream& in)
+{
+    std::string block(HEADER_BLOCK_SIZE, '\0');
+    in.clear();
+    in.seekg(0);
+    if (!in.read(&block[0], block.size()) || std::memcmp(block.data(), MAGIC, sizeof(MAGIC)) != 0
+        || getLittle(&block[FORMAT_VERSION_AT], 4) != BINARY_VERSION
+        || getLittle(&block[HEADER_SIZE_AT], 4) != HEADER_BLOCK_SIZE)
+    {
+        std::cerr << "Not a binary header record for this version." << std::endl;
+        return false;
+    }
+    const std::uint64_t lengthFormat = getLittle(&block[LENGTH_FORMAT_AT], 4);
+    const std::uint64_t recordEncoding = getLittle(&block[RECORD_ENCODING_AT], 4);
+    const std::uint64_t fieldCount = getLittle(&block[FIELD_COUNT_AT], 4);
+    if (lengthFormat > LengthIndicator::VARINT || recordEncoding > 1 || fieldCount > MAX_FIELDS)
+    {
+        std::cerr << "Damaged binary header record." << std::endl;
+        return false;
+    }
+    headerRecord.headerSize = HEADER_BLOCK_SIZE;
+    headerRecord.sizeFormatType = "binary";
+    headerRecord.lengthIndicatorFormat = LengthIndicator::Name(static_cast<LengthIndicator::Format>(lengthFormat));
+    headerRecord.recordEncoding = recordEncoding == 1 ? "dictionary" : "plain";
+    headerRecord.primaryKeyOrdinality = static_cast<int>(getLittle(&block[KEY_ORDINALITY_AT], 4));
+    headerRecord.version = static_cast<int>(getLittle(&block[VERSION_AT], 4));
+    headerRecord.recordCount = static_cast<int>(getLittle(&block[RECORD_COUNT_AT], 8));
+    headerRecord.dataSection = getSection(&block[DATA_SECTION_AT]);
+    headerRecord.indexSection = getSection(&block[INDEX_SECTION_AT]);
+    headerRecord.footerSection = getSection(&block[FOOTER_SECTION_AT]);
+    headerRecord.fieldNames.clear();
+    for (std::size_t i = 0; i < fieldCount; i++)
+    {
+        const char* slot = &block[SCHEMA_OFFSET + i * FIELD_NAME_WIDTH];
+        const std::size_t length = static_cast<unsigned char>(slot[0]);
+        if (length >= FIELD_NAME_WIDTH)
+        {
+            std::cerr << "Damaged binary header record." << std::endl;
+            return false;
+        }
+        headerRecord.fieldNames.emplace_back(slot + 1, length);
+    }
+    headerRecord.fieldsPerRecord = static_cast<int>(fieldCount);
+    // The dictionaries are the only variable-size part; they are read from the footer, not searched for.
+    if (headerRecord.isDictionaryEncoded())
+    {
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(headerRecord.footerSection.offset));
+        if (!headerRecord.dictionary.Read(in))
+        {
+            std::cerr << "Incomplete dictionary in header record." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Method to write the footer section, the State and County dictionaries
+ * @param header HeaderRecord object; its footer section is set to the bytes written
+ * @param out Stream positioned where the footer goes
+ * @pre None.
+ * @post The footer was written; it is empty unless the records are dictionary encoded
+ */
+bool HeaderRecordBuffer::WriteFooter(HeaderRecord& header, std::ostream& out)
+{
+    const std::streampos start = out.tellp();
+    if (header.isDictionaryEncoded())
+    {
+        header.dictionary.Write(out);
+    }
+    const std::streampos end = out.tellp();
+    if (!out || start < 0 || end < 0)
+    {
+        return false;
+    }
+    header.footerSection.offset = static_cast<std::uint64_t>(start);
+    header.footerSection.size = static_cast<std::uint64_t>(end - start);
+    return true;
+}
+
 /**
  * @brief Method to get headerRecord object headerRecord
  * @param none N/A
@@ -10,16 +10,39 @@
  * This file declares the class HeaderRecordBuffer, which provides functionality to read and write header records for files.
  * The class includes member functions for writing, reading, and analyzing CSV files.
  *
+ * Header records are written as one fixed-size binary block of HEADER_BLOCK_SIZE bytes, so reading one takes
+ * the same time however large the data file behind it is. Every number in the block is little-endian:
+ * - bytes 0-7:    magic "ZIPDATA\0"
+ * - bytes 8-39:   format version, block size, length indicator format, record encoding, a reserved
+ *                 word written as 0, field count, primary key ordinality and header record version,
+ *                 4 bytes each
+ * - bytes 40-47:  record count
+ * - bytes 48-95:  offset and size of the data, index and footer sections, 8 bytes each
+ * - from byte 128: field schema, FIELD_NAME_WIDTH bytes per field: a length byte, then the name
+ * The footer holds the State and County dictionaries of a dictionary-encoded file and is only read for one.
+ * Header files in the older text form are still read, line by line.
+ *
  */
 #ifndef ZIPCODES_HEADERRECORDBUFFER_H
 #define ZIPCODES_HEADERRECORDBUFFER_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <fstream>
+#include <istream>
+#include <ostream>
 #include "HeaderRecord.h"
 
 class HeaderRecordBuffer {
 public:
+    static constexpr std::size_t HEADER_BLOCK_SIZE = 4096;   /**< Bytes of the binary header block. */
+    static constexpr std::uint32_t BINARY_VERSION = 1;      /**< Version of the binary header block. */
+    static constexpr std::size_t SCHEMA_OFFSET = 128;       /**< Offset of the field schema in the block. */
+    static constexpr std::size_t FIELD_NAME_WIDTH = 32;     /**< Bytes per field in the schema. */
+    static constexpr std::size_t MAX_FIELDS = (HEADER_BLOCK_SIZE - SCHEMA_OFFSET) / FIELD_NAME_WIDTH;
+    static constexpr char MAGIC[8] = {'Z', 'I', 'P', 'D', 'A', 'T', 'A', '\0'};
+
     /**
      * @brief Constructor for the HeaderRecordBuffer class
      * @param none N/A
@@ -45,6 +68,16 @@ public:
      */
     bool ReadHeaderRecord(const std::string& filename);
 
+    /**
+     * @brief Method to read the header record that describes a data file
+     * @param dataFileName The data file; one built by DataFileBuilder starts with its binary header block
+     * @param headerFileName Separate header file of a data file without a header block, or empty
+     * @pre None.
+     * @post On success the header record describes the data file: its own block, else the separate header
+     * file with the records starting at offset 0, else a legacy data file with size_t length indicators
+     */
+    bool ReadDataFileHeader(const std::string& dataFileName, const std::string& headerFileName);
+
     // Method to write a header record to a file
     /**
      * @brief Method to write a header record to a file.
@@ -55,6 +88,33 @@ public:
     */
     bool WriteHeaderRecord( HeaderRecord& header,std::string& fields);
 
+    /**
+     * @brief Method to write the fixed-size binary header block
+     * @param header HeaderRecord object with the counts, formats and section offsets to store
+     * @param out Stream positioned where the block goes, normally offset 0 of the data file
+     * @pre header.fieldNames holds at most MAX_FIELDS names of at most FIELD_NAME_WIDTH - 1 bytes
+     * @post Exactly HEADER_BLOCK_SIZE bytes were written
+     */
+    bool WriteBinaryHeader(const HeaderRecord& header, std::ostream& out);
+
+    /**
+     * @brief Method to read the fixed-size binary header block and the footer
+     * @param in Stream of a file that starts with a binary header block
+     * @pre None.
+     * @post On success the header record holds the block's values and, for dictionary-encoded files,
+     * the dictionaries from the footer
+     */
+    bool ReadBinaryHeader(std::istream& in);
+
+    /**
+     * @brief Method to write the footer section, the State and County dictionaries
+     * @param header HeaderRecord object; its footer section is set to the bytes written
+     * @param out Stream positioned where the footer goes
+     * @pre None.
+     * @post The footer was written; it is empty unless the records are dictionary encoded
+     */
+    bool WriteFooter(HeaderRecord& header, std::ostream& out);
+
     // Accessor methods to get and set the header record
     /**
      * @brief Method to get the HeaderRecord object within the HeaderRecordBuffer
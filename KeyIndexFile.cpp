@@ -0,0 +1,173 @@
+/**
+ * @file KeyIndexFile.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the KeyIndexFile class.
+ * @see KeyIndexFile.h for declaration.
+ */
+
+#include "KeyIndexFile.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+namespace {
+
+/**
+ * @brief Orders entries by their zero-padded keys.
+ */
+bool keyLess(const KeyIndexEntry& a, const KeyIndexEntry& b) {
+    return std::memcmp(a.key, b.key, KeyIndexEntry::KEY_WIDTH) < 0;
+}
+
+} // namespace
+
+/**
+ * @brief Stores 'value' as the padded key.
+ * @param value The key to store.
+ * @return false if 'value' is longer than KEY_WIDTH, true otherwise.
+ */
+bool KeyIndexEntry::SetKey(std::string_view value) {
+    if (value.size() > KEY_WIDTH) {
+        return false;
+    }
+    std::memset(key, 0, KEY_WIDTH);
+    std::memcpy(key, value.data(), value.size());
+    return true;
+}
+
+/**
+ * @brief The key without its zero padding.
+ */
+std::string_view KeyIndexEntry::Key() const {
+    const void* end = std::memchr(key, '\0', KEY_WIDTH);
+    return std::string_view(key, end == nullptr ? KEY_WIDTH : static_cast<const char*>(end) - key);
+}
+
+/**
+ * @brief Default constructor. No index file is open.
+ */
+KeyIndexFile::KeyIndexFile() : entries(nullptr), entryCount(0) {
+}
+
+/**
+ * @brief Sorts 'entries' by key and writes them as a binary index file.
+ * @param fileName Name of the index file to create.
+ * @param entries The index entries, in any order. Keys must be unique.
+ * @return true if the file was written, false otherwise.
+ */
+bool KeyIndexFile::Write(const std::string& fileName, std::vector<KeyIndexEntry> entries) {
+    std::ofstream indexFile(fileName, std::ios::binary | std::ios::trunc);
+    if (!indexFile.is_open()) {
+        std::cerr << "Error: Failed to open the index file for writing." << std::endl;
+        return false;
+    }
+    return Write(indexFile, std::move(entries));
+}
+
+/**
+ * @brief Sorts 'entries' by key and writes them as a binary index at the stream's put position.
+ * @param out The stream, such as the index section of a data file.
+ * @param entries The index entries, in any order. Keys must be unique.
+ * @return true if the index was written, false otherwise.
+ */
+bool KeyIndexFile::Write(std::ostream& out, std::vector<KeyIndexEntry> entries) {
+    std::sort(entries.begin(), entries.end(), keyLess);
+
+    FileHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.entrySize = sizeof(KeyIndexEntry);
+    header.entryCount = entries.size();
+    header.keyWidth = KeyIndexEntry::KEY_WIDTH;
+    header.byteOrder = BYTE_ORDER_MARK;
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()),
+              static_cast<std::streamsize>(entries.size() * sizeof(KeyIndexEntry)));
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief Maps an index file and validates its header.
+ * @param fileName Name of the index file.
+ * @param sectionOffset Offset of the index inside the file. Must be a multiple of 8.
+ * @return true if the file is a valid index for this host, false otherwise.
+ */
+bool KeyIndexFile::Open(const std::string& fileName, std::uint64_t sectionOffset) {
+    close();
+    if (sectionOffset % alignof(KeyIndexEntry) != 0 || !file.Open(fileName)) {
+        return false;
+    }
+    FileHeader header;
+    if (file.size() < sectionOffset || file.size() - sectionOffset < sizeof(header)) {
+        close();
+        return false;
+    }
+    const std::size_t available = file.size() - static_cast<std::size_t>(sectionOffset);
+    std::memcpy(&header, file.data() + sectionOffset, sizeof(header));
+    const bool valid = std::memcmp(header.magic, MAGIC, sizeof(header.magic)) == 0
+                       && header.version == VERSION
+                       && header.entrySize == sizeof(KeyIndexEntry)
+                       && header.keyWidth == KeyIndexEntry::KEY_WIDTH
+                       && header.byteOrder == BYTE_ORDER_MARK
+                       && header.entryCount <= (available - sizeof(header)) / sizeof(KeyIndexEntry);
+    if (!valid) {
+        std::cerr << "Error: " << fileName << " is not a version " << VERSION << " key index." << std::endl;
+        close();
+        return false;
+    }
+    // The header is 32 bytes, the section offset a multiple of 8 and mmap returns page-aligned memory,
+    // so the entries are aligned.
+    entries = reinterpret_cast<const KeyIndexEntry*>(file.data() + sectionOffset + sizeof(header));
+    entryCount = static_cast<std::size_t>(header.entryCount);
+    file.AdviseRandom();
+    return true;
+}
+
+/**
+ * @brief Checks if an index file is open.
+ * @return true if an index file is open, false otherwise.
+ */
+bool KeyIndexFile::isOpen() const {
+    return file.isOpen();
+}
+
+/**
+ * @brief Binary-searches the mapped entries for 'key'.
+ * @param key The key to look up.
+ * @return The matching entry, or nullptr if the key is not in the index.
+ */
+const KeyIndexEntry* KeyIndexFile::Find(std::string_view key) const {
+    KeyIndexEntry probe;
+    if (!probe.SetKey(key)) {
+        return nullptr;
+    }
+    const KeyIndexEntry* found = std::lower_bound(begin(), end(), probe, keyLess);
+    if (found == end() || std::memcmp(found->key, probe.key, KeyIndexEntry::KEY_WIDTH) != 0) {
+        return nullptr;
+    }
+    return found;
+}
+
+const KeyIndexEntry* KeyIndexFile::begin() const {
+    return entries;
+}
+
+const KeyIndexEntry* KeyIndexFile::end() const {
+    return entries + entryCount;
+}
+
+std::size_t KeyIndexFile::size() const {
+    return entryCount;
+}
+
+/**
+ * @brief Unmaps the index file.
+ */
+void KeyIndexFile::close() {
+    file.close();
+    entries = nullptr;
+    entryCount = 0;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file KeyIndexFile.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class KeyIndexFile and struct KeyIndexEntry
+ * @see KeyIndexFile.cpp for the implementation of these functions.
+ * @details
+ * This file declares the binary primary key index format and the class that reads it in place.
+ * An index file is a 32-byte header followed by a key-sorted array of fixed-width KeyIndexEntry
+ * records. The file is memory-mapped and binary-searched directly, so opening it costs the same
+ * no matter how many keys it holds.
+ *
+ * File layout (version 1, host byte order, checked through 'byteOrder'):
+ * - char[8]  magic      "ZIPKIDX" followed by a zero byte
+ * - uint32   version    KeyIndexFile::VERSION
+ * - uint32   entrySize  sizeof(KeyIndexEntry)
+ * - uint64   entryCount number of entries that follow
+ * - uint32   keyWidth   KeyIndexEntry::KEY_WIDTH
+ * - uint32   byteOrder  0x01020304 as written by the host that built the file
+ * - KeyIndexEntry[entryCount], sorted by key
+ *
+ * The same bytes can also be embedded as the index section of a data file built by DataFileBuilder;
+ * Open() is then given the section's offset, which must be a multiple of 8 so the entries stay aligned.
+ *
+ * Assumptions:
+ * - Keys are at most KeyIndexEntry::KEY_WIDTH bytes. Shorter keys are padded with zero bytes, which
+ *   makes memcmp order the same as std::string order.
+ * - Keys are unique within a file.
+ */
+
+#ifndef ZIPCODES_KEYINDEXFILE_H
+#define ZIPCODES_KEYINDEXFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MappedFile.h"
+
+/**
+ * @brief One fixed-width entry of the binary primary key index.
+ */
+struct KeyIndexEntry {
+    static constexpr std::size_t KEY_WIDTH = 16; /**< Bytes reserved for the key. */
+
+    char key[KEY_WIDTH];   /**< The key, padded with zero bytes. */
+    std::uint64_t offset;  /**< File offset of the record's length indicator. */
+    std::uint32_t length;  /**< Payload length of the record in bytes. */
+    std::uint32_t reserved; /**< Always zero in version 1. */
+
+    /**
+     * @brief Stores 'value' as the padded key.
+     * @param value The key to store.
+     * @return false if 'value' is longer than KEY_WIDTH, true otherwise.
+     */
+    bool SetKey(std::string_view value);
+
+    /**
+     * @brief The key without its zero padding.
+     */
+    std::string_view Key() const;
+};
+
+static_assert(sizeof(KeyIndexEntry) == 32, "KeyIndexEntry must stay 32 bytes wide");
+
+class KeyIndexFile {
+public:
+    static constexpr std::uint32_t VERSION = 1; /**< Format version written by Write(). */
+
+    /**
+     * @brief Default constructor. No index file is open.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    KeyIndexFile();
+
+    /**
+     * @brief Sorts 'entries' by key and writes them as a binary index file.
+     * @param fileName Name of the index file to create.
+     * @param entries The index entries, in any order. Keys must be unique.
+     * @return true if the file was written, false otherwise.
+     * @pre None.
+     * @post 'fileName' holds a version 1 index that Open() accepts.
+     */
+    static bool Write(const std::string& fileName, std::vector<KeyIndexEntry> entries);
+
+    /**
+     * @brief Sorts 'entries' by key and writes them as a binary index at the stream's put position.
+     * @param out The stream, such as the index section of a data file.
+     * @param entries The index entries, in any order. Keys must be unique.
+     * @return true if the index was written, false otherwise.
+     * @pre None.
+     * @post 32 + 32 * entries.size() bytes were written.
+     */
+    static bool Write(std::ostream& out, std::vector<KeyIndexEntry> entries);
+
+    /**
+     * @brief Maps an index file and validates its header.
+     * @param fileName Name of the index file.
+     * @param sectionOffset Offset of the index inside the file: 0 for an index file, or the index section
+     * of a data file. Must be a multiple of 8.
+     * @return true if the file is a valid index for this host, false otherwise.
+     * @pre None.
+     * @post On success Find() searches the mapped entries in place.
+     */
+    bool Open(const std::string& fileName, std::uint64_t sectionOffset = 0);
+
+    /**
+     * @brief Checks if an index file is open.
+     * @return true if an index file is open, false otherwise.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief Binary-searches the mapped entries for 'key'.
+     * @param key The key to look up.
+     * @return The matching entry, or nullptr if the key is not in the index.
+     * @pre The index file is open.
+     * @post None.
+     */
+    const KeyIndexEntry* Find(std::string_view key) const;
+
+    const KeyIndexEntry* begin() const;
+    const KeyIndexEntry* end() const;
+    std::size_t size() const;
+
+    /**
+     * @brief Unmaps the index file.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    void close();
+
+private:
+    /**
+     * @brief On-disk header of an index file.
+     */
+    struct FileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t entrySize;
+        std::uint64_t entryCount;
+        std::uint32_t keyWidth;
+        std::uint32_t byteOrder;
+    };
+
+    static constexpr char MAGIC[8] = {'Z', 'I', 'P', 'K', 'I', 'D', 'X', '\0'};
+    static constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    MappedFile file;               /**< Mapping of the whole index file. */
+    const KeyIndexEntry* entries;  /**< First entry inside the mapping. */
+    std::size_t entryCount;        /**< Number of entries. */
+};
+
+#endif //ZIPCODES_KEYINDEXFILE_H
@@ -0,0 +1,181 @@
+/**
+ * @file KeyIndexLog.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the KeyIndexLog class.
+ * @see KeyIndexLog.h for declaration.
+ */
+
+#include "KeyIndexLog.h"
+#include <cstring>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define ZIPCODES_HAVE_POSIX_IO 1
+#endif
+
+constexpr char KeyIndexLog::MAGIC[8];
+
+/**
+ * @brief Default constructor. No log is open.
+ */
+KeyIndexLog::KeyIndexLog() : entries(0) {
+}
+
+/**
+ * @brief Calls 'apply' with every complete entry of a log, oldest first.
+ * @param fileName Name of the log.
+ * @param apply Receives each entry; its 'reserved' field holds the Operation.
+ * @return true if the log was replayed or does not exist, false if it is not a valid log for this host.
+ */
+bool KeyIndexLog::Replay(const std::string& fileName, const std::function<void(const KeyIndexEntry&)>& apply) {
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in.is_open()) {
+        return true;
+    }
+    FileHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        // A crash while the log was being created leaves at most a partial header and no changes.
+        return true;
+    }
+    if (!validHeader(header)) {
+        std::cerr << "Error: " << fileName << " is not a version " << VERSION << " key index log." << std::endl;
+        return false;
+    }
+    KeyIndexEntry entry;
+    while (in.read(reinterpret_cast<char*>(&entry), sizeof(entry))) {
+        apply(entry);
+    }
+    return true;
+}
+
+/**
+ * @brief Opens a log for appending, creating it if it does not exist.
+ * @param fileName Name of the log.
+ * @return true if the log is ready for Append(), false otherwise.
+ */
+bool KeyIndexLog::Open(const std::string& fileName) {
+    close();
+    std::uint64_t fileSize = 0;
+    {
+        std::ifstream in(fileName, std::ios::binary | std::ios::ate);
+        if (in.is_open()) {
+            fileSize = static_cast<std::uint64_t>(in.tellg());
+            FileHeader header;
+            in.seekg(0);
+            if (fileSize >= sizeof(header)
+                && (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || !validHeader(header))) {
+                std::cerr << "Error: " << fileName << " is not a version " << VERSION << " key index log." << std::endl;
+                return false;
+            }
+        }
+    }
+    if (fileSize < sizeof(FileHeader)) {
+        out.open(fileName, std::ios::binary | std::ios::trunc);
+        const FileHeader header = makeHeader();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        fileSize = sizeof(header);
+    } else {
+        const std::uint64_t whole = (fileSize - sizeof(FileHeader)) / sizeof(KeyIndexEntry);
+        const std::uint64_t validSize = sizeof(FileHeader) + whole * sizeof(KeyIndexEntry);
+#ifdef ZIPCODES_HAVE_POSIX_IO
+        // Appending after a torn entry would shift every later entry, so the tail is cut off first.
+        if (validSize != fileSize && ::truncate(fileName.c_str(), static_cast<off_t>(validSize)) != 0) {
+            std::cerr << "Error: Unable to repair the key index log " << fileName << "." << std::endl;
+            return false;
+        }
+#endif
+        entries = static_cast<std::size_t>(whole);
+        out.open(fileName, std::ios::binary | std::ios::app);
+    }
+    if (!out.is_open() || !out.flush()) {
+        std::cerr << "Error: Unable to open the key index log " << fileName << "." << std::endl;
+        out.close();
+        entries = 0;
+        return false;
+    }
+    name = fileName;
+    return true;
+}
+
+/**
+ * @brief Appends one change and hands it to the operating system.
+ * @param entry The key and the location of its record.
+ * @param operation What happened to the key.
+ * @return true if the entry was written, false otherwise.
+ */
+bool KeyIndexLog::Append(const KeyIndexEntry& entry, Operation operation) {
+    if (!out.is_open()) {
+        return false;
+    }
+    KeyIndexEntry logged = entry;
+    logged.reserved = operation;
+    if (!out.write(reinterpret_cast<const char*>(&logged), sizeof(logged)) || !out.flush()) {
+        std::cerr << "Error: Unable to append to the key index log " << name << "." << std::endl;
+        return false;
+    }
+    entries++;
+    return true;
+}
+
+/**
+ * @brief Empties the log after its changes were merged into the index file.
+ * @return true if the log was emptied, false otherwise.
+ */
+bool KeyIndexLog::Reset() {
+    if (!out.is_open()) {
+        return false;
+    }
+    out.close();
+    out.open(name, std::ios::binary | std::ios::trunc);
+    const FileHeader header = makeHeader();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    entries = 0;
+    if (!out.flush()) {
+        std::cerr << "Error: Unable to reset the key index log " << name << "." << std::endl;
+        return false;
+    }
+    out.close();
+    out.open(name, std::ios::binary | std::ios::app);
+    return out.is_open();
+}
+
+bool KeyIndexLog::isOpen() const {
+    return out.is_open();
+}
+
+/**
+ * @brief Number of entries in the log.
+ */
+std::size_t KeyIndexLog::size() const {
+    return entries;
+}
+
+/**
+ * @brief Closes the log.
+ */
+void KeyIndexLog::close() {
+    if (out.is_open()) {
+        out.close();
+    }
+    name.clear();
+    entries = 0;
+}
+
+KeyIndexLog::FileHeader KeyIndexLog::makeHeader() {
+    FileHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.entrySize = sizeof(KeyIndexEntry);
+    header.keyWidth = KeyIndexEntry::KEY_WIDTH;
+    header.byteOrder = BYTE_ORDER_MARK;
+    return header;
+}
+
+bool KeyIndexLog::validHeader(const FileHeader& header) {
+    return std::memcmp(header.magic, MAGIC, sizeof(header.magic)) == 0
+           && header.version == VERSION
+           && header.entrySize == sizeof(KeyIndexEntry)
+           && header.keyWidth == KeyIndexEntry::KEY_WIDTH
+           && header.byteOrder == BYTE_ORDER_MARK;
+}
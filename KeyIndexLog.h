@@ -0,0 +1,132 @@
+/**
+ * @file KeyIndexLog.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class KeyIndexLog
+ * @see KeyIndexLog.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class KeyIndexLog, the append-only delta log of a primary key index. Every change
+ * made to the index after it was written, a key stored or a key erased, is appended to the log as one
+ * fixed-width KeyIndexEntry, so a change costs one 32-byte write instead of a rewrite of the whole
+ * KeyIndexFile. Opening the index replays the log over it; a checkpoint merges the two and empties the log.
+ *
+ * File layout (version 1, host byte order, checked through 'byteOrder'):
+ * - char[8]  magic      "ZIPKLOG" followed by a zero byte
+ * - uint32   version    KeyIndexLog::VERSION
+ * - uint32   entrySize  sizeof(KeyIndexEntry)
+ * - uint32   keyWidth   KeyIndexEntry::KEY_WIDTH
+ * - uint32   byteOrder  0x01020304 as written by the host that built the file
+ * - KeyIndexEntry[], in the order the changes were made; 'reserved' holds the Operation
+ *
+ * Assumptions:
+ * - Every operation stores the full state of its key, so replaying an operation twice is harmless. A log
+ *   left behind by a checkpoint that stopped before Reset() is therefore safe to replay.
+ * - A torn last entry, from a crash during Append(), is ignored by Replay() and cut off by Open().
+ * - Only one process appends to a log at a time.
+ */
+
+#ifndef ZIPCODES_KEYINDEXLOG_H
+#define ZIPCODES_KEYINDEXLOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include "KeyIndexFile.h"
+
+class KeyIndexLog {
+public:
+    /**
+     * @brief Changes recorded in the log, stored in KeyIndexEntry::reserved.
+     */
+    enum Operation : std::uint32_t {
+        PUT = 1,   /**< The key now refers to the entry's offset and length. */
+        ERASE = 2  /**< The key was deleted; offset and length name the record it referred to. */
+    };
+
+    static constexpr std::uint32_t VERSION = 1; /**< Format version written by Open(). */
+
+    /**
+     * @brief Default constructor. No log is open.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    KeyIndexLog();
+
+    /**
+     * @brief Calls 'apply' with every complete entry of a log, oldest first.
+     * @param fileName Name of the log.
+     * @param apply Receives each entry; its 'reserved' field holds the Operation.
+     * @return true if the log was replayed or does not exist, false if it is not a valid log for this host.
+     * @pre None.
+     * @post None.
+     */
+    static bool Replay(const std::string& fileName, const std::function<void(const KeyIndexEntry&)>& apply);
+
+    /**
+     * @brief Opens a log for appending, creating it if it does not exist.
+     * @param fileName Name of the log.
+     * @return true if the log is ready for Append(), false otherwise.
+     * @pre None.
+     * @post A torn last entry has been cut off.
+     */
+    bool Open(const std::string& fileName);
+
+    /**
+     * @brief Appends one change and hands it to the operating system.
+     * @param entry The key and the location of its record.
+     * @param operation What happened to the key.
+     * @return true if the entry was written, false otherwise.
+     * @pre The log is open.
+     * @post The change survives a crash of the process.
+     */
+    bool Append(const KeyIndexEntry& entry, Operation operation);
+
+    /**
+     * @brief Empties the log after its changes were merged into the index file.
+     * @return true if the log was emptied, false otherwise.
+     * @pre The log is open.
+     * @post size() returns 0.
+     */
+    bool Reset();
+
+    bool isOpen() const;
+
+    /**
+     * @brief Number of entries in the log.
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief Closes the log.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    void close();
+
+private:
+    /**
+     * @brief On-disk header of a log.
+     */
+    struct FileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t entrySize;
+        std::uint32_t keyWidth;
+        std::uint32_t byteOrder;
+    };
+
+    static constexpr char MAGIC[8] = {'Z', 'I', 'P', 'K', 'L', 'O', 'G', '\0'};
+    static constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    std::string name;     /**< Name of the open log. */
+    std::ofstream out;    /**< Stream entries are appended to. */
+    std::size_t entries;  /**< Entries in the log. */
+
+    static FileHeader makeHeader();
+    static bool validHeader(const FileHeader& header);
+};
+
+#endif //ZIPCODES_KEYINDEXLOG_H
@@ -0,0 +1,141 @@
+/**
+ * @file LengthIndicator.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the LengthIndicator class.
+ * @see LengthIndicator.h for declaration.
+ */
+
+#include "LengthIndicator.h"
+#include <cstdint>
+#include <cstring>
+
+/**
+ * @brief Bytes taken by the indicator of a length.
+ * @param length The record payload length.
+ * @param format The format.
+ * @return The width of the indicator.
+ */
+std::size_t LengthIndicator::Size(std::size_t length, Format format) {
+    if (format == FIXED) {
+        return sizeof(std::size_t);
+    }
+    std::size_t bytes = 1;
+    while (length >= 0x80) {
+        length >>= 7;
+        bytes++;
+    }
+    return bytes;
+}
+
+/**
+ * @brief Appends the indicator of a length to a buffer.
+ * @param length The record payload length.
+ * @param format The format.
+ * @param buffer The buffer to append to.
+ */
+void LengthIndicator::Append(std::size_t length, Format format, std::string& buffer) {
+    char indicator[MAX_BYTES];
+    buffer.append(indicator, Store(length, format, indicator));
+}
+
+/**
+ * @brief Stores the indicator of a length in place.
+ * @param length The record payload length.
+ * @param format The format.
+ * @param out Receives the indicator; must have room for Size(length, format) bytes.
+ * @return The width of the indicator.
+ */
+std::size_t LengthIndicator::Store(std::size_t length, Format format, char* out) {
+    if (format == FIXED) {
+        std::memcpy(out, &length, sizeof(length));
+        return sizeof(length);
+    }
+    std::size_t bytes = 0;
+    while (length >= 0x80) {
+        out[bytes++] = static_cast<char>(length | 0x80);
+        length >>= 7;
+    }
+    out[bytes++] = static_cast<char>(length);
+    return bytes;
+}
+
+/**
+ * @brief Decodes the indicator at the start of a buffer.
+ * @param data Start of the indicator.
+ * @param available Bytes readable from 'data'.
+ * @param format The format.
+ * @param length Receives the payload length.
+ * @param bytes Receives the width of the indicator.
+ * @return false if the buffer ends inside the indicator or a varint is wider than MAX_BYTES.
+ */
+bool LengthIndicator::Decode(const char* data, std::size_t available, Format format, std::size_t& length,
+                             std::size_t& bytes) {
+    if (format == FIXED) {
+        if (available < sizeof(std::size_t)) {
+            return false;
+        }
+        // The indicator is not necessarily aligned, so it is copied out rather than dereferenced in place.
+        std::memcpy(&length, data, sizeof(length));
+        bytes = sizeof(std::size_t);
+        return true;
+    }
+    std::uint64_t value = 0;
+    const std::size_t limit = available < MAX_BYTES ? available : MAX_BYTES;
+    for (std::size_t i = 0; i < limit; i++) {
+        const unsigned char byte = static_cast<unsigned char>(data[i]);
+        value |= std::uint64_t(byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            length = static_cast<std::size_t>(value);
+            bytes = i + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Reads one indicator from a stream.
+ * @param in The stream, positioned at an indicator.
+ * @param format The format.
+ * @param length Receives the payload length.
+ * @return false at the end of the stream or inside a truncated indicator.
+ */
+bool LengthIndicator::Read(std::istream& in, Format format, std::size_t& length) {
+    if (format == FIXED) {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&length), sizeof(length)));
+    }
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < MAX_BYTES; i++) {
+        const int byte = in.get();
+        if (byte == std::istream::traits_type::eof()) {
+            return false;
+        }
+        value |= std::uint64_t(byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            length = static_cast<std::size_t>(value);
+            return true;
+        }
+    }
+    in.setstate(std::ios::failbit);
+    return false;
+}
+
+const char* LengthIndicator::Name(Format format) {
+    return format == FIXED ? "size_t" : "varint";
+}
+
+/**
+ * @brief Looks up a format by name.
+ * @param name "size_t" or "varint".
+ * @param format Receives the format.
+ * @return false if the name is unknown.
+ */
+bool LengthIndicator::FromName(const std::string& name, Format& format) {
+    for (Format candidate : {FIXED, VARINT}) {
+        if (name == Name(candidate)) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file LengthIndicator.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class LengthIndicator
+ * @see LengthIndicator.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class LengthIndicator, which encodes and decodes the length that precedes every
+ * record of a length-indicated data file. Two formats are available:
+ * - "varint": the length as an unsigned LEB128 number, seven bits per byte with the high bit set on every
+ *   byte but the last. Records below 128 bytes take one byte and records below 16 KiB two. This is the
+ *   default for new data files.
+ * - "size_t": the legacy format, the raw bytes of a host std::size_t. Data files written before the
+ *   format was recorded in the header record use it.
+ *
+ * Assumptions:
+ * - Readers know the format of a data file from its header record; it is not stored in the data file.
+ * - Writers always emit the shortest varint, so Size() gives the exact width of any indicator they wrote.
+ * - A "size_t" file is only read on a host with the same std::size_t width and byte order as the writer.
+ */
+
+#ifndef ZIPCODES_LENGTHINDICATOR_H
+#define ZIPCODES_LENGTHINDICATOR_H
+
+#include <cstddef>
+#include <istream>
+#include <string>
+
+class LengthIndicator {
+public:
+    /**
+     * @brief Length indicator formats, as named in the header record.
+     */
+    enum Format {
+        FIXED,  /**< Raw host std::size_t, the legacy format. */
+        VARINT  /**< Unsigned LEB128. */
+    };
+
+    static constexpr Format DEFAULT = VARINT;   /**< Format written unless the header record asks otherwise. */
+    static constexpr std::size_t MAX_BYTES = 10; /**< Widest indicator of either format. */
+
+    /**
+     * @brief Bytes taken by the indicator of a length.
+     * @param length The record payload length.
+     * @param format The format.
+     * @return The width of the indicator.
+     */
+    static std::size_t Size(std::size_t length, Format format);
+
+    /**
+     * @brief Appends the indicator of a length to a buffer.
+     * @param length The record payload length.
+     * @param format The format.
+     * @param buffer The buffer to append to.
+     */
+    static void Append(std::size_t length, Format format, std::string& buffer);
+
+    /**
+     * @brief Stores the indicator of a length in place.
+     * @param length The record payload length.
+     * @param format The format.
+     * @param out Receives the indicator; must have room for Size(length, format) bytes.
+     * @return The width of the indicator.
+     */
+    static std::size_t Store(std::size_t length, Format format, char* out);
+
+    /**
+     * @brief Decodes the indicator at the start of a buffer.
+     * @param data Start of the indicator.
+     * @param available Bytes readable from 'data'.
+     * @param format The format.
+     * @param length Receives the payload length.
+     * @param bytes Receives the width of the indicator.
+     * @return false if the buffer ends inside the indicator or a varint is wider than MAX_BYTES.
+     */
+    static bool Decode(const char* data, std::size_t available, Format format, std::size_t& length,
+                       std::size_t& bytes);
+
+    /**
+     * @brief Reads one indicator from a stream.
+     * @param in The stream, positioned at an indicator.
+     * @param format The format.
+     * @param length Receives the payload length.
+     * @return false at the end of the stream or inside a truncated indicator.
+     */
+    static bool Read(std::istream& in, Format format, std::size_t& length);
+
+    /**
+     * @brief Name of a format: "size_t" or "varint".
+     */
+    static const char* Name(Format format);
+
+    /**
+     * @brief Looks up a format by name.
+     * @param name "size_t" or "varint".
+     * @param format Receives the format.
+     * @return false if the name is unknown.
+     */
+    static bool FromName(const std::string& name, Format& format);
+};
+
+#endif //ZIPCODES_LENGTHINDICATOR_H
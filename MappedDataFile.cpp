@@ -0,0 +1,165 @@
+/**
+ * @file MappedDataFile.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the MappedDataFile class.
+ * @see MappedDataFile.h for declaration.
+ */
+
+#include "MappedDataFile.h"
+
+/**
+ * @brief Default constructor. The object does not map anything.
+ */
+MappedDataFile::MappedDataFile() : dataStart(0), dataEnd(0), indicatorFormat(LengthIndicator::DEFAULT) {
+}
+
+/**
+ * @brief Maps a length-indicated data file for reading.
+ * @param filename The name of the data file.
+ * @param dataOffset Offset of the first record, used to skip a header block.
+ * @param format Format of the length indicators, as recorded in the header record.
+ * @param dataSize Bytes of records after 'dataOffset', or TO_END_OF_FILE.
+ * @return true if the file was mapped, false if the caller should use the stream fallback.
+ */
+bool MappedDataFile::Open(const std::string& filename, std::uint64_t dataOffset, LengthIndicator::Format format,
+                          std::uint64_t dataSize) {
+    if (!file.Open(filename)) {
+        return false;
+    }
+    if (dataOffset > file.size()) {
+        file.close();
+        return false;
+    }
+    dataStart = dataOffset;
+    dataEnd = dataSize < file.size() - dataOffset ? dataOffset + dataSize : file.size();
+    indicatorFormat = format;
+    return true;
+}
+
+/**
+ * @brief Checks if the data file is mapped.
+ * @return true if the data file is mapped, false otherwise.
+ */
+bool MappedDataFile::isOpen() const {
+    return file.isOpen();
+}
+
+/**
+ * @brief Fetches the record whose length indicator starts at 'offset'.
+ * @param offset File offset of the length indicator.
+ * @param record Receives the record; its data points into the mapping.
+ * @return true if a complete record starts at 'offset', false otherwise.
+ */
+bool MappedDataFile::RecordAt(std::uint64_t offset, RecordView& record) const {
+    if (offset < dataStart || offset > dataEnd) {
+        return false;
+    }
+    std::size_t length;
+    std::size_t indicatorBytes;
+    if (!LengthIndicator::Decode(file.data() + offset, dataEnd - offset, indicatorFormat, length, indicatorBytes)) {
+        return false;
+    }
+    const std::uint64_t payload = offset + indicatorBytes;
+    if (length > dataEnd - payload) {
+        return false;
+    }
+    record.offset = offset;
+    record.length = length;
+    record.data = std::string_view(file.data() + payload, length);
+    return true;
+}
+
+MappedDataFile::Iterator MappedDataFile::begin() const {
+    if (!file.isOpen()) {
+        return end();
+    }
+    return Iterator(this, dataStart);
+}
+
+MappedDataFile::Iterator MappedDataFile::end() const {
+    return Iterator();
+}
+
+std::uint64_t MappedDataFile::dataOffset() const {
+    return dataStart;
+}
+
+LengthIndicator::Format MappedDataFile::lengthFormat() const {
+    return indicatorFormat;
+}
+
+std::size_t MappedDataFile::size() const {
+    return file.size();
+}
+
+const MappedFile& MappedDataFile::mapping() const {
+    return file;
+}
+
+/**
+ * @brief Unmaps the data file if it is mapped.
+ */
+void MappedDataFile::close() {
+    file.close();
+    dataStart = 0;
+    dataEnd = 0;
+}
+
+// ---------------------------------------- Iterator ---------------------------------------------------//
+
+MappedDataFile::Iterator::Iterator() : owner(nullptr), current{0, 0, std::string_view()} {
+}
+
+MappedDataFile::Iterator::Iterator(const MappedDataFile* owner, std::uint64_t offset)
+        : owner(owner), current{0, 0, std::string_view()} {
+    load(offset);
+}
+
+MappedDataFile::Iterator::reference MappedDataFile::Iterator::operator*() const {
+    return current;
+}
+
+MappedDataFile::Iterator::pointer MappedDataFile::Iterator::operator->() const {
+    return &current;
+}
+
+MappedDataFile::Iterator& MappedDataFile::Iterator::operator++() {
+    if (owner == nullptr) {
+        return *this;
+    }
+    // The next indicator starts right after the payload, whatever the width of this one.
+    load(static_cast<std::uint64_t>(current.data.data() - owner->file.data()) + current.length);
+    return *this;
+}
+
+MappedDataFile::Iterator MappedDataFile::Iterator::operator++(int) {
+    Iterator previous = *this;
+    ++(*this);
+    return previous;
+}
+
+bool MappedDataFile::Iterator::operator==(const Iterator& other) const {
+    if (owner == nullptr || other.owner == nullptr) {
+        return owner == other.owner;
+    }
+    return owner == other.owner && current.offset == other.current.offset;
+}
+
+bool MappedDataFile::Iterator::operator!=(const Iterator& other) const {
+    return !(*this == other);
+}
+
+/**
+ * @brief Positions the iterator on the first live record at or after 'offset', or at the end if there is none.
+ * @param offset File offset of the next length indicator.
+ */
+void MappedDataFile::Iterator::load(std::uint64_t offset) {
+    while (owner != nullptr && owner->RecordAt(offset, current)) {
+        if (!IsTombstone(current.data)) {
+            return;
+        }
+        offset = static_cast<std::uint64_t>(current.data.data() - owner->file.data()) + current.length;
+    }
+    owner = nullptr;
+    current = RecordView{0, 0, std::string_view()};
+}
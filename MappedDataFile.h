@@ -0,0 +1,152 @@
+/**
+ * @file MappedDataFile.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class MappedDataFile
+ * @see MappedDataFile.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class MappedDataFile, a read-only, zero-copy view of a length-indicated data file.
+ * Records are exposed as std::string_view spans into the mapping together with the offset of their
+ * length indicator, so a full scan performs no allocation and no per-record system call.
+ * The class supports sequential iteration and random access by offset.
+ *
+ * A record deleted by MutableDataFile keeps its length indicator, so the file can still be walked, but its
+ * payload starts with TOMBSTONE. Iteration skips such records; RecordAt() returns them as they are.
+ *
+ * Assumptions:
+ * - The data file was written by CSVReader::WriteToFile (length indicator followed by the payload), in the
+ *   LengthIndicator format given to Open().
+ * - Offsets handed to RecordAt() point at a length indicator, as produced by iteration or by the primary key index.
+ * - In a file that also holds an index or a footer, Open() is given the size of the data section so records
+ *   never run past it.
+ * - When the file cannot be mapped, callers fall back to CSVReader::ReadFromFile on an std::ifstream.
+ */
+
+#ifndef ZIPCODES_MAPPEDDATAFILE_H
+#define ZIPCODES_MAPPEDDATAFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+#include "LengthIndicator.h"
+#include "MappedFile.h"
+
+/**
+ * @brief A record located inside a mapped data file.
+ * The data view stays valid for as long as the owning MappedDataFile is open.
+ */
+struct RecordView {
+    std::uint64_t offset;  /**< File offset of the record's length indicator. */
+    std::size_t length;    /**< Payload length in bytes. */
+    std::string_view data; /**< The payload, pointing into the mapping. */
+};
+
+class MappedDataFile {
+public:
+    static constexpr std::uint64_t TO_END_OF_FILE = std::numeric_limits<std::uint64_t>::max(); /**< Unbounded data section. */
+
+    static constexpr char TOMBSTONE = '*'; /**< First payload byte of a deleted record; never starts a key. */
+
+    /**
+     * @brief Checks if a record payload marks a deleted record.
+     * @param payload The record payload.
+     * @return true if the record was deleted, false otherwise.
+     */
+    static bool IsTombstone(std::string_view payload) {
+        return !payload.empty() && payload.front() == TOMBSTONE;
+    }
+
+    /**
+     * @brief Forward iterator over the live records of a MappedDataFile.
+     * Iteration skips deleted records and stops at the end of the file or at the first truncated record.
+     */
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = RecordView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const RecordView*;
+        using reference = const RecordView&;
+
+        Iterator();
+        Iterator(const MappedDataFile* owner, std::uint64_t offset);
+
+        reference operator*() const;
+        pointer operator->() const;
+        Iterator& operator++();
+        Iterator operator++(int);
+        bool operator==(const Iterator& other) const;
+        bool operator!=(const Iterator& other) const;
+
+    private:
+        const MappedDataFile* owner; /**< File being iterated, or nullptr at the end. */
+        RecordView current;          /**< Record the iterator points at. */
+
+        void load(std::uint64_t offset);
+    };
+
+    /**
+     * @brief Default constructor. The object does not map anything.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    MappedDataFile();
+
+    /**
+     * @brief Maps a length-indicated data file for reading.
+     * @param filename The name of the data file.
+     * @param dataOffset Offset of the first record, used to skip a header block.
+     * @param format Format of the length indicators, as recorded in the header record.
+     * @param dataSize Bytes of records after 'dataOffset', or TO_END_OF_FILE.
+     * @return true if the file was mapped, false if the caller should use the stream fallback.
+     * @pre None.
+     * @post On success the records of the file can be iterated or fetched by offset.
+     */
+    bool Open(const std::string& filename, std::uint64_t dataOffset = 0,
+              LengthIndicator::Format format = LengthIndicator::DEFAULT, std::uint64_t dataSize = TO_END_OF_FILE);
+
+    /**
+     * @brief Checks if the data file is mapped.
+     * @return true if the data file is mapped, false otherwise.
+     * @pre None.
+     * @post None.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief Fetches the record whose length indicator starts at 'offset'.
+     * @param offset File offset of the length indicator.
+     * @param record Receives the record; its data points into the mapping.
+     * @return true if a complete record starts at 'offset', false otherwise.
+     * @pre The data file is open.
+     * @post 'record' is updated only when true is returned.
+     */
+    bool RecordAt(std::uint64_t offset, RecordView& record) const;
+
+    Iterator begin() const;
+    Iterator end() const;
+
+    std::uint64_t dataOffset() const;
+    LengthIndicator::Format lengthFormat() const;
+    std::size_t size() const;
+    const MappedFile& mapping() const;
+
+    /**
+     * @brief Unmaps the data file if it is mapped.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    void close();
+
+private:
+    MappedFile file;         /**< Mapping of the whole data file. */
+    std::uint64_t dataStart; /**< Offset of the first record. */
+    std::uint64_t dataEnd;   /**< Offset just past the last record. */
+    LengthIndicator::Format indicatorFormat; /**< Format of the length indicators. */
+};
+
+#endif //ZIPCODES_MAPPEDDATAFILE_H
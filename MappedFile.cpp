@@ -0,0 +1,144 @@
+/**
+ * @file MappedFile.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the MappedFile class.
+ * @see MappedFile.h for declaration.
+ */
+
+#include "MappedFile.h"
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ZIPCODES_HAVE_MMAP 1
+#endif
+
+/**
+ * @brief Default constructor. The object does not map anything.
+ */
+MappedFile::MappedFile() : mappedData(nullptr), mappedSize(0), opened(false) {
+}
+
+/**
+ * @brief Constructor that maps the file specified by the 'filename' parameter.
+ * @param filename The name of the file to map.
+ */
+MappedFile::MappedFile(const std::string& filename) : MappedFile() {
+    Open(filename);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+        : mappedData(std::exchange(other.mappedData, nullptr)),
+          mappedSize(std::exchange(other.mappedSize, 0)),
+          opened(std::exchange(other.opened, false)) {
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        mappedData = std::exchange(other.mappedData, nullptr);
+        mappedSize = std::exchange(other.mappedSize, 0);
+        opened = std::exchange(other.opened, false);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+/**
+ * @brief Maps the file specified by the 'filename' parameter, replacing any current mapping.
+ * @param filename The name of the file to map.
+ * @return true if the file was mapped, false otherwise.
+ */
+bool MappedFile::Open(const std::string& filename) {
+    close();
+#ifdef ZIPCODES_HAVE_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+    mappedSize = static_cast<std::size_t>(info.st_size);
+    if (mappedSize > 0) {
+        void* address = ::mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            ::close(fd);
+            mappedSize = 0;
+            return false;
+        }
+        mappedData = static_cast<const char*>(address);
+    }
+    // The mapping keeps its own reference to the file, so the descriptor is not needed any more.
+    ::close(fd);
+    opened = true;
+    return true;
+#else
+    (void)filename;
+    return false;
+#endif
+}
+
+/**
+ * @brief Checks if a file is mapped.
+ * @return true if a file is mapped, false otherwise.
+ */
+bool MappedFile::isOpen() const {
+    return opened;
+}
+
+/**
+ * @brief Hints to the kernel that the mapping will be read front to back.
+ */
+void MappedFile::AdviseSequential() const {
+#ifdef ZIPCODES_HAVE_MMAP
+    if (mappedData != nullptr) {
+        ::madvise(const_cast<char*>(mappedData), mappedSize, MADV_SEQUENTIAL);
+    }
+#endif
+}
+
+/**
+ * @brief Hints to the kernel that the mapping will be read at random offsets.
+ */
+void MappedFile::AdviseRandom() const {
+#ifdef ZIPCODES_HAVE_MMAP
+    if (mappedData != nullptr) {
+        ::madvise(const_cast<char*>(mappedData), mappedSize, MADV_RANDOM);
+    }
+#endif
+}
+
+const char* MappedFile::data() const {
+    return mappedData;
+}
+
+std::size_t MappedFile::size() const {
+    return mappedSize;
+}
+
+std::string_view MappedFile::view() const {
+    return std::string_view(mappedData, mappedSize);
+}
+
+/**
+ * @brief Unmaps the file if it is mapped.
+ */
+void MappedFile::close() {
+#ifdef ZIPCODES_HAVE_MMAP
+    if (mappedData != nullptr) {
+        ::munmap(const_cast<char*>(mappedData), mappedSize);
+    }
+#endif
+    mappedData = nullptr;
+    mappedSize = 0;
+    opened = false;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file MappedFile.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class MappedFile
+ * @see MappedFile.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class MappedFile, a read-only memory mapping of a whole file.
+ * The mapping is released when the object is closed or destroyed. Callers read the file
+ * contents directly out of the mapping, so no bytes are copied into user-space buffers.
+ *
+ * Assumptions:
+ * - The host provides POSIX mmap. On other hosts Open() fails and callers use their stream fallback.
+ * - The file is not truncated by another process while it is mapped.
+ */
+
+#ifndef ZIPCODES_MAPPEDFILE_H
+#define ZIPCODES_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Read-only memory mapping of an entire file.
+ * This class is move-only; a mapping has exactly one owner.
+ */
+class MappedFile {
+public:
+    /**
+     * @brief Default constructor. The object does not map anything.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    MappedFile();
+
+    /**
+     * @brief Constructor that maps the file specified by the 'filename' parameter.
+     * @param filename The name of the file to map.
+     * @pre None.
+     * @post The file is mapped if it exists and can be read.
+     */
+    explicit MappedFile(const std::string& filename);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    /**
+     * @brief Unmaps the file if it is mapped.
+     */
+    ~MappedFile();
+
+    /**
+     * @brief Maps the file specified by the 'filename' parameter, replacing any current mapping.
+     * @param filename The name of the file to map.
+     * @return true if the file was mapped, false otherwise.
+     * @pre None.
+     * @post On success data() and size() describe the whole file.
+     */
+    bool Open(const std::string& filename);
+
+    /**
+     * @brief Checks if a file is mapped.
+     * @return true if a file is mapped, false otherwise.
+     * @pre None.
+     * @post None.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief Hints to the kernel that the mapping will be read front to back.
+     * @pre None.
+     * @post Read-ahead is increased for the mapping if the host supports it.
+     */
+    void AdviseSequential() const;
+
+    /**
+     * @brief Hints to the kernel that the mapping will be read at random offsets.
+     * @pre None.
+     * @post Read-ahead is reduced for the mapping if the host supports it.
+     */
+    void AdviseRandom() const;
+
+    const char* data() const;
+    std::size_t size() const;
+    std::string_view view() const;
+
+    /**
+     * @brief Unmaps the file if it is mapped.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    void close();
+
+private:
+    const char* mappedData; /**< Start of the mapping, or nullptr for an empty file. */
+    std::size_t mappedSize; /**< Size of the mapping in bytes. */
+    bool opened;            /**< True while a file is mapped. */
+};
+
+#endif //ZIPCODES_MAPPEDFILE_H
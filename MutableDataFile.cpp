@@ -0,0 +1,293 @@
+/**
+ * @file MutableDataFile.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the MutableDataFile class.
+ * @see MutableDataFile.h for declaration.
+ */
+
+#include "MutableDataFile.h"
+#include "CSVReader.h"
+#include "FieldTokenizer.h"
+#include "MappedDataFile.h"
+#include <iostream>
+
+/**
+ * @brief Default constructor. No data file is open.
+ */
+MutableDataFile::MutableDataFile()
+        : index(nullptr), format(LengthIndicator::DEFAULT), fileEnd(0), availBytes(0),
+          poolFile(BufferPool::NO_FILE) {
+}
+
+/**
+ * @brief Opens a data file for changes and collects its free slots.
+ * @param fileName Name of the length-indicated data file.
+ * @param index Primary key index over the file, opened with OpenIndex().
+ * @param format Format of the length indicators.
+ * @param dataOffset Offset of the first record, used to skip a header block.
+ * @return true if the file was opened, false otherwise.
+ */
+bool MutableDataFile::Open(const std::string& fileName, PrimaryKeyIndex& index, LengthIndicator::Format format,
+                           std::uint64_t dataOffset) {
+    close();
+    // A Compactor copying the file would lose every change made meanwhile, so writers and compactions exclude
+    // each other.
+    if (!writerLock.Acquire(fileName)) {
+        std::cerr << "Error: " << fileName << " is being compacted or changed by another writer." << std::endl;
+        return false;
+    }
+    this->index = &index;
+    this->format = format;
+    auto addSlot = [this](std::uint64_t offset, std::size_t length, std::string_view payload) {
+        const std::uint64_t slotBytes = LengthIndicator::Size(length, this->format) + length;
+        if (MappedDataFile::IsTombstone(payload)) {
+            avail.emplace(slotBytes, offset);
+            availBytes += slotBytes;
+        }
+        return offset + slotBytes;
+    };
+
+    // Walk every record, deleted ones included. Appends start after the last complete record.
+    std::uint64_t offset = dataOffset;
+    MappedDataFile mapped;
+    if (mapped.Open(fileName, dataOffset, format)) {
+        mapped.mapping().AdviseSequential();
+        RecordView record;
+        while (mapped.RecordAt(offset, record)) {
+            offset = addSlot(offset, record.length, record.data);
+        }
+    } else {
+        std::ifstream inputFile(fileName, std::ios::binary);
+        if (!inputFile) {
+            std::cerr << "Failed to open input file." << std::endl;
+            close();
+            return false;
+        }
+        inputFile.seekg(static_cast<std::streamoff>(dataOffset));
+        while (inputFile) {
+            std::pair<std::size_t, std::string> record = CSVReader::ReadFromFile(inputFile, format);
+            if (record.first == 0 || record.second.size() != record.first) {
+                break; // End of file reached
+            }
+            offset = addSlot(offset, record.first, record.second);
+        }
+    }
+    fileEnd = offset;
+
+    file.open(fileName, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open the data file " << fileName << " for writing." << std::endl;
+        close();
+        return false;
+    }
+    // The registration shares its id with the one PrimaryKeyIndex::OpenDataFile() reads through.
+    poolFile = BufferPool::Shared().OpenFile(fileName);
+    if (poolFile == BufferPool::NO_FILE) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MutableDataFile::isOpen() const {
+    return file.is_open();
+}
+
+/**
+ * @brief Adds a record whose key is not in the index yet.
+ * @param record The record payload, comma separated, with its key in the key field of the index.
+ * @return true if the record was written and indexed, false if the key exists or a write failed.
+ */
+bool MutableDataFile::Append(std::string_view record) {
+    KeyIndexEntry existing;
+    if (!isOpen() || index->FindKey(FieldTokenizer::ExtractField(record, index->primaryKeyField()), existing)) {
+        return false;
+    }
+    KeyIndexEntry entry;
+    return place(record, entry) && index->PutKey(entry);
+}
+
+/**
+ * @brief Replaces the record with the same key.
+ * @param record The new record payload, comma separated, with its key in the key field of the index.
+ * @return true if the record was replaced, false if the key is unknown or a write failed.
+ */
+bool MutableDataFile::Update(std::string_view record) {
+    KeyIndexEntry old;
+    if (!isOpen() || !index->FindKey(FieldTokenizer::ExtractField(record, index->primaryKeyField()), old)) {
+        return false;
+    }
+    if (record.size() == old.length) {
+        // Same length, same indicator: the index entry stays valid.
+        return writeAt(old.offset + LengthIndicator::Size(old.length, format), record.data(), record.size());
+    }
+    // The new record is stored and indexed before the old one is freed, so a crash never loses the key.
+    KeyIndexEntry entry;
+    return place(record, entry) && index->PutKey(entry) && release(old);
+}
+
+/**
+ * @brief Deletes the record with a key.
+ * @param key The primary key.
+ * @return true if the record was deleted, false if the key is unknown or a write failed.
+ */
+bool MutableDataFile::Delete(std::string_view key) {
+    KeyIndexEntry old;
+    if (!isOpen() || !index->FindKey(key, old)) {
+        return false;
+    }
+    // Tombstone first: an index entry that survives a crash then points at a deleted record, which
+    // SearchIndex() reports as missing.
+    return release(old) && index->EraseKey(key);
+}
+
+/**
+ * @brief Number of free slots on the avail list.
+ */
+std::size_t MutableDataFile::freeSlots() const {
+    return avail.size();
+}
+
+/**
+ * @brief Bytes held by the free slots, length indicators included.
+ */
+std::uint64_t MutableDataFile::freeBytes() const {
+    return availBytes;
+}
+
+/**
+ * @brief File offset at which an appended record would start.
+ */
+std::uint64_t MutableDataFile::endOffset() const {
+    return fileEnd;
+}
+
+/**
+ * @brief Closes the data file.
+ */
+void MutableDataFile::close() {
+    if (file.is_open()) {
+        file.close();
+    }
+    if (poolFile != BufferPool::NO_FILE) {
+        BufferPool::Shared().CloseFile(poolFile);
+        poolFile = BufferPool::NO_FILE;
+    }
+    avail.clear();
+    availBytes = 0;
+    fileEnd = 0;
+    writerLock.Release();
+}
+
+/**
+ * @brief Writes a record into the best free slot, or at the end of the file.
+ * @param record The payload.
+ * @param entry Receives the key, offset and length of the stored record.
+ * @return false if the key is unusable or a write failed.
+ */
+bool MutableDataFile::place(std::string_view record, KeyIndexEntry& entry) {
+    if (!PrimaryKeyIndex::MakeEntry(record, fileEnd, entry, index->primaryKeyField())
+        || MappedDataFile::IsTombstone(record)) {
+        std::cerr << "Error: The record needs a primary key of 1 to " << KeyIndexEntry::KEY_WIDTH << " bytes."
+                  << std::endl;
+        return false;
+    }
+    std::string buffer;
+    LengthIndicator::Append(record.size(), format, buffer);
+    buffer.append(record.data(), record.size());
+
+    // Best fit: the smallest slot that holds the record and leaves either nothing or a usable slot.
+    std::uint64_t slotBytes = 0;
+    std::size_t payload;
+    for (auto slot = avail.lower_bound(buffer.size()); slot != avail.end(); ++slot) {
+        const std::uint64_t leftover = slot->first - buffer.size();
+        if (leftover == 0 || payloadForSlot(leftover, payload)) {
+            slotBytes = slot->first;
+            entry.offset = slot->second;
+            availBytes -= slot->first;
+            avail.erase(slot);
+            break;
+        }
+    }
+    // The rest of the slot is marked before the record is written over the slot's old indicator, so a
+    // scan interrupted by a crash still sees one tombstone covering the whole slot.
+    if (slotBytes > buffer.size() && !writeFreeSlot(entry.offset + buffer.size(), slotBytes - buffer.size())) {
+        return false;
+    }
+    if (!writeAt(entry.offset, buffer.data(), buffer.size())) {
+        return false;
+    }
+    if (slotBytes == 0) {
+        fileEnd += buffer.size();
+    }
+    return true;
+}
+
+/**
+ * @brief Marks the record of an index entry deleted and puts its slot on the avail list.
+ * @return false if the write failed.
+ */
+bool MutableDataFile::release(const KeyIndexEntry& entry) {
+    const std::size_t indicatorBytes = LengthIndicator::Size(entry.length, format);
+    const char tombstone = MappedDataFile::TOMBSTONE;
+    if (entry.length == 0 || !writeAt(entry.offset + indicatorBytes, &tombstone, 1)) {
+        return false;
+    }
+    avail.emplace(indicatorBytes + entry.length, entry.offset);
+    availBytes += indicatorBytes + entry.length;
+    return true;
+}
+
+/**
+ * @brief Writes a tombstoned record that fills 'slotBytes' bytes at 'offset' and lists it as free.
+ * @return false if the write failed.
+ */
+bool MutableDataFile::writeFreeSlot(std::uint64_t offset, std::uint64_t slotBytes) {
+    std::size_t payload;
+    if (!payloadForSlot(slotBytes, payload)) {
+        return false;
+    }
+    std::string buffer;
+    LengthIndicator::Append(payload, format, buffer);
+    buffer.push_back(MappedDataFile::TOMBSTONE);
+    buffer.resize(static_cast<std::size_t>(slotBytes), '\0');
+    if (!writeAt(offset, buffer.data(), buffer.size())) {
+        return false;
+    }
+    avail.emplace(slotBytes, offset);
+    availBytes += slotBytes;
+    return true;
+}
+
+/**
+ * @brief Writes bytes at an offset, hands them to the operating system and drops their cached pages.
+ * @return false if the write failed.
+ */
+bool MutableDataFile::writeAt(std::uint64_t offset, const char* data, std::size_t size) {
+    file.clear();
+    file.seekp(static_cast<std::streamoff>(offset));
+    if (!file.write(data, static_cast<std::streamsize>(size)) || !file.flush()) {
+        std::cerr << "Error: Unable to write the data file." << std::endl;
+        return false;
+    }
+    BufferPool::Shared().Invalidate(poolFile, offset, size);
+    return true;
+}
+
+/**
+ * @brief Finds the payload length whose record, indicator included, is exactly 'slotBytes' long.
+ * @return false if no record of at least one byte fills the slot exactly.
+ */
+bool MutableDataFile::payloadForSlot(std::uint64_t slotBytes, std::size_t& payload) const {
+    for (std::size_t indicatorBytes = 1; indicatorBytes <= LengthIndicator::MAX_BYTES; indicatorBytes++) {
+        if (slotBytes <= indicatorBytes) {
+            return false;
+        }
+        const std::size_t candidate = static_cast<std::size_t>(slotBytes - indicatorBytes);
+        if (LengthIndicator::Size(candidate, format) == indicatorBytes) {
+            payload = candidate;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,172 @@
+/**
+ * @file MutableDataFile.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class MutableDataFile
+ * @see MutableDataFile.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class MutableDataFile, which appends, updates and deletes records of a
+ * length-indicated data file in place and keeps its PrimaryKeyIndex current, so a delta of a few hundred
+ * rows costs a few hundred small writes rather than a rebuild of the data file and the index.
+ *
+ * A deleted record keeps its length indicator and has the first byte of its payload overwritten with
+ * MappedDataFile::TOMBSTONE; scans skip it. Its bytes, indicator included, form a free slot on the avail
+ * list. A new or relocated record goes into the smallest free slot that holds it, or at the end of the file.
+ * What is left of a slot becomes a smaller tombstoned slot when it can hold a length indicator and one byte.
+ * An updated record of the same length is overwritten in place; one of another length is relocated.
+ *
+ * The index changes are appended to the index's delta log (see KeyIndexLog) and merged into the index file
+ * by PrimaryKeyIndex::Checkpoint(). The avail list is rebuilt from the tombstones when the file is opened.
+ *
+ * The file is registered with the shared BufferPool while it is open, and every write invalidates the pages
+ * it touched, so PrimaryKeyIndex::SearchIndex() reads the changed bytes from the file rather than a stale page.
+ * A QueryEngine serving the file keeps its snapshot, mapping and index as they were; call QueryEngine::Reload()
+ * after a batch of changes to publish them.
+ *
+ * Assumptions:
+ * - The data section runs to the end of the file: a plain data file, possibly after a header block. A file
+ *   built by DataFileBuilder, with an index section after the records, is not changed in place.
+ * - The primary key is the field of every record that the index names, PrimaryKeyIndex::primaryKeyField(),
+ *   and fits in KeyIndexEntry::KEY_WIDTH bytes; a record with a longer key is refused.
+ * - Records never start with MappedDataFile::TOMBSTONE.
+ * - Only one writer changes a data file at a time. The FileLock of the file, held from Open() to close(),
+ *   keeps other MutableDataFile objects and the Compactor out.
+ * - Each change writes the data file before the index log, and a deletion marks the tombstone before the key
+ *   is erased, so after a crash the index never points at a record that is only partly written.
+ */
+
+#ifndef ZIPCODES_MUTABLEDATAFILE_H
+#define ZIPCODES_MUTABLEDATAFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <string_view>
+#include "BufferPool.h"
+#include "FileLock.h"
+#include "KeyIndexFile.h"
+#include "LengthIndicator.h"
+#include "PrimaryKeyIndex.h"
+
+class MutableDataFile {
+public:
+    /**
+     * @brief Default constructor. No data file is open.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    MutableDataFile();
+
+    /**
+     * @brief Opens a data file for changes and collects its free slots.
+     * @param fileName Name of the length-indicated data file.
+     * @param index Primary key index over the file, opened with OpenIndex(). It must outlive this object.
+     * @param format Format of the length indicators.
+     * @param dataOffset Offset of the first record, used to skip a header block.
+     * @return true if the file was opened, false otherwise, also when a Compactor or another MutableDataFile
+     * holds the FileLock of the file.
+     * @pre After a crash, Compactor::Recover() ran on the file and its index before they were opened.
+     * @post Append(), Update() and Delete() change the file and 'index'. The FileLock is held until close().
+     */
+    bool Open(const std::string& fileName, PrimaryKeyIndex& index,
+              LengthIndicator::Format format = LengthIndicator::DEFAULT, std::uint64_t dataOffset = 0);
+
+    bool isOpen() const;
+
+    /**
+     * @brief Adds a record whose key is not in the index yet.
+     * @param record The record payload, comma separated, with its key in the key field of the index.
+     * @return true if the record was written and indexed, false if the key exists or a write failed.
+     * @pre The file is open.
+     * @post The record is stored in a free slot or at the end of the file.
+     */
+    bool Append(std::string_view record);
+
+    /**
+     * @brief Replaces the record with the same key.
+     * @param record The new record payload, comma separated, with its key in the key field of the index.
+     * @return true if the record was replaced, false if the key is unknown or a write failed.
+     * @pre The file is open.
+     * @post A record of the same length is overwritten in place; otherwise the new record is stored like an
+     * appended one and the old one becomes a free slot.
+     */
+    bool Update(std::string_view record);
+
+    /**
+     * @brief Deletes the record with a key.
+     * @param key The primary key.
+     * @return true if the record was deleted, false if the key is unknown or a write failed.
+     * @pre The file is open.
+     * @post The record is a tombstone on the avail list and the key is erased from the index.
+     */
+    bool Delete(std::string_view key);
+
+    /**
+     * @brief Number of free slots on the avail list.
+     */
+    std::size_t freeSlots() const;
+
+    /**
+     * @brief Bytes held by the free slots, length indicators included.
+     */
+    std::uint64_t freeBytes() const;
+
+    /**
+     * @brief File offset at which an appended record would start.
+     */
+    std::uint64_t endOffset() const;
+
+    /**
+     * @brief Closes the data file.
+     * @pre None.
+     * @post isOpen() returns false. The index is left open.
+     */
+    void close();
+
+private:
+    std::fstream file;              /**< The data file, open for reading and writing. */
+    PrimaryKeyIndex* index;         /**< Index kept in step with the file. */
+    LengthIndicator::Format format; /**< Format of the length indicators. */
+    std::uint64_t fileEnd;          /**< Offset just past the last record. */
+    std::multimap<std::uint64_t, std::uint64_t> avail; /**< Free slots: size in bytes to file offset. */
+    std::uint64_t availBytes;       /**< Sum of the slot sizes in 'avail'. */
+    FileLock writerLock;            /**< Writer lock of the data file, held while it is open. */
+    BufferPool::FileId poolFile;    /**< Registration of the data file with the shared pool, for Invalidate(). */
+
+    /**
+     * @brief Writes a record into the best free slot, or at the end of the file.
+     * @param record The payload.
+     * @param entry Receives the key, offset and length of the stored record.
+     * @return false if the key is unusable or a write failed.
+     */
+    bool place(std::string_view record, KeyIndexEntry& entry);
+
+    /**
+     * @brief Marks the record of an index entry deleted and puts its slot on the avail list.
+     * @return false if the write failed.
+     */
+    bool release(const KeyIndexEntry& entry);
+
+    /**
+     * @brief Writes a tombstoned record that fills 'slotBytes' bytes at 'offset' and lists it as free.
+     * @return false if the write failed.
+     */
+    bool writeFreeSlot(std::uint64_t offset, std::uint64_t slotBytes);
+
+    /**
+     * @brief Writes bytes at an offset, hands them to the operating system and drops their cached pages.
+     * @return false if the write failed.
+     */
+    bool writeAt(std::uint64_t offset, const char* data, std::size_t size);
+
+    /**
+     * @brief Finds the payload length whose record, indicator included, is exactly 'slotBytes' long.
+     * @return false if no record of at least one byte fills the slot exactly.
+     */
+    bool payloadForSlot(std::uint64_t slotBytes, std::size_t& payload) const;
+};
+
+#endif //ZIPCODES_MUTABLEDATAFILE_H
@@ -0,0 +1,288 @@
+/**
+ * @file NameIndex.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the NameIndexBuilder and NameIndex classes.
+ * @see NameIndex.h for declaration.
+ */
+
+#include "NameIndex.h"
+#include "FieldTokenizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// ---------------------------------------- NamePosting ------------------------------------------------//
+
+/**
+ * @brief The primary key without its zero padding.
+ */
+std::string_view NamePosting::Key() const {
+    const void* end = std::memchr(key, '\0', sizeof(key));
+    return std::string_view(key, end == nullptr ? sizeof(key) : static_cast<const char*>(end) - key);
+}
+
+// -------------------------------------- NameIndexBuilder ---------------------------------------------//
+
+/**
+ * @brief Constructor.
+ * @param keyField Field of a record that holds its key.
+ */
+NameIndexBuilder::NameIndexBuilder(std::size_t keyField) : keyField(keyField) {
+}
+
+/**
+ * @brief Adds the place described by one record.
+ * @param record The record payload.
+ * @param offset File offset of the record's length indicator.
+ * @return true if the record had a key, a name and a latitude, false otherwise.
+ */
+bool NameIndexBuilder::AddRecord(std::string_view record, std::uint64_t offset) {
+    FieldViews fields;
+    FieldTokenizer::Tokenize(record, fields);
+    if (fields.size() <= std::max(NameIndex::LATITUDE_FIELD, keyField)) {
+        return false;
+    }
+    KeyIndexEntry keyEntry;
+    std::string name = NameIndex::Normalize(fields[NameIndex::NAME_FIELD]);
+    if (fields[keyField].empty() || name.empty() || !keyEntry.SetKey(fields[keyField])) {
+        return false;
+    }
+    // strtof needs a terminated string; latitudes are short, so a stack copy is enough.
+    char latitudeText[32] = {};
+    std::string_view latitudeField = fields[NameIndex::LATITUDE_FIELD];
+    std::memcpy(latitudeText, latitudeField.data(), std::min(latitudeField.size(), sizeof(latitudeText) - 1));
+    char* end = nullptr;
+    const float latitude = std::strtof(latitudeText, &end);
+    if (end == latitudeText) {
+        return false;
+    }
+
+    NamePosting posting;
+    std::memcpy(posting.key, keyEntry.key, sizeof(posting.key));
+    posting.offset = offset;
+    posting.length = static_cast<std::uint32_t>(record.size());
+    posting.latitude = latitude;
+    places[name].push_back(posting);
+    postingCount++;
+    return true;
+}
+
+/**
+ * @brief Writes the collected postings as a name index file.
+ * @param fileName Name of the index file to create.
+ * @return true if the file was written, false otherwise.
+ */
+bool NameIndexBuilder::Write(const std::string& fileName) const {
+    std::size_t bucketCount = 2;
+    while (bucketCount < places.size() * 2) {
+        bucketCount *= 2;
+    }
+    std::vector<NameIndex::Bucket> buckets(bucketCount, NameIndex::Bucket{0, 0, 0, 0, 0});
+    std::vector<NamePosting> postings;
+    postings.reserve(postingCount);
+    std::string names;
+
+    for (const auto& place : places) {
+        const std::string& name = place.first;
+        std::vector<NamePosting> run = place.second;
+        std::sort(run.begin(), run.end(), [](const NamePosting& a, const NamePosting& b) {
+            return a.latitude < b.latitude;
+        });
+        NameIndex::Bucket bucket;
+        bucket.hash = NameIndex::Hash(name);
+        bucket.nameOffset = static_cast<std::uint32_t>(names.size());
+        bucket.nameLength = static_cast<std::uint32_t>(name.size());
+        bucket.firstPosting = static_cast<std::uint32_t>(postings.size());
+        bucket.postingCount = static_cast<std::uint32_t>(run.size());
+        names += name;
+        postings.insert(postings.end(), run.begin(), run.end());
+
+        std::size_t slot = bucket.hash & (bucketCount - 1);
+        while (buckets[slot].postingCount != 0) {
+            slot = (slot + 1) & (bucketCount - 1);
+        }
+        buckets[slot] = bucket;
+    }
+
+    NameIndex::FileHeader header;
+    std::memcpy(header.magic, NameIndex::MAGIC, sizeof(header.magic));
+    header.version = NameIndex::VERSION;
+    header.byteOrder = NameIndex::BYTE_ORDER_MARK;
+    header.bucketCount = bucketCount;
+    header.postingCount = postings.size();
+    header.namesSize = names.size();
+
+    std::ofstream indexFile(fileName, std::ios::binary | std::ios::trunc);
+    if (!indexFile.is_open()) {
+        std::cerr << "Error: Failed to open the name index file for writing." << std::endl;
+        return false;
+    }
+    indexFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    indexFile.write(reinterpret_cast<const char*>(buckets.data()),
+                    static_cast<std::streamsize>(buckets.size() * sizeof(NameIndex::Bucket)));
+    indexFile.write(reinterpret_cast<const char*>(postings.data()),
+                    static_cast<std::streamsize>(postings.size() * sizeof(NamePosting)));
+    indexFile.write(names.data(), static_cast<std::streamsize>(names.size()));
+    return static_cast<bool>(indexFile);
+}
+
+std::size_t NameIndexBuilder::size() const {
+    return postingCount;
+}
+
+// ----------------------------------------- NameIndex -------------------------------------------------//
+
+/**
+ * @brief Default constructor. No index file is open.
+ */
+NameIndex::NameIndex() : buckets(nullptr), bucketMask(0), postings(nullptr), names(nullptr) {
+}
+
+/**
+ * @brief Maps a name index file and validates its header.
+ * @param fileName Name of the index file.
+ * @return true if the file is a valid name index for this host, false otherwise.
+ */
+bool NameIndex::Open(const std::string& fileName) {
+    close();
+    if (!file.Open(fileName)) {
+        return false;
+    }
+    FileHeader header;
+    bool valid = file.size() >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, file.data(), sizeof(header));
+        const std::uint64_t expected = sizeof(header) + header.bucketCount * sizeof(Bucket)
+                                       + header.postingCount * sizeof(NamePosting) + header.namesSize;
+        valid = std::memcmp(header.magic, MAGIC, sizeof(header.magic)) == 0
+                && header.version == VERSION
+                && header.byteOrder == BYTE_ORDER_MARK
+                && header.bucketCount >= 2
+                && (header.bucketCount & (header.bucketCount - 1)) == 0
+                && expected == file.size();
+    }
+    if (!valid) {
+        std::cerr << "Error: " << fileName << " is not a version " << VERSION << " name index." << std::endl;
+        close();
+        return false;
+    }
+    const char* base = file.data() + sizeof(header);
+    buckets = reinterpret_cast<const Bucket*>(base);
+    bucketMask = static_cast<std::size_t>(header.bucketCount - 1);
+    base += header.bucketCount * sizeof(Bucket);
+    postings = reinterpret_cast<const NamePosting*>(base);
+    base += header.postingCount * sizeof(NamePosting);
+    names = base;
+    file.AdviseRandom();
+    return true;
+}
+
+bool NameIndex::isOpen() const {
+    return file.isOpen();
+}
+
+/**
+ * @brief Finds every place with the given name.
+ * @param name The place name, in any case and spacing.
+ * @param first Receives the first posting, sorted by latitude.
+ * @param count Receives the number of postings.
+ * @return true if the name is in the index, false otherwise.
+ */
+bool NameIndex::Find(std::string_view name, const NamePosting*& first, std::size_t& count) const {
+    if (!isOpen()) {
+        return false;
+    }
+    const std::string normalized = Normalize(name);
+    const std::uint32_t hash = Hash(normalized);
+    for (std::size_t slot = hash & bucketMask; buckets[slot].postingCount != 0; slot = (slot + 1) & bucketMask) {
+        const Bucket& bucket = buckets[slot];
+        if (bucket.hash == hash
+            && std::string_view(names + bucket.nameOffset, bucket.nameLength) == normalized) {
+            first = postings + bucket.firstPosting;
+            count = bucket.postingCount;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Finds the place with the given name whose latitude is closest to 'latitude'.
+ * @param name The place name, in any case and spacing.
+ * @param latitude The latitude of the place.
+ * @param posting Receives the matching posting.
+ * @param accept If set, only the postings for which it returns true are considered.
+ * @return true if an accepted place of that name lies within LATITUDE_TOLERANCE of 'latitude', false otherwise.
+ */
+bool NameIndex::Find(std::string_view name, float latitude, NamePosting& posting,
+                     const std::function<bool(const NamePosting&)>& accept) const {
+    const NamePosting* first = nullptr;
+    std::size_t count = 0;
+    if (!Find(name, first, count)) {
+        return false;
+    }
+    // Postings are sorted by latitude: the candidates are the run within the tolerance of 'latitude'.
+    const NamePosting* last = first + count;
+    const NamePosting* candidate = std::lower_bound(first, last, latitude - LATITUDE_TOLERANCE,
+                                                    [](const NamePosting& p, float value) {
+        return p.latitude < value;
+    });
+    const NamePosting* best = nullptr;
+    for (; candidate != last && candidate->latitude <= latitude + LATITUDE_TOLERANCE; ++candidate) {
+        if ((best == nullptr || std::fabs(candidate->latitude - latitude) < std::fabs(best->latitude - latitude))
+            && (!accept || accept(*candidate))) {
+            best = candidate;
+        }
+    }
+    if (best == nullptr) {
+        return false;
+    }
+    posting = *best;
+    return true;
+}
+
+/**
+ * @brief Normalises a place name: ASCII lower case, no surrounding blanks, single inner blanks.
+ * @param name The name to normalise.
+ * @return The normalised name.
+ */
+std::string NameIndex::Normalize(std::string_view name) {
+    std::string normalized;
+    normalized.reserve(name.size());
+    bool pendingBlank = false;
+    for (char c : name) {
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            pendingBlank = !normalized.empty();
+            continue;
+        }
+        if (pendingBlank) {
+            normalized += ' ';
+            pendingBlank = false;
+        }
+        normalized += (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+    return normalized;
+}
+
+/**
+ * @brief Hash of a normalised name (32-bit FNV-1a).
+ */
+std::uint32_t NameIndex::Hash(std::string_view normalizedName) {
+    std::uint32_t hash = 2166136261u;
+    for (char c : normalizedName) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void NameIndex::close() {
+    file.close();
+    buckets = nullptr;
+    bucketMask = 0;
+    postings = nullptr;
+    names = nullptr;
+}
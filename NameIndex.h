@@ -0,0 +1,195 @@
+/**
+ * @file NameIndex.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for classes NameIndexBuilder and NameIndex
+ * @see NameIndex.cpp for the implementation of these functions.
+ * @details
+ * This file declares the secondary index on place name. Names are normalised (ASCII lower case,
+ * surrounding blanks removed, inner runs of blanks collapsed) and stored in an open-addressing hash
+ * table. Each name owns a run of postings sorted by latitude; a posting holds the primary key, the
+ * record location and the latitude, so a place is resolved by one hash probe and a binary search on
+ * latitude to break ties between places of the same name.
+ *
+ * NameIndexBuilder collects postings while the primary index is built and writes the file.
+ * NameIndex maps the file and answers lookups in place.
+ *
+ * File layout (version 1, host byte order, checked through 'byteOrder'):
+ * - FileHeader
+ * - Bucket[bucketCount], a power of two, at most half full
+ * - NamePosting[postingCount], grouped by name and sorted by latitude within a name
+ * - the normalised names, back to back
+ *
+ * Assumptions:
+ * - The place name is field NAME_FIELD and the latitude field LATITUDE_FIELD of a record. The key stored
+ *   with a posting is taken from the field given to the builder, the primary key field of the file.
+ */
+
+#ifndef ZIPCODES_NAMEINDEX_H
+#define ZIPCODES_NAMEINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "KeyIndexFile.h"
+#include "MappedFile.h"
+
+/**
+ * @brief One place in the name index.
+ */
+struct NamePosting {
+    char key[KeyIndexEntry::KEY_WIDTH]; /**< Primary key of the record, padded with zero bytes. */
+    std::uint64_t offset;               /**< File offset of the record's length indicator. */
+    std::uint32_t length;               /**< Payload length of the record in bytes. */
+    float latitude;                     /**< Latitude of the place. */
+
+    /**
+     * @brief The primary key without its zero padding.
+     */
+    std::string_view Key() const;
+};
+
+static_assert(sizeof(NamePosting) == 32, "NamePosting must stay 32 bytes wide");
+
+class NameIndexBuilder {
+public:
+    /**
+     * @brief Constructor.
+     * @param keyField Field of a record that holds its key, PrimaryKeyIndex::KeyFieldOf() of the data file.
+     * @pre None.
+     * @post size() returns 0.
+     */
+    explicit NameIndexBuilder(std::size_t keyField = 0);
+
+    /**
+     * @brief Adds the place described by one record.
+     * @param record The record payload.
+     * @param offset File offset of the record's length indicator.
+     * @return true if the record had a key, a name and a latitude, false otherwise.
+     * @pre None.
+     * @post The place is part of the next Write().
+     */
+    bool AddRecord(std::string_view record, std::uint64_t offset);
+
+    /**
+     * @brief Writes the collected postings as a name index file.
+     * @param fileName Name of the index file to create.
+     * @return true if the file was written, false otherwise.
+     * @pre None.
+     * @post 'fileName' holds an index that NameIndex::Open() accepts.
+     */
+    bool Write(const std::string& fileName) const;
+
+    std::size_t size() const;
+
+private:
+    std::unordered_map<std::string, std::vector<NamePosting>> places; /**< Postings by normalised name. */
+    std::size_t postingCount = 0;                                      /**< Number of postings collected. */
+    std::size_t keyField;                                              /**< Field of a record that holds its key. */
+};
+
+class NameIndex {
+public:
+    static constexpr std::size_t NAME_FIELD = 1;     /**< Field holding the place name. */
+    static constexpr std::size_t LATITUDE_FIELD = 4; /**< Field holding the latitude. */
+    static constexpr float LATITUDE_TOLERANCE = 0.0001f; /**< Largest latitude difference accepted as a match. */
+
+    /**
+     * @brief Default constructor. No index file is open.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    NameIndex();
+
+    /**
+     * @brief Maps a name index file and validates its header.
+     * @param fileName Name of the index file.
+     * @return true if the file is a valid name index for this host, false otherwise.
+     * @pre None.
+     * @post On success the lookups search the mapping in place.
+     */
+    bool Open(const std::string& fileName);
+
+    bool isOpen() const;
+
+    /**
+     * @brief Finds every place with the given name.
+     * @param name The place name, in any case and spacing.
+     * @param first Receives the first posting, sorted by latitude.
+     * @param count Receives the number of postings.
+     * @return true if the name is in the index, false otherwise.
+     * @pre The index is open.
+     * @post The postings stay valid while the index is open.
+     */
+    bool Find(std::string_view name, const NamePosting*& first, std::size_t& count) const;
+
+    /**
+     * @brief Finds the place with the given name whose latitude is closest to 'latitude'.
+     * @param name The place name, in any case and spacing.
+     * @param latitude The latitude of the place.
+     * @param posting Receives the matching posting.
+     * @param accept If set, only the postings for which it returns true are considered.
+     * @return true if an accepted place of that name lies within LATITUDE_TOLERANCE of 'latitude', false otherwise.
+     * @pre The index is open.
+     * @post 'posting' is updated only when true is returned.
+     */
+    bool Find(std::string_view name, float latitude, NamePosting& posting,
+              const std::function<bool(const NamePosting&)>& accept = nullptr) const;
+
+    /**
+     * @brief Normalises a place name: ASCII lower case, no surrounding blanks, single inner blanks.
+     * @param name The name to normalise.
+     * @return The normalised name.
+     */
+    static std::string Normalize(std::string_view name);
+
+    /**
+     * @brief Hash of a normalised name (32-bit FNV-1a).
+     */
+    static std::uint32_t Hash(std::string_view normalizedName);
+
+    void close();
+
+private:
+    friend class NameIndexBuilder;
+
+    /**
+     * @brief On-disk header of a name index file.
+     */
+    struct FileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byteOrder;
+        std::uint64_t bucketCount;
+        std::uint64_t postingCount;
+        std::uint64_t namesSize;
+    };
+
+    /**
+     * @brief One slot of the hash table. An empty slot has postingCount zero.
+     */
+    struct Bucket {
+        std::uint32_t hash;
+        std::uint32_t nameOffset;
+        std::uint32_t nameLength;
+        std::uint32_t firstPosting;
+        std::uint32_t postingCount;
+    };
+
+    static constexpr char MAGIC[8] = {'Z', 'I', 'P', 'N', 'I', 'D', 'X', '\0'};
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    MappedFile file;               /**< Mapping of the whole index file. */
+    const Bucket* buckets;         /**< Hash table inside the mapping. */
+    std::size_t bucketMask;        /**< bucketCount - 1. */
+    const NamePosting* postings;   /**< Postings inside the mapping. */
+    const char* names;             /**< Normalised names inside the mapping. */
+};
+
+#endif //ZIPCODES_NAMEINDEX_H
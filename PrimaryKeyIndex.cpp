@@ -7,6 +7,12 @@
 
 #include "PrimaryKeyIndex.h"
 #include "CSVReader.h"
+#include "DataFileBuilder.h"
+#include "FieldTokenizer.h"
+#include "MappedDataFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
@@ -14,124 +20,669 @@
  * @brief Default constructor for PrimaryKeyIndex.
  * @details Initializes any member variables if necessary.
  */
-PrimaryKeyIndex::PrimaryKeyIndex() {
-    // Constructor: You can initialize any member variables here.
+PrimaryKeyIndex::PrimaryKeyIndex()
+        : indexOffset(0), indexZipKeys(false), keyField(0), dataFile(BufferPool::NO_FILE), dataFormat(LengthIndicator::DEFAULT) {
+}
+
+/**
+ * @brief Closes the data file opened by OpenDataFile().
+ */
+PrimaryKeyIndex::~PrimaryKeyIndex() {
+    if (dataFile != BufferPool::NO_FILE) {
+        BufferPool::Shared().CloseFile(dataFile);
+    }
 }
 
 /**
  * @brief Builds a primary key index based on a given file.
  * @param filename The name of the file to be indexed.
+ * @param format Format of the length indicators of the data file.
  * @return A map representing the primary key index.
+ * @details Each key maps to the offset of its record's length indicator. The file is scanned through
+ * a MappedDataFile when it can be mapped, otherwise through CSVReader::ReadFromFile.
  */
-std::map<std::string, std::streampos> PrimaryKeyIndex::BuildIndex(std::string filename) {
+std::map<std::string, std::streampos> PrimaryKeyIndex::BuildIndex(std::string filename, LengthIndicator::Format format) {
+    std::map<std::string, std::streampos> primaryKeyIndex;
+
+    // Preferred path: scan the mapped file, the records are never copied out of the mapping.
+    MappedDataFile dataFile;
+    if (dataFile.Open(filename, 0, format)) {
+        dataFile.mapping().AdviseSequential();
+        for (const RecordView& record : dataFile) {
+            std::string_view key = FieldTokenizer::ExtractField(record.data, 0);
+            if (!key.empty()) {
+                primaryKeyIndex[std::string(key)] = static_cast<std::streamoff>(record.offset);
+            }
+        }
+        return primaryKeyIndex;
+    }
+
+    // Fallback path for hosts or files that cannot be mapped.
     std::ifstream inputFile(filename, std::ios::binary);
     if (!inputFile) {
         std::cerr << "Failed to open input file." << std::endl;
         return std::map<std::string, std::streampos>();;
     }
 
-    std::map<std::string, std::streampos> primaryKeyIndex;
-
     while (inputFile) {
-        std::pair<std::size_t, std::string> record = CSVReader::ReadFromFile(inputFile);
+        std::streampos currentRecordPos = inputFile.tellg();
+        std::pair<std::size_t, std::string> record = CSVReader::ReadFromFile(inputFile, format);
         std::size_t size = record.first;
         std::string data = record.second;
         if (size == 0) {
             break; // End of file reached
         }
+        if (MappedDataFile::IsTombstone(data)) {
+            continue;
+        }
 
-        std::vector<std::string> parsedRecord = CSVReader::ParseLine(data);
+        std::string_view key = FieldTokenizer::ExtractField(data, 0);
+        if (!key.empty()) {
+            primaryKeyIndex[std::string(key)] = currentRecordPos;
+        }
+    }
+    return primaryKeyIndex;
+}
 
-        if (!parsedRecord.empty()) {
-            std::string key = parsedRecord[0];
+/**
+ * @brief Builds the entries of the binary primary key index.
+ * @param filename The name of the file to be indexed.
+ * @param names Optional place name index builder fed from the same pass.
+ * @param points Optional spatial index builder fed from the same pass.
+ * @param format Format of the length indicators of the data file.
+ * @param keyField Field the keys are taken from.
+ * @param dataOffset Offset of the first record.
+ * @param dataSize Bytes of records after 'dataOffset', or MappedDataFile::TO_END_OF_FILE.
+ * @return One entry per distinct key, with the offset and payload length of its record, or no entries if a
+ * key is longer than KeyIndexEntry::KEY_WIDTH bytes.
+ */
+std::vector<KeyIndexEntry> PrimaryKeyIndex::BuildIndexEntries(const std::string& filename, NameIndexBuilder* names,
+                                                                SpatialIndexBuilder* points,
+                                                                LengthIndicator::Format format, std::size_t keyField,
+                                                                std::uint64_t dataOffset, std::uint64_t dataSize) {
+    std::vector<KeyIndexEntry> entries;
+    std::size_t skipped = 0;
+    std::string tooLong; // First key that does not fit an index entry.
+    auto addRecord = [&](std::string_view record, std::uint64_t offset) {
+        if (names != nullptr) {
+            names->AddRecord(record, offset);
+        }
+        if (points != nullptr) {
+            points->AddRecord(record, offset);
+        }
+        KeyIndexEntry entry;
+        if (MakeEntry(record, offset, entry, keyField)) {
+            entries.push_back(entry);
+            return;
+        }
+        const std::string_view key = FieldTokenizer::ExtractField(record, keyField);
+        if (key.empty()) {
+            skipped++;
+        } else if (tooLong.empty()) {
+            tooLong.assign(key.data(), key.size());
+        }
+    };
+
+    MappedDataFile dataFile;
+    if (dataFile.Open(filename, dataOffset, format, dataSize)) {
+        dataFile.mapping().AdviseSequential();
+        for (const RecordView& record : dataFile) {
+            addRecord(record.data, record.offset);
+        }
+    } else {
+        std::ifstream inputFile(filename, std::ios::binary);
+        if (!inputFile) {
+            std::cerr << "Failed to open input file." << std::endl;
+            return entries;
+        }
+        // The index and footer sections that follow the records are not records.
+        const std::uint64_t dataEnd = dataSize == MappedDataFile::TO_END_OF_FILE ? dataSize : dataOffset + dataSize;
+        inputFile.seekg(static_cast<std::streamoff>(dataOffset));
+        while (inputFile && static_cast<std::uint64_t>(inputFile.tellg()) < dataEnd) {
             std::streampos currentRecordPos = inputFile.tellg();
-            primaryKeyIndex[key] = currentRecordPos;
+            std::pair<std::size_t, std::string> record = CSVReader::ReadFromFile(inputFile, format);
+            if (record.first == 0) {
+                break; // End of file reached
+            }
+            if (MappedDataFile::IsTombstone(record.second)) {
+                continue;
+            }
+            addRecord(record.second, static_cast<std::uint64_t>(currentRecordPos));
         }
     }
-    return primaryKeyIndex;
+    if (!tooLong.empty()) {
+        // An index that silently lacks some keys would answer "not found" for records that exist.
+        std::cerr << "Error: The key \"" << tooLong << "\" of " << filename << " is longer than "
+                  << KeyIndexEntry::KEY_WIDTH << " bytes; no index was built." << std::endl;
+        entries.clear();
+        return entries;
+    }
+    if (skipped > 0) {
+        std::cerr << skipped << " records with an empty key were not indexed." << std::endl;
+    }
+
+    KeepLastOfEachKey(entries);
+    return entries;
+}
+
+/**
+ * @brief Fills the index entry of one record.
+ * @param record The record payload.
+ * @param offset File offset of the record's length indicator.
+ * @param entry Receives the entry.
+ * @param keyField Field of the record that holds its key.
+ * @return false if the key is empty or longer than KeyIndexEntry::KEY_WIDTH.
+ */
+bool PrimaryKeyIndex::MakeEntry(std::string_view record, std::uint64_t offset, KeyIndexEntry& entry,
+                                std::size_t keyField) {
+    std::string_view key = FieldTokenizer::ExtractField(record, keyField);
+    if (key.empty() || !entry.SetKey(key)) {
+        return false;
+    }
+    entry.offset = offset;
+    entry.length = static_cast<std::uint32_t>(record.size());
+    entry.reserved = 0;
+    return true;
+}
+
+/**
+ * @brief Sorts index entries by key and drops all but the last entry of every key.
+ * @param entries The entries, in file order.
+ */
+void PrimaryKeyIndex::KeepLastOfEachKey(std::vector<KeyIndexEntry>& entries) {
+    // Keep the last record of every key, which is what BuildIndex() does with its map.
+    std::stable_sort(entries.begin(), entries.end(), [](const KeyIndexEntry& a, const KeyIndexEntry& b) {
+        return std::memcmp(a.key, b.key, KeyIndexEntry::KEY_WIDTH) < 0;
+    });
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        const bool lastOfKey = i + 1 == entries.size()
+                               || std::memcmp(entries[i].key, entries[i + 1].key, KeyIndexEntry::KEY_WIDTH) != 0;
+        if (lastOfKey) {
+            entries[kept++] = entries[i];
+        }
+    }
+    entries.resize(kept);
+}
+
+/**
+ * @brief Field of a record that holds its key, as recorded in a header record.
+ * @param header The header record of the data file.
+ * @return HeaderRecord::getPrimaryKeyOrdinality(), or 0 if it is negative.
+ */
+std::size_t PrimaryKeyIndex::KeyFieldOf(const HeaderRecord& header) {
+    return header.getPrimaryKeyOrdinality() > 0 ? static_cast<std::size_t>(header.getPrimaryKeyOrdinality()) : 0;
 }
 
 /**
- * @brief Reads a primary key index from a given file.
+ * @brief Reads a binary primary key index into a map.
  * @param fileName The name of the index file.
  * @return A map representing the primary key index.
  */
 std::map<std::string, std::streampos> PrimaryKeyIndex::ReadIndex(const std::string& fileName) {
     std::map<std::string, std::streampos> primaryKeyIndex;
+    KeyIndexFile binaryIndex;
+    if (!binaryIndex.Open(fileName)) {
+        std::cerr << "Error: Failed to open the index file for reading." << std::endl;
+        return primaryKeyIndex;
+    }
+    for (const KeyIndexEntry& entry : binaryIndex) {
+        primaryKeyIndex.emplace_hint(primaryKeyIndex.end(), std::string(entry.Key()),
+                                     static_cast<std::streamoff>(entry.offset));
+    }
+    return primaryKeyIndex;
+}
 
-    // Open the file for reading
-    std::ifstream indexFile(fileName);
-    if (indexFile.is_open()) {
-        std::string line;
-        while (std::getline(indexFile, line)) {
-            std::string key;
-            std::streampos value;
-
-            // Split the line into key and value using a space
-            size_t spacePos = line.find(' ');
-            if (spacePos != std::string::npos) {
-                key = line.substr(0, spacePos);
-                value = std::stoll(line.substr(spacePos + 1));
-                primaryKeyIndex[key] = value;
-            }
+/**
+ * @brief Writes the primary key index as a binary, memory-mappable file.
+ * @param entries The index entries, in any order.
+ * @param fileName Name of the index file to write.
+ * @return true if the index was written, false otherwise.
+ */
+bool PrimaryKeyIndex::WriteIndex(const std::vector<KeyIndexEntry>& entries, const std::string& fileName) {
+    if (!KeyIndexFile::Write(fileName, entries)) {
+        return false;
+    }
+    // Reported on stderr, so the answers of batch mode on stdout are not mixed with it.
+    std::cerr << "Index written to " << fileName << std::endl;
+    return true;
+}
+
+/**
+ * @brief Writes the primary key index as a paged B+ tree.
+ * @param entries The index entries, in any order.
+ * @param fileName Name of the tree file to write.
+ * @param keyField Field the keys were taken from.
+ * @return true if the tree was written, false otherwise.
+ */
+bool PrimaryKeyIndex::WriteIndexTree(const std::vector<KeyIndexEntry>& entries, const std::string& fileName,
+                                     std::uint32_t keyField) {
+    if (!BPlusTree::Build(fileName, entries, keyField)) {
+        return false;
+    }
+    std::cerr << "Index written to " << fileName << std::endl;
+    return true;
+}
+
+/**
+ * @brief Writes the primary key index in the form that suits its size.
+ * @param entries The index entries.
+ * @param indexFileName Name of the binary index file, written for fewer than TREE_MIN_KEYS keys.
+ * @param treeFileName Name of the tree file, written for TREE_MIN_KEYS keys or more.
+ * @param keyField Field the keys were taken from.
+ * @return true if the index was written, false otherwise.
+ */
+bool PrimaryKeyIndex::WriteIndexFor(const std::vector<KeyIndexEntry>& entries, const std::string& indexFileName,
+                                    const std::string& treeFileName, std::size_t keyField) {
+    // A flat index only stays cheap while its keys fit in memory; past that the tree reads a few pages per lookup.
+    if (entries.size() >= TREE_MIN_KEYS) {
+        if (!WriteIndexTree(entries, treeFileName, static_cast<std::uint32_t>(keyField))) {
+            return false;
         }
-        // Close the file
-        indexFile.close();
-        std::cout << "Opened the index file for reading." << std::endl;
-        return primaryKeyIndex;
-    } else {
-        std::cerr << "Error: Failed to open the index file for reading." << std::endl;
+        std::remove(indexFileName.c_str());
+        std::remove((indexFileName + LOG_SUFFIX).c_str());
+        return true;
+    }
+    // The flat index records no key field; a header record with a primary key ordinality names it.
+    if (!WriteIndex(entries, indexFileName)) {
+        return false;
     }
+    std::remove(treeFileName.c_str());
+    return true;
 }
 
 /**
- * @brief Writes the primary key index to a file.
+ * @brief Writes the primary key index as text "key offset" lines, for debugging only.
  * @param primaryKeyIndex A map representing the primary key index.
+ * @param fileName Name of the text file to write.
  * @pre The map primaryKeyIndex is correctly populated.
- * @post The index is written to the file "KeyIndex.txt".
+ * @post The index is written to 'fileName'.
  */
-void PrimaryKeyIndex::WriteIndex(const std::map<std::string, std::streampos> primaryKeyIndex) {
-    // Implement the logic to write the primary key index to a file
+void PrimaryKeyIndex::ExportIndexText(const std::map<std::string, std::streampos>& primaryKeyIndex,
+                                      const std::string& fileName) {
     // Open the file for writing
-    std::ofstream indexFile("KeyIndex.txt");
+    std::ofstream indexFile(fileName);
     if (indexFile.is_open()) {
         // Iterate through the map and write key-value pairs to the file
         for (const auto& pair : primaryKeyIndex) {
-            indexFile << pair.first << " " << pair.second << std::endl;
+            indexFile << pair.first << " " << pair.second << '\n';
         }
         // Close the file
         indexFile.close();
-        std::cout << "Index written to index.txt" << std::endl;
+        std::cerr << "Index exported to " << fileName << std::endl;
     } else {
         std::cerr << "Error: Failed to open the index file for writing." << std::endl;
     }
 }
 
+/**
+ * @brief Maps a binary index file for lookups.
+ * @param fileName Name of the binary index file.
+ * @param zipKeys When true the keys are also loaded into a ZipKeyIndex.
+ * @param sectionOffset Offset of the index inside the file.
+ * @param keyField Field of a record that holds its key.
+ * @return true if the index was opened, false otherwise.
+ */
+bool PrimaryKeyIndex::OpenIndex(const std::string& fileName, bool zipKeys, std::uint64_t sectionOffset,
+                                std::size_t keyField) {
+    indexTree.close();
+    this->keyField = keyField;
+    keyTable.clear();
+    delta.clear();
+    deltaLog.close();
+    indexName = fileName;
+    indexOffset = sectionOffset;
+    indexZipKeys = zipKeys;
+    if (!indexFile.Open(fileName, sectionOffset)) {
+        return false;
+    }
+    if (zipKeys) {
+        keyTable.Build(indexFile.begin(), indexFile.end());
+    }
+    // Changes made since the index file was written; a later entry for a key replaces an earlier one.
+    return KeyIndexLog::Replay(fileName + LOG_SUFFIX, [this](const KeyIndexEntry& entry) {
+        delta[deltaKey(entry.Key())] = entry;
+    });
+}
+
+/**
+ * @brief Opens a B+ tree index for lookups, in place of an index opened by OpenIndex().
+ * @param fileName Name of the tree file.
+ * @param writable When true, PutKey() and EraseKey() change the tree in place.
+ * @return true if the tree was opened, false otherwise.
+ */
+bool PrimaryKeyIndex::OpenIndexTree(const std::string& fileName, bool writable) {
+    indexFile.close();
+    keyTable.clear();
+    delta.clear();
+    deltaLog.close();
+    indexName.clear();
+    indexOffset = 0;
+    if (!indexTree.Open(fileName, writable)) {
+        keyField = 0;
+        return false;
+    }
+    keyField = indexTree.keyField();
+    return true;
+}
+
+/**
+ * @brief Opens the primary key index of a data file, whichever form it was written in.
+ * @param dataFileName Name of the data file.
+ * @param header The header record of the data file.
+ * @param indexFileName Name of the binary index file.
+ * @param treeFileName Name of the tree file.
+ * @return true if an index was opened, false otherwise.
+ */
+bool PrimaryKeyIndex::OpenIndexFor(const std::string& dataFileName, const HeaderRecord& header,
+                                   const std::string& indexFileName, const std::string& treeFileName) {
+    const FileSection& embedded = header.getIndexSection();
+    if (embedded.size > 0) {
+        return OpenIndex(dataFileName, true, embedded.offset, KeyFieldOf(header));
+    }
+    // WriteIndexFor() leaves only one of the two files, so a tree that opens is the current index.
+    return OpenIndexTree(treeFileName) || OpenIndex(indexFileName, true, 0, KeyFieldOf(header));
+}
+
+/**
+ * @brief Field of a record that holds its key, as given to OpenIndex() or recorded in the tree.
+ */
+std::size_t PrimaryKeyIndex::primaryKeyField() const {
+    return keyField;
+}
+
+/**
+ * @brief Looks a key up in the index opened by OpenIndex() or OpenIndexTree().
+ * @param key The primary key.
+ * @param entry Receives the index entry of the key.
+ * @return true if the key is in the index, false otherwise.
+ */
+bool PrimaryKeyIndex::FindKey(std::string_view key, KeyIndexEntry& entry) const {
+    if (!delta.empty()) {
+        char padded[ZipKeyIndex::ZIP_DIGITS];
+        const auto changed = delta.find(ZipKeyIndex::Canonical(key, padded));
+        if (changed != delta.end()) {
+            if (changed->second.reserved == KeyIndexLog::ERASE) {
+                return false;
+            }
+            entry = changed->second;
+            entry.reserved = 0;
+            return true;
+        }
+    }
+    if (indexTree.isOpen()) {
+        return indexTree.Find(key, entry);
+    }
+    if (keyTable.mode() != ZipKeyIndex::Mode::Empty) {
+        RecordLocation location;
+        if (!keyTable.Find(key, location) || !entry.SetKey(key)) {
+            return false;
+        }
+        entry.offset = location.offset;
+        entry.length = location.length;
+        entry.reserved = 0;
+        return true;
+    }
+    const KeyIndexEntry* found = indexFile.Find(key);
+    if (found == nullptr) {
+        return false;
+    }
+    entry = *found;
+    return true;
+}
+
+/**
+ * @brief Points a key at a record, adding the key if it is new.
+ * @param entry The key with the offset and payload length of its record.
+ * @return true if the change was logged, false otherwise.
+ */
+bool PrimaryKeyIndex::PutKey(const KeyIndexEntry& entry) {
+    if (indexTree.isOpen()) {
+        return indexTree.Insert(entry);
+    }
+    if (!openDeltaLog() || !deltaLog.Append(entry, KeyIndexLog::PUT)) {
+        return false;
+    }
+    KeyIndexEntry& changed = delta[deltaKey(entry.Key())];
+    changed = entry;
+    changed.reserved = KeyIndexLog::PUT;
+    return true;
+}
+
+/**
+ * @brief Removes a key from the index.
+ * @param key The primary key.
+ * @return true if the key was in the index and its removal was logged, false otherwise.
+ */
+bool PrimaryKeyIndex::EraseKey(std::string_view key) {
+    if (indexTree.isOpen()) {
+        return indexTree.Erase(key);
+    }
+    KeyIndexEntry entry;
+    if (!FindKey(key, entry) || !openDeltaLog() || !deltaLog.Append(entry, KeyIndexLog::ERASE)) {
+        return false;
+    }
+    KeyIndexEntry& changed = delta[deltaKey(key)];
+    changed = entry;
+    changed.reserved = KeyIndexLog::ERASE;
+    return true;
+}
+
+/**
+ * @brief Merges the delta log into the index file and empties the log.
+ * @return true if the index file was rewritten, or there was nothing to merge; false otherwise.
+ */
+bool PrimaryKeyIndex::Checkpoint() {
+    if (delta.empty()) {
+        return true;
+    }
+    if (!openDeltaLog()) {
+        return false;
+    }
+    std::vector<KeyIndexEntry> merged;
+    merged.reserve(indexFile.size() + delta.size());
+    for (const KeyIndexEntry& entry : indexFile) {
+        if (delta.find(deltaKey(entry.Key())) == delta.end()) {
+            merged.push_back(entry);
+        }
+    }
+    for (const auto& changed : delta) {
+        if (changed.second.reserved == KeyIndexLog::PUT) {
+            merged.push_back(changed.second);
+            merged.back().reserved = 0;
+        }
+    }
+    // Written beside the index and renamed over it, so readers never map a half-written index. The merged
+    // file reaches the disk before the rename publishes it, and the rename before the log is emptied.
+    const std::string tempName = indexName + ".tmp";
+    const std::string::size_type slash = indexName.find_last_of('/');
+    const std::string directory = slash == std::string::npos ? std::string(".") : indexName.substr(0, slash + 1);
+    if (!KeyIndexFile::Write(tempName, std::move(merged)) || !DataFileBuilder::SyncPath(tempName)
+        || std::rename(tempName.c_str(), indexName.c_str()) != 0 || !DataFileBuilder::SyncPath(directory)) {
+        std::cerr << "Error: Failed to rewrite the index file " << indexName << "." << std::endl;
+        std::remove(tempName.c_str());
+        return false;
+    }
+    // The merged file already holds the logged changes, so replaying a log that survives a crash here is harmless.
+    keyTable.clear();
+    if (!indexFile.Open(indexName)) {
+        return false;
+    }
+    if (indexZipKeys) {
+        keyTable.Build(indexFile.begin(), indexFile.end());
+    }
+    delta.clear();
+    return deltaLog.Reset();
+}
+
+/**
+ * @brief Number of keys changed since the index file was written.
+ */
+std::size_t PrimaryKeyIndex::deltaSize() const {
+    return delta.size();
+}
+
+/**
+ * @brief Key of 'delta' for a primary key: its ZipKeyIndex::Canonical() form.
+ */
+std::string PrimaryKeyIndex::deltaKey(std::string_view key) {
+    char padded[ZipKeyIndex::ZIP_DIGITS];
+    return std::string(ZipKeyIndex::Canonical(key, padded));
+}
+
+/**
+ * @brief Opens the delta log for appending the first change.
+ * @return false if the index is embedded in a data file or the log cannot be opened.
+ */
+bool PrimaryKeyIndex::openDeltaLog() {
+    if (deltaLog.isOpen()) {
+        return true;
+    }
+    if (indexName.empty() || indexOffset != 0) {
+        std::cerr << "Error: Only a stand-alone index file can be changed." << std::endl;
+        return false;
+    }
+    return deltaLog.Open(indexName + LOG_SUFFIX);
+}
+
+/**
+ * @brief Opens the data file that the index points into.
+ * @param fileName Name of the length-indicated data file.
+ * @param format Format of its length indicators.
+ * @return true if the data file was opened, false otherwise.
+ */
+bool PrimaryKeyIndex::OpenDataFile(const std::string& fileName, LengthIndicator::Format format) {
+    dataFormat = format;
+    BufferPool& pool = BufferPool::Shared();
+    if (dataFile != BufferPool::NO_FILE) {
+        pool.CloseFile(dataFile);
+    }
+    dataFile = pool.OpenFile(fileName);
+    if (dataFile == BufferPool::NO_FILE) {
+        std::cerr << "Error: Failed to open the data file " << fileName << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
 /**
  * @brief Searches for a record in the primary key index.
- * @param recordIndex A map representing the primary key index.
- * @param filename The name of the file where the records are stored.
+ * @param key The primary key of the record.
+ * @param record Receives the record payload.
  * @return True if the record is found, false otherwise.
  */
-bool PrimaryKeyIndex::SearchIndex(const std::map<std::string,std::string> recordIndex,std::string filename) {
-    std::ifstream inputFile(filename, std::ios::binary);
-    // Implement the logic to search for a record in the index
-    // Implement the logic to read the primary key index from a file
-    std::string targetRecordId = "zipCode"; // The ID of the record you want to access
-    //std::streampos targetPosition = recordIndex[targetRecordId];
+bool PrimaryKeyIndex::SearchIndex(std::string_view key, std::string& record) const {
+    KeyIndexEntry entry;
+    if (!FindKey(key, entry)) {
+        return false;
+    }
+    // The index knows the payload length, and with it the width of the length indicator, so the
+    // indicator and the payload arrive in one read.
+    std::string buffer(LengthIndicator::Size(entry.length, dataFormat) + entry.length, '\0');
+    if (!readAt(entry.offset, &buffer[0], buffer.size())) {
+        return false;
+    }
+    if (!unpackAt(buffer.data(), buffer.size(), entry, record)) {
+        std::cerr << "Error: index entry for " << key << " does not match the data file." << std::endl;
+        return false;
+    }
+    return true;
+}
 
-// Move to the specified position in the file, accounting for the length indicator
-    //inputFile.seekg(targetPosition + lengthIndicatorSize);
+/**
+ * @brief Searches for many records at once.
+ * @param keys The primary keys to resolve.
+ * @return The (key, record) pairs of the keys that were found, in the order of 'keys'.
+ */
+std::vector<std::pair<std::string, std::string>>
+PrimaryKeyIndex::SearchIndexBatch(const std::vector<std::string>& keys) const {
+    struct Pending {
+        std::size_t keyPosition;
+        KeyIndexEntry entry;
+    };
+    std::vector<Pending> pending;
+    pending.reserve(keys.size());
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        Pending p;
+        p.keyPosition = i;
+        if (FindKey(keys[i], p.entry)) {
+            pending.push_back(p);
+        }
+    }
+    std::sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) {
+        return a.entry.offset < b.entry.offset;
+    });
+
+    std::vector<std::string> records(keys.size());
+    std::vector<char> found(keys.size(), 0);
+    std::string buffer;
+    for (std::size_t first = 0; first < pending.size();) {
+        // Grow the read while the next record starts within BATCH_GAP of the current end.
+        const std::uint64_t start = pending[first].entry.offset;
+        auto recordEnd = [this](const KeyIndexEntry& entry) {
+            return entry.offset + LengthIndicator::Size(entry.length, dataFormat) + entry.length;
+        };
+        std::uint64_t end = recordEnd(pending[first].entry);
+        std::size_t last = first + 1;
+        while (last < pending.size() && pending[last].entry.offset <= end + BATCH_GAP) {
+            end = std::max<std::uint64_t>(end, recordEnd(pending[last].entry));
+            last++;
+        }
+        buffer.resize(static_cast<std::size_t>(end - start));
+        if (readAt(start, &buffer[0], buffer.size())) {
+            for (std::size_t i = first; i < last; i++) {
+                const KeyIndexEntry& entry = pending[i].entry;
+                const std::size_t at = static_cast<std::size_t>(entry.offset - start);
+                if (unpackAt(buffer.data() + at, buffer.size() - at, entry, records[pending[i].keyPosition])) {
+                    found[pending[i].keyPosition] = 1;
+                }
+            }
+        }
+        first = last;
+    }
+
+    std::vector<std::pair<std::string, std::string>> results;
+    results.reserve(pending.size());
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        if (found[i]) {
+            results.emplace_back(keys[i], std::move(records[i]));
+        }
+    }
+    return results;
+}
 
-// Read the record at the specified position
-// Read the length indicator
-    std::size_t lengthIndicator;
-    //inputFile.read(reinterpret_cast<char*>(&lengthIndicator), lengthIndicatorSize);
+/**
+ * @brief Reads 'length' bytes at 'offset' of the data file through the shared buffer pool.
+ * @return true if all bytes were read.
+ */
+bool PrimaryKeyIndex::readAt(std::uint64_t offset, char* buffer, std::size_t length) const {
+    return dataFile != BufferPool::NO_FILE && BufferPool::Shared().Read(dataFile, offset, buffer, length);
+}
 
-// Read the record data based on the length indicator
-    std::string recordData(lengthIndicator, '\0');
-    inputFile.read(&recordData[0], lengthIndicator);
-    return false; // Return true if the record is found; false otherwise
+/**
+ * @brief Extracts the payload of the record at the start of 'buffer'.
+ * @param buffer Bytes read from the offset of the index entry.
+ * @param available Bytes in 'buffer'.
+ * @param entry The index entry of the record.
+ * @param record Receives the payload.
+ * @return false if the record at the entry's offset is not the entry's live record.
+ */
+bool PrimaryKeyIndex::unpackAt(const char* buffer, std::size_t available, const KeyIndexEntry& entry,
+                               std::string& record) const {
+    std::size_t length;
+    std::size_t indicatorBytes;
+    if (!LengthIndicator::Decode(buffer, available, dataFormat, length, indicatorBytes) || length != entry.length
+        || available - indicatorBytes < length
+        || (length > 0 && buffer[indicatorBytes] == MappedDataFile::TOMBSTONE)) {
+        return false;
+    }
+    // An index older than its data file can point at a record of the same length with another key.
+    const std::string_view payload(buffer + indicatorBytes, length);
+    if (!ZipKeyIndex::SameKey(FieldTokenizer::ExtractField(payload, keyField), entry.Key())) {
+        return false;
+    }
+    record.assign(payload.data(), payload.size());
+    return true;
 }
 
 /**
@@ -141,5 +692,15 @@ bool PrimaryKeyIndex::SearchIndex(const std::map<std::string,std::string> record
  * @post The record is unpacked and displayed to the console.
  */
 void PrimaryKeyIndex::UnpackRecord(const std::string& recordData) {
-    // Implement the logic to unpack and display a record
+    static const char* const labels[] = {"Zip", "Place", "State", "County", "Latitude", "Longitude"};
+    FieldViews fields;
+    FieldTokenizer::Tokenize(recordData, fields);
+    for (std::size_t i = 0; i < fields.size(); i++) {
+        if (i < sizeof(labels) / sizeof(labels[0])) {
+            std::cout << labels[i] << ": " << fields[i] << '\n';
+        } else {
+            std::cout << "Field " << i << ": " << fields[i] << '\n';
+        }
+    }
+    std::cout.flush();
 }
@@ -12,6 +12,13 @@
  * Assumptions:
  * - The file used for indexing contains valid data.
  * - The primary key index uses a mapping between a string (as the key) and a stream position.
+ * - The persistent index is a binary KeyIndexFile; the text form is only written as a debug export.
+ * - Changes made after the index file was written live in a KeyIndexLog next to it, replayed by OpenIndex()
+ *   and merged into the index file by Checkpoint().
+ * - An index too large to keep mapped can be written as a paged BPlusTree instead, opened by OpenIndexTree().
+ *   Its changes are written into the tree in place, so it needs no delta log. WriteIndexFor() picks the form
+ *   by the number of keys and OpenIndexFor() opens whichever of the two exists.
+ * - Keys are at most KeyIndexEntry::KEY_WIDTH bytes; building an index over a longer key fails.
  * - Record data can be unpacked for display purposes using the provided methods.
  */
 
@@ -19,7 +26,23 @@
 #define ZIPCODES_PRIMARYKEYINDEX_H
 
 #include <string>
+#include <string_view>
+#include <vector>
 #include <map> // For using std::map or std::unordered_map
+#include <fstream>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include "BPlusTree.h"
+#include "BufferPool.h"
+#include "HeaderRecord.h"
+#include "KeyIndexFile.h"
+#include "KeyIndexLog.h"
+#include "LengthIndicator.h"
+#include "MappedDataFile.h"
+#include "NameIndex.h"
+#include "SpatialIndex.h"
+#include "ZipKeyIndex.h"
 
 /**
  * @brief Represents the Primary Key Index functionality.
@@ -34,41 +57,255 @@ public:
      */
     PrimaryKeyIndex();
 
+    static constexpr std::size_t TREE_MIN_KEYS = std::size_t(1) << 20; /**< Keys from which WriteIndexFor() writes a tree. */
+    static constexpr const char* LOG_SUFFIX = ".log"; /**< Appended to the index file name to name its delta log. */
+
+    PrimaryKeyIndex(const PrimaryKeyIndex&) = delete;
+    PrimaryKeyIndex& operator=(const PrimaryKeyIndex&) = delete;
+
+    /**
+     * @brief Closes the data file opened by OpenDataFile().
+     */
+    ~PrimaryKeyIndex();
+
     /**
      * @brief Builds the primary key index.
      * @param filename Name of the file to build the index from.
+     * @param format Format of the length indicators of the data file.
      * @return A map representing the primary key index.
      * @pre The file with the given filename exists and contains valid data.
      * @post The primary key index is built and returned.
      */
-    std::map<std::string, std::streampos> BuildIndex(std::string filename);
+    std::map<std::string, std::streampos> BuildIndex(std::string filename,
+                                                     LengthIndicator::Format format = LengthIndicator::DEFAULT);
 
     /**
-     * @brief Reads the primary key index from a file.
-     * @param fileName Name of the file to read the index from.
-     * @return A map representing the primary key index.
+     * @brief Builds the entries of the binary primary key index.
+     * @param filename Name of the data file to build the index from.
+     * @param names When not null, every record is also added to this place name index builder,
+     * so the secondary index is built in the same pass over the data file.
+     * @param points When not null, every record is also added to this spatial index builder.
+     * @param format Format of the length indicators of the data file.
+     * @param keyField Field the keys are taken from, HeaderRecord::getPrimaryKeyOrdinality() of the file.
+     * @param dataOffset Offset of the first record, the data section of a file with a header block.
+     * @param dataSize Bytes of records after 'dataOffset', or MappedDataFile::TO_END_OF_FILE.
+     * @return One entry per distinct key, with the offset and payload length of its record, or no entries if
+     * a key is longer than KeyIndexEntry::KEY_WIDTH bytes.
+     * @pre The file with the given filename exists and contains valid data.
+     * @post None. When a key occurs more than once the last record wins, as in BuildIndex(). Records with an
+     * empty key are skipped; a key too long to index is reported on std::cerr.
+     */
+    std::vector<KeyIndexEntry> BuildIndexEntries(const std::string& filename, NameIndexBuilder* names = nullptr,
+                                                SpatialIndexBuilder* points = nullptr,
+                                                LengthIndicator::Format format = LengthIndicator::DEFAULT,
+                                                std::size_t keyField = 0, std::uint64_t dataOffset = 0,
+                                                std::uint64_t dataSize = MappedDataFile::TO_END_OF_FILE);
+
+    /**
+     * @brief Fills the index entry of one record.
+     * @param record The record payload.
+     * @param offset File offset of the record's length indicator.
+     * @param entry Receives the entry.
+     * @param keyField Field of the record that holds its key; the first field by default.
+     * @return false if the key is empty or longer than KeyIndexEntry::KEY_WIDTH.
+     * @pre None.
+     * @post 'entry' is fully set only when true is returned.
+     */
+    static bool MakeEntry(std::string_view record, std::uint64_t offset, KeyIndexEntry& entry,
+                          std::size_t keyField = 0);
+
+    /**
+     * @brief Sorts index entries by key and drops all but the last entry of every key.
+     * @param entries The entries, in file order.
+     * @pre None.
+     * @post 'entries' is sorted and its keys are unique, as KeyIndexFile::Write() requires.
+     */
+    static void KeepLastOfEachKey(std::vector<KeyIndexEntry>& entries);
+
+    /**
+     * @brief Field of a record that holds its key, as recorded in a header record.
+     * @param header The header record of the data file.
+     * @return HeaderRecord::getPrimaryKeyOrdinality(), or 0 if it is negative.
+     */
+    static std::size_t KeyFieldOf(const HeaderRecord& header);
+
+    /**
+     * @brief Reads a binary primary key index into a map.
+     * @param fileName Name of the binary index file.
+     * @return A map representing the primary key index, empty if the file is not a valid index.
      * @pre The file with the given filename exists and contains a valid index.
      * @post The primary key index is read and returned.
+     * @details Lookups should use OpenIndex() and FindKey(), which need no load step.
      */
     std::map<std::string, std::streampos> ReadIndex(const std::string& fileName);
 
     /**
-     * @brief Writes the primary key index to a file.
+     * @brief Writes the primary key index as a binary, memory-mappable file.
+     * @param entries The index entries, in any order.
+     * @param fileName Name of the index file to write.
+     * @return true if the index was written, false otherwise.
+     * @pre None.
+     * @post 'fileName' holds a sorted KeyIndexFile.
+     */
+    bool WriteIndex(const std::vector<KeyIndexEntry>& entries, const std::string& fileName = "KeyIndex.idx");
+
+    /**
+     * @brief Writes the primary key index as a paged B+ tree.
+     * @param entries The index entries, in any order, as returned by BuildIndexEntries().
+     * @param fileName Name of the tree file to write.
+     * @param keyField Field the keys were taken from, recorded in the tree.
+     * @return true if the tree was written, false otherwise.
+     * @pre None.
+     * @post 'fileName' holds a BPlusTree that OpenIndexTree() accepts.
+     */
+    bool WriteIndexTree(const std::vector<KeyIndexEntry>& entries, const std::string& fileName = "KeyIndex.bpt",
+                        std::uint32_t keyField = 0);
+
+    /**
+     * @brief Writes the primary key index in the form that suits its size.
+     * @param entries The index entries, as returned by BuildIndexEntries().
+     * @param indexFileName Name of the binary index file, written for fewer than TREE_MIN_KEYS keys.
+     * @param treeFileName Name of the tree file, written for TREE_MIN_KEYS keys or more.
+     * @param keyField Field the keys were taken from.
+     * @return true if the index was written, false otherwise.
+     * @pre None.
+     * @post The file of the other form is removed, so OpenIndexFor() cannot open a stale index.
+     */
+    bool WriteIndexFor(const std::vector<KeyIndexEntry>& entries, const std::string& indexFileName,
+                       const std::string& treeFileName, std::size_t keyField);
+
+    /**
+     * @brief Writes the primary key index as text "key offset" lines, for debugging only.
      * @param primaryKeyIndex The primary key index to write.
+     * @param fileName Name of the text file to write.
+     * @pre None.
+     * @post The primary key index is written to a text file.
+     */
+    void ExportIndexText(const std::map<std::string, std::streampos>& primaryKeyIndex,
+                         const std::string& fileName = "KeyIndex.txt");
+
+    /**
+     * @brief Maps a binary index file for lookups.
+     * @param fileName Name of the binary index file.
+     * @param zipKeys When true the keys are also loaded into a ZipKeyIndex, which addresses numeric
+     * zip keys directly and falls back to a sorted vector for any other key set.
+     * @param sectionOffset Offset of the index inside the file, such as the index section recorded in the
+     * header record of a data file built by DataFileBuilder.
+     * @param keyField Field of a record that holds its key, HeaderRecord::getPrimaryKeyOrdinality() of the file.
+     * @return true if the index was opened, false otherwise.
+     * @pre None.
+     * @post On success FindKey() searches the changes replayed from the delta log, then the ZipKeyIndex or
+     * the mapped index in place.
+     */
+    bool OpenIndex(const std::string& fileName, bool zipKeys = true, std::uint64_t sectionOffset = 0,
+                   std::size_t keyField = 0);
+
+    /**
+     * @brief Opens a B+ tree index for lookups, in place of an index opened by OpenIndex().
+     * @param fileName Name of the tree file.
+     * @param writable When true, PutKey() and EraseKey() change the tree in place.
+     * @return true if the tree was opened, false otherwise.
+     * @pre None.
+     * @post On success FindKey() descends the tree, reading a few pages per lookup, and records are matched
+     * against the key field recorded in the tree. Only the root page is held in memory.
+     */
+    bool OpenIndexTree(const std::string& fileName, bool writable = false);
+
+    /**
+     * @brief Opens the primary key index of a data file, whichever form it was written in.
+     * @param dataFileName Name of the data file.
+     * @param header The header record of the data file.
+     * @param indexFileName Name of the binary index file.
+     * @param treeFileName Name of the tree file.
+     * @return true if an index was opened, false otherwise.
+     * @pre None.
+     * @post The index section embedded in the data file is opened if there is one, else the tree, else the
+     * binary index file, with the key field named by the header record.
+     */
+    bool OpenIndexFor(const std::string& dataFileName, const HeaderRecord& header, const std::string& indexFileName,
+                      const std::string& treeFileName);
+
+    /**
+     * @brief Field of a record that holds its key, as given to OpenIndex() or recorded in the tree.
+     */
+    std::size_t primaryKeyField() const;
+
+    /**
+     * @brief Looks a key up in the index opened by OpenIndex().
+     * @param key The primary key.
+     * @param entry Receives the index entry of the key.
+     * @return true if the key is in the index, false otherwise.
+     * @pre OpenIndex() succeeded.
+     * @post 'entry' is updated only when true is returned.
+     */
+    bool FindKey(std::string_view key, KeyIndexEntry& entry) const;
+
+    /**
+     * @brief Points a key at a record, adding the key if it is new.
+     * @param entry The key with the offset and payload length of its record.
+     * @return true if the change was logged, false otherwise.
+     * @pre OpenIndex() succeeded on a stand-alone index file, or OpenIndexTree() on a writable tree.
+     * @post FindKey() returns 'entry'; the change is in the delta log, not yet in the index file, or written
+     * into the tree.
+     */
+    bool PutKey(const KeyIndexEntry& entry);
+
+    /**
+     * @brief Removes a key from the index.
+     * @param key The primary key.
+     * @return true if the key was in the index and its removal was logged, false otherwise.
+     * @pre OpenIndex() succeeded on a stand-alone index file, or OpenIndexTree() on a writable tree.
+     * @post FindKey() no longer finds 'key'.
+     */
+    bool EraseKey(std::string_view key);
+
+    /**
+     * @brief Merges the delta log into the index file and empties the log.
+     * @return true if the index file was rewritten, or there was nothing to merge; false otherwise.
+     * @pre OpenIndex() succeeded on a stand-alone index file.
+     * @post The index file holds every change and deltaSize() returns 0. The new file is synced and renamed
+     * into place and the rename is synced before the log is emptied, so a crash leaves either the old index
+     * with its log or the new one.
+     */
+    bool Checkpoint();
+
+    /**
+     * @brief Number of keys changed since the index file was written.
+     */
+    std::size_t deltaSize() const;
+
+    /**
+     * @brief Opens the data file that the index points into.
+     * @param fileName Name of the length-indicated data file.
+     * @param format Format of its length indicators.
+     * @return true if the data file was opened, false otherwise.
      * @pre None.
-     * @post The primary key index is written to a file.
+     * @post SearchIndex() and SearchIndexBatch() read records from 'fileName'.
      */
-    void WriteIndex(const std::map<std::string, std::streampos> primaryKeyIndex);
+    bool OpenDataFile(const std::string& fileName, LengthIndicator::Format format = LengthIndicator::DEFAULT);
 
     /**
      * @brief Searches for a record in the index using a primary key.
-     * @param recordIndex The map of records to search within.
-     * @param filename The name of the file containing the primary key index.
+     * @param key The primary key of the record.
+     * @param record Receives the record payload.
      * @return True if the record is found, otherwise false.
-     * @pre The file with the given filename exists and contains a valid index.
+     * @pre OpenIndex() and OpenDataFile() succeeded.
+     * @post 'record' is updated only when true is returned.
+     * @details The length indicator and the payload are fetched with one read through the shared
+     * BufferPool, so a record looked up again is served from memory.
+     */
+    bool SearchIndex(std::string_view key, std::string& record) const;
+
+    /**
+     * @brief Searches for many records at once.
+     * @param keys The primary keys to resolve.
+     * @return The (key, record) pairs of the keys that were found, in the order of 'keys'.
+     * @pre OpenIndex() and OpenDataFile() succeeded.
      * @post None.
+     * @details The reads are issued in file order and records that lie close together are fetched
+     * with one read, so resolving thousands of keys costs far fewer page requests than keys.
      */
-    bool SearchIndex(const std::map<std::string, std::string> recordIndex, std::string filename);
+    std::vector<std::pair<std::string, std::string>> SearchIndexBatch(const std::vector<std::string>& keys) const;
 
     /**
      * @brief Unpacks and displays a record given its data.
@@ -79,8 +316,43 @@ public:
     void UnpackRecord(const std::string& recordData);
 
 private:
-    // Define the data structure for the primary key index
-    //std::map<std::string, std::streampos> primaryKeyIndex; // You can use an unordered_map if preferred
+    KeyIndexFile indexFile; /**< Binary index mapped by OpenIndex(). */
+    ZipKeyIndex keyTable;   /**< Direct-address or sorted copy of the keys, when requested. */
+    std::string indexName;  /**< Index file opened by OpenIndex(). */
+    std::uint64_t indexOffset; /**< Offset of the index inside 'indexName'. */
+    bool indexZipKeys;      /**< Whether OpenIndex() built 'keyTable'. */
+    std::map<std::string, KeyIndexEntry, std::less<>> delta; /**< Changed keys by deltaKey(); 'reserved' holds the KeyIndexLog operation. */
+    KeyIndexLog deltaLog;   /**< Log the changes in 'delta' are appended to, opened on the first change. */
+    BPlusTree indexTree;    /**< Paged index opened by OpenIndexTree(), used instead of 'indexFile'. */
+    std::size_t keyField;   /**< Field of a record that holds its key. */
+    BufferPool::FileId dataFile; /**< Data file opened by OpenDataFile(), read through the shared pool. */
+    LengthIndicator::Format dataFormat; /**< Length indicator format of the data file. */
+
+    static constexpr std::uint64_t BATCH_GAP = 4096; /**< Largest gap between records merged into one batch read. */
+
+    /**
+     * @brief Key of 'delta' for a primary key: its ZipKeyIndex::Canonical() form, so "501" and "00501" share
+     * one change, as they share one entry of the ZipKeyIndex.
+     */
+    static std::string deltaKey(std::string_view key);
+
+    /**
+     * @brief Opens the delta log for appending the first change.
+     * @return false if the index is embedded in a data file or the log cannot be opened.
+     */
+    bool openDeltaLog();
+
+    /**
+     * @brief Reads 'length' bytes at 'offset' of the data file through the shared buffer pool.
+     * @return true if all bytes were read.
+     */
+    bool readAt(std::uint64_t offset, char* buffer, std::size_t length) const;
+
+    /**
+     * @brief Extracts the payload of the record at the start of 'buffer'.
+     * @return false if the record at the entry's offset is not the entry's live record.
+     */
+    bool unpackAt(const char* buffer, std::size_t available, const KeyIndexEntry& entry, std::string& record) const;
 };
 
 #endif //ZIPCODES_PRIMARYKEYINDEX_H
@@ -0,0 +1,236 @@
+/**
+ * @file QueryEngine.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the QueryEngine class.
+ * @see QueryEngine.h for declaration.
+ */
+
+#include "QueryEngine.h"
+#include "FieldTokenizer.h"
+#include "HeaderRecordBuffer.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+/**
+ * @brief Checks that a coordinate field reads as 'value', parsed as the index builders parse it.
+ */
+bool sameCoordinate(std::string_view field, float value) {
+    char text[32] = {};
+    std::memcpy(text, field.data(), std::min(field.size(), sizeof(text) - 1));
+    char* end = nullptr;
+    const float parsed = std::strtof(text, &end);
+    return end != text && parsed == value;
+}
+
+} // namespace
+
+/**
+ * @brief Looks a zip code up.
+ * @param zip The zip code.
+ * @param record Receives the record payload, in plain form.
+ * @return true if the zip is in the data file, false otherwise.
+ */
+bool QueryEngine::Snapshot::FindZip(std::string_view zip, std::string& record) const {
+    if (!data.isOpen()) {
+        if (!keys.SearchIndex(zip, record)) {
+            return false;
+        }
+    } else {
+        KeyIndexEntry entry;
+        RecordView view;
+        if (!keys.FindKey(zip, entry) || !data.RecordAt(entry.offset, view) || view.length != entry.length
+            || MappedDataFile::IsTombstone(view.data)
+            || !ZipKeyIndex::SameKey(FieldTokenizer::ExtractField(view.data, keys.primaryKeyField()), zip)) {
+            return false;
+        }
+        record.assign(view.data.data(), view.data.size());
+    }
+    // State and County of an encoded record are codes into the header's dictionaries.
+    if (!dictionary.empty()) {
+        record = dictionary.DecodeRecord(record);
+    }
+    return true;
+}
+
+/**
+ * @brief Finds the place with a name whose latitude is closest to 'latitude'.
+ * @param name The place name, in any case.
+ * @param latitude Latitude used to choose between places of the same name.
+ * @param posting Receives the place.
+ * @return true if a place of that name lies within NameIndex::LATITUDE_TOLERANCE, false otherwise.
+ */
+bool QueryEngine::Snapshot::FindPlace(std::string_view name, float latitude, NamePosting& posting) const {
+    const std::string normalized = NameIndex::Normalize(name);
+    return names.Find(name, latitude, posting, [&](const NamePosting& candidate) {
+        return isLive(candidate, normalized);
+    });
+}
+
+/**
+ * @brief Finds the live place nearest to a point.
+ * @return false if there are no live places.
+ */
+bool QueryEngine::Snapshot::Nearest(double latitude, double longitude, SpatialPoint& nearest,
+                                    double& distanceKm) const {
+    return points.Nearest(latitude, longitude, nearest, distanceKm, [this](const SpatialPoint& point) {
+        return isLive(point);
+    });
+}
+
+/**
+ * @brief Collects the live places within 'radiusKm' of a point, nearest first.
+ */
+void QueryEngine::Snapshot::WithinRadius(double latitude, double longitude, double radiusKm,
+                                         std::vector<SpatialPoint>& found) const {
+    points.WithinRadius(latitude, longitude, radiusKm, found, [this](const SpatialPoint& point) {
+        return isLive(point);
+    });
+}
+
+/**
+ * @brief Checks that the record a posting was built from is still in the data file unchanged.
+ * @param posting Posting of the name index.
+ * @param normalizedName The name looked up, normalised by NameIndex::Normalize().
+ * @return true if the key is found and its record has that name and the posting's latitude.
+ */
+bool QueryEngine::Snapshot::isLive(const NamePosting& posting, std::string_view normalizedName) const {
+    std::string record;
+    return FindZip(posting.Key(), record)
+           && NameIndex::Normalize(FieldTokenizer::ExtractField(record, NameIndex::NAME_FIELD)) == normalizedName
+           && sameCoordinate(FieldTokenizer::ExtractField(record, NameIndex::LATITUDE_FIELD), posting.latitude);
+}
+
+/**
+ * @brief Checks that the record a place was built from is still in the data file unchanged.
+ * @return true if the key is found and its record has the place's coordinates.
+ */
+bool QueryEngine::Snapshot::isLive(const SpatialPoint& point) const {
+    std::string record;
+    return FindZip(point.Key(), record)
+           && sameCoordinate(FieldTokenizer::ExtractField(record, SpatialIndex::LATITUDE_FIELD), point.latitude)
+           && sameCoordinate(FieldTokenizer::ExtractField(record, SpatialIndex::LONGITUDE_FIELD), point.longitude);
+}
+
+/**
+ * @brief Files the snapshot was opened from.
+ */
+const QueryEngine::Files& QueryEngine::Snapshot::files() const {
+    return sources;
+}
+
+/**
+ * @brief Number of the snapshot, counting the versions published by the engine from 1.
+ */
+std::uint64_t QueryEngine::Snapshot::version() const {
+    return number;
+}
+
+/**
+ * @brief Default constructor. No snapshot is published.
+ */
+QueryEngine::QueryEngine() : published(0) {
+}
+
+/**
+ * @brief Opens the data file and its indexes and publishes them as the new snapshot.
+ * @param files The files to open.
+ * @return true if every file was opened and the snapshot published; false leaves the old snapshot current.
+ */
+bool QueryEngine::Load(const Files& files) {
+    // The snapshot is complete before it is published and never changed after.
+    std::shared_ptr<Snapshot> next(new Snapshot());
+    next->sources = files;
+    HeaderRecordBuffer header;
+    if (!header.ReadDataFileHeader(files.data, files.header)) {
+        return false;
+    }
+    const HeaderRecord record = header.GetHeaderRecord();
+    const LengthIndicator::Format format = record.getLengthFormat();
+    if (record.isDictionaryEncoded()) {
+        next->dictionary = record.getDictionary();
+    }
+    // A data file built by DataFileBuilder carries its primary key index in its index section.
+    if (!next->keys.OpenIndexFor(files.data, record, files.index, files.indexTree) || !next->names.Open(files.nameIndex) || !next->points.Open(files.spatialIndex)) {
+        std::cerr << "Error: The indexes of " << files.data << " could not be opened." << std::endl;
+        return false;
+    }
+    if (next->data.Open(files.data, record.getDataSection().offset, format, record.getDataSize())) {
+        next->data.mapping().AdviseRandom();
+    } else if (!next->keys.OpenDataFile(files.data, format)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(publishLock);
+    next->number = ++published;
+    std::atomic_store(&current, std::shared_ptr<const Snapshot>(std::move(next)));
+    return true;
+}
+
+/**
+ * @brief Opens the files of the current snapshot again and publishes them.
+ * @return false if no snapshot is published or the files could not be opened.
+ */
+bool QueryEngine::Reload() {
+    const std::shared_ptr<const Snapshot> snapshot = Acquire();
+    return snapshot != nullptr && Load(snapshot->files());
+}
+
+/**
+ * @brief The current snapshot, for running several queries against one version.
+ * @return The snapshot, or nullptr if none was published.
+ */
+std::shared_ptr<const QueryEngine::Snapshot> QueryEngine::Acquire() const {
+    return std::atomic_load(&current);
+}
+
+bool QueryEngine::isLoaded() const {
+    return Acquire() != nullptr;
+}
+
+/**
+ * @brief Looks a zip code up in the current snapshot.
+ */
+bool QueryEngine::FindZip(std::string_view zip, std::string& record) const {
+    const std::shared_ptr<const Snapshot> snapshot = Acquire();
+    return snapshot != nullptr && snapshot->FindZip(zip, record);
+}
+
+/**
+ * @brief Finds a place by name in the current snapshot.
+ */
+bool QueryEngine::FindPlace(std::string_view name, float latitude, NamePosting& posting) const {
+    const std::shared_ptr<const Snapshot> snapshot = Acquire();
+    return snapshot != nullptr && snapshot->FindPlace(name, latitude, posting);
+}
+
+/**
+ * @brief Finds the place nearest to a point in the current snapshot.
+ */
+bool QueryEngine::Nearest(double latitude, double longitude, SpatialPoint& nearest, double& distanceKm) const {
+    const std::shared_ptr<const Snapshot> snapshot = Acquire();
+    return snapshot != nullptr && snapshot->Nearest(latitude, longitude, nearest, distanceKm);
+}
+
+/**
+ * @brief Collects the places within a radius in the current snapshot.
+ */
+void QueryEngine::WithinRadius(double latitude, double longitude, double radiusKm,
+                               std::vector<SpatialPoint>& found) const {
+    found.clear();
+    const std::shared_ptr<const Snapshot> snapshot = Acquire();
+    if (snapshot != nullptr) {
+        snapshot->WithinRadius(latitude, longitude, radiusKm, found);
+    }
+}
+
+/**
+ * @brief Version number of the current snapshot, 0 if none was published.
+ */
+std::uint64_t QueryEngine::version() const {
+    const std::shared_ptr<const Snapshot> snapshot = Acquire();
+    return snapshot != nullptr ? snapshot->version() : 0;
+}
@@ -0,0 +1,223 @@
+/**
+ * @file QueryEngine.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class QueryEngine
+ * @see QueryEngine.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class QueryEngine, which answers zip, place name and spatial lookups from any
+ * number of threads at once. The data file and its three indexes are opened together into a Snapshot that
+ * is never changed after it is published. The engine holds the current snapshot through a std::shared_ptr
+ * that is read with std::atomic_load and replaced with std::atomic_store, so a query copies the pointer
+ * and then works on that version alone, without taking a lock.
+ *
+ * Load() opens a new version, for example after the indexes were rebuilt or a Compactor swapped the files,
+ * and publishes it in one store. Queries that started before the store finish on the old snapshot; its files
+ * stay open until the last of them releases it, even if they were renamed over in the meantime.
+ *
+ * Records are fetched from a read-only mapping of the data file and keys are resolved through the in-memory
+ * ZipKeyIndex, so a lookup touches no shared mutable state and throughput grows with the number of cores.
+ * When the data file cannot be mapped the records are read through the shared BufferPool instead.
+ *
+ * The length indicator format of the data file is read from its header record when the snapshot is opened;
+ * see HeaderRecordBuffer::ReadDataFileHeader(). A data file built by DataFileBuilder is read within its data
+ * section and its embedded index section is used as the primary key index; otherwise the tree or the binary
+ * index written by PrimaryKeyIndex::WriteIndexFor() is opened. The dictionaries of a dictionary-encoded file
+ * are kept in the snapshot, and FindZip() returns records with their State and County decoded.
+ *
+ * The name and spatial indexes are only rebuilt, never changed with the data file, so after a MutableDataFile
+ * change or a compaction their entries may name deleted, changed or moved records. FindPlace(), Nearest() and
+ * WithinRadius() therefore resolve the key of every hit through the primary key index, as FindZip() does, and
+ * drop the hits whose record is gone or no longer has that name and those coordinates. The offset and length
+ * stored with a hit are those of the last rebuild; use its key. A record appended since then is found by
+ * FindZip() only.
+ *
+ * Assumptions:
+ * - A snapshot does not follow changes to its files. MutableDataFile changes the data file in place: the
+ *   records it appends lie past the end of the snapshot's mapping, and the index changes it logs are read
+ *   only by Load(). A Compactor renames new files over the old ones. Whoever changes the files calls Reload()
+ *   after each batch of changes, after PrimaryKeyIndex::Checkpoint() and after a compaction; until then a
+ *   lookup may miss a new record or still find a deleted one.
+ * - The primary key is the field of a record named by the header record's primary key ordinality, or the
+ *   key field recorded in a tree index.
+ */
+
+#ifndef ZIPCODES_QUERYENGINE_H
+#define ZIPCODES_QUERYENGINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MappedDataFile.h"
+#include "NameIndex.h"
+#include "PrimaryKeyIndex.h"
+#include "RecordDictionary.h"
+#include "SpatialIndex.h"
+
+class QueryEngine {
+public:
+    /**
+     * @brief Names of the files one snapshot is opened from.
+     */
+    struct Files {
+        std::string data = "output.txt";             /**< Length-indicated data file. */
+        std::string index = "KeyIndex.idx";          /**< Binary primary key index, unless the data file embeds one. */
+        std::string indexTree = "KeyIndex.bpt";      /**< B+ tree written in place of 'index' for a large key set. */
+        std::string nameIndex = "NameIndex.idx";     /**< Place name index. */
+        std::string spatialIndex = "SpatialIndex.idx"; /**< Spatial index. */
+        std::string header = "header.txt";           /**< Header record of a data file without a header block. */
+    };
+
+    /**
+     * @brief One immutable version of the data file and its indexes.
+     * All lookups are const and may run on many threads at once.
+     */
+    class Snapshot {
+    public:
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        /**
+         * @brief Looks a zip code up.
+         * @param zip The zip code.
+         * @param record Receives the record payload, in plain form even if the data file is dictionary-encoded.
+         * @return true if the zip is in the data file, false otherwise.
+         */
+        bool FindZip(std::string_view zip, std::string& record) const;
+
+        /**
+         * @brief Finds the place with a name whose latitude is closest to 'latitude'.
+         * @param name The place name, in any case.
+         * @param latitude Latitude used to choose between places of the same name.
+         * @param posting Receives the place.
+         * @return true if a live place of that name lies within NameIndex::LATITUDE_TOLERANCE, false otherwise.
+         */
+        bool FindPlace(std::string_view name, float latitude, NamePosting& posting) const;
+
+        /**
+         * @brief Finds the live place nearest to a point.
+         * @return false if there are no live places.
+         */
+        bool Nearest(double latitude, double longitude, SpatialPoint& nearest, double& distanceKm) const;
+
+        /**
+         * @brief Collects the live places within 'radiusKm' of a point, nearest first.
+         */
+        void WithinRadius(double latitude, double longitude, double radiusKm, std::vector<SpatialPoint>& found) const;
+
+        /**
+         * @brief Files the snapshot was opened from.
+         */
+        const Files& files() const;
+
+        /**
+         * @brief Number of the snapshot, counting the versions published by the engine from 1.
+         */
+        std::uint64_t version() const;
+
+    private:
+        friend class QueryEngine;
+        Snapshot() = default;
+
+        /**
+         * @brief Checks that the record a posting was built from is still in the data file unchanged.
+         * @param posting Posting of the name index.
+         * @param normalizedName The name looked up, normalised by NameIndex::Normalize().
+         * @return true if the key is found and its record has that name and the posting's latitude.
+         */
+        bool isLive(const NamePosting& posting, std::string_view normalizedName) const;
+
+        /**
+         * @brief Checks that the record a place was built from is still in the data file unchanged.
+         * @return true if the key is found and its record has the place's coordinates.
+         */
+        bool isLive(const SpatialPoint& point) const;
+
+        Files sources;                 /**< Files the snapshot was opened from. */
+        std::uint64_t number = 0;      /**< Version number. */
+        PrimaryKeyIndex keys;          /**< Primary key index, with its keys in a ZipKeyIndex. */
+        MappedDataFile data;           /**< Mapping of the data file, when it could be mapped. */
+        NameIndex names;               /**< Place name index. */
+        SpatialIndex points;           /**< Spatial index. */
+        RecordDictionary dictionary;   /**< State and County dictionaries; empty unless the file is encoded. */
+    };
+
+    /**
+     * @brief Default constructor. No snapshot is published.
+     * @pre None.
+     * @post isLoaded() returns false.
+     */
+    QueryEngine();
+
+    QueryEngine(const QueryEngine&) = delete;
+    QueryEngine& operator=(const QueryEngine&) = delete;
+
+    /**
+     * @brief Opens the data file and its indexes and publishes them as the new snapshot.
+     * @param files The files to open.
+     * @return true if every file was opened and the snapshot published; false leaves the old snapshot current.
+     * @pre The indexes exist and match the data file.
+     * @post Queries that start from now on see the new snapshot; queries already running keep the old one.
+     */
+    bool Load(const Files& files);
+
+    /**
+     * @brief Opens the files of the current snapshot again and publishes them.
+     * @return false if no snapshot is published or the files could not be opened.
+     * @pre None.
+     * @post As for Load().
+     */
+    bool Reload();
+
+    /**
+     * @brief The current snapshot, for running several queries against one version.
+     * @return The snapshot, or nullptr if none was published. It stays valid while the pointer is held.
+     * @pre None.
+     * @post None. Safe to call from any thread.
+     */
+    std::shared_ptr<const Snapshot> Acquire() const;
+
+    bool isLoaded() const;
+
+    /**
+     * @brief Looks a zip code up in the current snapshot.
+     * @see Snapshot::FindZip().
+     */
+    bool FindZip(std::string_view zip, std::string& record) const;
+
+    /**
+     * @brief Finds a place by name in the current snapshot.
+     * @see Snapshot::FindPlace().
+     */
+    bool FindPlace(std::string_view name, float latitude, NamePosting& posting) const;
+
+    /**
+     * @brief Finds the place nearest to a point in the current snapshot.
+     * @see Snapshot::Nearest().
+     */
+    bool Nearest(double latitude, double longitude, SpatialPoint& nearest, double& distanceKm) const;
+
+    /**
+     * @brief Collects the places within a radius in the current snapshot.
+     * @see Snapshot::WithinRadius().
+     */
+    void WithinRadius(double latitude, double longitude, double radiusKm, std::vector<SpatialPoint>& found) const;
+
+    /**
+     * @brief Version number of the current snapshot, 0 if none was published.
+     */
+    std::uint64_t version() const;
+
+private:
+    std::shared_ptr<const Snapshot> current; /**< Published snapshot; only accessed through atomic_load/atomic_store. */
+    std::mutex publishLock;                  /**< Serializes Load(); queries never take it. */
+    std::uint64_t published;                 /**< Versions published so far, guarded by 'publishLock'. */
+};
+
+#endif //ZIPCODES_QUERYENGINE_H
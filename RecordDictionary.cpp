@@ -0,0 +1,309 @@
+/**
+ * @file RecordDictionary.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the RecordDictionary class.
+ * @see RecordDictionary.h for declaration.
+ */
+
+#include "RecordDictionary.h"
+#include "FieldTokenizer.h"
+#include <charconv>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+const char DICTIONARY_MARKER[] = "#dictionary"; /**< First word of a dictionary section line. */
+
+/**
+ * @brief Writes one dictionary section.
+ */
+void writeSection(std::ostream& out, const char* field, const FieldDictionary& dictionary) {
+    out << DICTIONARY_MARKER << ' ' << field << ' ' << dictionary.size() << '\n';
+    for (const std::string& value : dictionary.values()) {
+        out << value << '\n';
+    }
+}
+
+/**
+ * @brief Reads one dictionary section into 'dictionary'.
+ */
+bool readSection(std::istream& in, const char* field, FieldDictionary& dictionary) {
+    std::string line;
+    if (!std::getline(in, line)) {
+        return false;
+    }
+    std::istringstream words(line);
+    std::string marker;
+    std::string name;
+    std::size_t count = 0;
+    if (!(words >> marker >> name >> count) || marker != DICTIONARY_MARKER || name != field) {
+        return false;
+    }
+    for (std::size_t i = 0; i < count; i++) {
+        if (!std::getline(in, line)) {
+            return false;
+        }
+        dictionary.Encode(line);
+    }
+    return dictionary.size() == count;
+}
+
+/**
+ * @brief Appends the decimal form of a code.
+ */
+void appendCode(std::uint32_t code, std::string& buffer) {
+    char digits[10];
+    std::to_chars_result written = std::to_chars(digits, digits + sizeof(digits), code);
+    buffer.append(digits, written.ptr);
+}
+
+} // namespace
+
+/**
+ * @brief Adds the state and county of a plain record to the dictionaries.
+ * @param record The record payload.
+ * @return true if the record has both fields.
+ */
+bool RecordDictionary::Add(std::string_view record) {
+    std::size_t stateBegin;
+    std::size_t countyBegin;
+    std::size_t countyEnd;
+    if (!fieldSpans(record, stateBegin, countyBegin, countyEnd)) {
+        return false;
+    }
+    stateValues.Encode(record.substr(stateBegin, countyBegin - 1 - stateBegin));
+    countyValues.Encode(record.substr(countyBegin, countyEnd - countyBegin));
+    return true;
+}
+
+/**
+ * @brief Appends the encoded form of a plain record to a buffer.
+ * @param record The record payload.
+ * @param buffer The buffer to append to.
+ * @return true if the record was encoded, false if it was appended unchanged.
+ */
+bool RecordDictionary::Encode(std::string_view record, std::string& buffer) const {
+    std::size_t stateBegin;
+    std::size_t countyBegin;
+    std::size_t countyEnd;
+    std::uint32_t state;
+    std::uint32_t county;
+    if (!fieldSpans(record, stateBegin, countyBegin, countyEnd)
+        || !stateValues.Find(record.substr(stateBegin, countyBegin - 1 - stateBegin), state)
+        || !countyValues.Find(record.substr(countyBegin, countyEnd - countyBegin), county)) {
+        buffer.append(record.data(), record.size());
+        return false;
+    }
+    buffer.append(record.data(), stateBegin);
+    appendCode(state, buffer);
+    buffer.push_back(',');
+    appendCode(county, buffer);
+    buffer.append(record.data() + countyEnd, record.size() - countyEnd);
+    return true;
+}
+
+/**
+ * @brief Reads both codes of an encoded record without decoding it.
+ * @param record The encoded record payload.
+ * @param state Receives the state code.
+ * @param county Receives the county code.
+ * @return false if the record is plain.
+ */
+bool RecordDictionary::Codes(std::string_view record, std::uint32_t& state, std::uint32_t& county) const {
+    std::size_t stateBegin;
+    std::size_t countyBegin;
+    std::size_t countyEnd;
+    return fieldSpans(record, stateBegin, countyBegin, countyEnd)
+           && parseCode(record.substr(stateBegin, countyBegin - 1 - stateBegin), stateValues.size(), state)
+           && parseCode(record.substr(countyBegin, countyEnd - countyBegin), countyValues.size(), county);
+}
+
+/**
+ * @brief Reads the state code of an encoded record without decoding it.
+ * @param record The encoded record payload.
+ * @param code Receives the code.
+ * @return true if the record holds a valid state code.
+ */
+bool RecordDictionary::StateCode(std::string_view record, std::uint32_t& code) const {
+    std::uint32_t county;
+    return Codes(record, code, county);
+}
+
+/**
+ * @brief Reads the county code of an encoded record without decoding it.
+ * @param record The encoded record payload.
+ * @param code Receives the code.
+ * @return true if the record holds a valid county code.
+ */
+bool RecordDictionary::CountyCode(std::string_view record, std::uint32_t& code) const {
+    std::uint32_t state;
+    return Codes(record, state, code);
+}
+
+/**
+ * @brief Decodes the state of a record.
+ * @param record An encoded or plain record payload.
+ * @return The state, as FieldTokenizer would return it from the plain record.
+ */
+std::string_view RecordDictionary::State(std::string_view record) const {
+    std::uint32_t state;
+    std::uint32_t county;
+    if (!Codes(record, state, county)) {
+        return FieldTokenizer::ExtractField(record, STATE_FIELD);
+    }
+    return FieldTokenizer::ExtractField(stateValues.Decode(state), 0);
+}
+
+/**
+ * @brief Decodes the county of a record.
+ * @param record An encoded or plain record payload.
+ * @return The county, as FieldTokenizer would return it from the plain record.
+ */
+std::string_view RecordDictionary::County(std::string_view record) const {
+    std::uint32_t state;
+    std::uint32_t county;
+    if (!Codes(record, state, county)) {
+        return FieldTokenizer::ExtractField(record, COUNTY_FIELD);
+    }
+    return FieldTokenizer::ExtractField(countyValues.Decode(county), 0);
+}
+
+/**
+ * @brief Restores the plain form of a record.
+ * @param record An encoded or plain record payload.
+ * @return The plain record, byte for byte as it was before Encode().
+ */
+std::string RecordDictionary::DecodeRecord(std::string_view record) const {
+    std::size_t stateBegin;
+    std::size_t countyBegin;
+    std::size_t countyEnd;
+    std::uint32_t state;
+    std::uint32_t county;
+    if (!fieldSpans(record, stateBegin, countyBegin, countyEnd)
+        || !parseCode(record.substr(stateBegin, countyBegin - 1 - stateBegin), stateValues.size(), state)
+        || !parseCode(record.substr(countyBegin, countyEnd - countyBegin), countyValues.size(), county)) {
+        return std::string(record);
+    }
+    const std::string_view stateText = stateValues.Decode(state);
+    const std::string_view countyText = countyValues.Decode(county);
+    std::string plain;
+    plain.reserve(record.size() + stateText.size() + countyText.size());
+    plain.append(record.data(), stateBegin);
+    plain.append(stateText.data(), stateText.size());
+    plain.push_back(',');
+    plain.append(countyText.data(), countyText.size());
+    plain.append(record.data() + countyEnd, record.size() - countyEnd);
+    return plain;
+}
+
+/**
+ * @brief Adds every value of another dictionary, in its code order.
+ * @param other The dictionary to merge.
+ */
+void RecordDictionary::Merge(const RecordDictionary& other) {
+    for (const std::string& value : other.stateValues.values()) {
+        stateValues.Encode(value);
+    }
+    for (const std::string& value : other.countyValues.values()) {
+        countyValues.Encode(value);
+    }
+}
+
+/**
+ * @brief Writes the dictionary section of a header file.
+ * @param out The stream to write to.
+ */
+void RecordDictionary::Write(std::ostream& out) const {
+    writeSection(out, "State", stateValues);
+    writeSection(out, "County", countyValues);
+}
+
+/**
+ * @brief Reads a dictionary section written by Write().
+ * @param in The stream, positioned at the start of the section.
+ * @return true if the section was complete.
+ */
+bool RecordDictionary::Read(std::istream& in) {
+    clear();
+    return readSection(in, "State", stateValues) && readSection(in, "County", countyValues);
+}
+
+const FieldDictionary& RecordDictionary::states() const {
+    return stateValues;
+}
+
+const FieldDictionary& RecordDictionary::counties() const {
+    return countyValues;
+}
+
+bool RecordDictionary::empty() const {
+    return stateValues.empty() && countyValues.empty();
+}
+
+void RecordDictionary::clear() {
+    stateValues.clear();
+    countyValues.clear();
+}
+
+/**
+ * @brief Finds the raw bytes of the State and County fields, quotes included.
+ * @param record The record payload.
+ * @param stateBegin Receives the offset of the State field.
+ * @param countyBegin Receives the offset of the County field; the State field ends at the comma before it.
+ * @param countyEnd Receives the offset just past the County field.
+ * @return false if the record has fewer than four fields.
+ * @details Quoting follows FieldTokenizer: a field is quoted only when it starts with '"'.
+ */
+bool RecordDictionary::fieldSpans(std::string_view record, std::size_t& stateBegin, std::size_t& countyBegin,
+                                  std::size_t& countyEnd) {
+    const char* base = record.data();
+    const std::size_t size = record.size();
+    std::size_t fieldEnds[COUNTY_FIELD + 1];
+    std::size_t pos = 0;
+    for (std::size_t field = 0; field <= COUNTY_FIELD; field++) {
+        if (field > 0) {
+            if (fieldEnds[field - 1] == size) {
+                return false;
+            }
+            pos = fieldEnds[field - 1] + 1;
+        }
+        if (pos < size && base[pos] == '"') {
+            // Skip to the closing quote, stepping over "" escapes.
+            pos++;
+            while (pos < size) {
+                if (base[pos] == '"') {
+                    if (pos + 1 < size && base[pos + 1] == '"') {
+                        pos += 2;
+                        continue;
+                    }
+                    pos++;
+                    break;
+                }
+                pos++;
+            }
+        }
+        const void* comma = pos < size ? std::memchr(base + pos, ',', size - pos) : nullptr;
+        fieldEnds[field] = comma != nullptr ? static_cast<std::size_t>(static_cast<const char*>(comma) - base) : size;
+    }
+    stateBegin = fieldEnds[STATE_FIELD - 1] + 1;
+    countyBegin = fieldEnds[STATE_FIELD] + 1;
+    countyEnd = fieldEnds[COUNTY_FIELD];
+    return true;
+}
+
+/**
+ * @brief Parses a code written by Encode().
+ * @param field The field text.
+ * @param limit Number of values in the dictionary.
+ * @param code Receives the code.
+ * @return true if 'field' is a canonical decimal number below 'limit'.
+ */
+bool RecordDictionary::parseCode(std::string_view field, std::size_t limit, std::uint32_t& code) {
+    if (field.empty() || (field.size() > 1 && field[0] == '0')) {
+        return false;
+    }
+    const char* end = field.data() + field.size();
+    std::from_chars_result parsed = std::from_chars(field.data(), end, code);
+    return parsed.ec == std::errc() && parsed.ptr == end && code < limit;
+}
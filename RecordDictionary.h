@@ -0,0 +1,144 @@
+/**
+ * @file RecordDictionary.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class RecordDictionary
+ * @see RecordDictionary.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class RecordDictionary, the codec of dictionary-encoded data file records.
+ * The State and County fields of a record are replaced by the decimal codes of their values, so
+ *
+ *     501,Holtsville,NY,Suffolk,40.8154,-73.0451   becomes   501,Holtsville,0,0,40.8154,-73.0451
+ *
+ * Every other field keeps its position and bytes, so code that reads the zip, name or coordinates of
+ * a record works on encoded records unchanged. The State and County text is only looked up when
+ * State(), County() or DecodeRecord() is called, and a filter on either field compares integers.
+ *
+ * The dictionaries are serialised in the header file written by HeaderRecordBuffer, as a section of
+ * one line per value after a "#dictionary <field> <count>" line.
+ *
+ * Assumptions:
+ * - Records follow the format Zip,Name,State,County,Latitude,Longitude.
+ * - Records with fewer than four fields are stored unencoded; a record whose State and County are not
+ *   both valid codes is read as a plain record.
+ * - State and county values do not contain a newline.
+ */
+
+#ifndef ZIPCODES_RECORDDICTIONARY_H
+#define ZIPCODES_RECORDDICTIONARY_H
+
+#include "FieldDictionary.h"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+class RecordDictionary {
+public:
+    static constexpr std::size_t STATE_FIELD = 2;  /**< Field holding the state. */
+    static constexpr std::size_t COUNTY_FIELD = 3; /**< Field holding the county. */
+
+    /**
+     * @brief Adds the state and county of a plain record to the dictionaries.
+     * @param record The record payload.
+     * @return true if the record has both fields.
+     * @pre None.
+     * @post Encode() can encode 'record'.
+     */
+    bool Add(std::string_view record);
+
+    /**
+     * @brief Appends the encoded form of a plain record to a buffer.
+     * @param record The record payload.
+     * @param buffer The buffer to append to.
+     * @return true if the record was encoded, false if it was appended unchanged.
+     * @pre Add() was called for 'record', or for a record with the same state and county.
+     * @post None.
+     */
+    bool Encode(std::string_view record, std::string& buffer) const;
+
+    /**
+     * @brief Reads both codes of an encoded record without decoding it.
+     * @param record The encoded record payload.
+     * @param state Receives the state code.
+     * @param county Receives the county code.
+     * @return false if the record is plain.
+     */
+    bool Codes(std::string_view record, std::uint32_t& state, std::uint32_t& county) const;
+
+    /**
+     * @brief Reads the state code of an encoded record without decoding it.
+     * @param record The encoded record payload.
+     * @param code Receives the code.
+     * @return true if the record holds a valid state code.
+     */
+    bool StateCode(std::string_view record, std::uint32_t& code) const;
+
+    /**
+     * @brief Reads the county code of an encoded record without decoding it.
+     * @param record The encoded record payload.
+     * @param code Receives the code.
+     * @return true if the record holds a valid county code.
+     */
+    bool CountyCode(std::string_view record, std::uint32_t& code) const;
+
+    /**
+     * @brief Decodes the state of a record.
+     * @param record An encoded or plain record payload.
+     * @return The state, as FieldTokenizer would return it from the plain record.
+     */
+    std::string_view State(std::string_view record) const;
+
+    /**
+     * @brief Decodes the county of a record.
+     * @param record An encoded or plain record payload.
+     * @return The county, as FieldTokenizer would return it from the plain record.
+     */
+    std::string_view County(std::string_view record) const;
+
+    /**
+     * @brief Restores the plain form of a record.
+     * @param record An encoded or plain record payload.
+     * @return The plain record, byte for byte as it was before Encode().
+     */
+    std::string DecodeRecord(std::string_view record) const;
+
+    /**
+     * @brief Adds every value of another dictionary, in its code order.
+     * @param other The dictionary to merge.
+     * @post Codes already assigned are unchanged.
+     */
+    void Merge(const RecordDictionary& other);
+
+    /**
+     * @brief Writes the dictionary section of a header file.
+     * @param out The stream to write to.
+     */
+    void Write(std::ostream& out) const;
+
+    /**
+     * @brief Reads a dictionary section written by Write().
+     * @param in The stream, positioned at the start of the section.
+     * @return true if the section was complete.
+     * @post The dictionaries hold the values read so far.
+     */
+    bool Read(std::istream& in);
+
+    const FieldDictionary& states() const;
+    const FieldDictionary& counties() const;
+    bool empty() const;
+    void clear();
+
+private:
+    static bool fieldSpans(std::string_view record, std::size_t& stateBegin, std::size_t& countyBegin,
+                           std::size_t& countyEnd);
+    static bool parseCode(std::string_view field, std::size_t limit, std::uint32_t& code);
+
+    FieldDictionary stateValues;  /**< Raw State field text by code. */
+    FieldDictionary countyValues; /**< Raw County field text by code. */
+};
+
+#endif //ZIPCODES_RECORDDICTIONARY_H
@@ -0,0 +1,305 @@
+/**
+ * @file RecordWriter.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the RecordWriter class.
+ * @see RecordWriter.h for declaration.
+ */
+
+#include "RecordWriter.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define ZIPCODES_HAVE_POSIX_IO 1
+#endif
+
+/**
+ * @brief Constructor.
+ * @param bufferSize Bytes buffered between writes, rounded up to a multiple of ALIGNMENT.
+ * @param format Format of the length indicators.
+ */
+RecordWriter::RecordWriter(std::size_t bufferSize, LengthIndicator::Format format)
+        : buffer(nullptr), capacity(0), used(0), format(format), fd(-1), stream(nullptr), direct(false),
+          failed(false), flushedBytes(0), records(0), flushes(0) {
+    allocate(bufferSize);
+}
+
+/**
+ * @brief Flushes and closes the file.
+ */
+RecordWriter::~RecordWriter() {
+    Close();
+}
+
+/**
+ * @brief Creates or truncates a data file.
+ * @param fileName Name of the file.
+ * @param directMode When true, write around the page cache with O_DIRECT if the host allows it.
+ * @return true if the file was opened, false otherwise.
+ */
+bool RecordWriter::Open(const std::string& fileName, bool directMode) {
+    Close();
+    failed = false;
+    flushedBytes = 0;
+    records = 0;
+    flushes = 0;
+#ifdef ZIPCODES_HAVE_POSIX_IO
+#ifdef O_DIRECT
+    if (directMode) {
+        // Not every file system accepts O_DIRECT; such files are written through the page cache.
+        fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        direct = fd >= 0;
+    }
+#endif
+    if (fd < 0) {
+        fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (fd < 0) {
+        std::cerr << "Error: Unable to create the data file " << fileName << "." << std::endl;
+        return false;
+    }
+    return true;
+#else
+    (void)directMode;
+    fileStream.open(fileName, std::ios::binary | std::ios::trunc);
+    if (!fileStream.is_open()) {
+        std::cerr << "Error: Unable to create the data file " << fileName << "." << std::endl;
+        return false;
+    }
+    stream = &fileStream;
+    return true;
+#endif
+}
+
+/**
+ * @brief Writes to a stream that is already open.
+ * @param out The stream. It must outlive the writer or the next Close().
+ * @return true if the stream is usable.
+ */
+bool RecordWriter::Attach(std::ostream& out) {
+    Close();
+    failed = false;
+    records = 0;
+    flushes = 0;
+    const std::streampos start = out.tellp();
+    flushedBytes = start < 0 ? 0 : static_cast<std::uint64_t>(start);
+    stream = &out;
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief Buffers one length-indicated record.
+ * @param record The record payload.
+ * @param offset Receives the file offset of the record's length indicator.
+ * @return false if an earlier flush failed or no file is open.
+ */
+bool RecordWriter::Write(std::string_view record, std::uint64_t& offset) {
+    const std::size_t need = LengthIndicator::Size(record.size(), format) + record.size();
+    if (!reserve(need)) {
+        return false;
+    }
+    offset = flushedBytes + used;
+    used += LengthIndicator::Store(record.size(), format, buffer + used);
+    std::memcpy(buffer + used, record.data(), record.size());
+    used += record.size();
+    records++;
+    return true;
+}
+
+bool RecordWriter::Write(std::string_view record) {
+    std::uint64_t offset;
+    return Write(record, offset);
+}
+
+/**
+ * @brief Buffers bytes that already hold whole length-indicated records.
+ * @param data The records, in this writer's length indicator format.
+ * @param size Bytes in 'data'.
+ * @param records Number of records in 'data', added to recordCount().
+ * @return false if an earlier flush failed or no file is open.
+ * @details Large blocks are copied through the buffer a buffer-full at a time, so direct mode keeps
+ * its alignment.
+ */
+bool RecordWriter::WriteEncoded(const char* data, std::size_t size, std::size_t records) {
+    while (size > 0) {
+        if (used == capacity && !Flush()) {
+            return false;
+        }
+        if (!isOpen() || failed) {
+            return false;
+        }
+        const std::size_t part = std::min(size, capacity - used);
+        std::memcpy(buffer + used, data, part);
+        used += part;
+        data += part;
+        size -= part;
+    }
+    this->records += records;
+    return !failed;
+}
+
+/**
+ * @brief Hands the buffered records to the operating system.
+ * @return false if a write failed.
+ */
+bool RecordWriter::Flush() {
+    if (failed || !isOpen()) {
+        return false;
+    }
+    // Direct writes must be whole multiples of ALIGNMENT; the rest stays at the front of the buffer.
+    const std::size_t size = direct ? used - used % ALIGNMENT : used;
+    if (size == 0) {
+        return true;
+    }
+    if (!writeOut(buffer, size)) {
+        return false;
+    }
+    std::memmove(buffer, buffer + size, used - size);
+    used -= size;
+    return true;
+}
+
+/**
+ * @brief Flushes every buffered byte and closes the file, or detaches the stream.
+ * @return true if every record was written.
+ */
+bool RecordWriter::Close() {
+    if (!isOpen()) {
+        return !failed;
+    }
+    bool ok = Flush();
+#ifdef ZIPCODES_HAVE_POSIX_IO
+#ifdef O_DIRECT
+    if (ok && direct && used > 0) {
+        // The tail is not a multiple of ALIGNMENT, so it is written with direct I/O switched off.
+        const int flags = ::fcntl(fd, F_GETFL);
+        ok = flags != -1 && ::fcntl(fd, F_SETFL, flags & ~O_DIRECT) != -1;
+        direct = false;
+        ok = ok && Flush();
+    }
+#endif
+    if (fd >= 0) {
+        ok = ::close(fd) == 0 && ok;
+        fd = -1;
+    }
+#endif
+    if (stream != nullptr) {
+        ok = static_cast<bool>(stream->flush()) && ok;
+        stream = nullptr;
+    }
+    if (fileStream.is_open()) {
+        fileStream.close();
+    }
+    direct = false;
+    used = 0;
+    failed = failed || !ok;
+    return ok;
+}
+
+bool RecordWriter::isOpen() const {
+    return fd >= 0 || stream != nullptr;
+}
+
+bool RecordWriter::directIO() const {
+    return direct;
+}
+
+LengthIndicator::Format RecordWriter::lengthFormat() const {
+    return format;
+}
+
+/**
+ * @brief Number of records written since Open() or Attach().
+ */
+std::size_t RecordWriter::recordCount() const {
+    return records;
+}
+
+/**
+ * @brief File offset at which the next record will start.
+ */
+std::uint64_t RecordWriter::offset() const {
+    return flushedBytes + used;
+}
+
+/**
+ * @brief Number of write calls made so far.
+ */
+std::size_t RecordWriter::flushCount() const {
+    return flushes;
+}
+
+/**
+ * @brief Allocates an aligned buffer of at least 'bytes' bytes, keeping the buffered records.
+ */
+void RecordWriter::allocate(std::size_t bytes) {
+    const std::size_t newCapacity = (std::max(bytes, ALIGNMENT) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    std::vector<char> newStorage(newCapacity + ALIGNMENT);
+    const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(newStorage.data());
+    char* newBuffer = newStorage.data() + (ALIGNMENT - address % ALIGNMENT) % ALIGNMENT;
+    if (used > 0) {
+        std::memcpy(newBuffer, buffer, used);
+    }
+    storage.swap(newStorage);
+    buffer = newBuffer;
+    capacity = newCapacity;
+}
+
+/**
+ * @brief Makes room for 'bytes' more bytes, flushing or growing the buffer.
+ * @return false if the writer cannot accept records.
+ */
+bool RecordWriter::reserve(std::size_t bytes) {
+    if (failed || !isOpen()) {
+        return false;
+    }
+    if (capacity - used >= bytes) {
+        return true;
+    }
+    if (!Flush()) {
+        return false;
+    }
+    if (capacity - used < bytes) {
+        // A record larger than the whole buffer.
+        allocate(used + bytes);
+    }
+    return true;
+}
+
+/**
+ * @brief Writes 'size' bytes with as few calls as the operating system allows.
+ * @return false, and marks the writer failed, if a write failed.
+ */
+bool RecordWriter::writeOut(const char* data, std::size_t size) {
+    if (stream != nullptr) {
+        flushes++;
+        if (!stream->write(data, static_cast<std::streamsize>(size))) {
+            std::cerr << "Error: Unable to write the data file." << std::endl;
+            failed = true;
+            return false;
+        }
+        flushedBytes += size;
+        return true;
+    }
+#ifdef ZIPCODES_HAVE_POSIX_IO
+    std::size_t done = 0;
+    while (done < size) {
+        flushes++;
+        const ssize_t written = ::write(fd, data + done, size - done);
+        if (written <= 0) {
+            std::cerr << "Error: Unable to write the data file." << std::endl;
+            failed = true;
+            return false;
+        }
+        done += static_cast<std::size_t>(written);
+    }
+    flushedBytes += size;
+    return true;
+#else
+    failed = true;
+    return false;
+#endif
+}
@@ -0,0 +1,156 @@
+/**
+ * @file RecordWriter.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class RecordWriter
+ * @see RecordWriter.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class RecordWriter, a buffered writer of length-indicated records. Each record is
+ * serialized, length indicator first, straight into one large reusable buffer, and only whole buffers are
+ * handed to the operating system, one write call per buffer instead of two stream writes per record.
+ *
+ * Every Write() reports the file offset of the record's length indicator, and the writer counts records
+ * and bytes, so the primary key, name and spatial indexes can be built while the data file is written
+ * rather than by scanning it again afterwards.
+ *
+ * A file opened in direct mode bypasses the page cache with O_DIRECT where the host supports it. The
+ * buffer is then aligned and only flushed in multiples of ALIGNMENT bytes; the unaligned tail is written
+ * by Close() once direct I/O has been switched off for the descriptor. When the host or the file system
+ * refuses O_DIRECT the file is written through the page cache instead, and directIO() returns false.
+ *
+ * Assumptions:
+ * - Only one RecordWriter writes to a file at a time, and nothing else writes to it while it is open.
+ * - Offsets are only meaningful once the records have been flushed, by Flush() or Close().
+ * - On hosts without POSIX I/O, Open() writes through an std::ofstream and direct mode is unavailable.
+ */
+
+#ifndef ZIPCODES_RECORDWRITER_H
+#define ZIPCODES_RECORDWRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "LengthIndicator.h"
+
+class RecordWriter {
+public:
+    static constexpr std::size_t DEFAULT_BUFFER_SIZE = std::size_t(4) << 20; /**< Bytes buffered between writes. */
+    static constexpr std::size_t ALIGNMENT = 4096; /**< Alignment of the buffer and of direct writes. */
+
+    /**
+     * @brief Constructor.
+     * @param bufferSize Bytes buffered between writes, rounded up to a multiple of ALIGNMENT.
+     * @param format Format of the length indicators.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    explicit RecordWriter(std::size_t bufferSize = DEFAULT_BUFFER_SIZE,
+                          LengthIndicator::Format format = LengthIndicator::DEFAULT);
+
+    /**
+     * @brief Flushes and closes the file.
+     */
+    ~RecordWriter();
+
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+
+    /**
+     * @brief Creates or truncates a data file.
+     * @param fileName Name of the file.
+     * @param directMode When true, write around the page cache with O_DIRECT if the host allows it.
+     * @return true if the file was opened, false otherwise.
+     * @pre None.
+     * @post Records are written to 'fileName' from offset 0.
+     */
+    bool Open(const std::string& fileName, bool directMode = false);
+
+    /**
+     * @brief Writes to a stream that is already open, such as the std::ofstream of CSVReader.
+     * @param out The stream. It must outlive the writer or the next Close().
+     * @return true if the stream is usable.
+     * @pre None.
+     * @post Records are written to 'out'; offsets start at its current put position.
+     */
+    bool Attach(std::ostream& out);
+
+    /**
+     * @brief Buffers one length-indicated record.
+     * @param record The record payload.
+     * @param offset Receives the file offset of the record's length indicator.
+     * @return false if an earlier flush failed or no file is open.
+     * @pre The writer is open.
+     * @post The record is written by the next flush.
+     */
+    bool Write(std::string_view record, std::uint64_t& offset);
+
+    bool Write(std::string_view record);
+
+    /**
+     * @brief Buffers bytes that already hold whole length-indicated records.
+     * @param data The records, in this writer's length indicator format.
+     * @param size Bytes in 'data'.
+     * @param records Number of records in 'data', added to recordCount().
+     * @return false if an earlier flush failed or no file is open.
+     */
+    bool WriteEncoded(const char* data, std::size_t size, std::size_t records);
+
+    /**
+     * @brief Hands the buffered records to the operating system.
+     * @return false if a write failed.
+     * @post In direct mode up to ALIGNMENT - 1 bytes may stay buffered until Close().
+     */
+    bool Flush();
+
+    /**
+     * @brief Flushes every buffered byte and closes the file, or detaches the stream.
+     * @return true if every record was written.
+     * @post isOpen() returns false; recordCount() and offset() keep their final values.
+     */
+    bool Close();
+
+    bool isOpen() const;
+    bool directIO() const;
+    LengthIndicator::Format lengthFormat() const;
+
+    /**
+     * @brief Number of records written since Open() or Attach().
+     */
+    std::size_t recordCount() const;
+
+    /**
+     * @brief File offset at which the next record will start.
+     */
+    std::uint64_t offset() const;
+
+    /**
+     * @brief Number of write calls made so far.
+     */
+    std::size_t flushCount() const;
+
+private:
+    std::vector<char> storage;        /**< Backing store of the buffer, ALIGNMENT bytes larger than it. */
+    char* buffer;                     /**< Start of the aligned buffer inside 'storage'. */
+    std::size_t capacity;             /**< Usable bytes of the buffer, a multiple of ALIGNMENT. */
+    std::size_t used;                 /**< Bytes of the buffer holding records not yet written. */
+    LengthIndicator::Format format;   /**< Format of the length indicators. */
+    int fd;                           /**< Descriptor opened by Open(), or -1. */
+    std::ofstream fileStream;         /**< The file opened by Open() on hosts without POSIX I/O. */
+    std::ostream* stream;             /**< Stream written to, from Attach() or 'fileStream', or nullptr. */
+    bool direct;                      /**< True while the descriptor is in O_DIRECT mode. */
+    bool failed;                      /**< True after a failed write. */
+    std::uint64_t flushedBytes;       /**< File offset just past the bytes already written. */
+    std::size_t records;              /**< Records written. */
+    std::size_t flushes;              /**< Write calls made. */
+
+    void allocate(std::size_t bytes);
+    bool reserve(std::size_t bytes);
+    bool writeOut(const char* data, std::size_t size);
+};
+
+#endif //ZIPCODES_RECORDWRITER_H
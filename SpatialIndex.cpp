@@ -0,0 +1,366 @@
+/**
+ * @file SpatialIndex.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the SpatialIndexBuilder and SpatialIndex classes.
+ * @see SpatialIndex.h for declaration.
+ */
+
+#include "SpatialIndex.h"
+#include "FieldTokenizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+namespace {
+
+constexpr double DEGREES_TO_RADIANS = 3.14159265358979323846 / 180.0;
+constexpr std::uint64_t MAX_CELLS = std::uint64_t(1) << 22; /**< Upper bound on the grid size. */
+
+/**
+ * @brief Parses a coordinate field.
+ * @return true if 'field' starts with a number.
+ */
+bool parseCoordinate(std::string_view field, float& value) {
+    char text[32] = {};
+    std::memcpy(text, field.data(), std::min(field.size(), sizeof(text) - 1));
+    char* end = nullptr;
+    value = std::strtof(text, &end);
+    return end != text && std::isfinite(value);
+}
+
+} // namespace
+
+// ---------------------------------------- SpatialPoint -----------------------------------------------//
+
+/**
+ * @brief The primary key without its zero padding.
+ */
+std::string_view SpatialPoint::Key() const {
+    const void* end = std::memchr(key, '\0', sizeof(key));
+    return std::string_view(key, end == nullptr ? sizeof(key) : static_cast<const char*>(end) - key);
+}
+
+// ------------------------------------- SpatialIndexBuilder -------------------------------------------//
+
+/**
+ * @brief Constructor.
+ * @param keyField Field of a record that holds its key.
+ */
+SpatialIndexBuilder::SpatialIndexBuilder(std::size_t keyField) : keyField(keyField) {
+}
+
+/**
+ * @brief Adds the place described by one record.
+ * @param record The record payload.
+ * @param offset File offset of the record's length indicator.
+ * @return true if the record had a key and valid coordinates, false otherwise.
+ */
+bool SpatialIndexBuilder::AddRecord(std::string_view record, std::uint64_t offset) {
+    FieldViews fields;
+    FieldTokenizer::Tokenize(record, fields);
+    if (fields.size() <= std::max(SpatialIndex::LONGITUDE_FIELD, keyField)) {
+        return false;
+    }
+    SpatialPoint point;
+    KeyIndexEntry keyEntry;
+    if (fields[keyField].empty() || !keyEntry.SetKey(fields[keyField])
+        || !parseCoordinate(fields[SpatialIndex::LATITUDE_FIELD], point.latitude)
+        || !parseCoordinate(fields[SpatialIndex::LONGITUDE_FIELD], point.longitude)
+        || std::fabs(point.latitude) > 90.0f || std::fabs(point.longitude) > 180.0f) {
+        return false;
+    }
+    std::memcpy(point.key, keyEntry.key, sizeof(point.key));
+    point.offset = offset;
+    point.length = static_cast<std::uint32_t>(record.size());
+    point.reserved = 0;
+    points.push_back(point);
+    return true;
+}
+
+/**
+ * @brief Writes the collected points as a spatial index file.
+ * @param fileName Name of the index file to create.
+ * @return true if the file was written, false otherwise.
+ */
+bool SpatialIndexBuilder::Write(const std::string& fileName) const {
+    SpatialIndex::FileHeader header;
+    std::memcpy(header.magic, SpatialIndex::MAGIC, sizeof(header.magic));
+    header.version = SpatialIndex::VERSION;
+    header.byteOrder = SpatialIndex::BYTE_ORDER_MARK;
+    header.pointCount = points.size();
+    header.minLatitude = 0.0;
+    header.minLongitude = 0.0;
+    header.cellDegrees = 1.0;
+    header.rows = 1;
+    header.columns = 1;
+
+    if (!points.empty()) {
+        double maxLatitude = -90.0;
+        double maxLongitude = -180.0;
+        header.minLatitude = 90.0;
+        header.minLongitude = 180.0;
+        for (const SpatialPoint& point : points) {
+            header.minLatitude = std::min<double>(header.minLatitude, point.latitude);
+            header.minLongitude = std::min<double>(header.minLongitude, point.longitude);
+            maxLatitude = std::max<double>(maxLatitude, point.latitude);
+            maxLongitude = std::max<double>(maxLongitude, point.longitude);
+        }
+        // Square cells sized so that an average cell holds about POINTS_PER_CELL places.
+        const double latitudeSpan = std::max(maxLatitude - header.minLatitude, 0.01);
+        const double longitudeSpan = std::max(maxLongitude - header.minLongitude, 0.01);
+        const double targetCells = std::max<double>(1.0, double(points.size()) / SpatialIndex::POINTS_PER_CELL);
+        header.cellDegrees = std::max(0.01, std::sqrt(latitudeSpan * longitudeSpan / targetCells));
+        while ((std::uint64_t(latitudeSpan / header.cellDegrees) + 1) * (std::uint64_t(longitudeSpan / header.cellDegrees) + 1)
+               > MAX_CELLS) {
+            header.cellDegrees *= 2.0;
+        }
+        header.rows = static_cast<std::uint32_t>(latitudeSpan / header.cellDegrees) + 1;
+        header.columns = static_cast<std::uint32_t>(longitudeSpan / header.cellDegrees) + 1;
+    }
+
+    // Counting sort of the points by row-major cell number.
+    const std::size_t cellCount = std::size_t(header.rows) * header.columns;
+    auto cellOf = [&](const SpatialPoint& point) {
+        std::size_t row = std::min<std::size_t>(header.rows - 1,
+                static_cast<std::size_t>((point.latitude - header.minLatitude) / header.cellDegrees));
+        std::size_t column = std::min<std::size_t>(header.columns - 1,
+                static_cast<std::size_t>((point.longitude - header.minLongitude) / header.cellDegrees));
+        return row * header.columns + column;
+    };
+    std::vector<std::uint32_t> cellStart(cellCount + 1, 0);
+    for (const SpatialPoint& point : points) {
+        cellStart[cellOf(point) + 1]++;
+    }
+    for (std::size_t cell = 0; cell < cellCount; cell++) {
+        cellStart[cell + 1] += cellStart[cell];
+    }
+    std::vector<SpatialPoint> sorted(points.size());
+    std::vector<std::uint32_t> next(cellStart.begin(), cellStart.end() - 1);
+    for (const SpatialPoint& point : points) {
+        sorted[next[cellOf(point)]++] = point;
+    }
+
+    std::ofstream indexFile(fileName, std::ios::binary | std::ios::trunc);
+    if (!indexFile.is_open()) {
+        std::cerr << "Error: Failed to open the spatial index file for writing." << std::endl;
+        return false;
+    }
+    indexFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    indexFile.write(reinterpret_cast<const char*>(cellStart.data()),
+                    static_cast<std::streamsize>(cellStart.size() * sizeof(std::uint32_t)));
+    if (cellStart.size() % 2 != 0) {
+        const std::uint32_t padding = 0;
+        indexFile.write(reinterpret_cast<const char*>(&padding), sizeof(padding));
+    }
+    indexFile.write(reinterpret_cast<const char*>(sorted.data()),
+                    static_cast<std::streamsize>(sorted.size() * sizeof(SpatialPoint)));
+    return static_cast<bool>(indexFile);
+}
+
+std::size_t SpatialIndexBuilder::size() const {
+    return points.size();
+}
+
+// ---------------------------------------- SpatialIndex -----------------------------------------------//
+
+/**
+ * @brief Default constructor. No index file is open.
+ */
+SpatialIndex::SpatialIndex() : header(), cellStart(nullptr), points(nullptr) {
+}
+
+/**
+ * @brief Maps a spatial index file and validates its header.
+ * @param fileName Name of the index file.
+ * @return true if the file is a valid spatial index for this host, false otherwise.
+ */
+bool SpatialIndex::Open(const std::string& fileName) {
+    close();
+    if (!file.Open(fileName)) {
+        return false;
+    }
+    bool valid = file.size() >= sizeof(header);
+    std::uint64_t cellBytes = 0;
+    if (valid) {
+        std::memcpy(&header, file.data(), sizeof(header));
+        const std::uint64_t cellCount = std::uint64_t(header.rows) * header.columns;
+        cellBytes = (cellCount + 1) * sizeof(std::uint32_t);
+        cellBytes += cellBytes % 8;
+        valid = std::memcmp(header.magic, MAGIC, sizeof(header.magic)) == 0
+                && header.version == VERSION
+                && header.byteOrder == BYTE_ORDER_MARK
+                && header.rows > 0 && header.columns > 0 && cellCount <= MAX_CELLS
+                && header.cellDegrees > 0.0
+                && sizeof(header) + cellBytes + header.pointCount * sizeof(SpatialPoint) == file.size();
+    }
+    if (!valid) {
+        std::cerr << "Error: " << fileName << " is not a version " << VERSION << " spatial index." << std::endl;
+        close();
+        return false;
+    }
+    cellStart = reinterpret_cast<const std::uint32_t*>(file.data() + sizeof(header));
+    points = reinterpret_cast<const SpatialPoint*>(file.data() + sizeof(header) + cellBytes);
+    file.AdviseRandom();
+    return true;
+}
+
+bool SpatialIndex::isOpen() const {
+    return file.isOpen();
+}
+
+/**
+ * @brief Finds the place closest to a point.
+ * @param latitude Latitude of the point in degrees.
+ * @param longitude Longitude of the point in degrees.
+ * @param nearest Receives the closest place.
+ * @param distanceKm Receives its distance in kilometres.
+ * @param accept If set, only the places for which it returns true are considered.
+ * @return true if the index holds at least one accepted place, false otherwise.
+ */
+bool SpatialIndex::Nearest(double latitude, double longitude, SpatialPoint& nearest, double& distanceKm,
+                           const std::function<bool(const SpatialPoint&)>& accept) const {
+    if (!isOpen() || header.pointCount == 0) {
+        return false;
+    }
+    // Grow a box of cells around the point until it holds an accepted place; that place bounds the answer.
+    double best = std::numeric_limits<double>::infinity();
+    const double clampedLatitude = std::min(std::max(latitude, header.minLatitude),
+                                            header.minLatitude + header.rows * header.cellDegrees);
+    const double clampedLongitude = std::min(std::max(longitude, header.minLongitude),
+                                             header.minLongitude + header.columns * header.cellDegrees);
+    const std::uint32_t maxRing = std::max(header.rows, header.columns);
+    for (std::uint32_t ring = 0; ring <= maxRing && best == std::numeric_limits<double>::infinity(); ring++) {
+        const double reach = (ring + 0.5) * header.cellDegrees;
+        forEachPointInBox(clampedLatitude - reach, clampedLatitude + reach,
+                          clampedLongitude - reach, clampedLongitude + reach, [&](const SpatialPoint& point) {
+            const double distance = DistanceKm(latitude, longitude, point.latitude, point.longitude);
+            if (distance < best && (!accept || accept(point))) {
+                best = distance;
+            }
+        });
+    }
+
+    // Every place closer than 'best' lies in the cells overlapping the circle of that radius.
+    std::vector<SpatialPoint> candidates;
+    WithinRadius(latitude, longitude, best, candidates, accept);
+    if (candidates.empty()) {
+        return false;
+    }
+    nearest = candidates.front();
+    distanceKm = DistanceKm(latitude, longitude, nearest.latitude, nearest.longitude);
+    return true;
+}
+
+/**
+ * @brief Finds every place within a distance of a point.
+ * @param latitude Latitude of the point in degrees.
+ * @param longitude Longitude of the point in degrees.
+ * @param radiusKm Search radius in kilometres.
+ * @param found Receives the places, closest first; its previous contents are discarded.
+ * @param accept If set, only the places for which it returns true are collected.
+ */
+void SpatialIndex::WithinRadius(double latitude, double longitude, double radiusKm,
+                                std::vector<SpatialPoint>& found,
+                                const std::function<bool(const SpatialPoint&)>& accept) const {
+    found.clear();
+    if (!isOpen() || radiusKm < 0.0) {
+        return;
+    }
+    // Bounding box of a spherical cap: the latitude band is exact, the longitude half-width is
+    // asin(sin(r) / cos(latitude)) unless the cap reaches a pole.
+    const double angular = radiusKm / EARTH_RADIUS_KM;
+    const double latitudeReach = angular / DEGREES_TO_RADIANS;
+    double minLongitude = -180.0;
+    double maxLongitude = 180.0;
+    const double ratio = std::sin(angular) / std::cos(latitude * DEGREES_TO_RADIANS);
+    if (latitude + latitudeReach < 90.0 && latitude - latitudeReach > -90.0 && ratio < 1.0) {
+        const double longitudeReach = std::asin(ratio) / DEGREES_TO_RADIANS;
+        minLongitude = longitude - longitudeReach;
+        maxLongitude = longitude + longitudeReach;
+    }
+
+    std::vector<std::pair<double, SpatialPoint>> hits;
+    // A small tolerance keeps the place that defined the radius in Nearest() despite rounding.
+    const double limit = radiusKm * (1.0 + 1e-9) + 1e-9;
+    auto collect = [&](const SpatialPoint& point) {
+        const double distance = DistanceKm(latitude, longitude, point.latitude, point.longitude);
+        if (distance <= limit && (!accept || accept(point))) {
+            hits.emplace_back(distance, point);
+        }
+    };
+    // A box that crosses the antimeridian is searched as two boxes, one on each side.
+    forEachPointInBox(latitude - latitudeReach, latitude + latitudeReach,
+                      std::max(minLongitude, -180.0), std::min(maxLongitude, 180.0), collect);
+    if (minLongitude < -180.0) {
+        forEachPointInBox(latitude - latitudeReach, latitude + latitudeReach, minLongitude + 360.0, 180.0, collect);
+    }
+    if (maxLongitude > 180.0) {
+        forEachPointInBox(latitude - latitudeReach, latitude + latitudeReach, -180.0, maxLongitude - 360.0, collect);
+    }
+    std::sort(hits.begin(), hits.end(), [](const std::pair<double, SpatialPoint>& a,
+                                           const std::pair<double, SpatialPoint>& b) {
+        return a.first < b.first;
+    });
+    found.reserve(hits.size());
+    for (const auto& hit : hits) {
+        found.push_back(hit.second);
+    }
+}
+
+/**
+ * @brief Great-circle distance between two points, in kilometres (haversine formula).
+ */
+double SpatialIndex::DistanceKm(double latitude1, double longitude1, double latitude2, double longitude2) {
+    const double dLatitude = (latitude2 - latitude1) * DEGREES_TO_RADIANS;
+    const double dLongitude = (longitude2 - longitude1) * DEGREES_TO_RADIANS;
+    const double a = std::sin(dLatitude / 2) * std::sin(dLatitude / 2)
+                     + std::cos(latitude1 * DEGREES_TO_RADIANS) * std::cos(latitude2 * DEGREES_TO_RADIANS)
+                       * std::sin(dLongitude / 2) * std::sin(dLongitude / 2);
+    return 2.0 * EARTH_RADIUS_KM * std::asin(std::min(1.0, std::sqrt(a)));
+}
+
+std::size_t SpatialIndex::size() const {
+    return isOpen() ? static_cast<std::size_t>(header.pointCount) : 0;
+}
+
+void SpatialIndex::close() {
+    file.close();
+    header = FileHeader();
+    cellStart = nullptr;
+    points = nullptr;
+}
+
+/**
+ * @brief Calls 'visit' for every point in the cells overlapping a lat/lon box.
+ */
+template <typename Visitor>
+void SpatialIndex::forEachPointInBox(double minLatitude, double maxLatitude, double minLongitude, double maxLongitude,
+                                     Visitor&& visit) const {
+    const double top = header.minLatitude + header.rows * header.cellDegrees;
+    const double right = header.minLongitude + header.columns * header.cellDegrees;
+    if (maxLatitude < header.minLatitude || minLatitude > top
+        || maxLongitude < header.minLongitude || minLongitude > right) {
+        return;
+    }
+    auto clampIndex = [](double value, std::uint32_t count) {
+        return static_cast<std::uint32_t>(std::min<double>(count - 1, std::max(0.0, std::floor(value))));
+    };
+    const std::uint32_t firstRow = clampIndex((minLatitude - header.minLatitude) / header.cellDegrees, header.rows);
+    const std::uint32_t lastRow = clampIndex((maxLatitude - header.minLatitude) / header.cellDegrees, header.rows);
+    const std::uint32_t firstColumn = clampIndex((minLongitude - header.minLongitude) / header.cellDegrees, header.columns);
+    const std::uint32_t lastColumn = clampIndex((maxLongitude - header.minLongitude) / header.cellDegrees, header.columns);
+    for (std::uint32_t row = firstRow; row <= lastRow; row++) {
+        // The cells of one row are adjacent, so a row of the box is one contiguous run of points.
+        const std::size_t rowBase = std::size_t(row) * header.columns;
+        const std::uint32_t begin = cellStart[rowBase + firstColumn];
+        const std::uint32_t end = cellStart[rowBase + lastColumn + 1];
+        for (std::uint32_t i = begin; i < end; i++) {
+            visit(points[i]);
+        }
+    }
+}
@@ -0,0 +1,191 @@
+/**
+ * @file SpatialIndex.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for classes SpatialIndexBuilder and SpatialIndex
+ * @see SpatialIndex.cpp for the implementation of these functions.
+ * @details
+ * This file declares the spatial index over record coordinates. The bounding box of all places is
+ * cut into a uniform grid of square lat/lon cells. The points of a cell are stored contiguously and a
+ * prefix array gives the first point of every cell, so a query reads only the cells that overlap its
+ * search area. The index answers "nearest zip to a point" and "all zips within R km".
+ *
+ * SpatialIndexBuilder collects points while the primary index is built and writes the file.
+ * SpatialIndex maps the file and answers queries in place.
+ *
+ * File layout (version 1, host byte order, checked through 'byteOrder'):
+ * - FileHeader
+ * - uint32 cellStart[rows * columns + 1], padded to a multiple of 8 bytes
+ * - SpatialPoint[pointCount], grouped by cell in row-major order
+ *
+ * Assumptions:
+ * - Latitude and longitude are fields LATITUDE_FIELD and LONGITUDE_FIELD of a record, in degrees. The key
+ *   stored with a point is taken from the field given to the builder, the primary key field of the file.
+ * - Distances are great-circle distances on a sphere of radius EARTH_RADIUS_KM.
+ * - Longitudes lie in [-180, 180]; search areas that cross the antimeridian are split in two.
+ */
+
+#ifndef ZIPCODES_SPATIALINDEX_H
+#define ZIPCODES_SPATIALINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "KeyIndexFile.h"
+#include "MappedFile.h"
+
+/**
+ * @brief One place in the spatial index.
+ */
+struct SpatialPoint {
+    char key[KeyIndexEntry::KEY_WIDTH]; /**< Primary key of the record, padded with zero bytes. */
+    std::uint64_t offset;               /**< File offset of the record's length indicator. */
+    std::uint32_t length;               /**< Payload length of the record in bytes. */
+    float latitude;                     /**< Latitude in degrees. */
+    float longitude;                    /**< Longitude in degrees. */
+    std::uint32_t reserved;             /**< Always zero in version 1. */
+
+    /**
+     * @brief The primary key without its zero padding.
+     */
+    std::string_view Key() const;
+};
+
+static_assert(sizeof(SpatialPoint) == 40, "SpatialPoint must stay 40 bytes wide");
+
+class SpatialIndexBuilder {
+public:
+    /**
+     * @brief Constructor.
+     * @param keyField Field of a record that holds its key, PrimaryKeyIndex::KeyFieldOf() of the data file.
+     * @pre None.
+     * @post size() returns 0.
+     */
+    explicit SpatialIndexBuilder(std::size_t keyField = 0);
+
+    /**
+     * @brief Adds the place described by one record.
+     * @param record The record payload.
+     * @param offset File offset of the record's length indicator.
+     * @return true if the record had a key and valid coordinates, false otherwise.
+     * @pre None.
+     * @post The place is part of the next Write().
+     */
+    bool AddRecord(std::string_view record, std::uint64_t offset);
+
+    /**
+     * @brief Writes the collected points as a spatial index file.
+     * @param fileName Name of the index file to create.
+     * @return true if the file was written, false otherwise.
+     * @pre None.
+     * @post 'fileName' holds an index that SpatialIndex::Open() accepts.
+     */
+    bool Write(const std::string& fileName) const;
+
+    std::size_t size() const;
+
+private:
+    std::vector<SpatialPoint> points; /**< Points collected so far. */
+    std::size_t keyField;             /**< Field of a record that holds its key. */
+};
+
+class SpatialIndex {
+public:
+    static constexpr std::size_t LATITUDE_FIELD = 4;  /**< Field holding the latitude. */
+    static constexpr std::size_t LONGITUDE_FIELD = 5; /**< Field holding the longitude. */
+    static constexpr double EARTH_RADIUS_KM = 6371.0; /**< Mean Earth radius. */
+    static constexpr std::size_t POINTS_PER_CELL = 4; /**< Average cell occupancy the builder aims for. */
+
+    /**
+     * @brief Default constructor. No index file is open.
+     * @pre None.
+     * @post isOpen() returns false.
+     */
+    SpatialIndex();
+
+    /**
+     * @brief Maps a spatial index file and validates its header.
+     * @param fileName Name of the index file.
+     * @return true if the file is a valid spatial index for this host, false otherwise.
+     * @pre None.
+     * @post On success the queries search the mapping in place.
+     */
+    bool Open(const std::string& fileName);
+
+    bool isOpen() const;
+
+    /**
+     * @brief Finds the place closest to a point.
+     * @param latitude Latitude of the point in degrees.
+     * @param longitude Longitude of the point in degrees.
+     * @param nearest Receives the closest place.
+     * @param distanceKm Receives its distance in kilometres.
+     * @param accept If set, only the places for which it returns true are considered.
+     * @return true if the index holds at least one accepted place, false otherwise.
+     * @pre The index is open.
+     * @post 'nearest' and 'distanceKm' are updated only when true is returned.
+     */
+    bool Nearest(double latitude, double longitude, SpatialPoint& nearest, double& distanceKm,
+                 const std::function<bool(const SpatialPoint&)>& accept = nullptr) const;
+
+    /**
+     * @brief Finds every place within a distance of a point.
+     * @param latitude Latitude of the point in degrees.
+     * @param longitude Longitude of the point in degrees.
+     * @param radiusKm Search radius in kilometres.
+     * @param found Receives the places, closest first; its previous contents are discarded.
+     * @param accept If set, only the places for which it returns true are collected.
+     * @pre The index is open.
+     * @post Only the grid cells that overlap the search area were read.
+     */
+    void WithinRadius(double latitude, double longitude, double radiusKm, std::vector<SpatialPoint>& found,
+                      const std::function<bool(const SpatialPoint&)>& accept = nullptr) const;
+
+    /**
+     * @brief Great-circle distance between two points, in kilometres.
+     */
+    static double DistanceKm(double latitude1, double longitude1, double latitude2, double longitude2);
+
+    std::size_t size() const;
+    void close();
+
+private:
+    friend class SpatialIndexBuilder;
+
+    /**
+     * @brief On-disk header of a spatial index file.
+     */
+    struct FileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byteOrder;
+        std::uint64_t pointCount;
+        double minLatitude;
+        double minLongitude;
+        double cellDegrees;
+        std::uint32_t rows;
+        std::uint32_t columns;
+    };
+
+    static constexpr char MAGIC[8] = {'Z', 'I', 'P', 'S', 'I', 'D', 'X', '\0'};
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    /**
+     * @brief Calls 'visit' for every point in the cells overlapping a lat/lon box.
+     */
+    template <typename Visitor>
+    void forEachPointInBox(double minLatitude, double maxLatitude, double minLongitude, double maxLongitude,
+                           Visitor&& visit) const;
+
+    MappedFile file;                 /**< Mapping of the whole index file. */
+    FileHeader header;               /**< Copy of the file header. */
+    const std::uint32_t* cellStart;  /**< First point of every cell inside the mapping. */
+    const SpatialPoint* points;      /**< Points inside the mapping. */
+};
+
+#endif //ZIPCODES_SPATIALINDEX_H
@@ -0,0 +1,615 @@
+/**
+ * @file StateExtremes.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the StateExtremes class.
+ * @see StateExtremes.h for declaration.
+ */
+
+#include "StateExtremes.h"
+#include "FieldTokenizer.h"
+#include "ZipKeyIndex.h"
+#include "ZipTable.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ZIPCODES_HAVE_X86 1
+#endif
+
+namespace {
+
+constexpr std::size_t KERNEL_MAX_COUNT = std::size_t(1) << 30; /**< Largest array a kernel indexes with int32 lanes. */
+
+constexpr std::size_t SCAN_WIDTH = 128; /**< Longest row decoded by the fast path; also the read padding. */
+
+/**
+ * @brief Exact powers of ten representable as a double.
+ */
+constexpr double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/**
+ * @brief Powers of ten up to 10^8 as integers.
+ */
+constexpr std::uint64_t INTEGER_POWERS_OF_TEN[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+/**
+ * @brief Parses a coordinate field without copying it (general path).
+ * @return true if the whole field is a finite number.
+ */
+bool parseCoordinate(std::string_view field, float& value) {
+    const char* end = field.data() + field.size();
+    std::from_chars_result parsed = std::from_chars(field.data(), end, value);
+    return parsed.ec == std::errc() && parsed.ptr == end && std::isfinite(value);
+}
+
+/**
+ * @brief Splits a row with FieldTokenizer and parses its state and coordinates (general path).
+ * @return true if the row has a state and valid coordinates.
+ */
+bool decodeRow(std::string_view row, std::string_view& state, float& latitude, float& longitude) {
+    FieldViews fields;
+    FieldTokenizer::Tokenize(row, fields);
+    if (fields.size() <= StateExtremes::LONGITUDE_FIELD) {
+        return false;
+    }
+    state = fields[StateExtremes::STATE_FIELD];
+    return parseCoordinate(fields[StateExtremes::LATITUDE_FIELD], latitude)
+           && parseCoordinate(fields[StateExtremes::LONGITUDE_FIELD], longitude);
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define ZIPCODES_HAVE_FAST_DECODE 1
+
+__extension__ typedef unsigned __int128 RowMask; /**< One bit per byte of a row of up to SCAN_WIDTH bytes. */
+
+/**
+ * @brief Index of the lowest set bit of a non-zero mask.
+ */
+inline std::size_t lowestBit(RowMask mask) {
+    const std::uint64_t low = static_cast<std::uint64_t>(mask);
+    return low != 0 ? static_cast<std::size_t>(__builtin_ctzll(low))
+                    : 64 + static_cast<std::size_t>(__builtin_ctzll(static_cast<std::uint64_t>(mask >> 64)));
+}
+
+/**
+ * @brief Bitmaps of the commas, quotes and dots among 64 bytes at 'text'.
+ */
+inline void scanBlock(const char* text, std::uint64_t& commas, std::uint64_t& quotes, std::uint64_t& dots) {
+    commas = 0;
+    quotes = 0;
+    dots = 0;
+#ifdef __SSE2__
+    for (int lane = 0; lane < 4; lane++) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + 16 * lane));
+        const int shift = 16 * lane;
+        commas |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(','))))) << shift;
+        quotes |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"'))))) << shift;
+        dots |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('.'))))) << shift;
+    }
+#else
+    for (std::size_t i = 0; i < 64; i++) {
+        const std::uint64_t bit = std::uint64_t(1) << i;
+        commas |= text[i] == ',' ? bit : 0;
+        quotes |= text[i] == '"' ? bit : 0;
+        dots |= text[i] == '.' ? bit : 0;
+    }
+#endif
+}
+
+/**
+ * @brief Value of 'length' (at most eight) ASCII digits at 'text', read as one 64-bit word.
+ * @details The digits are moved to the top of the word and the bottom is filled with '0', so one
+ * digit test and three multiplications handle every length without a branch. Eight bytes at 'text'
+ * must be readable.
+ * @return false if one of the digits is not an ASCII digit.
+ */
+inline bool parseDigits(const char* text, std::size_t length, std::uint64_t& value) {
+    std::uint64_t bytes;
+    std::memcpy(&bytes, text, sizeof(bytes));
+    // Both shifts are split in two so that a length of zero or eight never shifts by 64.
+    const unsigned half = static_cast<unsigned>(4 * (8 - length));
+    bytes = ((bytes << half) << half) | ((0x3030303030303030ull >> (4 * length)) >> (4 * length));
+    const bool digits = ((bytes & 0xF0F0F0F0F0F0F0F0ull)
+                         | (((bytes + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+    bytes -= 0x3030303030303030ull;
+    bytes = bytes * 10 + (bytes >> 8);
+    bytes = (((bytes & 0x000000FF000000FFull) * 0x000F424000000064ull)
+             + (((bytes >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull)) >> 32;
+    value = bytes & 0xFFFFFFFFull;
+    return digits;
+}
+
+/**
+ * @brief Parses the decimal in bytes [begin, end) of a scanned row.
+ * @details Handles "-ddd.ffff" with up to three integer digits and fifteen fraction digits, so the
+ * mantissa fits a signed 64-bit integer; the result is the float nearest to that decimal to
+ * within a unit of a double.
+ * @return false if the field has another shape; parseCoordinate() must be used then.
+ */
+inline bool parseDecimal(const char* text, std::size_t begin, std::size_t end, RowMask dots, float& value) {
+    const bool negative = begin < end && text[begin] == '-';
+    begin += negative ? 1 : 0;
+    const RowMask dotsInField = (dots >> begin) & ((RowMask(1) << (end - begin)) - 1);
+    if (dotsInField == 0) {
+        return false;
+    }
+    const std::size_t dot = begin + lowestBit(dotsInField);
+    const std::size_t integerLength = dot - begin;
+    const std::size_t fractionLength = end - dot - 1;
+    if (integerLength == 0 || integerLength > 3 || fractionLength > 15) {
+        return false;
+    }
+    std::uint64_t integer;
+    std::uint64_t high;
+    std::uint64_t low;
+    const std::size_t highLength = std::min<std::size_t>(fractionLength, 8);
+    const bool digits = parseDigits(text + begin, integerLength, integer)
+                        & parseDigits(text + dot + 1, highLength, high)
+                        & parseDigits(text + dot + 1 + highLength, fractionLength - highLength, low);
+    if (!digits) {
+        return false;
+    }
+    const std::uint64_t mantissa = (integer * INTEGER_POWERS_OF_TEN[highLength] + high)
+                                   * INTEGER_POWERS_OF_TEN[fractionLength - highLength] + low;
+    const double magnitude = static_cast<double>(static_cast<std::int64_t>(mantissa)) / POWERS_OF_TEN[fractionLength];
+    value = static_cast<float>(negative ? -magnitude : magnitude);
+    return true;
+}
+
+/**
+ * @brief Decodes the state and coordinates of an unquoted row of at most SCAN_WIDTH bytes in one scan.
+ * @param text The row, followed by at least SCAN_WIDTH readable bytes.
+ * @param size Length of the row.
+ * @return false if the row does not fit the fast path; decodeRow() must be used then.
+ */
+inline bool decodeRowFast(const char* text, std::size_t size, std::string_view& state,
+                          float& latitude, float& longitude) {
+    if (size > SCAN_WIDTH) {
+        return false;
+    }
+    std::uint64_t commaWords[2] = {0, 0};
+    std::uint64_t quoteWords[2] = {0, 0};
+    std::uint64_t dotWords[2] = {0, 0};
+    scanBlock(text, commaWords[0], quoteWords[0], dotWords[0]);
+    if (size > 64) {
+        scanBlock(text + 64, commaWords[1], quoteWords[1], dotWords[1]);
+    }
+    const RowMask inRow = size == SCAN_WIDTH ? ~RowMask(0) : (RowMask(1) << size) - 1;
+    RowMask commas = ((RowMask(commaWords[1]) << 64) | commaWords[0]) & inRow;
+    const RowMask quotes = ((RowMask(quoteWords[1]) << 64) | quoteWords[0]) & inRow;
+    const RowMask dots = (RowMask(dotWords[1]) << 64) | dotWords[0];
+    if (quotes != 0) {
+        return false;
+    }
+    // Field i ends at comma i; the longitude ends at the sixth comma or the end of the row.
+    std::size_t comma[6];
+    for (std::size_t i = 0; i < 5; i++) {
+        if (commas == 0) {
+            return false;
+        }
+        comma[i] = lowestBit(commas);
+        commas &= commas - 1;
+    }
+    comma[5] = commas != 0 ? lowestBit(commas) : size;
+    state = std::string_view(text + comma[1] + 1, comma[2] - comma[1] - 1);
+    return parseDecimal(text, comma[3] + 1, comma[4], dots, latitude)
+           && parseDecimal(text, comma[4] + 1, comma[5], dots, longitude);
+}
+
+#endif
+
+/**
+ * @brief Portable kernel, one element at a time.
+ */
+MinMaxResult minMaxScalar(const float* values, std::size_t count) {
+    MinMaxResult result{0, 0, values[0], values[0]};
+    for (std::size_t i = 1; i < count; i++) {
+        if (values[i] < result.minValue) {
+            result.minValue = values[i];
+            result.minIndex = i;
+        }
+        if (values[i] > result.maxValue) {
+            result.maxValue = values[i];
+            result.maxIndex = i;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Merges the per-lane results of a vector kernel and finishes the tail with scalar code.
+ * @details On equal values the lower index wins, so the result is the first extreme element.
+ */
+MinMaxResult finishLanes(const float* values, std::size_t count, std::size_t done, std::size_t lanes,
+                         const float* laneMin, const std::int32_t* laneMinIndex,
+                         const float* laneMax, const std::int32_t* laneMaxIndex) {
+    MinMaxResult result{std::size_t(laneMinIndex[0]), std::size_t(laneMaxIndex[0]), laneMin[0], laneMax[0]};
+    for (std::size_t lane = 1; lane < lanes; lane++) {
+        if (laneMin[lane] < result.minValue
+            || (laneMin[lane] == result.minValue && std::size_t(laneMinIndex[lane]) < result.minIndex)) {
+            result.minValue = laneMin[lane];
+            result.minIndex = std::size_t(laneMinIndex[lane]);
+        }
+        if (laneMax[lane] > result.maxValue
+            || (laneMax[lane] == result.maxValue && std::size_t(laneMaxIndex[lane]) < result.maxIndex)) {
+            result.maxValue = laneMax[lane];
+            result.maxIndex = std::size_t(laneMaxIndex[lane]);
+        }
+    }
+    for (std::size_t i = done; i < count; i++) {
+        if (values[i] < result.minValue) {
+            result.minValue = values[i];
+            result.minIndex = i;
+        }
+        if (values[i] > result.maxValue) {
+            result.maxValue = values[i];
+            result.maxIndex = i;
+        }
+    }
+    return result;
+}
+
+#ifdef ZIPCODES_HAVE_X86
+
+/**
+ * @brief SSE2 kernel, four lanes that each track their own extreme and its index.
+ */
+__attribute__((target("sse2")))
+MinMaxResult minMaxSse2(const float* values, std::size_t count) {
+    if (count < 8) {
+        return minMaxScalar(values, count);
+    }
+    __m128 minimum = _mm_loadu_ps(values);
+    __m128 maximum = minimum;
+    __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i minIndex = index;
+    __m128i maxIndex = index;
+    const __m128i step = _mm_set1_epi32(4);
+    std::size_t i = 4;
+    for (; i + 4 <= count; i += 4) {
+        index = _mm_add_epi32(index, step);
+        const __m128 x = _mm_loadu_ps(values + i);
+        // Strict compares keep the earlier index on ties.
+        const __m128i less = _mm_castps_si128(_mm_cmplt_ps(x, minimum));
+        const __m128i greater = _mm_castps_si128(_mm_cmpgt_ps(x, maximum));
+        minimum = _mm_min_ps(x, minimum);
+        maximum = _mm_max_ps(x, maximum);
+        minIndex = _mm_or_si128(_mm_and_si128(less, index), _mm_andnot_si128(less, minIndex));
+        maxIndex = _mm_or_si128(_mm_and_si128(greater, index), _mm_andnot_si128(greater, maxIndex));
+    }
+    alignas(16) float laneMin[4], laneMax[4];
+    alignas(16) std::int32_t laneMinIndex[4], laneMaxIndex[4];
+    _mm_store_ps(laneMin, minimum);
+    _mm_store_ps(laneMax, maximum);
+    _mm_store_si128(reinterpret_cast<__m128i*>(laneMinIndex), minIndex);
+    _mm_store_si128(reinterpret_cast<__m128i*>(laneMaxIndex), maxIndex);
+    return finishLanes(values, count, i, 4, laneMin, laneMinIndex, laneMax, laneMaxIndex);
+}
+
+/**
+ * @brief AVX2 kernel, eight lanes that each track their own extreme and its index.
+ */
+__attribute__((target("avx2")))
+MinMaxResult minMaxAvx2(const float* values, std::size_t count) {
+    if (count < 16) {
+        return minMaxScalar(values, count);
+    }
+    __m256 minimum = _mm256_loadu_ps(values);
+    __m256 maximum = minimum;
+    __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i minIndex = index;
+    __m256i maxIndex = index;
+    const __m256i step = _mm256_set1_epi32(8);
+    std::size_t i = 8;
+    for (; i + 8 <= count; i += 8) {
+        index = _mm256_add_epi32(index, step);
+        const __m256 x = _mm256_loadu_ps(values + i);
+        const __m256 less = _mm256_cmp_ps(x, minimum, _CMP_LT_OQ);
+        const __m256 greater = _mm256_cmp_ps(x, maximum, _CMP_GT_OQ);
+        minimum = _mm256_min_ps(x, minimum);
+        maximum = _mm256_max_ps(x, maximum);
+        minIndex = _mm256_blendv_epi8(minIndex, index, _mm256_castps_si256(less));
+        maxIndex = _mm256_blendv_epi8(maxIndex, index, _mm256_castps_si256(greater));
+    }
+    alignas(32) float laneMin[8], laneMax[8];
+    alignas(32) std::int32_t laneMinIndex[8], laneMaxIndex[8];
+    _mm256_store_ps(laneMin, minimum);
+    _mm256_store_ps(laneMax, maximum);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(laneMinIndex), minIndex);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(laneMaxIndex), maxIndex);
+    return finishLanes(values, count, i, 8, laneMin, laneMinIndex, laneMax, laneMaxIndex);
+}
+
+#endif
+
+} // namespace
+
+/**
+ * @brief Constructor that selects the fastest kernel supported by the processor.
+ */
+StateExtremes::StateExtremes() : kernel(minMaxScalar), kernelName("scalar"), acceptedRows(0), lastStateId(0) {
+#ifdef ZIPCODES_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernel = minMaxAvx2;
+        kernelName = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        kernel = minMaxSse2;
+        kernelName = "sse2";
+    }
+#endif
+    clear();
+}
+
+/**
+ * @brief Decodes one CSV data row into the current batch.
+ * @param row The row, without its newline.
+ * @return true if the row had a state and valid coordinates, false if it was skipped.
+ */
+bool StateExtremes::AddRow(std::string_view row) {
+    // The row is copied into the batch first: the copy is padded, so the fast path may read past its end.
+    const std::size_t start = rowStarts.back();
+    if (rowText.size() < start + row.size() + SCAN_WIDTH) {
+        rowText.resize(std::max(rowText.size() * 2, start + row.size() + SCAN_WIDTH));
+    }
+    char* text = rowText.data() + start;
+    std::memcpy(text, row.data(), row.size());
+
+    std::string_view state;
+    float latitude;
+    float longitude;
+    std::uint16_t id;
+#ifdef ZIPCODES_HAVE_FAST_DECODE
+    const bool decoded = decodeRowFast(text, row.size(), state, latitude, longitude)
+                         || decodeRow(row, state, latitude, longitude);
+#else
+    const bool decoded = decodeRow(row, state, latitude, longitude);
+#endif
+    if (!decoded || state.empty() || !std::isfinite(latitude) || !std::isfinite(longitude) || !stateId(state, id)) {
+        return false;
+    }
+    latitudes.push_back(latitude);
+    longitudes.push_back(longitude);
+    stateIds.push_back(id);
+    rowStarts.push_back(static_cast<std::uint32_t>(start + row.size()));
+    acceptedRows++;
+    if (latitudes.size() == BATCH_ROWS) {
+        Flush();
+    }
+    return true;
+}
+
+/**
+ * @brief Adds every row of a columnar table.
+ * @param table The table.
+ * @return Number of rows that had a state and valid coordinates.
+ */
+std::size_t StateExtremes::AddTable(const ZipTable& table) {
+    Flush();
+    // Table state ids are mapped on first use, so a state without a valid row is never added.
+    enum : char { UNMAPPED, MAPPED, UNUSABLE };
+    std::vector<std::uint16_t> ids(table.stateCount());
+    std::vector<char> mapping(table.stateCount(), UNMAPPED);
+    const std::vector<float>& tableLatitudes = table.latitudes();
+    const std::vector<float>& tableLongitudes = table.longitudes();
+    const std::vector<std::uint16_t>& tableStates = table.stateIds();
+    const std::size_t before = acceptedRows;
+    sourceTable = &table;
+    for (std::size_t row = 0; row < table.size(); row++) {
+        const std::uint16_t id = tableStates[row];
+        if (!std::isfinite(tableLatitudes[row]) || !std::isfinite(tableLongitudes[row])) {
+            continue;
+        }
+        if (mapping[id] == UNMAPPED) {
+            const std::string_view state = table.StateName(id);
+            mapping[id] = !state.empty() && stateId(state, ids[id]) ? MAPPED : UNUSABLE;
+        }
+        if (mapping[id] == UNUSABLE) {
+            continue;
+        }
+        latitudes.push_back(tableLatitudes[row]);
+        longitudes.push_back(tableLongitudes[row]);
+        stateIds.push_back(ids[id]);
+        tableRows.push_back(static_cast<std::uint32_t>(row));
+        acceptedRows++;
+        if (latitudes.size() == BATCH_ROWS) {
+            Flush();
+        }
+    }
+    Flush();
+    sourceTable = nullptr;
+    return acceptedRows - before;
+}
+
+/**
+ * @brief Reduces the current batch into the per-state extremes.
+ * @details The batch rows are regrouped by state with a stable counting sort, so every state owns a
+ * contiguous run of latitudes and longitudes in row order. Each run is reduced by the kernel and only
+ * the winning rows are decoded into StatePlace strings.
+ */
+void StateExtremes::Flush() {
+    const std::size_t count = latitudes.size();
+    if (count == 0) {
+        return;
+    }
+    stateStart.assign(states.size() + 1, 0);
+    for (std::uint16_t id : stateIds) {
+        stateStart[id + 1]++;
+    }
+    for (std::size_t id = 0; id < states.size(); id++) {
+        stateStart[id + 1] += stateStart[id];
+    }
+    groupedLatitudes.resize(count);
+    groupedLongitudes.resize(count);
+    groupedRows.resize(count);
+    std::vector<std::uint32_t> next(stateStart.begin(), stateStart.end() - 1);
+    for (std::size_t row = 0; row < count; row++) {
+        const std::uint32_t slot = next[stateIds[row]]++;
+        groupedLatitudes[slot] = latitudes[row];
+        groupedLongitudes[slot] = longitudes[row];
+        groupedRows[slot] = static_cast<std::uint32_t>(row);
+    }
+
+    for (std::size_t id = 0; id < states.size(); id++) {
+        const std::uint32_t begin = stateStart[id];
+        const std::uint32_t end = stateStart[id + 1];
+        if (begin == end) {
+            continue;
+        }
+        StateAccumulator& state = states[id];
+        // Strict compares: a row from an earlier batch keeps its place on a tie.
+        const MinMaxResult north = MinMax(groupedLatitudes.data() + begin, end - begin);
+        if (north.maxValue > state.bestNorth) {
+            state.bestNorth = north.maxValue;
+            takePlace(groupedRows[begin + north.maxIndex], state.places.northern);
+        }
+        if (north.minValue < state.bestSouth) {
+            state.bestSouth = north.minValue;
+            takePlace(groupedRows[begin + north.minIndex], state.places.southern);
+        }
+        const MinMaxResult east = MinMax(groupedLongitudes.data() + begin, end - begin);
+        if (east.maxValue > state.bestEast) {
+            state.bestEast = east.maxValue;
+            takePlace(groupedRows[begin + east.maxIndex], state.places.eastern);
+        }
+        if (east.minValue < state.bestWest) {
+            state.bestWest = east.minValue;
+            takePlace(groupedRows[begin + east.minIndex], state.places.western);
+        }
+    }
+
+    latitudes.clear();
+    longitudes.clear();
+    stateIds.clear();
+    rowStarts.assign(1, 0);
+    tableRows.clear();
+}
+
+/**
+ * @brief The extremes of every state seen so far, ordered by state.
+ */
+std::map<std::string, StateExtremeSet> StateExtremes::Results() const {
+    std::map<std::string, StateExtremeSet> results;
+    for (const StateAccumulator& state : states) {
+        results.emplace(state.name, state.places);
+    }
+    return results;
+}
+
+/**
+ * @brief Prints one line per state with the ZIP codes of its four extreme places.
+ * @param out The stream to print to.
+ */
+void StateExtremes::Print(std::ostream& out) const {
+    out << std::left << std::setw(8) << "State" << std::setw(14) << "Easternmost" << std::setw(14) << "Westernmost"
+        << std::setw(14) << "Northernmost" << "Southernmost" << "\n";
+    for (const auto& state : Results()) {
+        out << std::setw(8) << state.first << std::setw(14) << state.second.eastern.zip
+            << std::setw(14) << state.second.western.zip << std::setw(14) << state.second.northern.zip
+            << state.second.southern.zip << "\n";
+    }
+    out << std::right << std::flush;
+}
+
+/**
+ * @brief Finds the first smallest and first largest element of an array.
+ * @param values The array.
+ * @param count Number of elements, at least one.
+ * @return Their values and indexes.
+ */
+MinMaxResult StateExtremes::MinMax(const float* values, std::size_t count) const {
+    // The vector kernels keep indexes in 32-bit lanes; longer arrays are reduced piece by piece.
+    MinMaxResult result = kernel(values, std::min(count, KERNEL_MAX_COUNT));
+    for (std::size_t done = KERNEL_MAX_COUNT; done < count; done += KERNEL_MAX_COUNT) {
+        const MinMaxResult part = kernel(values + done, std::min(count - done, KERNEL_MAX_COUNT));
+        if (part.minValue < result.minValue) {
+            result.minValue = part.minValue;
+            result.minIndex = done + part.minIndex;
+        }
+        if (part.maxValue > result.maxValue) {
+            result.maxValue = part.maxValue;
+            result.maxIndex = done + part.maxIndex;
+        }
+    }
+    return result;
+}
+
+const char* StateExtremes::KernelName() const {
+    return kernelName;
+}
+
+std::size_t StateExtremes::rowCount() const {
+    return acceptedRows;
+}
+
+/**
+ * @brief Forgets every row and every state.
+ */
+void StateExtremes::clear() {
+    latitudes.clear();
+    longitudes.clear();
+    stateIds.clear();
+    rowStarts.assign(1, 0);
+    sourceTable = nullptr;
+    tableRows.clear();
+    states.clear();
+    stateIdsByName.clear();
+    lastStateId = 0;
+    acceptedRows = 0;
+    latitudes.reserve(BATCH_ROWS);
+    longitudes.reserve(BATCH_ROWS);
+    stateIds.reserve(BATCH_ROWS);
+    rowStarts.reserve(BATCH_ROWS + 1);
+}
+
+/**
+ * @brief Maps a state abbreviation to its id, adding the state on first sight.
+ * @return false if the state table is full.
+ */
+bool StateExtremes::stateId(std::string_view state, std::uint16_t& id) {
+    // Rows of the same state usually follow each other.
+    if (lastStateId < states.size() && states[lastStateId].name == state) {
+        id = lastStateId;
+        return true;
+    }
+    auto found = stateIdsByName.find(std::string(state));
+    if (found == stateIdsByName.end()) {
+        if (states.size() > std::numeric_limits<std::uint16_t>::max()) {
+            return false;
+        }
+        const float infinity = std::numeric_limits<float>::infinity();
+        states.push_back(StateAccumulator{std::string(state), StateExtremeSet(), -infinity, infinity, -infinity, infinity});
+        found = stateIdsByName.emplace(std::string(state), static_cast<std::uint16_t>(states.size() - 1)).first;
+    }
+    lastStateId = found->second;
+    id = lastStateId;
+    return true;
+}
+
+/**
+ * @brief Decodes the zip, name and coordinates of a batch row into 'place'.
+ * The zip is zero-padded to five digits, whichever way the row was added.
+ */
+void StateExtremes::takePlace(std::uint32_t row, StatePlace& place) const {
+    char padded[ZipKeyIndex::ZIP_DIGITS];
+    if (sourceTable != nullptr) {
+        place.zip = std::string(ZipKeyIndex::Canonical(std::to_string(sourceTable->Zip(tableRows[row])), padded));
+        place.name = std::string(sourceTable->Name(tableRows[row]));
+        place.latitude = latitudes[row];
+        place.longitude = longitudes[row];
+        return;
+    }
+    const std::string_view text(rowText.data() + rowStarts[row], rowStarts[row + 1] - rowStarts[row]);
+    FieldViews fields;
+    FieldTokenizer::Tokenize(text, fields);
+    place.zip = std::string(ZipKeyIndex::Canonical(fields[ZIP_FIELD], padded));
+    place.name = std::string(fields[NAME_FIELD]);
+    place.latitude = latitudes[row];
+    place.longitude = longitudes[row];
+}
@@ -0,0 +1,199 @@
+/**
+ * @file StateExtremes.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class StateExtremes
+ * @see StateExtremes.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class StateExtremes, which finds the easternmost, westernmost, northernmost
+ * and southernmost place of every state in a single pass over the CSV rows.
+ *
+ * Rows are decoded into a columnar batch: contiguous latitude and longitude arrays, a small integer
+ * state id per row and the row text. When the batch is full it is bucketed by state with a stable
+ * counting sort, and each state's run of coordinates is reduced by a SIMD min/max-with-index kernel.
+ * Only the rows that beat a state's current extremes are ever turned into strings.
+ *
+ * Decoding is the expensive part, so unquoted rows of up to 128 bytes take a fast path: one SIMD pass
+ * builds the comma and dot bitmaps of the row, and the coordinates are parsed eight digits at a time.
+ * Other rows go through FieldTokenizer and std::from_chars. A ZipTable is already decoded, so AddTable()
+ * copies its coordinate and state columns straight into the batch.
+ *
+ * The kernel is chosen once at construction: AVX2 when the processor reports it at runtime, SSE2 as
+ * the x86-64 baseline, and a portable scalar loop everywhere else.
+ *
+ * Assumptions:
+ * - Rows follow the format Zip,Name,State,County,Latitude,Longitude.
+ * - Rows with a missing state or unreadable coordinates are skipped.
+ * - On a tie the row that came first wins, so the result is the same as a row-at-a-time scan.
+ */
+
+#ifndef ZIPCODES_STATEEXTREMES_H
+#define ZIPCODES_STATEEXTREMES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class ZipTable;
+
+/**
+ * @brief A place that is an extreme of its state.
+ */
+struct StatePlace {
+    std::string zip;        /**< The ZIP code, zero-padded to five digits. */
+    std::string name;       /**< The place name. */
+    float latitude = 0.0f;  /**< The latitude. */
+    float longitude = 0.0f; /**< The longitude. */
+};
+
+/**
+ * @brief The four extreme places of one state.
+ */
+struct StateExtremeSet {
+    StatePlace eastern;  /**< Place with the largest longitude. */
+    StatePlace western;  /**< Place with the smallest longitude. */
+    StatePlace northern; /**< Place with the largest latitude. */
+    StatePlace southern; /**< Place with the smallest latitude. */
+};
+
+/**
+ * @brief Position and value of the smallest and largest element of an array.
+ */
+struct MinMaxResult {
+    std::size_t minIndex; /**< First index holding the smallest value. */
+    std::size_t maxIndex; /**< First index holding the largest value. */
+    float minValue;       /**< The smallest value. */
+    float maxValue;       /**< The largest value. */
+};
+
+class StateExtremes {
+public:
+    static constexpr std::size_t BATCH_ROWS = 1 << 16; /**< Rows decoded before a batch is reduced. */
+    static constexpr std::size_t ZIP_FIELD = 0;        /**< Field holding the ZIP code. */
+    static constexpr std::size_t NAME_FIELD = 1;       /**< Field holding the place name. */
+    static constexpr std::size_t STATE_FIELD = 2;      /**< Field holding the state. */
+    static constexpr std::size_t LATITUDE_FIELD = 4;   /**< Field holding the latitude. */
+    static constexpr std::size_t LONGITUDE_FIELD = 5;  /**< Field holding the longitude. */
+
+    /**
+     * @brief Constructor that selects the fastest kernel supported by the processor.
+     * @pre None.
+     * @post No rows have been seen.
+     */
+    StateExtremes();
+
+    /**
+     * @brief Decodes one CSV data row into the current batch.
+     * @param row The row, without its newline.
+     * @return true if the row had a state and valid coordinates, false if it was skipped.
+     * @pre None.
+     * @post The row takes part in the next Flush(). A full batch is flushed automatically.
+     */
+    bool AddRow(std::string_view row);
+
+    /**
+     * @brief Adds every row of a columnar table.
+     * @param table The table.
+     * @return Number of rows that had a state and valid coordinates.
+     * @pre None.
+     * @post The rows take part in Results() without a further Flush().
+     */
+    std::size_t AddTable(const ZipTable& table);
+
+    /**
+     * @brief Reduces the current batch into the per-state extremes.
+     * @pre None.
+     * @post The batch is empty and Results() reflects every row added so far.
+     */
+    void Flush();
+
+    /**
+     * @brief The extremes of every state seen so far, ordered by state.
+     * @pre Flush() was called after the last AddRow().
+     * @post None.
+     */
+    std::map<std::string, StateExtremeSet> Results() const;
+
+    /**
+     * @brief Prints one line per state with the ZIP codes of its four extreme places.
+     * @param out The stream to print to.
+     * @pre Flush() was called after the last AddRow().
+     * @post None.
+     */
+    void Print(std::ostream& out) const;
+
+    /**
+     * @brief Finds the first smallest and first largest element of an array.
+     * @param values The array.
+     * @param count Number of elements, at least one.
+     * @return Their values and indexes.
+     */
+    MinMaxResult MinMax(const float* values, std::size_t count) const;
+
+    /**
+     * @brief Name of the kernel in use, "avx2", "sse2" or "scalar".
+     */
+    const char* KernelName() const;
+
+    /**
+     * @brief Number of rows that were accepted by AddRow().
+     */
+    std::size_t rowCount() const;
+
+    /**
+     * @brief Forgets every row and every state.
+     */
+    void clear();
+
+    /**
+     * @brief Signature shared by the min/max-with-index kernels.
+     */
+    using Kernel = MinMaxResult (*)(const float* values, std::size_t count);
+
+private:
+    /**
+     * @brief Current extremes of one state; the 'best' values are compared before any string is built.
+     */
+    struct StateAccumulator {
+        std::string name;
+        StateExtremeSet places;
+        float bestEast;
+        float bestWest;
+        float bestNorth;
+        float bestSouth;
+    };
+
+    bool stateId(std::string_view state, std::uint16_t& id);
+    void takePlace(std::uint32_t row, StatePlace& place) const;
+
+    Kernel kernel;                  /**< Selected min/max kernel. */
+    const char* kernelName;         /**< Name of the selected kernel. */
+    std::size_t acceptedRows;       /**< Rows accepted since construction or clear(). */
+
+    // Columnar batch.
+    std::vector<float> latitudes;        /**< Latitude of every batch row. */
+    std::vector<float> longitudes;       /**< Longitude of every batch row. */
+    std::vector<std::uint16_t> stateIds; /**< State id of every batch row. */
+    std::vector<std::uint32_t> rowStarts; /**< Start of every batch row in 'rowText', plus its end. */
+    std::vector<char> rowText;           /**< Text of the batch rows, back to back, with read padding. */
+    const ZipTable* sourceTable;         /**< Table the batch was filled from by AddTable(), or nullptr. */
+    std::vector<std::uint32_t> tableRows; /**< Table row of every batch row filled by AddTable(). */
+
+    // Scratch arrays for the rows regrouped by state.
+    std::vector<std::uint32_t> stateStart;
+    std::vector<float> groupedLatitudes;
+    std::vector<float> groupedLongitudes;
+    std::vector<std::uint32_t> groupedRows;
+
+    std::vector<StateAccumulator> states;                          /**< Extremes by state id. */
+    std::unordered_map<std::string, std::uint16_t> stateIdsByName; /**< State id by state abbreviation. */
+    std::uint16_t lastStateId;                                     /**< Id of the state of the previous row. */
+};
+
+#endif //ZIPCODES_STATEEXTREMES_H
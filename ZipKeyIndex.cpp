@@ -0,0 +1,176 @@
+/**
+ * @file ZipKeyIndex.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the ZipKeyIndex class.
+ * @see ZipKeyIndex.h for declaration.
+ */
+
+#include "ZipKeyIndex.h"
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @brief Default constructor. The index is empty.
+ */
+ZipKeyIndex::ZipKeyIndex() : indexMode(Mode::Empty), keyCount(0) {
+}
+
+/**
+ * @brief Builds the index from a range of key index entries.
+ * @param begin First entry.
+ * @param end One past the last entry.
+ */
+void ZipKeyIndex::Build(const KeyIndexEntry* begin, const KeyIndexEntry* end) {
+    clear();
+    keyCount = static_cast<std::size_t>(end - begin);
+
+    direct.assign(DIRECT_SLOTS, Slot{ABSENT, 0});
+    bool numeric = true;
+    for (const KeyIndexEntry* entry = begin; entry != end && numeric; ++entry) {
+        std::uint32_t zip;
+        numeric = ParseZip(entry->Key(), zip);
+        // "501" and "00501" share a slot; the first of them in key order keeps it.
+        if (numeric && direct[zip].offset == ABSENT) {
+            direct[zip] = Slot{entry->offset, entry->length};
+        }
+    }
+    if (numeric) {
+        indexMode = Mode::Direct;
+        return;
+    }
+
+    // The zips among the keys are stored padded, so both modes answer the same lookups.
+    std::vector<Slot>().swap(direct);
+    sorted.assign(begin, end);
+    char padded[ZIP_DIGITS];
+    for (KeyIndexEntry& entry : sorted) {
+        const std::string_view key = Canonical(entry.Key(), padded);
+        if (key.data() == padded) {
+            entry.SetKey(key);
+        }
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const KeyIndexEntry& a, const KeyIndexEntry& b) {
+        return std::memcmp(a.key, b.key, KeyIndexEntry::KEY_WIDTH) < 0;
+    });
+    indexMode = Mode::Sorted;
+}
+
+/**
+ * @brief Looks a key up.
+ * @param key The primary key.
+ * @param location Receives the record location.
+ * @return true if the key is in the index, false otherwise.
+ */
+bool ZipKeyIndex::Find(std::string_view key, RecordLocation& location) const {
+    if (indexMode == Mode::Direct) {
+        std::uint32_t zip;
+        return ParseZip(key, zip) && Find(zip, location);
+    }
+    if (indexMode == Mode::Sorted) {
+        KeyIndexEntry probe;
+        char padded[ZIP_DIGITS];
+        if (!probe.SetKey(Canonical(key, padded))) {
+            return false;
+        }
+        auto found = std::lower_bound(sorted.begin(), sorted.end(), probe,
+                                      [](const KeyIndexEntry& a, const KeyIndexEntry& b) {
+                                          return std::memcmp(a.key, b.key, KeyIndexEntry::KEY_WIDTH) < 0;
+                                      });
+        if (found == sorted.end() || std::memcmp(found->key, probe.key, KeyIndexEntry::KEY_WIDTH) != 0) {
+            return false;
+        }
+        location = RecordLocation{found->offset, found->length};
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Looks a numeric zip up.
+ * @param zip The zip code.
+ * @param location Receives the record location.
+ * @return true if the zip is in the index, false otherwise.
+ */
+bool ZipKeyIndex::Find(std::uint32_t zip, RecordLocation& location) const {
+    if (indexMode == Mode::Direct) {
+        if (zip >= DIRECT_SLOTS || direct[zip].offset == ABSENT) {
+            return false;
+        }
+        location = RecordLocation{direct[zip].offset, direct[zip].length};
+        return true;
+    }
+    if (indexMode == Mode::Sorted && zip < DIRECT_SLOTS) {
+        char digits[ZIP_DIGITS];
+        for (std::size_t i = ZIP_DIGITS; i-- > 0; zip /= 10) {
+            digits[i] = static_cast<char>('0' + zip % 10);
+        }
+        return Find(std::string_view(digits, ZIP_DIGITS), location);
+    }
+    return false;
+}
+
+/**
+ * @brief Parses a key of one to five decimal digits.
+ * @param key The key to parse.
+ * @param zip Receives the numeric value.
+ * @return true if 'key' is a five-digit-or-shorter number, false otherwise.
+ */
+bool ZipKeyIndex::ParseZip(std::string_view key, std::uint32_t& zip) {
+    if (key.empty() || key.size() > 5) {
+        return false;
+    }
+    std::uint32_t value = 0;
+    for (char c : key) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + static_cast<std::uint32_t>(c - '0');
+    }
+    zip = value;
+    return true;
+}
+
+/**
+ * @brief Canonical form of a key: a zip of one to five digits is zero-padded to ZIP_DIGITS.
+ * @param key The key.
+ * @param buffer Room for ZIP_DIGITS characters; receives the padded zip.
+ * @return The padded zip in 'buffer', or 'key' itself if it is not a zip.
+ */
+std::string_view ZipKeyIndex::Canonical(std::string_view key, char* buffer) {
+    std::uint32_t zip;
+    if (key.size() == ZIP_DIGITS || !ParseZip(key, zip)) {
+        return key;
+    }
+    const std::size_t padding = ZIP_DIGITS - key.size();
+    std::memset(buffer, '0', padding);
+    std::memcpy(buffer + padding, key.data(), key.size());
+    return std::string_view(buffer, ZIP_DIGITS);
+}
+
+/**
+ * @brief Checks whether two keys name the same record once both are in canonical form.
+ * @return true for equal keys and for zips that differ only in leading zeros.
+ */
+bool ZipKeyIndex::SameKey(std::string_view a, std::string_view b) {
+    char paddedA[ZIP_DIGITS];
+    char paddedB[ZIP_DIGITS];
+    return a == b || Canonical(a, paddedA) == Canonical(b, paddedB);
+}
+
+ZipKeyIndex::Mode ZipKeyIndex::mode() const {
+    return indexMode;
+}
+
+std::size_t ZipKeyIndex::size() const {
+    return keyCount;
+}
+
+/**
+ * @brief Releases the table.
+ */
+void ZipKeyIndex::clear() {
+    std::vector<Slot>().swap(direct);
+    std::vector<KeyIndexEntry>().swap(sorted);
+    indexMode = Mode::Empty;
+    keyCount = 0;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file ZipKeyIndex.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class ZipKeyIndex
+ * @see ZipKeyIndex.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class ZipKeyIndex, an in-memory primary key index specialised for zip codes.
+ * When every key is a number of at most five digits the record locations are stored in a dense
+ * 100,000-slot table addressed directly by the zip, so a lookup is one array access and touches a
+ * single cache line. Unused slots hold the ABSENT sentinel. Any other key set falls back to a sorted
+ * flat vector of KeyIndexEntry that is binary-searched.
+ *
+ * Assumptions:
+ * - The table is built from the entries of a KeyIndexFile, which are unique and sorted.
+ * - Numeric keys that differ only in leading zeros ("501" and "00501") name the same zip, in both modes:
+ *   the sorted vector stores and looks up zips zero-padded to ZIP_DIGITS. When a key set holds both forms
+ *   of a zip, the first in key order is kept.
+ */
+
+#ifndef ZIPCODES_ZIPKEYINDEX_H
+#define ZIPCODES_ZIPKEYINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+#include "KeyIndexFile.h"
+
+/**
+ * @brief Where a record lives in the data file.
+ */
+struct RecordLocation {
+    std::uint64_t offset; /**< File offset of the record's length indicator. */
+    std::uint32_t length; /**< Payload length of the record in bytes. */
+};
+
+class ZipKeyIndex {
+public:
+    /**
+     * @brief How the keys are stored.
+     */
+    enum class Mode {
+        Empty,  /**< Nothing has been built. */
+        Direct, /**< Dense table addressed by the numeric zip. */
+        Sorted  /**< Sorted flat vector, binary-searched. */
+    };
+
+    static constexpr std::size_t DIRECT_SLOTS = 100000; /**< One slot per five-digit zip. */
+    static constexpr std::size_t ZIP_DIGITS = 5;        /**< Digits of a zip in canonical form. */
+    static constexpr std::uint64_t ABSENT = std::numeric_limits<std::uint64_t>::max(); /**< Offset of an unused slot. */
+
+    /**
+     * @brief Default constructor. The index is empty.
+     * @pre None.
+     * @post mode() returns Mode::Empty.
+     */
+    ZipKeyIndex();
+
+    /**
+     * @brief Builds the index from a range of key index entries.
+     * @param begin First entry.
+     * @param end One past the last entry.
+     * @pre The keys in the range are unique.
+     * @post A zip is found by each of its forms ("501", "00501", 501).
+     * @post mode() is Mode::Direct if every key is a zip of at most five digits, otherwise Mode::Sorted.
+     */
+    void Build(const KeyIndexEntry* begin, const KeyIndexEntry* end);
+
+    /**
+     * @brief Looks a key up.
+     * @param key The primary key.
+     * @param location Receives the record location.
+     * @return true if the key is in the index, false otherwise.
+     * @pre None.
+     * @post 'location' is updated only when true is returned.
+     */
+    bool Find(std::string_view key, RecordLocation& location) const;
+
+    /**
+     * @brief Looks a numeric zip up, as its zero-padded five-digit key.
+     * @param zip The zip code.
+     * @param location Receives the record location.
+     * @return true if the zip is in the index, false otherwise.
+     * @pre None.
+     * @post 'location' is updated only when true is returned.
+     */
+    bool Find(std::uint32_t zip, RecordLocation& location) const;
+
+    /**
+     * @brief Parses a key of one to five decimal digits.
+     * @param key The key to parse.
+     * @param zip Receives the numeric value.
+     * @return true if 'key' is a five-digit-or-shorter number, false otherwise.
+     */
+    static bool ParseZip(std::string_view key, std::uint32_t& zip);
+
+    /**
+     * @brief Canonical form of a key: a zip of one to five digits is zero-padded to ZIP_DIGITS.
+     * @param key The key.
+     * @param buffer Room for ZIP_DIGITS characters; receives the padded zip.
+     * @return The padded zip in 'buffer', or 'key' itself if it is not a zip.
+     */
+    static std::string_view Canonical(std::string_view key, char* buffer);
+
+    /**
+     * @brief Checks whether two keys name the same record once both are in canonical form.
+     * @return true for equal keys and for zips that differ only in leading zeros.
+     */
+    static bool SameKey(std::string_view a, std::string_view b);
+
+    Mode mode() const;
+    std::size_t size() const;
+
+    /**
+     * @brief Releases the table.
+     * @pre None.
+     * @post mode() returns Mode::Empty.
+     */
+    void clear();
+
+private:
+    /**
+     * @brief One slot of the direct table. 16 bytes, so a slot never straddles a cache line.
+     */
+    struct alignas(16) Slot {
+        std::uint64_t offset;
+        std::uint32_t length;
+    };
+
+    Mode indexMode;                    /**< Current storage mode. */
+    std::size_t keyCount;              /**< Number of keys stored. */
+    std::vector<Slot> direct;          /**< DIRECT_SLOTS slots in Mode::Direct. */
+    std::vector<KeyIndexEntry> sorted; /**< Sorted entries in Mode::Sorted. */
+};
+
+#endif //ZIPCODES_ZIPKEYINDEX_H
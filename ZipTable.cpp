@@ -0,0 +1,333 @@
+/**
+ * @file ZipTable.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Member function definitions for the ZipTable class.
+ * @see ZipTable.h for declaration.
+ */
+
+#include "ZipTable.h"
+#include "CSVReader.h"
+#include "FieldTokenizer.h"
+#include "MappedDataFile.h"
+#include "ZipKeyIndex.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace {
+
+/**
+ * @brief Parses a coordinate field, or yields NaN.
+ */
+float parseCoordinate(std::string_view field) {
+    float value = 0.0f;
+    const char* end = field.data() + field.size();
+    std::from_chars_result parsed = std::from_chars(field.data(), end, value);
+    if (parsed.ec != std::errc() || parsed.ptr != end || field.empty()) {
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+    return value;
+}
+
+} // namespace
+
+/**
+ * @brief Default constructor. The table is empty.
+ */
+ZipTable::ZipTable() : zipsSorted(true) {
+    nameOffsets.push_back(0);
+}
+
+/**
+ * @brief Loads every record of a length-indicated data file.
+ * @param fileName Name of the data file.
+ * @param dataOffset Offset of the first record, used to skip a header block.
+ * @param dictionary The State and County dictionaries of a dictionary-encoded file, or nullptr.
+ * @param format Format of the length indicators of the data file.
+ * @param dataSize Bytes of records after 'dataOffset', or MappedDataFile::TO_END_OF_FILE.
+ * @return true if the file could be read, false otherwise.
+ */
+bool ZipTable::Load(const std::string& fileName, std::uint64_t dataOffset, const RecordDictionary* dictionary,
+                    LengthIndicator::Format format, std::uint64_t dataSize) {
+    clear();
+    if (dictionary != nullptr) {
+        states = dictionary->states();
+        counties = dictionary->counties();
+    }
+    MappedDataFile dataFile;
+    if (dataFile.Open(fileName, dataOffset, format, dataSize)) {
+        dataFile.mapping().AdviseSequential();
+        // Records are rarely shorter than 40 bytes, so this reserves a little more than needed.
+        const std::size_t estimate = dataFile.size() / 40;
+        zipColumn.reserve(estimate);
+        latitudeColumn.reserve(estimate);
+        longitudeColumn.reserve(estimate);
+        stateColumn.reserve(estimate);
+        countyColumn.reserve(estimate);
+        nameOffsets.reserve(estimate + 1);
+        for (const RecordView& record : dataFile) {
+            addRecord(record.data, dictionary);
+        }
+    } else {
+        std::ifstream inputFile(fileName, std::ios::binary);
+        if (!inputFile) {
+            std::cerr << "Failed to open input file." << std::endl;
+            return false;
+        }
+        const std::uint64_t dataEnd = dataSize == MappedDataFile::TO_END_OF_FILE ? dataSize : dataOffset + dataSize;
+        inputFile.seekg(static_cast<std::streamoff>(dataOffset));
+        while (inputFile && static_cast<std::uint64_t>(inputFile.tellg()) < dataEnd) {
+            std::pair<std::size_t, std::string> record = CSVReader::ReadFromFile(inputFile, format);
+            if (record.first == 0) {
+                break; // End of file reached
+            }
+            if (MappedDataFile::IsTombstone(record.second)) {
+                continue;
+            }
+            addRecord(record.second, dictionary);
+        }
+    }
+    // The estimate above over-reserves; give the slack back since the table is usually kept for long.
+    zipColumn.shrink_to_fit();
+    latitudeColumn.shrink_to_fit();
+    longitudeColumn.shrink_to_fit();
+    stateColumn.shrink_to_fit();
+    countyColumn.shrink_to_fit();
+    nameOffsets.shrink_to_fit();
+    names.shrink_to_fit();
+    indexZips();
+    return true;
+}
+
+/**
+ * @brief Appends one record.
+ * @param record The record payload.
+ * @return true if the record had a numeric zip, false if it was skipped.
+ */
+bool ZipTable::AddRecord(std::string_view record) {
+    return addRecord(record, nullptr);
+}
+
+/**
+ * @brief Appends one plain or dictionary-encoded record.
+ * @param record The record payload.
+ * @param dictionary The dictionaries of an encoded record, or nullptr for a plain one.
+ * @return true if the record had a numeric zip, false if it was skipped.
+ */
+bool ZipTable::addRecord(std::string_view record, const RecordDictionary* dictionary) {
+    FieldViews fields;
+    FieldTokenizer::Tokenize(record, fields);
+    std::uint32_t zip;
+    if (fields.size() <= ZIP_FIELD || !ZipKeyIndex::ParseZip(fields[ZIP_FIELD], zip)) {
+        return false;
+    }
+    auto field = [&fields](std::size_t ordinal) {
+        return ordinal < fields.size() ? fields[ordinal] : std::string_view();
+    };
+    // An encoded record already holds the ids; the table's dictionaries are copies of the file's.
+    std::uint32_t stateId;
+    std::uint32_t countyId;
+    if (dictionary == nullptr || !dictionary->Codes(record, stateId, countyId)) {
+        stateId = states.Encode(field(STATE_FIELD));
+        countyId = counties.Encode(field(COUNTY_FIELD));
+    }
+    if (stateId > std::numeric_limits<std::uint16_t>::max()) {
+        return false;
+    }
+    if (!zipColumn.empty() && zip < zipColumn.back()) {
+        zipsSorted = false;
+        zipOrder.clear();
+    }
+    zipColumn.push_back(zip);
+    latitudeColumn.push_back(parseCoordinate(field(LATITUDE_FIELD)));
+    longitudeColumn.push_back(parseCoordinate(field(LONGITUDE_FIELD)));
+    stateColumn.push_back(static_cast<std::uint16_t>(stateId));
+    countyColumn.push_back(countyId);
+    names.append(field(NAME_FIELD).data(), field(NAME_FIELD).size());
+    nameOffsets.push_back(static_cast<std::uint32_t>(names.size()));
+    return true;
+}
+
+/**
+ * @brief Finds the first row holding a zip code.
+ * @param zip The zip code.
+ * @return The row, or NOT_FOUND.
+ */
+std::size_t ZipTable::FindZip(std::uint32_t zip) const {
+    if (zipsSorted) {
+        auto found = std::lower_bound(zipColumn.begin(), zipColumn.end(), zip);
+        return found != zipColumn.end() && *found == zip ? static_cast<std::size_t>(found - zipColumn.begin())
+                                                         : NOT_FOUND;
+    }
+    if (zipOrder.size() == zipColumn.size()) {
+        auto found = std::lower_bound(zipOrder.begin(), zipOrder.end(), zip, [this](std::uint32_t row, std::uint32_t value) {
+            return zipColumn[row] < value;
+        });
+        return found != zipOrder.end() && zipColumn[*found] == zip ? *found : NOT_FOUND;
+    }
+    auto found = std::find(zipColumn.begin(), zipColumn.end(), zip);
+    return found != zipColumn.end() ? static_cast<std::size_t>(found - zipColumn.begin()) : NOT_FOUND;
+}
+
+/**
+ * @brief Finds the rows of many zip codes at once.
+ * @param zips The zip codes, in any order.
+ * @param rows Receives the row of every zip, or NOT_FOUND, in the order of 'zips'.
+ */
+void ZipTable::FindZips(const std::vector<std::uint32_t>& zips, std::vector<std::size_t>& rows) const {
+    rows.assign(zips.size(), NOT_FOUND);
+    if (!zipsSorted && zipOrder.size() != zipColumn.size()) {
+        for (std::size_t i = 0; i < zips.size(); i++) {
+            rows[i] = FindZip(zips[i]);
+        }
+        return;
+    }
+    std::vector<std::uint32_t> queries(zips.size());
+    std::iota(queries.begin(), queries.end(), 0);
+    std::sort(queries.begin(), queries.end(), [&zips](std::uint32_t a, std::uint32_t b) {
+        return zips[a] < zips[b];
+    });
+    // Sorted queries only move forward through the sorted zips, so each search starts at the last hit.
+    const std::size_t count = zipColumn.size();
+    auto zipAt = [this](std::size_t rank) {
+        return zipsSorted ? zipColumn[rank] : zipColumn[zipOrder[rank]];
+    };
+    std::size_t low = 0;
+    for (std::uint32_t query : queries) {
+        const std::uint32_t zip = zips[query];
+        std::size_t high = count;
+        while (low < high) {
+            const std::size_t middle = low + (high - low) / 2;
+            if (zipAt(middle) < zip) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        if (low < count && zipAt(low) == zip) {
+            rows[query] = zipsSorted ? low : zipOrder[low];
+        }
+    }
+}
+
+std::size_t ZipTable::size() const {
+    return zipColumn.size();
+}
+
+const std::vector<std::uint32_t>& ZipTable::zips() const {
+    return zipColumn;
+}
+
+const std::vector<float>& ZipTable::latitudes() const {
+    return latitudeColumn;
+}
+
+const std::vector<float>& ZipTable::longitudes() const {
+    return longitudeColumn;
+}
+
+const std::vector<std::uint16_t>& ZipTable::stateIds() const {
+    return stateColumn;
+}
+
+const std::vector<std::uint32_t>& ZipTable::countyIds() const {
+    return countyColumn;
+}
+
+std::uint32_t ZipTable::Zip(std::size_t row) const {
+    return zipColumn[row];
+}
+
+float ZipTable::Latitude(std::size_t row) const {
+    return latitudeColumn[row];
+}
+
+float ZipTable::Longitude(std::size_t row) const {
+    return longitudeColumn[row];
+}
+
+std::string_view ZipTable::Name(std::size_t row) const {
+    return std::string_view(names.data() + nameOffsets[row], nameOffsets[row + 1] - nameOffsets[row]);
+}
+
+std::string_view ZipTable::State(std::size_t row) const {
+    return StateName(stateColumn[row]);
+}
+
+std::string_view ZipTable::County(std::size_t row) const {
+    return CountyName(countyColumn[row]);
+}
+
+std::size_t ZipTable::stateCount() const {
+    return states.size();
+}
+
+std::size_t ZipTable::countyCount() const {
+    return counties.size();
+}
+
+std::string_view ZipTable::StateName(std::uint16_t stateId) const {
+    return states.Decode(stateId);
+}
+
+std::string_view ZipTable::CountyName(std::uint32_t countyId) const {
+    return counties.Decode(countyId);
+}
+
+/**
+ * @brief Bytes held by the columns, dictionaries and name blob.
+ */
+std::size_t ZipTable::MemoryBytes() const {
+    std::size_t bytes = zipColumn.capacity() * sizeof(std::uint32_t)
+                        + latitudeColumn.capacity() * sizeof(float)
+                        + longitudeColumn.capacity() * sizeof(float)
+                        + stateColumn.capacity() * sizeof(std::uint16_t)
+                        + countyColumn.capacity() * sizeof(std::uint32_t)
+                        + nameOffsets.capacity() * sizeof(std::uint32_t)
+                        + names.capacity()
+                        + zipOrder.capacity() * sizeof(std::uint32_t);
+    for (const FieldDictionary* dictionary : {&states, &counties}) {
+        for (const std::string& value : dictionary->values()) {
+            bytes += sizeof(std::string) + value.capacity();
+        }
+    }
+    return bytes;
+}
+
+/**
+ * @brief Removes every row and dictionary entry.
+ */
+void ZipTable::clear() {
+    zipColumn.clear();
+    latitudeColumn.clear();
+    longitudeColumn.clear();
+    stateColumn.clear();
+    countyColumn.clear();
+    nameOffsets.assign(1, 0);
+    names.clear();
+    states.clear();
+    counties.clear();
+    zipsSorted = true;
+    zipOrder.clear();
+}
+
+/**
+ * @brief Sorts the rows by zip into 'zipOrder' when the zip column itself is not sorted.
+ */
+void ZipTable::indexZips() {
+    zipOrder.clear();
+    if (zipsSorted) {
+        return;
+    }
+    zipOrder.resize(zipColumn.size());
+    std::iota(zipOrder.begin(), zipOrder.end(), 0);
+    // Stable, so the first row of a repeated zip is found first, as in a sorted column.
+    std::stable_sort(zipOrder.begin(), zipOrder.end(), [this](std::uint32_t a, std::uint32_t b) {
+        return zipColumn[a] < zipColumn[b];
+    });
+}
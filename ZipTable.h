@@ -0,0 +1,150 @@
+/**
+ * @file ZipTable.h
+ * @callergraph
+ * @callgraph
+ * @author Fabian MullerDahlberg
+ * @brief Declarations for class ZipTable
+ * @see ZipTable.cpp for the implementation of these functions.
+ * @details
+ * This file declares the class ZipTable, an in-memory columnar (structure-of-arrays) copy of the data file.
+ * Each attribute of a record lives in its own contiguous array, so a scan over coordinates or zips
+ * touches only the bytes it needs:
+ * - zip, latitude and longitude are plain arrays of uint32 and float;
+ * - state and county are dictionary encoded: each row stores a small integer id and the distinct
+ *   strings are stored once;
+ * - place names are stored back to back in one blob and addressed by offset.
+ *
+ * A row costs about 30 bytes plus its name, against well over 100 bytes for a Row with its three
+ * std::string members.
+ *
+ * Assumptions:
+ * - Records follow the format Zip,Name,State,County,Latitude,Longitude.
+ * - Zip codes are numbers of at most five digits; other records are not loaded.
+ * - A missing or unreadable coordinate is stored as NaN.
+ * - Records of a dictionary-encoded data file keep their codes as ids; no State or County text is read.
+ * - Zip searches use binary search when the zip column is sorted or after Load() has indexed it;
+ *   rows appended later with AddRecord() out of zip order are searched linearly until the next Load().
+ */
+
+#ifndef ZIPCODES_ZIPTABLE_H
+#define ZIPCODES_ZIPTABLE_H
+
+#include "FieldDictionary.h"
+#include "LengthIndicator.h"
+#include "MappedDataFile.h"
+#include "RecordDictionary.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ZipTable {
+public:
+    static constexpr std::size_t NOT_FOUND = static_cast<std::size_t>(-1); /**< Row returned for a missing zip. */
+    static constexpr std::size_t ZIP_FIELD = 0;       /**< Field holding the ZIP code. */
+    static constexpr std::size_t NAME_FIELD = 1;      /**< Field holding the place name. */
+    static constexpr std::size_t STATE_FIELD = 2;     /**< Field holding the state. */
+    static constexpr std::size_t COUNTY_FIELD = 3;    /**< Field holding the county. */
+    static constexpr std::size_t LATITUDE_FIELD = 4;  /**< Field holding the latitude. */
+    static constexpr std::size_t LONGITUDE_FIELD = 5; /**< Field holding the longitude. */
+
+    /**
+     * @brief Default constructor. The table is empty.
+     * @pre None.
+     * @post size() returns 0.
+     */
+    ZipTable();
+
+    /**
+     * @brief Loads every record of a length-indicated data file.
+     * @param fileName Name of the data file.
+     * @param dataOffset Offset of the first record, used to skip a header block.
+     * @param dictionary The State and County dictionaries of a dictionary-encoded file, or nullptr.
+     * @param format Format of the length indicators of the data file.
+     * @param dataSize Bytes of records after 'dataOffset', HeaderRecord::getDataSize() of the file.
+     * @return true if the file could be read, false otherwise.
+     * @pre None.
+     * @post The table holds one row per loadable record, in file order, and zip searches are indexed.
+     * The state and county ids of an encoded file are its codes.
+     */
+    bool Load(const std::string& fileName, std::uint64_t dataOffset = 0, const RecordDictionary* dictionary = nullptr,
+              LengthIndicator::Format format = LengthIndicator::DEFAULT,
+              std::uint64_t dataSize = MappedDataFile::TO_END_OF_FILE);
+
+    /**
+     * @brief Appends one record.
+     * @param record The record payload.
+     * @return true if the record had a numeric zip, false if it was skipped.
+     * @pre None.
+     * @post The record is the last row of the table.
+     */
+    bool AddRecord(std::string_view record);
+
+    /**
+     * @brief Finds the first row holding a zip code.
+     * @param zip The zip code.
+     * @return The row, or NOT_FOUND.
+     */
+    std::size_t FindZip(std::uint32_t zip) const;
+
+    /**
+     * @brief Finds the rows of many zip codes at once.
+     * @param zips The zip codes, in any order.
+     * @param rows Receives the row of every zip, or NOT_FOUND, in the order of 'zips'.
+     * @pre None.
+     * @post The queries were answered in zip order, so each search starts where the previous one ended.
+     */
+    void FindZips(const std::vector<std::uint32_t>& zips, std::vector<std::size_t>& rows) const;
+
+    std::size_t size() const;
+
+    // Column access.
+    const std::vector<std::uint32_t>& zips() const;
+    const std::vector<float>& latitudes() const;
+    const std::vector<float>& longitudes() const;
+    const std::vector<std::uint16_t>& stateIds() const;
+    const std::vector<std::uint32_t>& countyIds() const;
+
+    // Row access.
+    std::uint32_t Zip(std::size_t row) const;
+    float Latitude(std::size_t row) const;
+    float Longitude(std::size_t row) const;
+    std::string_view Name(std::size_t row) const;
+    std::string_view State(std::size_t row) const;
+    std::string_view County(std::size_t row) const;
+
+    // Dictionaries.
+    std::size_t stateCount() const;
+    std::size_t countyCount() const;
+    std::string_view StateName(std::uint16_t stateId) const;
+    std::string_view CountyName(std::uint32_t countyId) const;
+
+    /**
+     * @brief Bytes held by the columns, dictionaries and name blob.
+     */
+    std::size_t MemoryBytes() const;
+
+    /**
+     * @brief Removes every row and dictionary entry.
+     */
+    void clear();
+
+private:
+    std::vector<std::uint32_t> zipColumn;       /**< Zip code of every row. */
+    std::vector<float> latitudeColumn;          /**< Latitude of every row. */
+    std::vector<float> longitudeColumn;         /**< Longitude of every row. */
+    std::vector<std::uint16_t> stateColumn;     /**< State id of every row. */
+    std::vector<std::uint32_t> countyColumn;    /**< County id of every row. */
+    std::vector<std::uint32_t> nameOffsets;     /**< Start of every name in 'names', plus the end of the last. */
+    std::string names;                          /**< Place names, back to back. */
+    FieldDictionary states;                     /**< State abbreviations. */
+    FieldDictionary counties;                   /**< County names. */
+    bool zipsSorted;                            /**< True while the zip column is in ascending order. */
+    std::vector<std::uint32_t> zipOrder;        /**< Rows by ascending zip when the zip column is not sorted. */
+
+    bool addRecord(std::string_view record, const RecordDictionary* dictionary);
+    void indexZips();
+};
+
+#endif //ZIPCODES_ZIPTABLE_H
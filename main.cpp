@@ -13,16 +13,27 @@
  * location name alphabetically A-Z. The two running's are compared to ensure that their output is the same.
  */
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <map>
 #include <string>
 #include <iomanip>
+#include <thread>
+#include "BufferPool.h"
 #include "CSVReader.h"
 #include "CommandLineReader.h"
+#include "StateExtremes.h"
 
 // Declaration for analyzeCSV
 void analyzeCSV(CSVReader &file);
 
+// Declaration for runBatch
+int runBatch(int argc, char* argv[]);
+
 
 
 /**
@@ -30,10 +41,19 @@ void analyzeCSV(CSVReader &file);
  * @details This function creates a CSVReader object, opens a CSV file, reads and
  * processes the data, and displays state statistics. 
  * It also makes a CommandLineReader instance to check for zipcodes and if location is present
+ * With --batch the statistics and the menu are skipped and queries are answered from a stream instead.
+ * @param argc Number of command line arguments.
+ * @param argv The arguments: none, or --batch [queryFile] [--threads N].
  * @return 0 on success, 1 on failure (e.g., if the CSV file cannot be opened).
  */
-int main() {
+int main(int argc, char* argv[]) {
     //RunTest();
+    // Data file and index pages are cached in one pool; its budget is fixed before the first lookup.
+    BufferPool::ConfigureShared(std::size_t(32) << 20);
+    if (argc > 1 && std::string(argv[1]) == "--batch") {
+        return runBatch(argc, argv);
+    }
+
     // Create a CSVReader object and open a CSV file
     std::string file = "us_postal_codes.csv";
     std::cout << "Processing us_postal_codes.csv. \n" << std::endl;
@@ -66,12 +86,61 @@ void analyzeCSV(CSVReader &csvReader) {
         std::cerr << "Failed to open CSV file." << std::endl;
         return;
     }
-    // Read and process the CSV file.
-    csvReader.ReadFile();
-
+    // Read and process the CSV file in one pass, then print the extremes of every state.
+    StateExtremes extremes;
+    csvReader.ReadFile(extremes);
+    extremes.Print(std::cout);
+    std::cout << extremes.rowCount() << " rows analyzed.\n" << std::endl;
 
     // Close the CSV file.
     csvReader.close();
 }
 
-
+/**
+ * @brief Answers the queries of a file, or of standard input, in batch mode.
+ * @param argc Number of command line arguments.
+ * @param argv The arguments: --batch, then an optional query file ("-" for standard input) and
+ * an optional --threads N, where 0 uses every hardware thread.
+ * @return 0 on success, 1 if the query file cannot be opened or N is not a thread count.
+ * @pre argv[1] is --batch.
+ * @post One answer line per query was written to standard output.
+ */
+int runBatch(int argc, char* argv[]) {
+    std::string queryFile = "-";
+    unsigned threads = 1;
+    for (int i = 2; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--threads") {
+            // strtoul() accepts a sign and stops at the first non-digit, so the whole value is checked.
+            const char* value = i + 1 < argc ? argv[++i] : "";
+            char* end = nullptr;
+            errno = 0;
+            const unsigned long count = std::strtoul(value, &end, 10);
+            if (!std::isdigit(static_cast<unsigned char>(value[0])) || *end != '\0' || errno == ERANGE
+                || count > CommandLineReader::MAX_BATCH_THREADS) {
+                std::cerr << "Error: --threads takes a number from 0 to " << CommandLineReader::MAX_BATCH_THREADS
+                          << "; 0 uses every hardware thread." << std::endl;
+                return 1;
+            }
+            threads = static_cast<unsigned>(count);
+            if (threads == 0) {
+                threads = std::max(std::thread::hardware_concurrency(), 1u);
+            }
+        } else {
+            queryFile = argument;
+        }
+    }
+    // The answers are written in large blocks, so the C streams need not be kept in step.
+    std::ios::sync_with_stdio(false);
+    std::ifstream queries;
+    if (queryFile != "-") {
+        queries.open(queryFile);
+        if (!queries.is_open()) {
+            std::cerr << "Failed to open query file." << std::endl;
+            return 1;
+        }
+    }
+    CommandLineReader cmdReader;
+    cmdReader.RunBatch(queryFile == "-" ? std::cin : queries, std::cout, threads);
+    return 0;
+}
@@ -0,0 +1,174 @@
+/**
+ * @file BPlusTreeTest.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Checks BPlusTree: bulk load, inserts that split leaves and internal pages, erase, scan and reopen.
+ * @details Built with -I.. against every source file of the parent directory except main.cpp.
+ * The program writes its files to the working directory, removes them again, prints each difference it
+ * finds and returns 1, or returns 0.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "BPlusTree.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+const std::string TREE_FILE = "BPlusTreeTest.bpt";
+
+/**
+ * @brief Enough keys for the root to split twice: the tree grows to three levels.
+ */
+constexpr std::uint64_t KEY_COUNT = 30000;
+
+std::string keyOf(std::uint64_t number) {
+    std::string key = std::to_string(number);
+    return std::string(6 - key.size(), '0') + key;
+}
+
+KeyIndexEntry makeEntry(std::uint64_t number, std::uint64_t offset) {
+    KeyIndexEntry entry;
+    entry.SetKey(keyOf(number));
+    entry.offset = offset;
+    entry.length = 10;
+    entry.reserved = 0;
+    return entry;
+}
+
+/**
+ * @brief Offset the tree finds for a key, or UINT64_MAX if it finds none.
+ */
+std::uint64_t offsetOf(const BPlusTree& tree, std::uint64_t number) {
+    KeyIndexEntry entry;
+    return tree.Find(keyOf(number), entry) ? entry.offset : UINT64_MAX;
+}
+
+/**
+ * @brief Checks that a scan visits exactly the keys 'present' names, in order, with their offsets.
+ */
+void checkScan(const BPlusTree& tree, const std::vector<bool>& present, std::uint64_t offsetBase,
+               const std::string& what) {
+    std::uint64_t expected = 0;
+    bool inOrder = true;
+    const bool read = tree.Scan("", [&](const KeyIndexEntry& entry) {
+        while (expected < present.size() && !present[expected]) {
+            expected++;
+        }
+        inOrder = inOrder && expected < present.size() && entry.Key() == keyOf(expected)
+                  && entry.offset == offsetBase + expected;
+        expected++;
+        return true;
+    });
+    while (expected < present.size() && !present[expected]) {
+        expected++;
+    }
+    check(read && inOrder && expected == present.size(), what);
+}
+
+/**
+ * @brief Inserts every key into an empty tree, in random order, then erases every third one.
+ */
+void checkInsertAndErase() {
+    std::remove(TREE_FILE.c_str());
+    check(BPlusTree::Build(TREE_FILE, {}, 0), "an empty tree is built");
+    std::vector<std::uint64_t> order(KEY_COUNT);
+    for (std::uint64_t i = 0; i < KEY_COUNT; i++) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(7));
+
+    std::vector<bool> present(KEY_COUNT, false);
+    {
+        BPlusTree tree;
+        check(tree.Open(TREE_FILE, true) && tree.size() == 0 && tree.height() == 1, "the empty tree is one leaf");
+        bool inserted = true;
+        for (std::uint64_t number : order) {
+            inserted = inserted && tree.Insert(makeEntry(number, 1000 + number));
+            present[number] = true;
+        }
+        check(inserted, "every insert is written");
+        check(tree.size() == KEY_COUNT, "the tree counts every inserted key");
+        check(tree.height() == 3, "the splits grow the tree to three levels");
+        bool found = true;
+        for (std::uint64_t number = 0; number < KEY_COUNT; number++) {
+            found = found && offsetOf(tree, number) == 1000 + number;
+        }
+        check(found, "every inserted key is found");
+        check(offsetOf(tree, KEY_COUNT) == UINT64_MAX, "a key never inserted is not found");
+        checkScan(tree, present, 1000, "a scan returns the inserted keys in order");
+
+        check(tree.Insert(makeEntry(42, 5)) && offsetOf(tree, 42) == 5 && tree.size() == KEY_COUNT,
+              "inserting an existing key points it at the new record");
+        check(tree.Insert(makeEntry(42, 1042)), "the key is pointed back");
+
+        bool erased = true;
+        for (std::uint64_t number = 0; number < KEY_COUNT; number += 3) {
+            erased = erased && tree.Erase(keyOf(number));
+            present[number] = false;
+        }
+        check(erased, "every erase removes its key");
+        check(!tree.Erase(keyOf(0)), "erasing a missing key fails");
+        check(offsetOf(tree, 3) == UINT64_MAX && offsetOf(tree, 4) == 1004, "an erase removes only its key");
+    }
+
+    BPlusTree reopened;
+    check(reopened.Open(TREE_FILE) && reopened.size() == KEY_COUNT - (KEY_COUNT + 2) / 3,
+          "the changes are in the file");
+    checkScan(reopened, present, 1000, "a scan of the reopened tree skips the erased keys");
+    std::uint64_t seen = 0;
+    reopened.Scan(keyOf(KEY_COUNT - 5), [&](const KeyIndexEntry&) {
+        seen++;
+        return true;
+    });
+    check(seen == static_cast<std::uint64_t>(std::count(present.end() - 5, present.end(), true)),
+          "a scan starts at the first key not below its start");
+    reopened.close();
+    std::remove(TREE_FILE.c_str());
+}
+
+/**
+ * @brief Inserts into a bulk-loaded tree, whose leaves are full, so the first insert into each leaf splits it.
+ */
+void checkInsertIntoBuiltTree() {
+    std::remove(TREE_FILE.c_str());
+    std::vector<KeyIndexEntry> entries;
+    std::vector<bool> present(KEY_COUNT, false);
+    for (std::uint64_t number = 0; number < KEY_COUNT; number += 2) {
+        entries.push_back(makeEntry(number, 1000 + number));
+        present[number] = true;
+    }
+    check(BPlusTree::Build(TREE_FILE, entries, 6), "the tree is bulk-loaded");
+    BPlusTree tree;
+    check(tree.Open(TREE_FILE, true) && tree.keyField() == 6 && tree.size() == entries.size(),
+          "the bulk-loaded tree is opened");
+    bool inserted = true;
+    for (std::uint64_t number = 1; number < KEY_COUNT; number += 2) {
+        inserted = inserted && tree.Insert(makeEntry(number, 1000 + number));
+        present[number] = true;
+    }
+    check(inserted && tree.size() == KEY_COUNT, "keys between the loaded ones are inserted");
+    checkScan(tree, present, 1000, "a scan after the splits returns every key in order");
+    tree.close();
+    std::remove(TREE_FILE.c_str());
+}
+
+} // namespace
+
+int main() {
+    checkInsertAndErase();
+    checkInsertIntoBuiltTree();
+    return failures == 0 ? 0 : 1;
+}
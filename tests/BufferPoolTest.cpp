@@ -0,0 +1,146 @@
+/**
+ * @file BufferPoolTest.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Checks BufferPool: shared registrations, CLOCK eviction with a second chance, pinning and
+ * invalidation.
+ * @details Built with -I.. against every source file of the parent directory except main.cpp.
+ * The program writes its files to the working directory, removes them again, prints each difference it
+ * finds and returns 1, or returns 0.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "BufferPool.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+const std::string DATA_FILE = "BufferPoolTest.dat";
+constexpr std::size_t PAGE = 4096;
+constexpr std::size_t FRAMES = 4;
+constexpr std::size_t PAGES = 8;
+
+/**
+ * @brief Writes PAGES pages; every byte of page i is 'a' + i.
+ */
+bool writeFile() {
+    std::ofstream out(DATA_FILE, std::ios::binary | std::ios::trunc);
+    for (std::size_t page = 0; page < PAGES; page++) {
+        out << std::string(PAGE, static_cast<char>('a' + page));
+    }
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief Reads the first byte of a page through the pool, or 0 if the read failed.
+ */
+char firstByte(BufferPool& pool, BufferPool::FileId file, std::uint64_t page) {
+    char byte = 0;
+    return pool.Read(file, page * PAGE, &byte, 1) ? byte : 0;
+}
+
+/**
+ * @brief Whether a page is cached: pinning it is a hit. The pin is released at once.
+ */
+bool isCached(BufferPool& pool, BufferPool::FileId file, std::uint64_t page) {
+    const std::uint64_t before = pool.hits();
+    BufferPool::PageRef ref = pool.Pin(file, page);
+    return ref && pool.hits() == before + 1;
+}
+
+void checkRegistration() {
+    BufferPool pool(FRAMES * PAGE, PAGE);
+    const BufferPool::FileId file = pool.OpenFile(DATA_FILE);
+    check(file != BufferPool::NO_FILE, "the file is registered");
+    check(pool.OpenFile(DATA_FILE) == file, "a second registration of the file shares its id");
+    check(pool.OpenFile("BufferPoolTest.missing") == BufferPool::NO_FILE, "a missing file is not registered");
+    check(firstByte(pool, file, 1) == 'b' && pool.misses() == 1, "the first read of a page misses");
+    pool.CloseFile(file);
+    check(isCached(pool, file, 1), "the pages stay while one registration is left");
+    pool.CloseFile(file);
+    check(pool.residentPages() == 0 && !pool.Pin(file, 1), "the last CloseFile() drops the pages and the file");
+}
+
+void checkEviction() {
+    BufferPool pool(FRAMES * PAGE, PAGE);
+    check(pool.capacity() == FRAMES && pool.budget() == FRAMES * PAGE, "the budget buys whole frames");
+    const BufferPool::FileId file = pool.OpenFile(DATA_FILE);
+    bool read = true;
+    for (std::uint64_t page = 0; page < FRAMES; page++) {
+        read = read && firstByte(pool, file, page) == static_cast<char>('a' + page);
+    }
+    check(read && pool.misses() == FRAMES && pool.evictions() == 0, "the free frames are filled first");
+    check(firstByte(pool, file, 2) == 'c' && pool.hits() == 1, "a cached page is a hit");
+
+    // Every frame was read since the hand passed, so the hand clears them all and takes the first.
+    check(firstByte(pool, file, 4) == 'e' && pool.evictions() == 1 && pool.residentPages() == FRAMES,
+          "a full pool evicts one page for a new one");
+    // Page 1 is read again, so the hand passes it and evicts page 2 for the next miss.
+    check(firstByte(pool, file, 1) == 'b', "page 1 is read again");
+    check(firstByte(pool, file, 5) == 'f' && pool.evictions() == 2, "a second page is evicted");
+    check(isCached(pool, file, 1), "a page read since the hand passed gets a second chance");
+    check(!isCached(pool, file, 2), "a page not read since the hand passed is evicted");
+
+    // A pinned page stays whatever else is read.
+    {
+        BufferPool::PageRef pinned = pool.Pin(file, 7);
+        check(pinned && pinned.size() == PAGE && pinned.data()[0] == 'h', "a pinned page holds its bytes");
+        for (std::uint64_t page = 0; page < PAGES - 1; page++) {
+            firstByte(pool, file, page);
+        }
+        check(pinned.data()[PAGE - 1] == 'h', "a pinned page is never evicted");
+    }
+
+    // With every frame pinned, a read goes around the pool rather than failing.
+    std::vector<BufferPool::PageRef> pins;
+    for (std::uint64_t page = 0; page < FRAMES; page++) {
+        pins.push_back(pool.Pin(file, page));
+    }
+    check(!pool.Pin(file, 6), "no page can be pinned when every frame is pinned");
+    check(firstByte(pool, file, 6) == 'g', "a read with every frame pinned goes to the file");
+    pins.clear();
+    pool.CloseFile(file);
+}
+
+void checkInvalidation() {
+    BufferPool pool(FRAMES * PAGE, PAGE);
+    const BufferPool::FileId file = pool.OpenFile(DATA_FILE);
+    check(firstByte(pool, file, 0) == 'a' && firstByte(pool, file, 1) == 'b', "pages 0 and 1 are cached");
+    {
+        // A writer changes the last byte of page 0 and the first of page 1.
+        std::fstream out(DATA_FILE, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(PAGE - 1);
+        out.write("XY", 2);
+    }
+    char bytes[2] = {};
+    check(pool.Read(file, PAGE - 1, bytes, 2) && bytes[0] == 'a' && bytes[1] == 'b',
+          "cached pages hide a write that was not invalidated");
+    pool.Invalidate(file, PAGE - 1, 2);
+    check(pool.residentPages() == 0, "both pages the write touched are dropped");
+    check(pool.Read(file, PAGE - 1, bytes, 2) && bytes[0] == 'X' && bytes[1] == 'Y',
+          "the next read sees the write");
+    pool.CloseFile(file);
+}
+
+} // namespace
+
+int main() {
+    check(writeFile(), "the data file is written");
+    checkRegistration();
+    checkEviction();
+    checkInvalidation();
+    std::remove(DATA_FILE.c_str());
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+/**
+ * @file CompactorTest.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Checks that Compactor replaces a changed data file and its tree or binary index, and that Recover()
+ * finishes or undoes an interrupted swap.
+ * @details Built with -I.. against every source file of the parent directory except main.cpp.
+ * The program writes its files to the working directory, removes them again, prints each difference it
+ * finds and returns 1, or returns 0.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Compactor.h"
+#include "FileLock.h"
+#include "HeaderRecord.h"
+#include "MutableDataFile.h"
+#include "PrimaryKeyIndex.h"
+#include "RecordWriter.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+const std::string DATA_FILE = "CompactorTest.dat";
+const std::string INDEX_FILE = "CompactorTest.idx";
+const std::string TREE_FILE = "CompactorTest.bpt";
+
+const std::vector<std::string> ROWS = {
+    "01002,Amherst,MA,Hampshire,42.3671,-72.4646",
+    "01003,Amherst,MA,Hampshire,42.3919,-72.5248",
+    "01004,Amherst,MA,Hampshire,42.3845,-72.5132",
+    "01005,Barre,MA,Worcester,42.4097,-72.1084",
+};
+
+bool exists(const std::string& fileName) {
+    return std::ifstream(fileName).is_open();
+}
+
+void removeFiles() {
+    for (const std::string& name : {DATA_FILE, INDEX_FILE, TREE_FILE}) {
+        std::remove(name.c_str());
+        std::remove((name + Compactor::TEMP_SUFFIX).c_str());
+    }
+    std::remove((INDEX_FILE + PrimaryKeyIndex::LOG_SUFFIX).c_str());
+    std::remove((DATA_FILE + Compactor::SWAP_SUFFIX).c_str());
+    std::remove((DATA_FILE + FileLock::LOCK_SUFFIX).c_str());
+}
+
+/**
+ * @brief Writes 'rows' as a data file.
+ * @return The index entries of the rows.
+ */
+std::vector<KeyIndexEntry> writeData(const std::string& fileName, const std::vector<std::string>& rows) {
+    std::vector<KeyIndexEntry> entries;
+    RecordWriter writer(RecordWriter::DEFAULT_BUFFER_SIZE, LengthIndicator::DEFAULT);
+    check(writer.Open(fileName), "the data file is created: " + fileName);
+    for (const std::string& row : rows) {
+        std::uint64_t offset;
+        KeyIndexEntry entry;
+        check(writer.Write(row, offset) && PrimaryKeyIndex::MakeEntry(row, offset, entry, 0),
+              "row is written: " + row);
+        entries.push_back(entry);
+    }
+    check(writer.Close(), "the data file is closed: " + fileName);
+    return entries;
+}
+
+/**
+ * @brief Looks a zip up through whichever index OpenIndexFor() opens.
+ * @return The record, or an empty string if the zip was not found.
+ */
+std::string search(const std::string& zip) {
+    PrimaryKeyIndex index;
+    std::string record;
+    if (!index.OpenIndexFor(DATA_FILE, HeaderRecord(), INDEX_FILE, TREE_FILE) || !index.OpenDataFile(DATA_FILE)
+        || !index.SearchIndex(zip, record)) {
+        return std::string();
+    }
+    return record;
+}
+
+/**
+ * @brief Compacts a file whose index is a tree changed in place by MutableDataFile. Fewer than
+ * PrimaryKeyIndex::TREE_MIN_KEYS keys are left, so the swap replaces the tree with a binary index.
+ */
+void checkTreeCompaction() {
+    removeFiles();
+    {
+        PrimaryKeyIndex index;
+        check(index.WriteIndexTree(writeData(DATA_FILE, ROWS), TREE_FILE, 0), "the tree is written");
+    }
+    const std::string longer = "01004,North Amherst,MA,Hampshire,42.3845,-72.5132";
+    const std::string appended = "01010,Brimfield,MA,Hampden,42.1165,-72.1884";
+    {
+        PrimaryKeyIndex index;
+        MutableDataFile data;
+        check(index.OpenIndexTree(TREE_FILE, true) && data.Open(DATA_FILE, index), "the files are opened for changes");
+        check(data.Delete("01003"), "delete");
+        check(data.Update(longer), "update that relocates the record");
+        check(data.Append(appended), "append");
+    }
+
+    Compactor compactor(0);
+    check(compactor.Compact(DATA_FILE, INDEX_FILE, TREE_FILE), "the tree-indexed file is compacted");
+    check(compactor.recordsCopied() == 4 && compactor.bytesReclaimed() > 0, "only the live records are copied");
+    check(!exists(TREE_FILE) && exists(INDEX_FILE), "the tree is replaced by a binary index");
+    check(!exists(DATA_FILE + Compactor::SWAP_SUFFIX) && !exists(DATA_FILE + Compactor::TEMP_SUFFIX)
+          && !exists(INDEX_FILE + Compactor::TEMP_SUFFIX), "the swap leaves no marker or copies");
+    check(search("01002") == ROWS[0], "an unchanged record is found after the compaction");
+    check(search("01003").empty(), "a deleted record is not found after the compaction");
+    check(search("01004") == longer, "a relocated record is found after the compaction");
+    check(search("01005") == ROWS[3], "a record after a dead one is found after the compaction");
+    check(search("01010") == appended, "an appended record is found after the compaction");
+    removeFiles();
+}
+
+/**
+ * @brief Recover() installs the copies of a committed swap, whatever the form of their index, and removes
+ * the copies of one that was never committed.
+ */
+void checkRecovery() {
+    removeFiles();
+    // The old pair: the data file with a binary index.
+    {
+        PrimaryKeyIndex index;
+        check(index.WriteIndex(writeData(DATA_FILE, ROWS), INDEX_FILE), "the old index is written");
+    }
+    // Copies left by a compaction that crashed before its marker was written.
+    const std::vector<std::string> live = {ROWS[0], ROWS[3]};
+    {
+        PrimaryKeyIndex index;
+        check(index.WriteIndexTree(writeData(DATA_FILE + Compactor::TEMP_SUFFIX, live),
+                                   TREE_FILE + Compactor::TEMP_SUFFIX, 0), "the uncommitted copies are written");
+    }
+    check(Compactor::Recover(DATA_FILE, INDEX_FILE, TREE_FILE), "recovery without a marker");
+    check(!exists(DATA_FILE + Compactor::TEMP_SUFFIX) && !exists(TREE_FILE + Compactor::TEMP_SUFFIX)
+          && !exists(TREE_FILE), "uncommitted copies are removed");
+    check(search("01003") == ROWS[1], "the old files are kept when the swap was not committed");
+
+    // The same copies after the marker committed them, with a tree as the new index.
+    {
+        PrimaryKeyIndex index;
+        check(index.WriteIndexTree(writeData(DATA_FILE + Compactor::TEMP_SUFFIX, live),
+                                   TREE_FILE + Compactor::TEMP_SUFFIX, 0), "the committed copies are written");
+        std::ofstream(DATA_FILE + Compactor::SWAP_SUFFIX) << "tree";
+    }
+    check(Compactor::Recover(DATA_FILE, INDEX_FILE, TREE_FILE), "recovery with a marker");
+    check(exists(TREE_FILE) && !exists(INDEX_FILE) && !exists(DATA_FILE + Compactor::SWAP_SUFFIX),
+          "the tree replaces the binary index and the marker is removed");
+    check(search("01005") == ROWS[3], "a live record is found in the recovered files");
+    check(search("01003").empty(), "a record the compaction dropped is not found in the recovered files");
+    removeFiles();
+}
+
+} // namespace
+
+int main() {
+    checkTreeCompaction();
+    checkRecovery();
+    return failures == 0 ? 0 : 1;
+}
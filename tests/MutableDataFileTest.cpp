@@ -0,0 +1,100 @@
+/**
+ * @file MutableDataFileTest.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Checks that lookups through the shared BufferPool see the changes of a MutableDataFile.
+ * @details Built with -I.. against every source file of the parent directory except main.cpp.
+ * The program writes its files to the working directory, removes them again, prints each difference it
+ * finds and returns 1, or returns 0.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "FileLock.h"
+#include "MutableDataFile.h"
+#include "PrimaryKeyIndex.h"
+#include "RecordWriter.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+const std::string DATA_FILE = "MutableDataFileTest.dat";
+const std::string INDEX_FILE = "MutableDataFileTest.idx";
+
+void removeFiles() {
+    std::remove(DATA_FILE.c_str());
+    std::remove(INDEX_FILE.c_str());
+    std::remove((INDEX_FILE + ".log").c_str());
+    std::remove((DATA_FILE + FileLock::LOCK_SUFFIX).c_str());
+}
+
+/**
+ * @brief Looks a zip up through the index and the pool.
+ * @return The record, or an empty string if the zip was not found.
+ */
+std::string search(const PrimaryKeyIndex& index, const std::string& zip) {
+    std::string record;
+    return index.SearchIndex(zip, record) ? record : std::string();
+}
+
+} // namespace
+
+int main() {
+    removeFiles();
+    const std::vector<std::string> rows = {
+        "01002,Amherst,MA,Hampshire,42.3671,-72.4646",
+        "01003,Amherst,MA,Hampshire,42.3919,-72.5248",
+        "01004,Amherst,MA,Hampshire,42.3845,-72.5132",
+    };
+    {
+        RecordWriter writer(RecordWriter::DEFAULT_BUFFER_SIZE, LengthIndicator::DEFAULT);
+        check(writer.Open(DATA_FILE), "the data file is created");
+        for (const std::string& row : rows) {
+            std::uint64_t offset;
+            check(writer.Write(row, offset), "row is written: " + row);
+        }
+        check(writer.Close(), "the data file is closed");
+    }
+
+    PrimaryKeyIndex index;
+    check(index.WriteIndex(index.BuildIndexEntries(DATA_FILE), INDEX_FILE), "the index is written");
+    check(index.OpenIndex(INDEX_FILE) && index.OpenDataFile(DATA_FILE), "the index and data file are opened");
+    // Every record is read once, so the pool holds the pages the changes below overwrite.
+    for (const std::string& row : rows) {
+        check(search(index, row.substr(0, 5)) == row, "found before the changes: " + row);
+    }
+
+    {
+        MutableDataFile data;
+        check(data.Open(DATA_FILE, index), "the data file is opened for changes");
+
+        const std::string sameLength = "01003,Amherst,MA,Hampshire,42.3919,-72.5249";
+        check(data.Update(sameLength), "update in place");
+        check(search(index, "01003") == sameLength, "an update in place is seen");
+
+        const std::string longer = "01004,North Amherst,MA,Hampshire,42.3845,-72.5132";
+        check(data.Update(longer), "update that relocates the record");
+        check(search(index, "01004") == longer, "a relocated record is seen");
+
+        check(data.Delete("01002"), "delete");
+        check(search(index, "01002").empty(), "a deleted record is not found");
+
+        const std::string appended = "01005,Barre,MA,Worcester,42.4097,-72.1084";
+        check(data.Append(appended), "append into the freed slot");
+        check(search(index, "01005") == appended, "an appended record is seen");
+        check(search(index, "01002").empty(), "the freed slot does not bring back its old record");
+    }
+
+    removeFiles();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file PrimaryKeyIndexTest.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Checks the delta log of PrimaryKeyIndex: changes under either spelling of a zip, replay and checkpoint.
+ * @details Built with -I.. against every source file of the parent directory except main.cpp.
+ * The program writes its files to the working directory, removes them again, prints each difference it
+ * finds and returns 1, or returns 0.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "PrimaryKeyIndex.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+const std::string INDEX_FILE = "PrimaryKeyIndexTest.idx";
+
+void removeFiles() {
+    std::remove(INDEX_FILE.c_str());
+    std::remove((INDEX_FILE + ".log").c_str());
+}
+
+KeyIndexEntry makeEntry(const std::string& key, std::uint64_t offset) {
+    KeyIndexEntry entry;
+    entry.SetKey(key);
+    entry.offset = offset;
+    entry.length = 10;
+    entry.reserved = 0;
+    return entry;
+}
+
+/**
+ * @brief Offset the index finds for a key, or UINT64_MAX if it finds none.
+ */
+std::uint64_t offsetOf(const PrimaryKeyIndex& index, const std::string& key) {
+    KeyIndexEntry entry;
+    return index.FindKey(key, entry) ? entry.offset : UINT64_MAX;
+}
+
+/**
+ * @brief Runs the checks with or without the ZipKeyIndex copy of the keys.
+ */
+void checkDelta(bool zipKeys) {
+    const std::string mode = zipKeys ? " (zip keys)" : " (mapped index)";
+    removeFiles();
+    // The source CSV writes zips without their leading zeros.
+    const std::vector<KeyIndexEntry> entries = {makeEntry("501", 100), makeEntry("602", 200),
+                                                makeEntry("1002", 300)};
+    PrimaryKeyIndex index;
+    check(index.WriteIndex(entries, INDEX_FILE), "the index is written" + mode);
+    check(index.OpenIndex(INDEX_FILE, zipKeys), "the index is opened" + mode);
+    // Only the ZipKeyIndex matches the base index across spellings; the delta does in both modes.
+    check(offsetOf(index, zipKeys ? "00501" : "501") == 100, "the base index finds its key" + mode);
+
+    check(index.PutKey(makeEntry("00501", 150)), "put under the padded spelling" + mode);
+    check(offsetOf(index, "501") == 150, "a put is seen under the other spelling" + mode);
+    check(index.EraseKey("602"), "erase under the short spelling" + mode);
+    check(offsetOf(index, "00602") == UINT64_MAX, "an erase is seen under the padded spelling" + mode);
+    check(index.deltaSize() == 2, "both spellings share one change" + mode);
+
+    PrimaryKeyIndex replayed;
+    check(replayed.OpenIndex(INDEX_FILE, zipKeys), "the index is reopened" + mode);
+    check(offsetOf(replayed, "00501") == 150, "the log replays the put" + mode);
+    check(offsetOf(replayed, "602") == UINT64_MAX, "the log replays the erase" + mode);
+
+    check(replayed.Checkpoint() && replayed.deltaSize() == 0, "the checkpoint merges the log" + mode);
+    PrimaryKeyIndex merged;
+    check(merged.OpenIndex(INDEX_FILE, zipKeys), "the merged index is opened" + mode);
+    check(merged.deltaSize() == 0, "the log is empty after the checkpoint" + mode);
+    check(offsetOf(merged, "00501") == 150, "the merged index holds the put once" + mode);
+    check(offsetOf(merged, "00602") == UINT64_MAX, "the merged index lacks the erased key" + mode);
+    check(offsetOf(merged, zipKeys ? "01002" : "1002") == 300,
+          "an unchanged key survives the checkpoint" + mode);
+    removeFiles();
+}
+
+} // namespace
+
+int main() {
+    checkDelta(true);
+    checkDelta(false);
+    return failures == 0 ? 0 : 1;
+}
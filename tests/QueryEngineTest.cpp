@@ -0,0 +1,220 @@
+/**
+ * @file QueryEngineTest.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Checks the lookups of QueryEngine on a data file built by DataFileBuilder and on a changed data file,
+ * and the snapshots Reload() publishes.
+ * @details Built with -I.. against every source file of the parent directory except main.cpp.
+ * The program writes its files to the working directory, removes them again, prints each difference it
+ * finds and returns 1, or returns 0.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "CSVReader.h"
+#include "DataFileBuilder.h"
+#include "FileLock.h"
+#include "HeaderRecordBuffer.h"
+#include "MutableDataFile.h"
+#include "QueryEngine.h"
+#include "RecordWriter.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+const std::string CSV_FILE = "QueryEngineTest.csv";
+const std::string DATA_FILE = "QueryEngineTest.dat";
+const std::string NAME_FILE = "QueryEngineTest.names";
+const std::string SPATIAL_FILE = "QueryEngineTest.points";
+const std::string INDEX_FILE = "QueryEngineTest.idx";
+const std::string TREE_FILE = "QueryEngineTest.bpt";
+
+const std::vector<std::string> ROWS = {
+    "501,Holtsville,NY,Suffolk,40.8154,-73.0451",
+    "1002,Amherst,MA,Hampshire,42.3671,-72.4646",
+    "1003,Amherst,MA,Hampshire,42.3919,-72.5248",
+    "1005,Barre,MA,Worcester,42.4097,-72.1084",
+};
+
+void removeFiles() {
+    for (const std::string& name : {CSV_FILE, DATA_FILE, NAME_FILE, SPATIAL_FILE, INDEX_FILE, TREE_FILE,
+                                    INDEX_FILE + ".log", DATA_FILE + FileLock::LOCK_SUFFIX}) {
+        std::remove(name.c_str());
+    }
+}
+
+/**
+ * @brief Converts ROWS into a data file with an embedded index and builds its two other indexes.
+ * @param encoding "plain" or "dictionary".
+ */
+bool buildFiles(const std::string& encoding) {
+    {
+        std::ofstream csv(CSV_FILE, std::ios::binary);
+        csv << "Zip Code,Place Name,State,County,Lat,Long\n";
+        for (const std::string& row : ROWS) {
+            csv << row << '\n';
+        }
+    }
+    CSVReader reader(CSV_FILE);
+    HeaderRecord header;
+    header.setRecordEncoding(encoding);
+    DataFileBuilder builder(false, RecordWriter::DEFAULT_BUFFER_SIZE, 1);
+    if (!builder.Build(reader, header, DATA_FILE)) {
+        return false;
+    }
+    NameIndexBuilder names;
+    SpatialIndexBuilder points;
+    PrimaryKeyIndex keys;
+    keys.BuildIndexEntries(DATA_FILE, &names, &points, header.getLengthFormat(), 0,
+                           header.getDataSection().offset, header.getDataSize());
+    return names.Write(NAME_FILE) && points.Write(SPATIAL_FILE);
+}
+
+/**
+ * @brief Writes ROWS as a headerless data file that MutableDataFile can change, with its three indexes.
+ */
+bool buildPlainFiles() {
+    {
+        RecordWriter writer(RecordWriter::DEFAULT_BUFFER_SIZE, LengthIndicator::FIXED);
+        if (!writer.Open(DATA_FILE)) {
+            return false;
+        }
+        for (const std::string& row : ROWS) {
+            std::uint64_t offset;
+            if (!writer.Write(row, offset)) {
+                return false;
+            }
+        }
+        if (!writer.Close()) {
+            return false;
+        }
+    }
+    NameIndexBuilder names;
+    SpatialIndexBuilder points;
+    PrimaryKeyIndex keys;
+    return keys.WriteIndexFor(keys.BuildIndexEntries(DATA_FILE, &names, &points, LengthIndicator::FIXED),
+                              INDEX_FILE, TREE_FILE, 0)
+           && names.Write(NAME_FILE) && points.Write(SPATIAL_FILE);
+}
+
+QueryEngine::Files engineFiles() {
+    QueryEngine::Files files;
+    files.data = DATA_FILE;
+    files.index = INDEX_FILE;
+    files.indexTree = TREE_FILE;
+    files.nameIndex = NAME_FILE;
+    files.spatialIndex = SPATIAL_FILE;
+    files.header.clear();
+    return files;
+}
+
+/**
+ * @brief Records come back in plain form whatever the encoding of the data file.
+ */
+void checkDecoding(const std::string& encoding) {
+    removeFiles();
+    check(buildFiles(encoding), "the " + encoding + " data file is built");
+    QueryEngine engine;
+    check(engine.Load(engineFiles()), "the " + encoding + " data file is loaded");
+    for (const std::string& row : ROWS) {
+        std::string record;
+        check(engine.FindZip(row.substr(0, row.find(',')), record) && record == row,
+              "FindZip returns the plain record of a " + encoding + " file: " + row);
+    }
+    std::string record;
+    check(!engine.FindZip("99999", record), "an unknown zip is not found in a " + encoding + " file");
+    removeFiles();
+}
+
+/**
+ * @brief Place name and spatial lookups skip the places a MutableDataFile deleted or moved since the name and
+ * spatial indexes were built.
+ */
+void checkChangedRecords() {
+    removeFiles();
+    check(buildPlainFiles(), "the plain data file is built");
+    PrimaryKeyIndex index;
+    check(index.OpenIndex(INDEX_FILE), "the index is opened for changes");
+    {
+        MutableDataFile data;
+        check(data.Open(DATA_FILE, index, LengthIndicator::FIXED), "the data file is opened for changes");
+        check(data.Delete("1003"), "1003 is deleted");
+        check(data.Update("1002,Amherst,MA,Hampshire,41.3671,-72.4646"), "1002 is moved south");
+    }
+    QueryEngine engine;
+    check(engine.Load(engineFiles()), "the changed data file is loaded");
+
+    std::string record;
+    check(!engine.FindZip("1003", record), "FindZip does not find a deleted zip");
+    NamePosting posting;
+    check(!engine.FindPlace("Amherst", 42.3919f, posting), "F does not find a deleted place");
+    check(!engine.FindPlace("Amherst", 42.3671f, posting), "F does not find a place at its old latitude");
+    check(engine.FindPlace("Barre", 42.4097f, posting) && posting.Key() == "1005", "F finds an unchanged place");
+
+    SpatialPoint nearest;
+    double distance = 0.0;
+    check(engine.Nearest(42.39, -72.52, nearest, distance) && nearest.Key() == "1005",
+          "N skips the deleted and the moved place for the nearest live one");
+    std::vector<SpatialPoint> found;
+    engine.WithinRadius(42.37, -72.50, 10.0, found);
+    check(found.empty(), "R returns neither the deleted nor the moved place");
+    engine.WithinRadius(42.40, -72.11, 5.0, found);
+    check(found.size() == 1 && found[0].Key() == "1005", "R returns an unchanged place");
+    removeFiles();
+}
+
+/**
+ * @brief Reload() publishes the changes a MutableDataFile made after the engine was loaded, while a snapshot
+ * acquired before it keeps the version it was opened with.
+ */
+void checkReload() {
+    removeFiles();
+    check(buildPlainFiles(), "the plain data file is built");
+    QueryEngine engine;
+    check(engine.Load(engineFiles()) && engine.version() == 1, "the data file is loaded as version 1");
+    const std::shared_ptr<const QueryEngine::Snapshot> before = engine.Acquire();
+
+    const std::string appended = "1010,Brimfield,MA,Hampden,42.1165,-72.1884";
+    PrimaryKeyIndex index;
+    check(index.OpenIndex(INDEX_FILE), "the index is opened for changes");
+    {
+        MutableDataFile data;
+        check(data.Open(DATA_FILE, index, LengthIndicator::FIXED), "the data file is opened for changes");
+        check(data.Append(appended), "1010 is appended");
+        check(data.Delete("501"), "501 is deleted");
+    }
+    std::string record;
+    check(!engine.FindZip("1010", record), "the published snapshot does not follow the changes");
+    check(engine.Reload() && engine.version() == 2, "the changed files are published as version 2");
+    check(engine.FindZip("1010", record) && record == appended, "a record appended before Reload() is found");
+    check(!engine.FindZip("501", record), "a record deleted before Reload() is not found");
+    check(before->version() == 1 && before->FindZip("1002", record) && record == ROWS[1],
+          "a snapshot acquired before Reload() still answers");
+
+    check(index.Checkpoint() && engine.Reload() && engine.version() == 3, "the checkpointed index is published");
+    check(engine.FindZip("1010", record) && record == appended, "an appended record is found after the checkpoint");
+    check(!engine.FindZip("501", record), "a deleted record stays deleted after the checkpoint");
+    removeFiles();
+}
+
+} // namespace
+
+int main() {
+    checkDecoding("plain");
+    checkDecoding("dictionary");
+    checkChangedRecords();
+    checkReload();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file SecondaryIndexTest.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Checks the place name and spatial indexes: name, nearest and radius lookups, and the key they store.
+ * @details Built with -I.. against every source file of the parent directory except main.cpp.
+ * The program writes its files to the working directory, removes them again, prints each difference it
+ * finds and returns 1, or returns 0.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "NameIndex.h"
+#include "SpatialIndex.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+const std::string NAME_FILE = "SecondaryIndexTest.names";
+const std::string SPATIAL_FILE = "SecondaryIndexTest.points";
+
+void removeFiles() {
+    std::remove(NAME_FILE.c_str());
+    std::remove(SPATIAL_FILE.c_str());
+}
+
+/**
+ * @brief Indexes 'rows' with the key taken from 'keyField' and checks what the lookups return.
+ */
+void checkLookups(const std::vector<std::string>& rows, std::size_t keyField) {
+    const std::string mode = " (key field " + std::to_string(keyField) + ")";
+    removeFiles();
+    NameIndexBuilder names(keyField);
+    SpatialIndexBuilder points(keyField);
+    std::uint64_t offset = 0;
+    for (const std::string& row : rows) {
+        check(names.AddRecord(row, offset), "the name index takes " + row);
+        check(points.AddRecord(row, offset), "the spatial index takes " + row);
+        offset += row.size() + 1;
+    }
+    check(names.Write(NAME_FILE) && points.Write(SPATIAL_FILE), "the indexes are written" + mode);
+
+    NameIndex nameIndex;
+    SpatialIndex spatialIndex;
+    check(nameIndex.Open(NAME_FILE) && spatialIndex.Open(SPATIAL_FILE), "the indexes are opened" + mode);
+
+    NamePosting posting;
+    check(nameIndex.Find("  AMHERST ", 42.3919f, posting) && posting.Key() == "1003",
+          "a name is found in any case and spacing, the latitude picks the place" + mode);
+    check(nameIndex.Find("amherst", 42.3671f, posting) && posting.Key() == "1002",
+          "the other place of the same name" + mode);
+    check(!nameIndex.Find("Amherst", 10.0f, posting), "a latitude far from every place is not a match" + mode);
+    check(!nameIndex.Find("Springfield", 42.1f, posting), "an unknown name is not found" + mode);
+
+    SpatialPoint nearest;
+    double distance = 0.0;
+    check(spatialIndex.Nearest(42.39, -72.52, nearest, distance) && nearest.Key() == "1003" && distance < 1.0,
+          "the nearest place" + mode);
+    std::vector<SpatialPoint> found;
+    spatialIndex.WithinRadius(42.37, -72.50, 10.0, found);
+    check(found.size() == 2 && found[0].Key() == "1002" && found[1].Key() == "1003",
+          "the places within a radius, nearest first" + mode);
+    spatialIndex.WithinRadius(40.8154, -73.0451, 1.0, found);
+    check(found.size() == 1 && found[0].Key() == "501", "a radius around one place" + mode);
+    removeFiles();
+}
+
+} // namespace
+
+int main() {
+    checkLookups({
+        "501,Holtsville,NY,Suffolk,40.8154,-73.0451",
+        "1002,Amherst,MA,Hampshire,42.3671,-72.4646",
+        "1003,Amherst,MA,Hampshire,42.3919,-72.5248",
+        "1005,Barre,MA,Worcester,42.4097,-72.1084",
+    }, 0);
+    // A file whose header names the last column as its primary key.
+    checkLookups({
+        "a,Holtsville,NY,Suffolk,40.8154,-73.0451,501",
+        "b,Amherst,MA,Hampshire,42.3671,-72.4646,1002",
+        "c,Amherst,MA,Hampshire,42.3919,-72.5248,1003",
+        "d,Barre,MA,Worcester,42.4097,-72.1084,1005",
+    }, 6);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file StateExtremesTest.cpp
+ * @author Fabian MullerDahlberg
+ * @brief Checks that StateExtremes reports the same places whether rows come from AddRow() or AddTable().
+ * @details Built with -I.. against every source file of the parent directory except main.cpp.
+ * The program prints each difference it finds and returns 1, or returns 0.
+ */
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "StateExtremes.h"
+#include "ZipTable.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+bool samePlace(const StatePlace& a, const StatePlace& b) {
+    return a.zip == b.zip && a.name == b.name && a.latitude == b.latitude && a.longitude == b.longitude;
+}
+
+} // namespace
+
+int main() {
+    // The source CSV writes zips without their leading zeros.
+    const std::vector<std::string> rows = {
+        "501,Holtsville,NY,Suffolk,40.8154,-73.0451",
+        "544,Holtsville,NY,Suffolk,40.8000,-73.0500",
+        "10001,New York,NY,New York,40.7484,-73.9967",
+        "601,Adjuntas,PR,Adjuntas,18.1800,-66.7500",
+        "00602,Aguada,PR,Aguada,18.3600,-67.1800",
+    };
+
+    StateExtremes byRow;
+    ZipTable table;
+    for (const std::string& row : rows) {
+        check(byRow.AddRow(row), "AddRow accepts " + row);
+        check(table.AddRecord(row), "AddRecord accepts " + row);
+    }
+    byRow.Flush();
+
+    StateExtremes byTable;
+    check(byTable.AddTable(table) == rows.size(), "AddTable accepts every row");
+
+    const std::map<std::string, StateExtremeSet> fromRows = byRow.Results();
+    const std::map<std::string, StateExtremeSet> fromTable = byTable.Results();
+    check(fromRows.size() == fromTable.size(), "both report the same states");
+    for (const auto& [state, extremes] : fromRows) {
+        const auto other = fromTable.find(state);
+        if (other == fromTable.end()) {
+            check(false, "AddTable reports state " + state);
+            continue;
+        }
+        check(samePlace(extremes.eastern, other->second.eastern), state + " eastern place");
+        check(samePlace(extremes.western, other->second.western), state + " western place");
+        check(samePlace(extremes.northern, other->second.northern), state + " northern place");
+        check(samePlace(extremes.southern, other->second.southern), state + " southern place");
+    }
+
+    const auto ny = fromTable.find("NY");
+    check(ny != fromTable.end() && ny->second.eastern.zip == "00501", "leading zeros of 501 are kept");
+    const auto pr = fromRows.find("PR");
+    check(pr != fromRows.end() && pr->second.western.zip == "00602", "a padded zip stays padded");
+
+    return failures == 0 ? 0 : 1;
+}